@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb_bench.cpp - measures loading a register database and creating its
+ * layout with expression evaluation, e.g. the full reg_access ADB:
+ *
+ *   adb_bench tools_layouts/adb/prm/hca/ext/register_access_table.adb root 10
+ *
+ * The checksum covers the names, offsets and attributes of all the
+ * instances, so runs of different builds can be compared.
+ *
+ * usage: adb_bench <adb file> [root node] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <boost/lexical_cast.hpp>
+#include "adb_parser.h"
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void hashStr(u_int64_t *h, const string &s)
+{
+    for (size_t i = 0; i < s.size(); i++) {
+        *h = (*h ^ (u_int8_t)s[i]) * 0x100000001b3ULL;
+    }
+}
+
+static u_int64_t checksum(AdbInstance *inst, u_int64_t h, unsigned int *count)
+{
+    (*count)++;
+    hashStr(&h, inst->fullName() + ":" + boost::lexical_cast<string>(inst->offset) + "." + boost::lexical_cast<string>(inst->size));
+    for (AttrsMap::iterator it = inst->attrs.begin(); it != inst->attrs.end(); it++) {
+        hashStr(&h, it->first);
+        hashStr(&h, it->second);
+    }
+    for (size_t i = 0; i < inst->subItems.size(); i++) {
+        h = checksum(inst->subItems[i], h, count);
+    }
+    return h;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "usage: %s <adb file> [root node] [iterations]\n", argv[0]);
+        return 1;
+    }
+    string rootNode = argc > 2 ? argv[2] : "root";
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+    double loadTime = 0, layoutTime = 0;
+    u_int64_t sum = 0;
+    unsigned int count = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        Adb adb;
+        double t0 = now();
+        if (!adb.load(argv[1], false, NULL, false)) {
+            fprintf(stderr, "-E- Failed to load %s: %s\n", argv[1], adb.getLastError().c_str());
+            return 1;
+        }
+        double t1 = now();
+        AdbInstance *root = adb.createLayout(rootNode, true);
+        if (!root) {
+            fprintf(stderr, "-E- Failed to create the layout of %s: %s\n", rootNode.c_str(), adb.getLastError().c_str());
+            return 1;
+        }
+        double t2 = now();
+        loadTime += t1 - t0;
+        layoutTime += t2 - t1;
+        count = 0;
+        sum = checksum(root, 0xcbf29ce484222325ULL, &count);
+        delete root;
+    }
+
+    printf("load:   %8.2f ms\n", loadTime / iterations);
+    printf("layout: %8.2f ms (%u instances)\n", layoutTime / iterations, count);
+    printf("checksum: 0x%016llx\n", (unsigned long long)sum);
+    return 0;
+}
@@ -0,0 +1,589 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb_cache.cpp - compiled binary form of a loaded Adb project, see adb_cache.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "adb_cache.h"
+
+#define ADB_CACHE_ENV           "ADB_CACHE"
+#define ADB_CACHE_DEBUG_ENV     "ADB_CACHE_DEBUG"
+#define ADB_CACHE_EXT           ".adbc"
+#define ADB_CACHE_TMP_PREFIX    "/tmp/mstflint_adb_"
+#define ADB_CACHE_MAGIC         0x43424441 /* "ADBC" */
+#define ADB_CACHE_VERSION       1
+#define ADB_CACHE_NONE          0xffffffff
+
+enum {
+    ADB_CACHE_ADD_RESERVED = 0x1,
+    ADB_CACHE_STRICT       = 0x2
+};
+
+/*************************** Serialization ***************************/
+/* Host endian, a cache written on another architecture fails the magic check */
+class AdbCacheWriter {
+public:
+    void u32(u_int32_t val) {
+        _buf.append((const char*)&val, sizeof(val));
+    }
+    void u64(u_int64_t val) {
+        _buf.append((const char*)&val, sizeof(val));
+    }
+    void str(const string &s) {
+        u32(s.size());
+        _buf.append(s);
+    }
+    void attrs(const AttrsMap &attrs) {
+        u32(attrs.size());
+        for (AttrsMap::const_iterator it = attrs.begin(); it != attrs.end(); it++) {
+            str(it->first);
+            str(it->second);
+        }
+    }
+
+    string _buf;
+};
+
+class AdbCacheReader {
+public:
+    AdbCacheReader(const char *data, size_t size) :
+        _p(data), _end(data + size), _ok(true) {
+    }
+    u_int32_t u32() {
+        u_int32_t val = 0;
+        get(&val, sizeof(val));
+        return val;
+    }
+    u_int64_t u64() {
+        u_int64_t val = 0;
+        get(&val, sizeof(val));
+        return val;
+    }
+    string str() {
+        u_int32_t len = u32();
+        if (!_ok || len > (size_t)(_end - _p)) {
+            _ok = false;
+            return string();
+        }
+        string s(_p, len);
+        _p += len;
+        return s;
+    }
+    void attrs(AttrsMap &attrs) {
+        u_int32_t num = u32();
+        for (u_int32_t i = 0; _ok && i < num; i++) {
+            string key = str();
+            // keys were written in order, so insertion at the end is O(1)
+            attrs.insert(attrs.end(), AttrsMap::value_type(key, str()));
+        }
+    }
+    bool ok() {
+        return _ok;
+    }
+
+private:
+    void get(void *dst, size_t len) {
+        if (!_ok || len > (size_t)(_end - _p)) {
+            _ok = false;
+            return;
+        }
+        memcpy(dst, _p, len);
+        _p += len;
+    }
+
+    const char *_p;
+    const char *_end;
+    bool _ok;
+};
+
+static u_int64_t fnv1a(const u_int8_t *data, size_t len, u_int64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static double timeMs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void writeField(AdbCacheWriter &w, AdbField *field)
+{
+    w.str(field->name);
+    w.u32(field->size);
+    w.u32(field->offset);
+    w.str(field->desc);
+    w.u32(field->definedAsArr);
+    w.u32(field->lowBound);
+    w.u32(field->highBound);
+    w.u32(field->unlimitedArr);
+    w.str(field->subNode);
+    w.attrs(field->attrs);
+    w.u32(field->isReserved);
+    w.str(field->condition);
+}
+
+static AdbField* readField(AdbCacheReader &r)
+{
+    AdbField *field = new AdbField;
+    field->name = r.str();
+    field->size = r.u32();
+    field->offset = r.u32();
+    field->desc = r.str();
+    field->definedAsArr = r.u32();
+    field->lowBound = r.u32();
+    field->highBound = r.u32();
+    field->unlimitedArr = r.u32();
+    field->subNode = r.str();
+    r.attrs(field->attrs);
+    field->isReserved = r.u32();
+    field->condition = r.str();
+    return field;
+}
+
+static void writeFields(AdbCacheWriter &w, FieldsList &fields)
+{
+    w.u32(fields.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+        writeField(w, fields[i]);
+    }
+}
+
+static void readFields(AdbCacheReader &r, FieldsList &fields)
+{
+    u_int32_t num = r.u32();
+    for (u_int32_t i = 0; r.ok() && i < num; i++) {
+        fields.push_back(readField(r));
+    }
+}
+
+static void clearAdb(Adb *adb)
+{
+    for (size_t i = 0; i < adb->configs.size(); i++) {
+        delete adb->configs[i];
+    }
+    for (NodesMap::iterator it = adb->nodesMap.begin(); it != adb->nodesMap.end(); it++) {
+        delete it->second;
+    }
+    adb->configs.clear();
+    adb->nodesMap.clear();
+    adb->instAttrs.clear();
+    adb->includePaths.clear();
+    adb->includedFiles.clear();
+    adb->warnings.clear();
+}
+
+/*************************** AdbCache ***************************/
+/**
+ * Function: AdbCache::AdbCache
+ **/
+AdbCache::AdbCache(const string &adbFile, bool addReserved, bool strict) :
+    _adbFile(adbFile), _addReserved(addReserved), _strict(strict) {
+    const char *env = getenv(ADB_CACHE_ENV);
+    _debug = getenv(ADB_CACHE_DEBUG_ENV) != NULL;
+    if (env && *env) {
+        if (strcmp(env, "0")) {
+            _cacheFiles.push_back(env);
+        }
+    } else {
+        _cacheFiles.push_back(defaultCacheFile(adbFile));
+        _cacheFiles.push_back(tmpCacheFile(adbFile));
+    }
+    _cacheFile = _cacheFiles.empty() ? "" : _cacheFiles[0];
+}
+
+/**
+ * Function: AdbCache::defaultCacheFile
+ **/
+string AdbCache::defaultCacheFile(const string &adbFile) {
+    string cacheFile = adbFile;
+    size_t extPos = cacheFile.rfind(".adb");
+    if (extPos != string::npos && extPos == cacheFile.size() - 4) {
+        cacheFile.erase(extPos);
+    }
+    return cacheFile + ADB_CACHE_EXT;
+}
+
+/**
+ * Function: AdbCache::tmpCacheFile
+ * Used when the default cache file is stale and its directory isn't writable
+ **/
+string AdbCache::tmpCacheFile(const string &adbFile) {
+    char absPath[PATH_MAX];
+    string path = realpath(adbFile.c_str(), absPath) ? absPath : adbFile;
+    char tmpFile[64 + sizeof(ADB_CACHE_TMP_PREFIX)];
+    snprintf(tmpFile, sizeof(tmpFile), ADB_CACHE_TMP_PREFIX "%u_%016llx" ADB_CACHE_EXT, (unsigned)geteuid(),
+             (unsigned long long)fnv1a((const u_int8_t*)path.c_str(), path.size()));
+    return tmpFile;
+}
+
+/**
+ * Function: AdbCache::isEnabled
+ **/
+bool AdbCache::isEnabled() {
+    return !_cacheFiles.empty();
+}
+
+/**
+ * Function: AdbCache::getCacheFile
+ **/
+string AdbCache::getCacheFile() {
+    return _cacheFile;
+}
+
+/**
+ * Function: AdbCache::getLastError
+ **/
+string AdbCache::getLastError() {
+    return _lastError;
+}
+
+/**
+ * Function: AdbCache::hashFile
+ **/
+bool AdbCache::hashFile(const string &fileName, u_int64_t &size, u_int64_t &hash) {
+    u_int8_t buf[65536];
+    ssize_t len;
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        _lastError = "Can't open file (" + fileName + "): " + strerror(errno);
+        return false;
+    }
+    size = 0;
+    hash = fnv1a(NULL, 0);
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        hash = fnv1a(buf, len, hash);
+        size += len;
+    }
+    close(fd);
+    if (len < 0) {
+        _lastError = "Can't read file (" + fileName + "): " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Function: AdbCache::isTrusted
+ * Only our own (or root's) regular files that others can't modify are used
+ **/
+bool AdbCache::isTrusted(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if (st.st_uid != geteuid() && st.st_uid != 0) {
+        return false;
+    }
+    return !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/**
+ * Function: AdbCache::load
+ **/
+bool AdbCache::load(Adb *adb) {
+    _lastError = "Cache is disabled";
+    for (size_t i = 0; i < _cacheFiles.size(); i++) {
+        _cacheFile = _cacheFiles[i];
+        if (loadFile(adb)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Function: AdbCache::loadFile
+ **/
+bool AdbCache::loadFile(Adb *adb) {
+    double startTime = timeMs();
+    int fd = open(_cacheFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        _lastError = "Can't open cache file (" + _cacheFile + "): " + strerror(errno);
+        if (_debug) {
+            fprintf(stderr, "-D- %s\n", _lastError.c_str());
+        }
+        return false;
+    }
+    struct stat st;
+    if (!isTrusted(fd) || fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        _lastError = "Cache file (" + _cacheFile + ") isn't trusted";
+        if (_debug) {
+            fprintf(stderr, "-D- %s\n", _lastError.c_str());
+        }
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        _lastError = "Can't map cache file (" + _cacheFile + "): " + strerror(errno);
+        return false;
+    }
+
+    AdbCacheReader r((const char*)data, st.st_size);
+    bool status = false;
+    u_int32_t magic = r.u32();
+    u_int32_t version = r.u32();
+    u_int32_t flags = r.u32();
+    u_int32_t expectedFlags = (_addReserved ? ADB_CACHE_ADD_RESERVED : 0) |
+                              (_strict ? ADB_CACHE_STRICT : 0);
+    _lastError = "Cache file (" + _cacheFile + ") is out of date";
+    if (magic == ADB_CACHE_MAGIC && version == ADB_CACHE_VERSION &&
+        flags == expectedFlags) {
+        // source files: the main file (by content only, so the cache can be
+        // generated at build time) and the files it includes
+        u_int32_t numFiles = r.u32();
+        bool valid = r.ok() && numFiles > 0;
+        for (u_int32_t i = 0; valid && i < numFiles; i++) {
+            string fileName = i ? r.str() : _adbFile;
+            u_int64_t cachedSize = r.u64();
+            u_int64_t cachedHash = r.u64();
+            u_int64_t size, hash;
+            valid = r.ok() && hashFile(fileName, size, hash) && size == cachedSize &&
+                    hash == cachedHash;
+        }
+
+        if (valid) {
+            adb->version = r.str();
+            adb->rootNode = r.str();
+            adb->bigEndianArr = r.u32();
+            adb->singleEntryArrSupp = r.u32();
+            adb->srcDocName = r.str();
+            adb->srcDocVer = r.str();
+            adb->mainFileName = _adbFile;
+
+            u_int32_t num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                adb->includePaths.push_back(r.str());
+            }
+            num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                string name = r.str();
+                IncludeFileInfo info;
+                info.fullPath = r.str();
+                info.includedFromFile = r.str();
+                info.includedFromLine = r.u32();
+                if (info.includedFromFile == "ROOT") {
+                    info.fullPath = _adbFile;
+                }
+                adb->includedFiles[name] = info;
+            }
+            num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                adb->warnings.push_back(r.str());
+            }
+            num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                AdbConfig *config = new AdbConfig;
+                adb->configs.push_back(config);
+                r.attrs(config->attrs);
+                r.attrs(config->enums);
+            }
+            num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                string path = r.str();
+                r.attrs(adb->instAttrs[path]);
+            }
+
+            num = r.u32();
+            for (u_int32_t i = 0; r.ok() && i < num; i++) {
+                AdbNode *node = new AdbNode;
+                node->name = r.str();
+                adb->nodesMap.insert(adb->nodesMap.end(), NodesMap::value_type(node->name, node));
+                node->size = r.u32();
+                node->isUnion = r.u32();
+                node->desc = r.str();
+                r.attrs(node->attrs);
+                node->fileName = r.str();
+                node->lineNumber = r.u32();
+                readFields(r, node->fields);
+                readFields(r, node->condFields);
+            }
+            // a node name that repeats means a corrupted file
+            status = r.ok() && num == adb->nodesMap.size();
+            if (!status) {
+                _lastError = "Cache file (" + _cacheFile + ") is corrupted";
+            }
+        }
+    }
+    munmap(data, st.st_size);
+
+    if (!status) {
+        clearAdb(adb);
+    }
+    if (_debug) {
+        if (status) {
+            fprintf(stderr, "-D- Loaded %s from %s in %.3f ms\n", _adbFile.c_str(), _cacheFile.c_str(),
+                    timeMs() - startTime);
+        } else {
+            fprintf(stderr, "-D- %s\n", _lastError.c_str());
+        }
+    }
+    return status;
+}
+
+/**
+ * Function: AdbCache::save
+ **/
+bool AdbCache::save(Adb *adb) {
+    _lastError = "Cache is disabled";
+    for (size_t i = 0; i < _cacheFiles.size(); i++) {
+        _cacheFile = _cacheFiles[i];
+        if (save(adb, _cacheFile)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AdbCache::save(Adb *adb, const string &cacheFile) {
+    AdbCacheWriter w;
+    u_int32_t flags = (_addReserved ? ADB_CACHE_ADD_RESERVED : 0) | (_strict ? ADB_CACHE_STRICT : 0);
+    w.u32(ADB_CACHE_MAGIC);
+    w.u32(ADB_CACHE_VERSION);
+    w.u32(flags);
+
+    vector<string> files(1, _adbFile);
+    for (IncludeFileMap::iterator it = adb->includedFiles.begin(); it != adb->includedFiles.end(); it++) {
+        if (it->second.includedFromFile != "ROOT") {
+            files.push_back(it->second.fullPath);
+        }
+    }
+    w.u32(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        u_int64_t size, hash;
+        if (!hashFile(files[i], size, hash)) {
+            return false;
+        }
+        if (i) {
+            w.str(files[i]);
+        }
+        w.u64(size);
+        w.u64(hash);
+    }
+
+    w.str(adb->version);
+    w.str(adb->rootNode);
+    w.u32(adb->bigEndianArr);
+    w.u32(adb->singleEntryArrSupp);
+    w.str(adb->srcDocName);
+    w.str(adb->srcDocVer);
+    w.u32(adb->includePaths.size());
+    for (size_t i = 0; i < adb->includePaths.size(); i++) {
+        w.str(adb->includePaths[i]);
+    }
+    w.u32(adb->includedFiles.size());
+    for (IncludeFileMap::iterator it = adb->includedFiles.begin(); it != adb->includedFiles.end(); it++) {
+        w.str(it->first);
+        w.str(it->second.fullPath);
+        w.str(it->second.includedFromFile);
+        w.u32(it->second.includedFromLine);
+    }
+    w.u32(adb->warnings.size());
+    for (size_t i = 0; i < adb->warnings.size(); i++) {
+        w.str(adb->warnings[i]);
+    }
+    w.u32(adb->configs.size());
+    for (size_t i = 0; i < adb->configs.size(); i++) {
+        w.attrs(adb->configs[i]->attrs);
+        w.attrs(adb->configs[i]->enums);
+    }
+    w.u32(adb->instAttrs.size());
+    for (InstanceAttrs::iterator it = adb->instAttrs.begin(); it != adb->instAttrs.end(); it++) {
+        w.str(it->first);
+        w.attrs(it->second);
+    }
+
+    w.u32(adb->nodesMap.size());
+    for (NodesMap::iterator it = adb->nodesMap.begin(); it != adb->nodesMap.end(); it++) {
+        AdbNode *node = it->second;
+        w.str(node->name);
+        w.u32(node->size);
+        w.u32(node->isUnion);
+        w.str(node->desc);
+        w.attrs(node->attrs);
+        w.str(node->fileName);
+        w.u32(node->lineNumber);
+        writeFields(w, node->fields);
+        writeFields(w, node->condFields);
+    }
+
+    // write a temporary file and rename it, readers never see a partial cache
+    char tmpSuffix[32];
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%d.tmp", (int)getpid());
+    string tmpFile = cacheFile + tmpSuffix;
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        _lastError = "Can't create cache file (" + tmpFile + "): " + strerror(errno);
+        return false;
+    }
+    const char *p = w._buf.data();
+    size_t left = w._buf.size();
+    while (left) {
+        ssize_t len = write(fd, p, left);
+        if (len <= 0) {
+            _lastError = "Failed to write cache file (" + tmpFile + "): " + strerror(errno);
+            close(fd);
+            unlink(tmpFile.c_str());
+            return false;
+        }
+        p += len;
+        left -= len;
+    }
+    if (close(fd) || rename(tmpFile.c_str(), cacheFile.c_str())) {
+        _lastError = "Failed to write cache file (" + cacheFile + "): " + strerror(errno);
+        unlink(tmpFile.c_str());
+        return false;
+    }
+    if (_debug) {
+        fprintf(stderr, "-D- Saved %s to %s (%u bytes)\n", _adbFile.c_str(), cacheFile.c_str(),
+                (unsigned)w._buf.size());
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb_cache.h - compiled binary form of a loaded Adb project.
+ *
+ * Parsing a register database and instantiating its layout takes much longer
+ * than the register accesses done by a typical tool run. AdbCache stores the
+ * nodes, fields, configs (enums) and instance attributes of a loaded Adb in a
+ * single file. Later runs mmap that file and rebuild the objects from it
+ * instead of parsing XML. The layout isn't cached, it is created from them as
+ * before.
+ *
+ * The cache is keyed by the size and FNV-1a hash of the source .adb and of
+ * every file it includes, and by the load parameters. Any mismatch is
+ * treated as a miss and the caller parses the source as before.
+ *
+ * The cache file is <file>.adbc next to the source, e.g. the one generated at
+ * build time for the PRM databases. When that one is stale and can't be
+ * rewritten, /tmp/mstflint_adb_<uid>_<path hash>.adbc is used instead. Only
+ * regular files owned by the user (or root) that are not writable by others
+ * are used.
+ *
+ * Environment:
+ *   ADB_CACHE        - cache file path, "0" disables the cache.
+ *   ADB_CACHE_DEBUG  - print cache hits, misses and load times to stderr.
+ */
+
+#ifndef ADB_CACHE_H
+#define ADB_CACHE_H
+
+#include <string>
+#include <vector>
+#include "adb_parser.h"
+
+using namespace std;
+
+class AdbCache {
+public:
+    // Methods
+    AdbCache(const string &adbFile, bool addReserved = false, bool strict = false);
+
+    // Restore adb from the cache. adb must be empty, it is left empty on a miss.
+    bool load(Adb *adb);
+    // Write adb to the cache file
+    bool save(Adb *adb);
+    // Same, to an explicit file (build time generation)
+    bool save(Adb *adb, const string &cacheFile);
+
+    bool isEnabled();
+    string getCacheFile();
+    string getLastError();
+
+    static string defaultCacheFile(const string &adbFile);
+    static string tmpCacheFile(const string &adbFile);
+
+private:
+    bool loadFile(Adb *adb);
+    bool hashFile(const string &fileName, u_int64_t &size, u_int64_t &hash);
+    bool isTrusted(int fd);
+
+private:
+    string _adbFile;
+    vector<string> _cacheFiles;
+    string _cacheFile; // the one used last
+    bool _addReserved;
+    bool _strict;
+    bool _debug;
+    string _lastError;
+};
+
+#endif // ADB_CACHE_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb_cachegen.cpp - compiles a register database into an
+ * AdbCache file at build time (see adb_cache.h).
+ *
+ * usage: adb_cachegen <adb file> <cache file>
+ */
+
+#include <stdio.h>
+#include "adb_parser.h"
+#include "adb_cache.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <adb file> <cache file>\n", argv[0]);
+        return 1;
+    }
+
+    Adb adb;
+    if (!adb.load(argv[1], false, NULL, false)) {
+        fprintf(stderr, "-E- Failed to load %s: %s\n", argv[1], adb.getLastError().c_str());
+        return 1;
+    }
+
+    AdbCache cache(argv[1]);
+    if (!cache.save(&adb, argv[2])) {
+        fprintf(stderr, "-E- %s\n", cache.getLastError().c_str());
+        return 1;
+    }
+    return 0;
+}
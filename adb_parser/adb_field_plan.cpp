@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include "adb_field_plan.h"
+
+static bool compareOps(const buf_field_op &a, const buf_field_op &b)
+{
+    return a.byte_offset < b.byte_offset;
+}
+
+/**
+ * Function: AdbFieldPlan::AdbFieldPlan
+ **/
+AdbFieldPlan::AdbFieldPlan(AdbInstance *node) :
+    _fields(node->getLeafFields())
+{
+    _ops.resize(_fields.size());
+    for (size_t i = 0; i < _fields.size(); i++) {
+        buf_op_init(&_ops[i], _fields[i]->offset, _fields[i]->size);
+        _ops[i].index = i;
+    }
+    std::stable_sort(_ops.begin(), _ops.end(), compareOps);
+
+    _opIdx.resize(_ops.size());
+    for (size_t i = 0; i < _ops.size(); i++) {
+        _opIdx[_ops[i].index] = i;
+    }
+
+    int depth = 0;
+    for (AdbInstance *p = node; p; p = p->parent) {
+        depth++;
+    }
+    for (size_t i = 0; i < _fields.size(); i++) {
+        // insert() keeps the first leaf of a repeated name
+        _fieldIdx.insert(std::make_pair(_fields[i]->name, (int)i));
+        _fieldIdx.insert(std::make_pair(_fields[i]->fullName(depth), (int)i));
+    }
+}
+
+/**
+ * Function: AdbFieldPlan::findField
+ **/
+int AdbFieldPlan::findField(const std::string &name) const
+{
+    boost::unordered_map<std::string, int>::const_iterator it = _fieldIdx.find(name);
+    return it == _fieldIdx.end() ? -1 : it->second;
+}
+
+/**
+ * Function: AdbFieldPlan::decode
+ **/
+void AdbFieldPlan::decode(const u_int8_t *buf, std::vector<u_int64_t> &values) const
+{
+    values.resize(_ops.size());
+    if (!_ops.empty()) {
+        buf_plan_decode(buf, &_ops[0], _ops.size(), &values[0]);
+    }
+}
+
+/**
+ * Function: AdbFieldPlan::pop
+ **/
+u_int64_t AdbFieldPlan::pop(const u_int8_t *buf, size_t idx) const
+{
+    return buf_op_pop(buf, &_ops[_opIdx[idx]]);
+}
+
+/**
+ * Function: AdbFieldPlan::push
+ **/
+void AdbFieldPlan::push(u_int8_t *buf, size_t idx, u_int64_t value) const
+{
+    buf_op_push(buf, &_ops[_opIdx[idx]], value);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb_field_plan.h - decode/encode plan of a register layout.
+ *
+ * AdbInstance::popBuf/pushBuf look up a single field. Printing or parsing a
+ * whole register does that for each of its leaves, so AdbFieldPlan compiles
+ * the leaf fields of a node once into buf_field_op records (see buf_ops.h)
+ * and decodes the whole register buffer into a value array in one pass.
+ * Buffers are in the big-endian layout used by popBuf/pushBuf.
+ *
+ * Leaf fields are also indexed by name and by their path relative to the
+ * node (e.g. "counter_set.if_in_octets_high"). A name shared by several
+ * leaves refers to the first of them, as a linear search would.
+ */
+
+#ifndef ADB_FIELD_PLAN_H
+#define ADB_FIELD_PLAN_H
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include "adb_parser.h"
+#include "buf_ops.h"
+
+class AdbFieldPlan
+{
+public:
+    AdbFieldPlan() {}
+    AdbFieldPlan(AdbInstance *node);
+
+    // Leaf fields of the node, value arrays are indexed the same way
+    const std::vector<AdbInstance*>& getFields() const { return _fields; }
+    // Index of the leaf field with this name or relative path, or -1
+    int findField(const std::string &name) const;
+
+    void decode(const u_int8_t *buf, std::vector<u_int64_t> &values) const;
+    u_int64_t pop(const u_int8_t *buf, size_t idx) const;
+    void push(u_int8_t *buf, size_t idx, u_int64_t value) const;
+
+private:
+    std::vector<AdbInstance*> _fields;
+    std::vector<buf_field_op> _ops;   // sorted by buffer position
+    std::vector<u_int32_t> _opIdx;    // field index -> index in _ops
+    boost::unordered_map<std::string, int> _fieldIdx; // name/path -> field index
+};
+
+#endif // ADB_FIELD_PLAN_H
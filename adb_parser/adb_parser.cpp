@@ -398,13 +398,15 @@ void AdbNode::print(int indent) {
  **/
 AdbField::AdbField() :
     size(0), offset(0xffffffff), definedAsArr(false), lowBound(0),
-            highBound(0), unlimitedArr(false), isReserved(false), userData(0) {
+            highBound(0), unlimitedArr(false), isReserved(false), enumMap(NULL),
+            userData(0) {
 }
 
 /**
  * Function: AdbField::~AdbField
  **/
 AdbField::~AdbField() {
+    delete enumMap;
 }
 
 /**
@@ -551,7 +553,8 @@ string AdbConfig::toXml() {
  **/
 AdbInstance::AdbInstance() :
     fieldDesc(NULL), nodeDesc(NULL), parent(NULL), offset(0xffffffff), size(0),
-            arrIdx(0), unionSelector(NULL), isDiff(false), userData(NULL)
+            arrIdx(0), unionSelector(NULL), isDiff(false), lazyAdb(NULL),
+            userData(NULL)
 
 {
 
@@ -672,6 +675,7 @@ AdbInstance* AdbInstance::getChildByPath(const string &path,
         return this;
     }
 
+    expand();
     // Search for childName
     AdbInstance *child = NULL;
     for (size_t i = 0; i < subItems.size(); i++) {
@@ -712,6 +716,7 @@ vector<AdbInstance*> AdbInstance::findChild(const string& childName,
     }
 
     // do that recursively for all child items
+    expand();
     for (size_t i = 0; i < subItems.size(); i++) {
         vector<AdbInstance*> l = subItems[i]->findChild(effName, true);
         childList.insert(childList.end(), l.begin(), l.end());
@@ -820,6 +825,13 @@ map<string, u_int64_t> AdbInstance::getEnumMap() {
     map < string, u_int64_t > enumMap;
     vector < string > enumValues;
     string enums = getAttr("enum");
+    // instances of the same field share the parsed map, unless their enum was evaluated differently
+    AttrsMap::iterator fieldEnumIt;
+    bool isFieldEnum = fieldDesc && (fieldEnumIt = fieldDesc->attrs.find("enum"))
+            != fieldDesc->attrs.end() && fieldEnumIt->second == enums;
+    if (isFieldEnum && fieldDesc->enumMap) {
+        return *fieldDesc->enumMap;
+    }
     boost::algorithm::split(enumValues, enums, boost::is_any_of(string(",")));
 
     for (size_t i = 0; i < enumValues.size(); i++) {
@@ -845,6 +857,9 @@ map<string, u_int64_t> AdbInstance::getEnumMap() {
         enumMap[pair[0]] = intVal;
     }
 
+    if (isFieldEnum) {
+        fieldDesc->enumMap = new map<string, u_int64_t>(enumMap);
+    }
     return enumMap;
 }
 
@@ -889,6 +904,7 @@ AdbInstance* AdbInstance::getUnionSelectedNodeName(const u_int64_t& selectorVal)
                 fullName().c_str());
     }
 
+    expand();
     if (!unionSelector) {
         throw AdbException("Can't find selector for union: " + name);
     }
@@ -929,6 +945,7 @@ AdbInstance* AdbInstance::getUnionSelectedNodeName(const string& selectorEnum) {
                 fullName().c_str());
     }
 
+    expand();
     if (!unionSelector) {
         throw AdbException("Can't find selector for union: " + name);
     }
@@ -945,6 +962,14 @@ AdbInstance* AdbInstance::getUnionSelectedNodeName(const string& selectorEnum) {
                     + ")");
 }
 
+/**
+ * Function: AdbInstance::getUnionSelector
+ **/
+AdbInstance* AdbInstance::getUnionSelector() {
+    expand();
+    return unionSelector;
+}
+
 /**
  * Function: AdbInstance::isConditionalNode
  * Throws exception: AdbException
@@ -1006,6 +1031,7 @@ bool AdbInstance::isConditionValid(map<string, string> *valuesMap) {
 vector<AdbInstance*> AdbInstance::getLeafFields() {
     vector<AdbInstance*> fields;
 
+    expand();
     for (size_t i = 0; i < subItems.size(); i++) {
         if (subItems[i]->isNode()) {
             vector<AdbInstance*> subFields = subItems[i]->getLeafFields();
@@ -1018,18 +1044,36 @@ vector<AdbInstance*> AdbInstance::getLeafFields() {
     return fields;
 }
 
+/**
+ * Function: AdbInstance::expand
+ **/
+void AdbInstance::expand(bool recursive) {
+    if (lazyAdb) {
+        Adb *adb = lazyAdb;
+        lazyAdb = NULL;
+        adb->expandInstance(this);
+    }
+    for (size_t i = 0; recursive && i < subItems.size(); i++) {
+        subItems[i]->expand(true);
+    }
+}
+
 /**
  * Function: AdbInstance::pushBuf
  **/
 void AdbInstance::pushBuf(u_int8_t *buf, u_int64_t value) {
-    push_to_buf(buf, offset, size, value);
+    buf_field_op op;
+    buf_op_init(&op, offset, size);
+    buf_op_push(buf, &op, value);
 }
 
 /**
  * Function: AdbInstance::popBuf
  **/
 u_int64_t AdbInstance::popBuf(u_int8_t *buf) {
-    return pop_from_buf(buf, offset, size);
+    buf_field_op op;
+    buf_op_init(&op, offset, size);
+    return buf_op_pop(buf, &op);
 }
 
 /**
@@ -1043,6 +1087,7 @@ void AdbInstance::print(int indent) {
             offset % 32, (size >> 5) << 2, size % 32, isNode(), isUnion());
 
     if (isNode()) {
+        expand();
         for (size_t i = 0; i < subItems.size(); i++)
             subItems[i]->print(indent + 1);
     }
@@ -1053,7 +1098,8 @@ void AdbInstance::print(int indent) {
  * Function: Adb::Adb
  **/
 Adb::Adb() :
-    bigEndianArr(false), singleEntryArrSupp(false){
+    bigEndianArr(false), singleEntryArrSupp(false), _lazyExprEval(false),
+            _lazyRootLayout(false) {
 }
 
 /**
@@ -1341,7 +1387,7 @@ AdbInstance* Adb::addMissingNodes(int depth, bool allowMultipleExceptions) {
  **/
 AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
         AdbProgress *progressObj, int depth, bool ignoreMissingNodes,
-        bool allowMultipleExceptions) {
+        bool allowMultipleExceptions, bool lazy) {
     try {
         NodesMap::iterator it;
         it = nodesMap.find(rootNodeName);
@@ -1372,6 +1418,28 @@ AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
             addMissingNodes(depth, allowMultipleExceptions);
         }
 
+        if (lazy) {
+            // sub items are created by expandInstance() on first access
+            _lazyExprEval = isExprEval;
+            _lazyRootLayout = rootNodeName == rootNode;
+            _lazyInstAttrs.clear();
+            for (InstanceAttrs::iterator it = instAttrs.begin(); _lazyRootLayout
+                    && it != instAttrs.end(); it++) {
+                size_t idx = it->first.find(".");
+                string path = idx == string::npos ? string()
+                        : it->first.substr(idx + 1);
+                _lazyInstAttrs[path] = &it->second;
+            }
+            if (_lazyInstAttrs.count("")) {
+                AttrsMap *attrs = _lazyInstAttrs[""];
+                for (AttrsMap::iterator it = attrs->begin(); it != attrs->end(); it++) {
+                    rootItem->attrs[it->first] = it->second;
+                }
+            }
+            rootItem->lazyAdb = nodeDesc->fields.empty() ? NULL : this;
+            return rootItem;
+        }
+
         for (size_t i = 0; (depth == -1 || depth > 0) && i
                 < nodeDesc->fields.size(); i++) {
             vector<AdbInstance*> subItems = createInstance(nodeDesc->fields[i],
@@ -1415,105 +1483,184 @@ AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
         for (list<AdbInstance*>::iterator it =
                 _unionSelectorEvalDeffered.begin(); it
                 != _unionSelectorEvalDeffered.end(); it++) {
-            vector < string > path;
-            AdbInstance *inst = *it;
-            AdbInstance *curInst = inst;
-            boost::algorithm::split(path, inst->attrs["union_selector"],
-                    boost::is_any_of(string(".")));
-            for (size_t i = 0; i < path.size(); i++) {
-                if (path[i] == "#(parent)" || path[i] == "$(parent)") {
-                    curInst = curInst->parent;
-                } else {
-                    size_t j;
-                    bool inPath = false;
-                    for (j = 0; j < curInst->subItems.size(); j++) {
-                        if (curInst->subItems[j]->name == path[i]) {
-                            curInst = curInst->subItems[j];
-                            inPath = true;
-                            break;
-                        }
-                    }
+            evalUnionSelector(*it, rootNodeName == rootNode,
+                    allowMultipleExceptions);
+        }
 
-                    if (j == curInst->subItems.size() && !inPath) {
-                        if (rootNodeName == rootNode) { // give this warning only if this root instantiation
-                            string exceptionTxt =
-                                    "Failed to find union selector for union ("
-                                            + inst->fullName()
-                                            + ") Can't find field (" + path[i]
-                                            + ") under (" + curInst->fullName()
-                                            + ")";
-                            if (allowMultipleExceptions) {
-                                insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
-                            } else {
-                                throw AdbException(exceptionTxt);
-                            }
-                        }
-                    }
-                }
-            }
+        return rootItem;
+    } catch (AdbException &exp) {
+        _lastError = exp.what_s();
+        if (allowMultipleExceptions) {
+            insertNewException(ExceptionHolder::FATAL_EXCEPTION, _lastError);
+        }
+        return NULL;
+    } catch (...) {
+        _lastError = "Unknown error occurred";
+        return NULL;
+    }
+}
 
-            inst->unionSelector = curInst;
-            for (size_t i = 0; i < inst->subItems.size(); i++) {
-                //printf("Field %s, isResered=%d\n", inst->subItems[i]->fullName().c_str(), inst->subItems[i]->isReserved());
-                if (inst->subItems[i]->isReserved()) {
-                    continue;
+/**
+ * Function: Adb::evalUnionSelector
+ **/
+void Adb::evalUnionSelector(AdbInstance *inst, bool isRootLayout,
+        bool allowMultipleExceptions) {
+    vector < string > path;
+    AdbInstance *curInst = inst;
+    boost::algorithm::split(path, inst->attrs["union_selector"],
+            boost::is_any_of(string(".")));
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] == "#(parent)" || path[i] == "$(parent)") {
+            curInst = curInst->parent;
+        } else {
+            size_t j;
+            bool inPath = false;
+            curInst->expand();
+            for (j = 0; j < curInst->subItems.size(); j++) {
+                if (curInst->subItems[j]->name == path[i]) {
+                    curInst = curInst->subItems[j];
+                    inPath = true;
+                    break;
                 }
+            }
 
-                // make sure all union subnodes define "selected_by" attribute
-                AttrsMap::iterator selectorValIt =
-                        inst->subItems[i]->attrs.find("selected_by");
-                if (selectorValIt == inst->subItems[i]->attrs.end()) {
-                    string exceptionTxt = "In union (" + inst->fullName()
-                            + ") the union subnode (" + inst->subItems[i]->name
-                            + ") doesn't define selection value";
+            if (j == curInst->subItems.size() && !inPath) {
+                if (isRootLayout) { // give this warning only if this root instantiation
+                    string exceptionTxt =
+                            "Failed to find union selector for union ("
+                                    + inst->fullName()
+                                    + ") Can't find field (" + path[i]
+                                    + ") under (" + curInst->fullName()
+                                    + ")";
                     if (allowMultipleExceptions) {
                         insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
-                        continue;
                     } else {
                         throw AdbException(exceptionTxt);
                     }
                 }
+            }
+        }
+    }
 
-                // make sure that all union subnodes selector values are defined in the selector field enum
-                if (selectorValIt->second == "") {
-                    continue;
-                }
+    inst->unionSelector = curInst;
+    for (size_t i = 0; i < inst->subItems.size(); i++) {
+        //printf("Field %s, isResered=%d\n", inst->subItems[i]->fullName().c_str(), inst->subItems[i]->isReserved());
+        if (inst->subItems[i]->isReserved()) {
+            continue;
+        }
 
-                map<string, u_int64_t>::iterator it;
-                map < string, u_int64_t > selectorValMap
-                        = inst->unionSelector->getEnumMap();
-                for (it = selectorValMap.begin(); it != selectorValMap.end(); it++) {
-                    if (it->first == selectorValIt->second) {
-                        break;
-                    }
-                }
+        // make sure all union subnodes define "selected_by" attribute
+        AttrsMap::iterator selectorValIt =
+                inst->subItems[i]->attrs.find("selected_by");
+        if (selectorValIt == inst->subItems[i]->attrs.end()) {
+            string exceptionTxt = "In union (" + inst->fullName()
+                    + ") the union subnode (" + inst->subItems[i]->name
+                    + ") doesn't define selection value";
+            if (allowMultipleExceptions) {
+                insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
+                continue;
+            } else {
+                throw AdbException(exceptionTxt);
+            }
+        }
 
-                if (it == selectorValMap.end()) {
-                    string exceptionTxt = "In union (" + inst->fullName()
-                            + ") the union subnode (" + inst->subItems[i]->name
-                            + ") uses a selector value ("
-                            + selectorValIt->second
-                            + ") which isn't defined in the selector field ("
-                            + inst->unionSelector->fullName() + ")";
-                    if (allowMultipleExceptions) {
-                        insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
-                    } else {
-                        throw AdbException(exceptionTxt);
-                    }
-                }
+        // make sure that all union subnodes selector values are defined in the selector field enum
+        if (selectorValIt->second == "") {
+            continue;
+        }
+
+        map<string, u_int64_t>::iterator it;
+        map < string, u_int64_t > selectorValMap
+                = inst->unionSelector->getEnumMap();
+        for (it = selectorValMap.begin(); it != selectorValMap.end(); it++) {
+            if (it->first == selectorValIt->second) {
+                break;
             }
         }
 
-        return rootItem;
-    } catch (AdbException &exp) {
-        _lastError = exp.what_s();
-        if (allowMultipleExceptions) {
-            insertNewException(ExceptionHolder::FATAL_EXCEPTION, _lastError);
+        if (it == selectorValMap.end()) {
+            string exceptionTxt = "In union (" + inst->fullName()
+                    + ") the union subnode (" + inst->subItems[i]->name
+                    + ") uses a selector value ("
+                    + selectorValIt->second
+                    + ") which isn't defined in the selector field ("
+                    + inst->unionSelector->fullName() + ")";
+            if (allowMultipleExceptions) {
+                insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
+            } else {
+                throw AdbException(exceptionTxt);
+            }
         }
-        return NULL;
-    } catch (...) {
-        _lastError = "Unknown error occurred";
-        return NULL;
+    }
+}
+
+/**
+ * Function: Adb::checkSubItemsOverlap
+ **/
+void Adb::checkSubItemsOverlap(AdbInstance *inst, bool allowMultipleExceptions) {
+    for (size_t j = 0; j + 1 < inst->subItems.size(); j++) {
+        if (inst->subItems[j + 1]->offset
+                < inst->subItems[j]->offset
+                        + inst->subItems[j]->size) {
+            string exceptionTxt = "Field ("
+                    + inst->subItems[j + 1]->name + ") ("
+                    + formatAddr(inst->subItems[j + 1]->offset,
+                            inst->subItems[j + 1]->size).c_str()
+                    + ") overlaps with (" + inst->subItems[j]->name
+                    + ") (" + formatAddr(inst->subItems[j]->offset,
+                    inst->subItems[j]->size).c_str() + ")";
+            if (allowMultipleExceptions) {
+                insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
+            } else {
+                throw AdbException(exceptionTxt);
+            }
+        }
+    }
+}
+
+/**
+ * Function: Adb::expandInstance
+ * Creates the sub items of a lazy layout instance, they are lazy themselves
+ **/
+void Adb::expandInstance(AdbInstance *inst) {
+    if (inst->size != inst->nodeDesc->size) {
+        inst->nodeDesc->size = inst->size;
+    }
+
+    _unionSelectorEvalDeffered.clear();
+    for (size_t i = 0; i < inst->nodeDesc->fields.size(); i++) {
+        vector<AdbInstance*> subItems = createInstance(
+                inst->nodeDesc->fields[i], inst, inst->vars, _lazyExprEval,
+                NULL, 0);
+        inst->subItems.insert(inst->subItems.end(), subItems.begin(),
+                subItems.end());
+    }
+    _unionSelectorEvalDeffered.clear();
+
+    if (!inst->isUnion()) {
+        stable_sort(inst->subItems.begin(), inst->subItems.end(),
+                compareFieldsPtr<AdbInstance> );
+        checkSubItemsOverlap(inst, false);
+    }
+
+    for (size_t i = 0; i < inst->subItems.size(); i++) {
+        AdbInstance *subItem = inst->subItems[i];
+        if (subItem->isNode() && !subItem->nodeDesc->fields.empty()) {
+            subItem->lazyAdb = this;
+        }
+        if (!_lazyInstAttrs.empty()) {
+            map<string, AttrsMap*>::iterator it = _lazyInstAttrs.find(subItem->fullName(1));
+            if (it != _lazyInstAttrs.end()) {
+                for (AttrsMap::iterator it2 = it->second->begin(); it2
+                        != it->second->end(); it2++) {
+                    subItem->attrs[it2->first] = it2->second;
+                }
+            }
+        }
+    }
+
+    if (inst->isUnion() && inst->attrs.find("union_selector") != inst->attrs.end()) {
+        evalUnionSelector(inst, _lazyRootLayout, false);
     }
 }
 
@@ -1720,26 +1867,7 @@ vector<AdbInstance*> Adb::createInstance(AdbField *fieldDesc,
             }
 
             if (!inst->isUnion()) {
-                for (size_t j = 0; j < inst->subItems.size() - 1; j++) {
-                    //printf("field: %s, offset: %s\n", inst->subItems[j+1]->name.c_str(),formatAddr(inst->subItems[j+1]->offset, inst->subItems[j+1]->size).c_str());
-                    //printf("field: %s, offset: %s\n", inst->subItems[j]->name.c_str(),formatAddr(inst->subItems[j]->offset, inst->subItems[j]->size).c_str());
-                    if (inst->subItems[j + 1]->offset
-                            < inst->subItems[j]->offset
-                                    + inst->subItems[j]->size) {
-                        string exceptionTxt = "Field ("
-                                + inst->subItems[j + 1]->name + ") ("
-                                + formatAddr(inst->subItems[j + 1]->offset,
-                                        inst->subItems[j + 1]->size).c_str()
-                                + ") overlaps with (" + inst->subItems[j]->name
-                                + ") (" + formatAddr(inst->subItems[j]->offset,
-                                inst->subItems[j]->size).c_str() + ")";
-                        if (allowMultipleExceptions) {
-                            insertNewException(ExceptionHolder::ERROR_EXCEPTION, exceptionTxt);
-                        } else {
-                            throw AdbException(exceptionTxt);
-                        }
-                    }
-                }
+                checkSubItemsOverlap(inst, allowMultipleExceptions);
             }
         }
 
@@ -1799,12 +1927,101 @@ string Adb::evalExpr(string expr, AttrsMap *vars) {
         return expr;
     }
 
+    map<string, ExprTemplate>::iterator ct = _exprCache.find(expr);
+    if (ct == _exprCache.end()) {
+        ct = _exprCache.insert(make_pair(expr, ExprTemplate())).first;
+        compileExpr(expr, ct->second);
+    }
+    const ExprTemplate &tmpl = ct->second;
+    if (tmpl.interpret) {
+        return interpretExpr(expr, vars);
+    }
+
+    string result;
+    for (vector<ExprRef>::const_iterator ref = tmpl.refs.begin(); ref
+            != tmpl.refs.end(); ref++) {
+        result += ref->prefix;
+        if (ref->isVar) {
+            AttrsMap::iterator it = vars->find(ref->name);
+            if (it == vars->end()) {
+                throw AdbException("Can't find the variable: " + ref->name);
+            }
+            if (it->second.find('$') != string::npos) {
+                // the substituted value is scanned again for references
+                return interpretExpr(result + it->second
+                        + expr.substr(ref->restPos), vars);
+            }
+            result += it->second;
+        } else {
+            u_int64_t res;
+            _adbExpr.setVars(vars);
+            int status = _adbExpr.run(ref->prog, &res);
+            if (status < 0) {
+                throw AdbException("Error evaluating expression " + result
+                        + "$(" + ref->name + ")" + expr.substr(ref->restPos)
+                        + " : " + AdbExpr::statusStr(status));
+            }
+            result += boost::lexical_cast<string>(res);
+        }
+    }
+    return result + tmpl.tail;
+}
+
+/**
+ * Function: Adb::compileExpr
+ **/
+void Adb::compileExpr(const string &expr, ExprTemplate &tmpl) {
+    size_t pos = 0;
+
+    // same references as found by interpretExpr, line breaks are left to it
+    tmpl.interpret = expr.find_first_of("\r\n") != string::npos;
+    while (!tmpl.interpret) {
+        size_t start = expr.find('$', pos);
+        if (start == string::npos || expr.compare(start, 2, "$(")) {
+            break;
+        }
+        size_t end = expr.find(')', start + 2);
+        if (end == string::npos || end == start + 2) {
+            break;
+        }
+
+        ExprRef ref;
+        ref.prefix = expr.substr(pos, start - pos);
+        ref.name = expr.substr(start + 2, end - start - 2);
+        ref.restPos = end + 1;
+        ref.isVar = isalpha((unsigned char)ref.name[0]) || ref.name[0] == '_';
+        for (size_t i = 1; ref.isVar && i < ref.name.size(); i++) {
+            ref.isVar = isalnum((unsigned char)ref.name[i]) || ref.name[i] == '_';
+        }
+        if (!ref.isVar) {
+            vector<char> exp(ref.name.begin(), ref.name.end());
+            exp.push_back('\0');
+            char *expPtr = &exp[0];
+            if (_adbExpr.compile(&expPtr, &ref.prog) == Expr::ERR_NO_COMPILE) {
+                tmpl.interpret = true;
+                break;
+            }
+        }
+        tmpl.refs.push_back(ref);
+        pos = ref.restPos;
+    }
+    tmpl.tail = expr.substr(pos);
+}
+
+/**
+ * Function: Adb::interpretExpr
+ **/
+string Adb::interpretExpr(string expr, AttrsMap *vars) {
+    if (expr.find('$') == string::npos) {
+        return expr;
+    }
+
     smatch what, what2;
-    regex singleExpr("^([^\\$]*)(\\$\\(([^)]+)\\))(.*)$");
+    static const regex singleExpr("^([^\\$]*)(\\$\\(([^)]+)\\))(.*)$");
+    static const regex singleVar("^[a-zA-Z_][a-zA-Z0-9_]*$");
     while (regex_search(expr, what, singleExpr)) {
         string vname = what[3].str();
         string vvalue;
-        regex singleVar("^[a-zA-Z_][a-zA-Z0-9_]*$");
 
         if (regex_search(vname, what2, singleVar)) {
             AttrsMap::iterator it = vars->find(vname);
@@ -157,6 +157,7 @@ public:
     AttrsMap attrs;
     bool isReserved;
     string condition; // field's visibility dynamic condition
+    map<string, u_int64_t> *enumMap; // parsed "enum" attribute, shared by the field's instances
 
     // FOR USER USAGE
     void *userData;
@@ -177,6 +178,7 @@ public:
 };
 
 /*************************** AdbInstance ***************************/
+class Adb;
 class AdbInstance {
 public:
     // Methods
@@ -198,6 +200,7 @@ public:
     vector<u_int64_t> getEnumValues();
     AdbInstance* getUnionSelectedNodeName(const u_int64_t& selectorVal);
     AdbInstance* getUnionSelectedNodeName(const string& selectorEnum);
+    AdbInstance* getUnionSelector();
     bool operator<(const AdbInstance& other);
     bool isConditionalNode();
     bool isConditionValid(map<string, string> *valuesMap);
@@ -210,6 +213,7 @@ public:
     string getAttr(const string &attrName);
     void setAttr(const string &attrName, const string &attrValue);
     vector<AdbInstance*> getLeafFields(); // Get all leaf fields
+    void expand(bool recursive = false); // Create the sub items of a lazy layout instance
     void pushBuf(u_int8_t *buf, u_int64_t value);
     u_int64_t popBuf(u_int8_t *buf);
 
@@ -228,8 +232,9 @@ public:
     AttrsMap attrs; // Attributes after evaluations and array expanding
     u_int32_t arrIdx;
     AttrsMap vars; // all variables relevant to this item after evaluation
-    AdbInstance *unionSelector; // For union instances only
+    AdbInstance *unionSelector; // For union instances only, see getUnionSelector()
     bool isDiff;
+    Adb *lazyAdb; // Set until the sub items of a lazy layout instance are created
 
     // FOR USER USAGE
     void *userData;
@@ -271,7 +276,8 @@ public:
     AdbInstance* addMissingNodes(int depth, bool allowMultipleExceptions);
     AdbInstance* createLayout(string rootNodeName, bool isExprEval = false,
             AdbProgress *progressObj = NULL, int depth = -1, /* -1 means instantiate full tree */
-            bool ignoreMissingNodes = false, bool getAllExceptions = false);
+            bool ignoreMissingNodes = false, bool getAllExceptions = false,
+            bool lazy = false); /* create sub items on first access, see AdbInstance::expand() */
     vector<string> getNodeDeps(string nodeName);
     string getLastError();
 
@@ -303,6 +309,7 @@ public:
     IncludeFileMap includedFiles;
     StringVector warnings;
     ExceptionsMap adbExceptionMap;
+    void expandInstance(AdbInstance *inst);
 private:
     vector<AdbInstance*> createInstance(AdbField *fieldDesc,
             AdbInstance *parent, map<string, string> vars, bool isExprEval,
@@ -311,11 +318,34 @@ private:
     u_int32_t calcArrOffset(AdbField *fieldDesc, AdbInstance *parent,
             u_int32_t arrIdx);
     string evalExpr(string expr, AttrsMap *vars);
+    string interpretExpr(string expr, AttrsMap *vars);
     bool checkInstSizeConsistency(bool getAllExceptions = false);
+    void evalUnionSelector(AdbInstance *inst, bool isRootLayout,
+            bool getAllExceptions);
+    void checkSubItemsOverlap(AdbInstance *inst, bool getAllExceptions);
 
 private:
     string _lastError;
     AdbExpr _adbExpr;
+    // compiled attribute strings, key is the attribute value (see evalExpr)
+    typedef struct {
+        string prefix;        // text before the $(...) reference
+        string name;          // variable name or expression
+        bool isVar;
+        Expr::program prog;   // compiled expression, if not a variable
+        size_t restPos;       // position after the reference
+    } ExprRef;
+    typedef struct {
+        bool interpret;       // can't be compiled, use interpretExpr
+        vector<ExprRef> refs;
+        string tail;
+    } ExprTemplate;
+    map<string, ExprTemplate> _exprCache;
+    void compileExpr(const string &expr, ExprTemplate &tmpl);
     std::list<AdbInstance*> _unionSelectorEvalDeffered;
+    // lazy layout
+    bool _lazyExprEval;
+    bool _lazyRootLayout;
+    map<string, AttrsMap*> _lazyInstAttrs; // instance path (w/o root) -> instance_ops attributes
 };
 #endif // ADB_PARSER_H
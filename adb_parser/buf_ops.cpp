@@ -74,26 +74,68 @@ static void push_integer_to_buff(u_int8_t *buff, u_int32_t bit_offset,  u_int32_
     memcpy(buff + bit_offset / 8, (u_int8_t*)&field_value + (8 - byte_size), byte_size);
 }
 
+/************************************
+* Function: load_be_bytes
+************************************/
+// loads the n (1-4) bytes at p as the MSBs of a big endian dword
+static inline u_int32_t load_be_bytes(const u_int8_t *p, u_int32_t n)
+{
+    u_int32_t dword = 0;
+    memcpy(&dword, p, n);
+    return BE32_TO_CPU(dword);
+}
+
+/************************************
+* Function: store_be_bytes
+************************************/
+static inline void store_be_bytes(u_int8_t *p, u_int32_t n, u_int32_t value)
+{
+    value = CPU_TO_BE32(value);
+    memcpy(p, &value, n);
+}
+
+/************************************
+* Function: load_dword
+************************************/
+static inline u_int32_t load_dword(const u_int8_t *buff, u_int32_t byte_offset)
+{
+    return load_be_bytes(buff + byte_offset, 4);
+}
+
+/************************************
+* Function: store_dword
+************************************/
+static inline void store_dword(u_int8_t *buff, u_int32_t byte_offset, u_int32_t value)
+{
+    store_be_bytes(buff + byte_offset, 4, value);
+}
+
 /************************************
 * Function: push_bits_to_buff
 ************************************/
-//the next function will push the field into the buffer by inserting it's MSB bits first
-//and therefore by doing it we save the CPU_TO_BE operation
+// bit_offset counts from the MSB of byte 0. The bytes of the field are
+// updated as one big endian word, a field over 5 bytes takes a dword and a byte
 static void push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
 {
-    u_int32_t i         = 0;
-    u_int32_t byte_n    = bit_offset / 8;
-    u_int32_t byte_n_offset = bit_offset % 8;
-    u_int32_t to_push;
-
-    //going over all bits in field
-    while (i < field_size) {
-        to_push = TOOLS_MIN(8 - byte_n_offset, field_size - i);
-        i += to_push;
-        BYTE_N(buff, byte_n) = INSERTF(BYTE_N(buff, byte_n), 8 - to_push - byte_n_offset, field_value, field_size - i, to_push);
-        byte_n_offset  = 0; //(byte_n_offset + to_push) % 8;
-        byte_n++;
+    u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
+    u_int64_t word, mask;
+
+    if (field_size == 0) {
+        return;
+    }
+    if (n <= 4) {
+        u_int32_t shift = 32 - start - field_size;
+        u_int32_t mask32 = ONES32(field_size) << shift;
+        store_be_bytes(p, n, (load_be_bytes(p, n) & ~mask32) | ((field_value << shift) & mask32));
+        return;
     }
+    mask = (u_int64_t)ONES32(field_size) << (40 - start - field_size);
+    word = ((u_int64_t)load_be_bytes(p, 4) << 8) | p[4];
+    word = (word & ~mask) | (((u_int64_t)field_value << (40 - start - field_size)) & mask);
+    store_be_bytes(p, 4, (u_int32_t)(word >> 8));
+    p[4] = (u_int8_t)word;
 }
 
 /************************************
@@ -122,26 +164,19 @@ static u_int64_t pop_integer_from_buff(const u_int8_t *buff, u_int32_t bit_offse
 /************************************
 * Function: pop_bits_from_buff
 ************************************/
-//the next function will pop the field into the buffer by removing it's MSB bits first
-//and therefore by doing it we save the BE_TO_CPU operation
 static u_int32_t pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
 {
-    u_int32_t i         = 0;
-    u_int32_t byte_n    = bit_offset / 8;
-    u_int32_t byte_n_offset = bit_offset % 8;
-    u_int32_t field_32  = 0;
-    u_int32_t to_pop;
-
-    //going over all bits in field
-    while (i < field_size) {
-        to_pop =  TOOLS_MIN(8 - byte_n_offset, field_size - i);
-        i += to_pop;
-        field_32 = INSERTF(field_32, field_size - i, BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
-        byte_n_offset  = 0; //(byte_n_offset + to_pop) % 8;
-        byte_n++;
-    }
+    const u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
 
-    return field_32;
+    if (field_size == 0) {
+        return 0;
+    }
+    if (n <= 4) {
+        return (load_be_bytes(p, n) << start) >> (32 - field_size);
+    }
+    return (u_int32_t)(((((u_int64_t)load_be_bytes(p, 4) << 8) | p[4]) >> (40 - start - field_size)) & ONES32(field_size));
 }
 
 /************************************
@@ -158,6 +193,113 @@ u_int64_t pop_from_buf(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t fie
     }
 }
 
+/************************************
+* Function: buf_op_init
+************************************/
+void buf_op_init(buf_field_op *op, u_int32_t bit_offset, u_int32_t field_size)
+{
+    op->bit_offset = bit_offset;
+    op->size = field_size;
+    op->byte_offset = (bit_offset >> 5) << 2;
+    op->shift = bit_offset % 32;
+    op->mask = field_size >= 32 ? 0xffffffff : (1U << field_size) - 1;
+    op->index = 0;
+
+    if (field_size > 32) {
+        op->type = field_size <= 64 ? BUF_OP_INTEGER : BUF_OP_GENERIC;
+    } else if (op->shift + field_size > 32 || field_size == 0) {
+        op->type = BUF_OP_GENERIC;
+    } else if (field_size == 32) {
+        op->type = BUF_OP_DWORD;
+    } else if (field_size == 8 && !(op->shift % 8)) {
+        op->type = BUF_OP_BYTE;
+        op->byte_offset += 3 - op->shift / 8;
+    } else {
+        op->type = BUF_OP_BITS;
+    }
+}
+
+/************************************
+* Function: buf_op_pop
+************************************/
+u_int64_t buf_op_pop(const u_int8_t *buff, const buf_field_op *op)
+{
+    switch (op->type) {
+    case BUF_OP_DWORD:
+        return load_dword(buff, op->byte_offset);
+
+    case BUF_OP_BYTE:
+        return buff[op->byte_offset];
+
+    case BUF_OP_BITS:
+        return (load_dword(buff, op->byte_offset) >> op->shift) & op->mask;
+
+    case BUF_OP_INTEGER:
+        return pop_integer_from_buff(buff, op->bit_offset, op->size / 8);
+
+    default:
+        return pop_from_buf(buff, op->bit_offset, op->size);
+    }
+}
+
+/************************************
+* Function: buf_op_push
+************************************/
+void buf_op_push(u_int8_t *buff, const buf_field_op *op, u_int64_t field_value)
+{
+    u_int32_t dword;
+
+    switch (op->type) {
+    case BUF_OP_DWORD:
+        store_dword(buff, op->byte_offset, (u_int32_t)field_value);
+        break;
+
+    case BUF_OP_BYTE:
+        buff[op->byte_offset] = (u_int8_t)field_value;
+        break;
+
+    case BUF_OP_BITS:
+        dword = load_dword(buff, op->byte_offset);
+        dword &= ~(op->mask << op->shift);
+        dword |= ((u_int32_t)field_value & op->mask) << op->shift;
+        store_dword(buff, op->byte_offset, dword);
+        break;
+
+    case BUF_OP_INTEGER:
+        push_integer_to_buff(buff, op->bit_offset, op->size / 8, field_value);
+        break;
+
+    default:
+        push_to_buf(buff, op->bit_offset, op->size, field_value);
+        break;
+    }
+}
+
+/************************************
+* Function: buf_plan_decode
+************************************/
+// ops are sorted by byte_offset, so fields sharing a dword are extracted
+// from a single load
+void buf_plan_decode(const u_int8_t *buff, const buf_field_op *ops, u_int32_t ops_num, u_int64_t *values)
+{
+    u_int32_t dword = 0;
+    u_int32_t dword_offset = 0xffffffff;
+    u_int32_t i;
+
+    for (i = 0; i < ops_num; i++) {
+        const buf_field_op *op = &ops[i];
+        if (op->type == BUF_OP_DWORD || op->type == BUF_OP_BITS) {
+            if (op->byte_offset != dword_offset) {
+                dword_offset = op->byte_offset;
+                dword = load_dword(buff, dword_offset);
+            }
+            values[op->index] = (dword >> op->shift) & op->mask;
+        } else {
+            values[op->index] = buf_op_pop(buff, op);
+        }
+    }
+}
+
 /************************************
 * Function: add_indentation
 ************************************/
@@ -50,4 +50,33 @@
 void print_raw(FILE *file, void *buff, int buff_len);
 u_int64_t pop_from_buf(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size);
 void push_to_buf(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int64_t field_value);
+
+/*
+ * Field access record, prepared once per field by buf_op_init() and used to
+ * pop/push the field without walking its bits. A list of records sorted by
+ * byte_offset is a decode plan: buf_plan_decode() extracts all of its fields
+ * loading each dword once.
+ */
+enum {
+    BUF_OP_DWORD,       /* whole dword                              */
+    BUF_OP_BYTE,        /* byte aligned byte                        */
+    BUF_OP_BITS,        /* bits within one dword                    */
+    BUF_OP_INTEGER,     /* big-endian integer of up to 64 bits      */
+    BUF_OP_GENERIC      /* anything else, done by pop/push_to_buf   */
+};
+
+typedef struct {
+    u_int32_t bit_offset;   /* field offset as given to pop_from_buf    */
+    u_int32_t size;         /* field size in bits                       */
+    u_int32_t byte_offset;  /* dword (or byte for BUF_OP_BYTE) offset   */
+    u_int32_t shift;        /* field LSB position within the dword      */
+    u_int32_t mask;         /* field mask, not shifted                  */
+    u_int32_t type;         /* BUF_OP_*                                 */
+    u_int32_t index;        /* decode plan: position in the value array */
+} buf_field_op;
+
+void buf_op_init(buf_field_op *op, u_int32_t bit_offset, u_int32_t field_size);
+u_int64_t buf_op_pop(const u_int8_t *buff, const buf_field_op *op);
+void buf_op_push(u_int8_t *buff, const buf_field_op *op, u_int64_t field_value);
+void buf_plan_decode(const u_int8_t *buff, const buf_field_op *ops, u_int32_t ops_num, u_int64_t *values);
 #endif // BIT_OPS_H
@@ -44,6 +44,7 @@
 char*Expr::str;
 char*Expr::initial_arg;
 Expr::status Expr::state;
+Expr::program*Expr::prog;
 
 /*
  * Number of elements in array
@@ -97,6 +98,8 @@ Expr::status Expr::state;
  * Other token types
  */
 #define VALUE     103   /* Name or constant */
+#define NAME      104   /* Symbolic name (compiled program only) */
+#define ERROR     105   /* Error report (compiled program only) */
 #define EXPR_OK   0     /* Expression getted successfully */
 
 /*
@@ -107,6 +110,7 @@ Expr::status Expr::state;
 #endif
 #define IGNORE    " \t\n\r" /* Ignore in parsing */
 #define HIGH_PRI  1
+#define MAX_STACK 64    /* Operand stack depth of a compiled program */
 #define LOW_PRI   9
 
 /*
@@ -219,6 +223,138 @@ int Expr::expr(char **pstr, u_int64_t *result)
 }
 
 
+/********************************************************
+* routine:     compile
+*
+* description:
+*     Parses expression once and stores it as a program for
+*     repeated evaluation by run(). Names are not resolved and
+*     syntax errors are not reported while compiling, both are
+*     postponed to run() so that a compiled expression behaves
+*     exactly like expr() called on the same string.
+*
+* arguments:
+*     pstr            pointer to string which contains expression,
+*                     moved to the first unparsed character.
+*     program         program to fill in.
+*
+* return code:
+*     >=0             length of compiled expression.
+*     <0              error code as in expr(), the program ends
+*                     with the error report.
+*     ERR_NO_COMPILE  expression can't be compiled, use expr().
+*
+********************************************************/
+int Expr::compile(char **pstr, program *p)
+{
+    u_int64_t val = 0;
+    unsigned int i;
+    int rc, depth = 0;
+
+    p->clear();
+    prog = p;
+    rc = expr(pstr, &val);
+    prog = NULL;
+
+    for (i = 0; i < p->size(); i++) {
+        switch ((*p)[i].type)
+        {
+        case SWAP32:
+        case SWAP16:
+            /* SWAP operations use the accumulator seen before the operand */
+            p->clear();
+            return ERR_NO_COMPILE;
+
+        case VALUE:
+        case NAME:
+            if (++depth > MAX_STACK) {
+                p->clear();
+                return ERR_NO_COMPILE;
+            }
+            break;
+
+        case ERROR:
+            break;
+
+        default:
+            if ((*p)[i].type < ULOGNOT) {
+                depth--;
+            }
+            break;
+        }
+    }
+    if (rc < 0) {
+        if (p->empty() || p->back().type != ERROR) {
+            p->clear();
+            return ERR_NO_COMPILE;
+        }
+        p->back().value = (u_int64_t)rc;
+    }
+    return rc;
+}
+
+
+/********************************************************
+* routine:     run
+*
+* description:
+*     Evaluates a program prepared by compile().
+*
+* arguments:
+*     p               compiled program.
+*     result          pointer to unsigned long to put result of expression.
+*
+* return code:
+*     EXPR_OK         Expression evaluated successfully.
+*     <0              error code, see expr().
+*
+********************************************************/
+int Expr::run(const program &p, u_int64_t *result)
+{
+    u_int64_t stack[MAX_STACK];
+    int sp = 0;
+    int rc;
+    unsigned int i;
+
+    for (i = 0; i < p.size(); i++) {
+        const instr &in = p[i];
+        switch (in.type)
+        {
+        case VALUE:
+            stack[sp++] = in.value;
+            break;
+
+        case NAME:
+            if (ResolveName((char*)in.text.c_str(), &stack[sp]) != 0) {
+                ErrorReport("Symbolic name \"%s\" not resolved.\n", in.text.c_str());
+                return ERR_BAD_NAME;
+            }
+            sp++;
+            break;
+
+        case ERROR:
+            Error((char*)in.text.c_str());
+            return (int)in.value;
+
+        default:
+            if (in.type < ULOGNOT) {
+                sp--;
+                rc = BinaryOp(in.type, &stack[sp - 1], stack[sp]);
+                if (rc != EXPR_OK) {
+                    return rc;
+                }
+            } else {
+                UnaryOp(in.type, &stack[sp - 1], 0);
+            }
+            break;
+        }
+    }
+
+    *result = stack[0];
+    return EXPR_OK;
+}
+
+
 /********************************************************
 * routine:     GetBinaryOp
 *
@@ -272,91 +408,14 @@ int Expr::GetBinaryOp(u_int64_t *val, int priority)
                     return rc;
                 }
 
-                switch (curr.type)
-                {
-                case MODUL:
-                    if (right == 0) {
-                        ErrorReport("Zero modulo attempt.\n");
-                        return ERR_DIV_ZERO;
-                    }
-                    left = left % right;
-                    break;
-
-                case MULT:
-                    left = left * right;
-                    break;
-
-                case DIVID:
-                    if (right == 0) {
-                        ErrorReport("Zero divide attempt.\n");
-                        return ERR_DIV_ZERO;
+                if (prog) {
+                    /* Compile mode, the operation runs in run(). */
+                    Emit(curr.type, 0, NULL);
+                } else {
+                    rc = BinaryOp(curr.type, &left, right);
+                    if (rc != EXPR_OK) {
+                        return rc;
                     }
-                    left = left / right;
-                    break;
-
-                case PLUS:
-                    left = left + right;
-                    break;
-
-                case MINUS:
-                    left = left - right;
-                    break;
-
-                case SHIFT_L:
-                    left = (left << (int)right);
-                    break;
-
-                case SHIFT_R:
-                    left = (left >> (int)right);
-                    break;
-
-                case GREAT:
-                    left = (left > right);
-                    break;
-
-                case GREAT_EQ:
-                    left = (left >= right);
-                    break;
-
-                case LESS:
-                    left = (left < right);
-                    break;
-
-                case LESS_EQ:
-                    left = (left <= right);
-                    break;
-
-                case EQ:
-                    left = (left == right);
-                    break;
-
-                case NOTEQ:
-                    left = (left != right);
-                    break;
-
-                case BIT_AND:
-                    left = left & right;
-                    break;
-
-                case BIT_OR:
-                    left = left | right;
-                    break;
-
-                case BIT_XOR:
-                    left = left ^ right;
-                    break;
-
-                case AND:
-                    left = (left && right);
-                    break;
-
-                case OR:
-                    left = (left || right);
-                    break;
-
-                case XOR:
-                    left = (left && !right)  ||  (!left && right);
-                    break;
                 }
                 break;
             }
@@ -388,8 +447,6 @@ int Expr::GetBinaryOp(u_int64_t *val, int priority)
 int Expr::GetUnaryOp(u_int64_t *val)
 {
     int rc, unary_op;
-    u_int64_t tmp = 0;
-    u_int64_t tmp1 = 0;
     token curr;
     u_int64_t tmpVal = *val;
 
@@ -414,51 +471,10 @@ int Expr::GetUnaryOp(u_int64_t *val)
             return rc;
         }
 
-        /* OK, execute required unary operation. */
-        switch (unary_op)
-        {
-        case U2POW_ALT:
-        case U2POW:
-            *val = (u_int64_t)1 << (int)(*val);
-            break;
-
-        case ULOG2_ALT:
-        case ULOG2:
-            if (*val != 0) {
-                for (tmp = 1, tmp1 = 0; tmp < *val; tmp = tmp << 1)
-                    ++tmp1;
-                *val = tmp1;
-            }
-            break;
-
-        case ULOGNOT:
-            *val = !(*val);
-            break;
-
-        case UMINUS:
-            *val = (u_int64_t)(-((int64_t)(*val)));
-            break;
-
-        case UNOT:
-            *val = ~(*val);
-            break;
-
-        case UPLUS:
-            break;
-
-        case SWAP32:
-            *val = ((tmpVal & 0x000000FFUL) << 24)  |
-                   ((tmpVal & 0x0000FF00UL) << 8)   |
-                   ((tmpVal & 0x00FF0000UL) >> 8)   |
-                   ((tmpVal & 0xFF000000UL) >> 24);
-            break;
-
-        case SWAP16:
-            *val = ((tmpVal & 0xFF000000U) >> 8) |
-                   ((tmpVal & 0x00FF0000U) << 8) |
-                   ((tmpVal & 0x0000FF00U) >> 8) |
-                   ((tmpVal & 0x000000FFU) << 8);
-            break;
+        if (prog) {
+            Emit(unary_op, 0, NULL);
+        } else {
+            UnaryOp(unary_op, val, tmpVal);
         }
         break;
 
@@ -482,6 +498,182 @@ int Expr::GetUnaryOp(u_int64_t *val)
     return EXPR_OK;
 }
 
+
+/********************************************************
+* routine:     BinaryOp
+*
+* description:
+*     Executes a single binary operation.
+*
+* arguments:
+*     op              Binary operation type.
+*     left            Pointer to the left operand, replaced by result.
+*     right           Right operand.
+*
+* return code:
+*     EXPR_OK         Operation was calculated successfully
+*     ERR_DIV_ZERO    Zero divide attempt
+*
+********************************************************/
+int Expr::BinaryOp(int op, u_int64_t *left, u_int64_t right)
+{
+    switch (op)
+    {
+    case MODUL:
+        if (right == 0) {
+            ErrorReport("Zero modulo attempt.\n");
+            return ERR_DIV_ZERO;
+        }
+        *left = *left % right;
+        break;
+
+    case MULT:
+        *left = *left * right;
+        break;
+
+    case DIVID:
+        if (right == 0) {
+            ErrorReport("Zero divide attempt.\n");
+            return ERR_DIV_ZERO;
+        }
+        *left = *left / right;
+        break;
+
+    case PLUS:
+        *left = *left + right;
+        break;
+
+    case MINUS:
+        *left = *left - right;
+        break;
+
+    case SHIFT_L:
+        *left = (*left << (int)right);
+        break;
+
+    case SHIFT_R:
+        *left = (*left >> (int)right);
+        break;
+
+    case GREAT:
+        *left = (*left > right);
+        break;
+
+    case GREAT_EQ:
+        *left = (*left >= right);
+        break;
+
+    case LESS:
+        *left = (*left < right);
+        break;
+
+    case LESS_EQ:
+        *left = (*left <= right);
+        break;
+
+    case EQ:
+        *left = (*left == right);
+        break;
+
+    case NOTEQ:
+        *left = (*left != right);
+        break;
+
+    case BIT_AND:
+        *left = *left & right;
+        break;
+
+    case BIT_OR:
+        *left = *left | right;
+        break;
+
+    case BIT_XOR:
+        *left = *left ^ right;
+        break;
+
+    case AND:
+        *left = (*left && right);
+        break;
+
+    case OR:
+        *left = (*left || right);
+        break;
+
+    case XOR:
+        *left = (*left && !right)  ||  (!*left && right);
+        break;
+    }
+
+    return EXPR_OK;
+}
+
+
+/********************************************************
+* routine:     UnaryOp
+*
+* description:
+*     Executes a single unary operation.
+*
+* arguments:
+*     op              Unary operation type.
+*     val             Pointer to the operand, replaced by result.
+*     tmpVal          Accumulator value seen before the operand
+*                     (used by SWAP32 and SWAP16).
+*
+********************************************************/
+void Expr::UnaryOp(int op, u_int64_t *val, u_int64_t tmpVal)
+{
+    u_int64_t tmp = 0;
+    u_int64_t tmp1 = 0;
+
+    switch (op)
+    {
+    case U2POW_ALT:
+    case U2POW:
+        *val = (u_int64_t)1 << (int)(*val);
+        break;
+
+    case ULOG2_ALT:
+    case ULOG2:
+        if (*val != 0) {
+            for (tmp = 1, tmp1 = 0; tmp < *val; tmp = tmp << 1)
+                ++tmp1;
+            *val = tmp1;
+        }
+        break;
+
+    case ULOGNOT:
+        *val = !(*val);
+        break;
+
+    case UMINUS:
+        *val = (u_int64_t)(-((int64_t)(*val)));
+        break;
+
+    case UNOT:
+        *val = ~(*val);
+        break;
+
+    case UPLUS:
+        break;
+
+    case SWAP32:
+        *val = ((tmpVal & 0x000000FFUL) << 24)  |
+               ((tmpVal & 0x0000FF00UL) << 8)   |
+               ((tmpVal & 0x00FF0000UL) >> 8)   |
+               ((tmpVal & 0xFF000000UL) >> 24);
+        break;
+
+    case SWAP16:
+        *val = ((tmpVal & 0xFF000000U) >> 8) |
+               ((tmpVal & 0x00FF0000U) << 8) |
+               ((tmpVal & 0x0000FF00U) >> 8) |
+               ((tmpVal & 0x000000FFU) << 8);
+        break;
+    }
+}
+
+
 /********************************************************
 * routine:     GetToken
 *
@@ -703,6 +895,9 @@ int Expr::GetNumb(u_int64_t *val)
                                                 ( ('A' <= *str && *str <= 'F') ? *str - 'A' + 10 :
                                                                                  *str - '0'));
 
+    if (prog) {
+        Emit(VALUE, *val, NULL);
+    }
     return EXPR_OK;
 }
 
@@ -754,6 +949,13 @@ int Expr::GetName(u_int64_t *val)
         return GetNumb(val); /* and get it as number        */
     }
 
+    /* In compile mode the name is resolved by run(). */
+    if (prog) {
+        *val = 0;
+        Emit(NAME, 0, name);
+        return EXPR_OK;
+    }
+
     /* Retrieve name from symbol table. */
     /* -------------------------------- */
     if (ResolveName(name, val) == 0) {
@@ -817,6 +1019,31 @@ int Expr::valid_digit(char ch, int radix)
 }
 
 
+/********************************************************
+* routine:     Emit
+*
+* description:
+*     Appends an instruction to the program being compiled.
+*
+* arguments:
+*     type         - operation, VALUE, NAME or ERROR
+*     value        - constant value
+*     text         - name or message, may be NULL
+*
+********************************************************/
+void Expr::Emit(int type, u_int64_t value, const char *text)
+{
+    instr in;
+
+    in.type = type;
+    in.value = value;
+    if (text) {
+        in.text = text;
+    }
+    prog->push_back(in);
+}
+
+
 /********************************************************
 * routine:     ErrorReport
 *
@@ -835,7 +1062,12 @@ void Expr::ErrorReport(const char *format, ...)
     va_start(args, format);
     msg = vprint(format, args);
     va_end(args);
-    Error(msg);
+    if (prog) {
+        /* Compile mode, the error is reported when the program runs. */
+        Emit(ERROR, 0, msg);
+    } else {
+        Error(msg);
+    }
     delete [] msg;
 }
 
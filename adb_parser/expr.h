@@ -88,6 +88,10 @@
  *    value per name. Function must be written according to your
  *    application and must return 0 on success completion.
  *
+ *    An expression evaluated many times may be compiled once by
+ *    compile() and evaluated by run(), names are resolved on
+ *    each run.
+ *
  *  Version: $Id: Expr.h,v 1.1 2007-08-29 10:29:45 orenk Exp $
  *
  */
@@ -97,6 +101,8 @@
 
 #include <stdarg.h>
 #include <sys/types.h>
+#include <string>
+#include <vector>
 
 #include <common/compatibility.h>
 
@@ -110,13 +116,25 @@ public:
         ERR_BIN_EXP   = -3,   // Binary operation expected (normal at end)
         ERR_DIV_ZERO  = -4,   // Divide zero attempt
         ERR_BAD_NUMBER = -5,   // Bad constant syntax
-        ERR_BAD_NAME  = -6    // Name not resolved
+        ERR_BAD_NAME  = -6,   // Name not resolved
+        ERR_NO_COMPILE = -7   // Expression can't be compiled
     };
     Expr() : def_radix(10) { }
     virtual ~Expr()        { }
 
     int     expr(char **pstr, u_int64_t *result);
 
+    /* Compiled expression: operands and operations in evaluation order. */
+    typedef struct {
+        int type;          /* operation, VALUE, NAME or ERROR            */
+        u_int64_t value;   /* constant (VALUE) or error code (ERROR)     */
+        std::string text;  /* symbolic name (NAME) or message (ERROR)    */
+    } instr;
+    typedef std::vector<instr> program;
+
+    int     compile(char **pstr, program *p);
+    int     run(const program &p, u_int64_t *result);
+
     /* Current state of parsing. */
     typedef enum {
         was_bin,          /* was binary operation */
@@ -143,10 +161,14 @@ private:
     static char    *str;
     static char    *initial_arg;
     static status state;
+    static program *prog;  /* not NULL while compiling */
     int def_radix;
 
     int     GetBinaryOp(u_int64_t *val, int priority);
     int     GetUnaryOp(u_int64_t *val);
+    int     BinaryOp(int op, u_int64_t *left, u_int64_t right);
+    void    UnaryOp(int op, u_int64_t *val, u_int64_t tmpVal);
+    void    Emit(int type, u_int64_t value, const char *text);
     void    GetToken(token *pt);
     void    UngetToken(token t);
     int     GetNumb(u_int64_t *val);
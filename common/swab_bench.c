@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * swab_bench.c - checks the SIMD dword swab paths of tools_swab.h against a
+ * byte at a time swab, for every length up to MAX_CHECK_DWORDS and every
+ * source/destination alignment, in place and out of place, then measures
+ * the swab rate for buffers of 4KB to 64MB:
+ *
+ *   swab_bench [iterations]
+ *
+ * Exits with 1 on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "tools_swab.h"
+
+#define MAX_CHECK_DWORDS 256
+#define MAX_ALIGN        32
+#define GUARD            0xa5
+
+typedef void (*swab_func)(void *dst, const void *src, size_t dwords);
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* The reference for the checks */
+static void ref_swab32(void *dst, const void *src, size_t dwords)
+{
+    u_int8_t *d = (u_int8_t*)dst;
+    const u_int8_t *s = (const u_int8_t*)src;
+    size_t i;
+    for (i = 0; i < dwords * 4; i += 4) {
+        d[i] = s[i + 3];
+        d[i + 1] = s[i + 2];
+        d[i + 2] = s[i + 1];
+        d[i + 3] = s[i];
+    }
+}
+
+static void scalar_swab32(void *dst, const void *src, size_t dwords)
+{
+    u_int8_t *d = (u_int8_t*)dst;
+    const u_int8_t *s = (const u_int8_t*)src;
+    u_int32_t tmp;
+    size_t i;
+    for (i = 0; i < dwords; i++) {
+        memcpy(&tmp, s + i * 4, 4);
+        tmp = ___my_swab32(tmp);
+        memcpy(d + i * 4, &tmp, 4);
+    }
+}
+
+#ifdef TOOLS_SWAB_X86
+__attribute__((target("avx2")))
+static void avx2_swab32(void *dst, const void *src, size_t dwords)
+{
+    size_t i = tools_swab32_avx2((u_int8_t*)dst, (const u_int8_t*)src, dwords);
+    scalar_swab32((u_int8_t*)dst + i * 4, (const u_int8_t*)src + i * 4, dwords - i);
+}
+
+__attribute__((target("ssse3")))
+static void ssse3_swab32(void *dst, const void *src, size_t dwords)
+{
+    size_t i = tools_swab32_ssse3((u_int8_t*)dst, (const u_int8_t*)src, dwords);
+    scalar_swab32((u_int8_t*)dst + i * 4, (const u_int8_t*)src + i * 4, dwords - i);
+}
+#endif
+
+#ifdef TOOLS_SWAB_NEON
+static void neon_swab32(void *dst, const void *src, size_t dwords)
+{
+    size_t i = tools_swab32_neon((u_int8_t*)dst, (const u_int8_t*)src, dwords);
+    scalar_swab32((u_int8_t*)dst + i * 4, (const u_int8_t*)src + i * 4, dwords - i);
+}
+#endif
+
+struct swab_impl {
+    const char *name;
+    swab_func swab;
+    int supported;
+};
+
+static struct swab_impl impls[] = {
+    {"scalar", scalar_swab32, 1},
+    {"tools_swab32_buf", tools_swab32_buf, 1},
+#ifdef TOOLS_SWAB_X86
+    {"avx2", avx2_swab32, 0},
+    {"ssse3", ssse3_swab32, 0},
+#endif
+#ifdef TOOLS_SWAB_NEON
+    {"neon", neon_swab32, 1},
+#endif
+};
+
+#define IMPLS_NUM (sizeof(impls) / sizeof(impls[0]))
+
+static void init_impls()
+{
+#ifdef TOOLS_SWAB_X86
+    unsigned int i;
+    for (i = 0; i < IMPLS_NUM; i++) {
+        if (!strcmp(impls[i].name, "avx2")) {
+            impls[i].supported = __builtin_cpu_supports("avx2");
+        } else if (!strcmp(impls[i].name, "ssse3")) {
+            impls[i].supported = __builtin_cpu_supports("ssse3");
+        }
+    }
+#endif
+}
+
+/* Swab src + src_off into dst + dst_off and compare to the reference, including the bytes around it */
+static int check_one(const struct swab_impl *impl, const u_int8_t *pattern, u_int8_t *src, u_int8_t *dst,
+                     u_int8_t *exp, size_t dwords, unsigned int src_off, unsigned int dst_off, int in_place)
+{
+    size_t size = MAX_CHECK_DWORDS * 4 + 2 * MAX_ALIGN;
+
+    memcpy(src, pattern, size);
+    memset(exp, GUARD, size);
+    if (in_place) {
+        memcpy(exp, src, size);
+        ref_swab32(exp + src_off, src + src_off, dwords);
+        impl->swab(src + src_off, src + src_off, dwords);
+        return memcmp(exp, src, size);
+    }
+    memset(dst, GUARD, size);
+    ref_swab32(exp + dst_off, src + src_off, dwords);
+    impl->swab(dst + dst_off, src + src_off, dwords);
+    return memcmp(exp, dst, size);
+}
+
+static int check_impl(const struct swab_impl *impl)
+{
+    size_t size = MAX_CHECK_DWORDS * 4 + 2 * MAX_ALIGN;
+    u_int8_t *pattern = (u_int8_t*)malloc(size);
+    u_int8_t *src = (u_int8_t*)malloc(size);
+    u_int8_t *dst = (u_int8_t*)malloc(size);
+    u_int8_t *exp = (u_int8_t*)malloc(size);
+    unsigned int src_off, dst_off;
+    size_t dwords;
+    int rc = 0;
+
+    if (!pattern || !src || !dst || !exp) {
+        fprintf(stderr, "-E- Out of memory\n");
+        rc = 1;
+        goto cleanup;
+    }
+    for (dwords = 0; dwords < size; dwords++) {
+        pattern[dwords] = (u_int8_t)rand();
+    }
+    for (dwords = 0; dwords <= MAX_CHECK_DWORDS; dwords++) {
+        for (src_off = 0; src_off < MAX_ALIGN; src_off++) {
+            if (check_one(impl, pattern, src, dst, exp, dwords, src_off, 0, 1)) {
+                fprintf(stderr, "-E- %s: mismatch in place, dwords %zu, offset %u\n", impl->name, dwords, src_off);
+                rc = 1;
+                goto cleanup;
+            }
+            for (dst_off = 0; dst_off < MAX_ALIGN; dst_off++) {
+                if (check_one(impl, pattern, src, dst, exp, dwords, src_off, dst_off, 0)) {
+                    fprintf(stderr, "-E- %s: mismatch, dwords %zu, src offset %u, dst offset %u\n",
+                            impl->name, dwords, src_off, dst_off);
+                    rc = 1;
+                    goto cleanup;
+                }
+            }
+        }
+    }
+cleanup:
+    free(pattern);
+    free(src);
+    free(dst);
+    free(exp);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = {4 << 10, 64 << 10, 1 << 20, 16 << 20, 64 << 20};
+    const unsigned int sizes_num = sizeof(sizes) / sizeof(sizes[0]);
+    int iterations = argc > 1 ? atoi(argv[1]) : 1;
+    unsigned int i, j;
+    u_int8_t *src;
+    u_int8_t *dst;
+
+    init_impls();
+    for (i = 0; i < IMPLS_NUM; i++) {
+        if (!impls[i].supported) {
+            printf("%-18s not supported by this CPU\n", impls[i].name);
+            continue;
+        }
+        if (check_impl(&impls[i])) {
+            return 1;
+        }
+        printf("%-18s matches the reference\n", impls[i].name);
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    src = (u_int8_t*)malloc(sizes[sizes_num - 1]);
+    dst = (u_int8_t*)malloc(sizes[sizes_num - 1]);
+    if (!src || !dst) {
+        fprintf(stderr, "-E- Out of memory\n");
+        free(src);
+        free(dst);
+        return 1;
+    }
+    memset(src, 0x5a, sizes[sizes_num - 1]);
+    memset(dst, 0, sizes[sizes_num - 1]);
+
+    printf("\n%-18s", "GB/s");
+    for (j = 0; j < sizes_num; j++) {
+        printf(" %9zuKB", sizes[j] >> 10);
+    }
+    printf("\n");
+    for (i = 0; i < IMPLS_NUM; i++) {
+        if (!impls[i].supported) {
+            continue;
+        }
+        printf("%-18s", impls[i].name);
+        for (j = 0; j < sizes_num; j++) {
+            /* About 256MB per measurement, at least one pass */
+            long reps = (long)((256 << 20) / sizes[j]) * iterations;
+            double start, ms;
+            long r;
+            impls[i].swab(dst, src, sizes[j] / 4);
+            start = now();
+            for (r = 0; r < reps; r++) {
+                impls[i].swab(dst, src, sizes[j] / 4);
+            }
+            ms = now() - start;
+            printf(" %11.2f", ms > 0 ? (double)sizes[j] * reps / (ms * 1e6) : 0.0);
+        }
+        printf("\n");
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * tools_swab.h - Byte swapping of dword buffers.
+ *
+ * Block transfers hand big-endian dwords to/from the device, converting them
+ * one by one is measurable for flash images and cr-space dumps. The helpers
+ * below swap 8 (AVX2) or 4 (SSSE3/NEON) dwords per instruction and fall back
+ * to the scalar swab on other targets. The x86 path is selected at runtime
+ * so the binaries still run on CPUs without these extensions.
+ * Buffers do not need to be aligned and dst may be equal to src.
+ */
+
+#ifndef TOOLS_SWAB_H
+#define TOOLS_SWAB_H
+
+#include <string.h>
+#include "compatibility.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ >= 5 || defined(__clang__))
+    #define TOOLS_SWAB_X86 1
+    #include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+    #define TOOLS_SWAB_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#ifdef TOOLS_SWAB_X86
+__attribute__((target("avx2")))
+static inline size_t tools_swab32_avx2(u_int8_t *dst, const u_int8_t *src, size_t dwords)
+{
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i;
+    for (i = 0; i + 8 <= dwords; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static inline size_t tools_swab32_ssse3(u_int8_t *dst, const u_int8_t *src, size_t dwords)
+{
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i;
+    for (i = 0; i + 4 <= dwords; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+#endif
+
+#ifdef TOOLS_SWAB_NEON
+static inline size_t tools_swab32_neon(u_int8_t *dst, const u_int8_t *src, size_t dwords)
+{
+    size_t i;
+    for (i = 0; i + 4 <= dwords; i += 4) {
+        vst1q_u8(dst + i * 4, vrev32q_u8(vld1q_u8(src + i * 4)));
+    }
+    return i;
+}
+#endif
+
+/*
+ * Unconditionally swap the bytes of each of the dwords in src into dst.
+ */
+static inline void tools_swab32_buf(void *dst, const void *src, size_t dwords)
+{
+    u_int8_t *d = (u_int8_t*)dst;
+    const u_int8_t *s = (const u_int8_t*)src;
+    size_t i = 0;
+    u_int32_t tmp;
+
+#if defined(TOOLS_SWAB_X86)
+    if (dwords >= 8 && __builtin_cpu_supports("avx2")) {
+        i = tools_swab32_avx2(d, s, dwords);
+    } else if (dwords >= 4 && __builtin_cpu_supports("ssse3")) {
+        i = tools_swab32_ssse3(d, s, dwords);
+    }
+#elif defined(TOOLS_SWAB_NEON)
+    i = tools_swab32_neon(d, s, dwords);
+#endif
+    for (; i < dwords; i++) {
+        memcpy(&tmp, s + i * 4, 4);
+        tmp = ___my_swab32(tmp);
+        memcpy(d + i * 4, &tmp, 4);
+    }
+}
+
+/*
+ * Convert big-endian dwords to CPU order and vice versa.
+ */
+static inline void tools_be32_to_cpu_buf(void *dst, const void *src, size_t dwords)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    tools_swab32_buf(dst, src, dwords);
+#else
+    if (dst != src) {
+        memmove(dst, src, dwords * 4);
+    }
+#endif
+}
+
+#define tools_cpu_to_be32_buf(dst, src, dwords) tools_be32_to_cpu_buf((dst), (src), (dwords))
+
+#endif
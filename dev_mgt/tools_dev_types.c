@@ -44,6 +44,7 @@
 #include <string.h>
 #include <errno.h>
 #include <reg_access/reg_access.h>
+#include <mtcr_dev_cache.h>
 #include "tools_dev_types.h"
 #include "mflash/mflash_types.h"
 
@@ -364,6 +365,8 @@ int dm_get_device_id(mfile *mf,
     u_int32_t dword = 0;
     int rc;
     u_int32_t dev_flags;
+    u_int64_t start_time = mdev_cache_time_us();
+    int cache_dev_id = 0;
 
     //Special case: FPGA device:
 #ifndef MST_UL
@@ -447,6 +450,15 @@ int dm_get_device_id(mfile *mf,
             }
         }
     } else {
+        int cached_dev_id;
+        if (!mdev_cache_get_dev_id(mf, &cached_dev_id, ptr_hw_dev_id, ptr_hw_rev)) {
+            *ptr_dm_dev_id = (dm_dev_id_t)cached_dev_id;
+            if (mdev_cache_debug()) {
+                fprintf(stderr, "-D- device id taken from the cache (%lu usec)\n",
+                        (unsigned long)(mdev_cache_time_us() - start_time));
+            }
+            return 0;
+        }
         if (mread4(mf, DEVID_ADDR, &dword) != 4) {
             printf("FATAL - crspace read (0x%x) failed: %s\n", DEVID_ADDR, strerror(errno));
             return 1;
@@ -454,6 +466,7 @@ int dm_get_device_id(mfile *mf,
 
         *ptr_hw_dev_id = EXTRACT(dword, 0, 16);
         *ptr_hw_rev    = EXTRACT(dword, 16, 8);
+        cache_dev_id = 1;
     }
 
     *ptr_dm_dev_id = get_entry_by_dev_rev_id(*ptr_hw_dev_id, *ptr_hw_rev)->dm_id;
@@ -464,6 +477,13 @@ int dm_get_device_id(mfile *mf,
         printf("FATAL - Can't find device id.\n");
         return MFE_UNSUPPORTED_DEVICE;
     }
+    if (cache_dev_id) {
+        if (mdev_cache_debug()) {
+            fprintf(stderr, "-D- device id probe took %lu usec\n",
+                    (unsigned long)(mdev_cache_time_us() - start_time));
+        }
+        mdev_cache_set_dev_id(mf, *ptr_dm_dev_id, *ptr_hw_dev_id, *ptr_hw_rev);
+    }
     return 0;
 }
 
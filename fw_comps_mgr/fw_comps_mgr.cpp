@@ -40,6 +40,7 @@
 #include "fw_comps_mgr.h"
 #include "compatibility.h"
 #include "bit_slice.h"
+#include "tools_swab.h"
 #include <time.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -123,7 +124,6 @@ bool FwCompsMgr::accessComponent(u_int32_t offset,
                                  ProgressCallBackAdvSt *progressFuncAdv)
 {
     int leftSize = (int)size;
-    u_int32_t i = 0;
     mcdaReg accessData;
     char stage[MAX_MSG_SIZE] = {0};
     int progressPercentage = -1;
@@ -151,14 +151,10 @@ bool FwCompsMgr::accessComponent(u_int32_t offset,
                 _lastError = regErrTrans(rc);
                 return false;
             }
-            for (i = 0; i < accessData.size / 4; i++) {
-                data[(size - leftSize) / 4 + i] = ___my_swab32(accessData.data[i]);
-            }
+            tools_swab32_buf(data + (size - leftSize) / 4, accessData.data, accessData.size / 4);
             //printf("data[%#02x]: %#08x\n", (i-1)*4, data[(size - leftSize)/4 + i-1]);
         } else {
-            for (i = 0; i < accessData.size / 4; i++) {
-                accessData.data[i] = ___my_swab32(data[(size - leftSize) / 4 + i]);
-            }
+            tools_swab32_buf(accessData.data, data + (size - leftSize) / 4, accessData.size / 4);
             reg_access_status_t rc = reg_access_mcda(_mf, REG_ACCESS_METHOD_SET, &accessData);
             deal_with_signal();
             if (rc) {
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mtcr_async.h - Asynchronous register access queue.
+ *
+ * Register accesses are submitted to a queue and executed by a small pool of
+ * worker threads. Accesses to the same mfile are executed one at a time in
+ * submission order (a device has a single icmd/tools_cmdif mailbox), while
+ * accesses to different mfiles run in parallel so their transport latency
+ * overlaps.
+ * Completion callbacks are invoked from maccess_reg_poll()/maccess_reg_drain()
+ * in the thread that calls them, never from the worker threads.
+ * reg_data must stay valid until the callback of the access was invoked.
+ */
+
+#ifndef MTCR_ASYNC_H
+#define MTCR_ASYNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mtcr.h"
+
+#define MACCESS_REG_QUEUE_DEF_WORKERS 8
+
+/*
+ * rc and reg_status hold the values maccess_reg() would have returned
+ */
+typedef void (*maccess_reg_cb_t)(int rc, int reg_status, void *reg_data, void *cb_ctx);
+
+typedef struct maccess_reg_queue_t maccess_reg_queue;
+
+/*
+ * Create a queue served by num_workers threads (MACCESS_REG_QUEUE_DEF_WORKERS if <= 0).
+ * Return NULL on failure.
+ */
+maccess_reg_queue* maccess_reg_queue_create(int num_workers);
+
+/*
+ * Drain the queue (invoking the pending callbacks) and release it.
+ */
+void maccess_reg_queue_destroy(maccess_reg_queue *q);
+
+/*
+ * Submit a register access, same arguments as maccess_reg().
+ * Return 0 on success, -1 on failure (errno is set), cb is not called on failure.
+ */
+int maccess_reg_async(maccess_reg_queue *q, mfile *mf, u_int16_t reg_id, maccess_reg_method_t reg_method,
+                      void *reg_data, u_int32_t reg_size, u_int32_t r_size_reg, u_int32_t w_size_reg,
+                      maccess_reg_cb_t cb, void *cb_ctx);
+
+/*
+ * Invoke the callbacks of the accesses that completed so far without blocking.
+ * Return the number of completions handled.
+ */
+int maccess_reg_poll(maccess_reg_queue *q);
+
+/*
+ * Wait for all submitted accesses and invoke their callbacks.
+ * Return the number of completions handled.
+ */
+int maccess_reg_drain(maccess_reg_queue *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
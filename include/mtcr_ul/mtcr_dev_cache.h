@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * mtcr_dev_cache.h - Per boot cache of the PCI device probe results.
+ *
+ * Opening a device over PCI config space walks the capability list to find
+ * the VSEC and probes every address space through the gateway, and
+ * dm_get_device_id() reads the HW id from CR-Space, all before a tool does
+ * any real work. The results can only change when the device changes, so
+ * they are kept in a small file keyed by the boot id and the device BDF,
+ * and validated against the PCI ids and the HW revision of the function,
+ * and the subsystem ids that the FW image sets.
+ *
+ * Only the VSEC offset and the address space support are cached, opening
+ * still takes the VSEC semaphore (and fails when it is held), and checks
+ * that the CR-Space is still reachable through the gateway. A mismatch
+ * there (e.g. a FW upgrade and reset that changed the spaces) re-probes.
+ *
+ * Environment:
+ *   MTCR_DEV_CACHE        - cache file path, "0" disables the cache.
+ *   MTCR_DEV_CACHE_DEBUG  - print probe and cache lookup times to stderr.
+ */
+
+#ifndef MTCR_DEV_CACHE_H
+#define MTCR_DEV_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mtcr.h"
+
+/* The config header dwords a cache entry is validated against */
+typedef struct mdev_pci_ids {
+    u_int32_t id;     /* vendor/device id */
+    u_int32_t rev;    /* revision id (HW revision) and class code */
+    u_int32_t subsys; /* subsystem vendor/device id, set by the FW image */
+} mdev_pci_ids;
+
+/*
+ * VSEC probe results of an mfile opened over PCI config space.
+ * Return 0 and update the mf VSEC fields on hit.
+ */
+int mdev_cache_get_vsec(mfile *mf, const mdev_pci_ids *ids);
+void mdev_cache_set_vsec(mfile *mf, const mdev_pci_ids *ids);
+
+/*
+ * Device identification, valid only after the VSEC results were cached
+ * (i.e. the device was validated at open time).
+ * Return 0 on hit.
+ */
+int mdev_cache_get_dev_id(mfile *mf, int *dev_type, u_int32_t *hw_dev_id, u_int32_t *hw_rev);
+void mdev_cache_set_dev_id(mfile *mf, int dev_type, u_int32_t hw_dev_id, u_int32_t hw_rev);
+
+/* Monotonic time in micro seconds, for the debug prints */
+u_int64_t mdev_cache_time_us(void);
+int mdev_cache_debug(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
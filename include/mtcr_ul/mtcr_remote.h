@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * mtcr_remote.h - Devices served by a remote mstmtserver.
+ *
+ * A device name of the form "<host>:<port>,<device>" opens <device> on the
+ * mstmtserver listening at <host>:<port>, over its binary protocol (see
+ * mtserver_proto.h). Register accesses are executed by the server.
+ *
+ * Every access is a network round trip, and the tools mostly read dwords:
+ * the flash gateway and the icmd interface poll status words and read the
+ * neighbouring data words one by one. ID registers (the HW id) are read
+ * once per session. CR-Space dword reads may also go through a line cache,
+ * which is off by default:
+ *   - a miss fetches its whole 64 byte line with one block read, and the
+ *     following reads of the line are served locally for a short window;
+ *   - volatile registers (HW semaphores, the flash gateway command word) are
+ *     always read from the device, and never fetched as part of a line.
+ * A line fetch reads words the caller did not ask for, so it must only be
+ * enabled when every read sensitive register of the device (semaphores,
+ * clear on read counters) is covered by the volatile ranges.
+ * Writes, register accesses, PCI changes and address space switches
+ * invalidate the cached lines. Other address spaces are not cached.
+ *
+ * Environment:
+ *   MTCR_REMOTE_WINDOW  - line cache window in micro seconds, 0 (the
+ *                         default) disables the line cache.
+ *   MTCR_REMOTE_BYPASS  - additional volatile ranges, "addr[+size],...".
+ *   MTCR_REMOTE_DEBUG   - print the round trip statistics to stderr on close.
+ */
+
+#ifndef MTCR_REMOTE_H
+#define MTCR_REMOTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mtcr.h"
+
+typedef struct mtcr_remote_stats {
+    u_int64_t round_trips;
+    u_int64_t reads;            /* dword reads */
+    u_int64_t line_hits;
+    u_int64_t static_hits;
+    u_int64_t line_fetches;
+    u_int64_t bypassed;         /* dword reads of volatile registers */
+} mtcr_remote_stats_t;
+
+/* Return 1 if "name" is a remote device name */
+int mtcr_remote_is_name(const char *name);
+
+/* Connect and open the remote device, fills the mf access functions */
+int mtcr_remote_open(mfile *mf, const char *name);
+
+int mtcr_remote_access_reg(mfile *mf, u_int16_t reg_id, maccess_reg_method_t reg_method, void *reg_data,
+                           u_int32_t reg_size, int *reg_status);
+int mtcr_remote_set_addr_space(mfile *mf, int space);
+
+/*
+ * Mark [addr, addr + size) volatile, or "addr" as a read only ID register.
+ * Return 0, or -1 when the table is full.
+ */
+int mtcr_remote_cache_bypass(mfile *mf, u_int32_t addr, u_int32_t size);
+int mtcr_remote_cache_static(mfile *mf, u_int32_t addr);
+
+/* Return 0 and the statistics of a remote device, -1 for other devices */
+int mtcr_remote_get_stats(mfile *mf, mtcr_remote_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mtcr_session.h - Thread safe sessions on top of a single mfile.
+ *
+ * An mfile keeps the address space, VSEC semaphore state, icmd state and the
+ * file lock per handle, so it must not be used by several threads at once.
+ * A session wraps one mfile with a mutex: every call below is one gateway
+ * transaction executed atomically, and the address space is a parameter of
+ * the transaction instead of a property of the handle.
+ * Threads that need a sequence of accesses to be atomic (e.g. a
+ * semaphore protected flow) may hold the session with msession_lock().
+ */
+
+#ifndef MTCR_SESSION_H
+#define MTCR_SESSION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mtcr.h"
+
+/* Use the address space currently set on the underlying mfile */
+#define MSESSION_CURR_SPACE -1
+
+typedef struct msession_t msession;
+
+/*
+ * Open a device and wrap it in a session, the session owns the mfile.
+ * Return valid session ptr or NULL on failure (errno is set)
+ */
+msession* msession_open(const char *name);
+
+/*
+ * Wrap an already opened mfile, the caller keeps ownership of mf and must
+ * not access it directly while the session is alive.
+ */
+msession* msession_attach(mfile *mf);
+
+/*
+ * Destroy the session, the mfile is closed only if it is owned by the session.
+ */
+int msession_close(msession *ms);
+
+mfile* msession_get_mfile(msession *ms);
+
+/*
+ * Hold/release the session for a multi transaction sequence.
+ * The lock is recursive so the accessors below may be called while holding it.
+ */
+void msession_lock(msession *ms);
+void msession_unlock(msession *ms);
+
+/*
+ * Same return values as the matching mtcr functions.
+ * space is an AS_* value or MSESSION_CURR_SPACE.
+ */
+int msession_read4(msession *ms, int space, unsigned int offset, u_int32_t *value);
+int msession_write4(msession *ms, int space, unsigned int offset, u_int32_t value);
+int msession_read4_block(msession *ms, int space, unsigned int offset, u_int32_t *data, int byte_len);
+int msession_write4_block(msession *ms, int space, unsigned int offset, u_int32_t *data, int byte_len);
+
+int msession_access_reg(msession *ms, u_int16_t reg_id, maccess_reg_method_t reg_method, void *reg_data,
+                        u_int32_t reg_size, u_int32_t r_size_reg, u_int32_t w_size_reg, int *reg_status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ *
+ *  mtserver_proto.h - mtserver binary protocol definitions
+ *
+ *  A client switches a connection from the ASCII protocol to the binary
+ *  protocol by sending "X <Version>" (the highest version it supports).
+ *  The server answers "O <Version>" with the version both sides will use,
+ *  and from then on every message on the connection is a binary frame:
+ *  a fixed little endian header followed by "len" payload bytes.
+ *
+ *  Requests carry a client chosen id which is echoed in the response, so a
+ *  client may send many requests before reading the responses. The server
+ *  executes requests in the order they arrive and answers in the same order.
+ *
+ *  Op               Request                        Response
+ *  OPEN             arg=DType (0 - any),           arg=VSEC_SUPP
+ *                   payload=DevName
+ *  CLOSE            -                              -
+ *  READ4            addr                           payload=4 bytes
+ *  WRITE4           addr, arg=value                -
+ *  READ_BLOCK       addr, arg=size[bytes]          payload=size bytes
+ *  WRITE_BLOCK      addr, payload=data             -
+ *  REG_ACCESS       addr=RegId, arg=Method,        addr=RegStatus, arg=mtcr rc,
+ *                   payload=register data          payload=register data
+ *  SET_ADDR_SPACE   arg=AddressSpace               -
+ *  PCI_CHANGE       -                              -
+ *
+ *  Block data is sent as little endian dwords, register data is sent as is.
+ *  A non zero status in a response is an errno value, the request had no
+ *  effect on the device unless the op is REG_ACCESS.
+ */
+
+#ifndef MTSERVER_PROTO_H
+#define MTSERVER_PROTO_H
+
+#include <string.h>
+#include <compatibility.h>
+
+#define MTSRV_PROTO_VERSION  1
+#define MTSRV_FRAME_MAGIC    0x534d      /* "MS" */
+#define MTSRV_HDR_SIZE       24
+#define MTSRV_MAX_PAYLOAD    (1 << 20)
+
+enum {
+    MTSRV_OP_OPEN = 1,
+    MTSRV_OP_CLOSE,
+    MTSRV_OP_READ4,
+    MTSRV_OP_WRITE4,
+    MTSRV_OP_READ_BLOCK,
+    MTSRV_OP_WRITE_BLOCK,
+    MTSRV_OP_REG_ACCESS,
+    MTSRV_OP_SET_ADDR_SPACE,
+    MTSRV_OP_PCI_CHANGE,
+};
+
+typedef struct mtsrv_frame_hdr {
+    u_int16_t magic;
+    u_int8_t  version;
+    u_int8_t  op;
+    u_int32_t id;
+    u_int32_t addr;
+    u_int32_t arg;
+    u_int32_t status;
+    u_int32_t len;
+} mtsrv_frame_hdr_t;
+
+static inline void mtsrv_hdr_pack(u_int8_t *buf, const mtsrv_frame_hdr_t *hdr)
+{
+    mtsrv_frame_hdr_t le;
+
+    le.magic = __cpu_to_le16(hdr->magic);
+    le.version = hdr->version;
+    le.op = hdr->op;
+    le.id = __cpu_to_le32(hdr->id);
+    le.addr = __cpu_to_le32(hdr->addr);
+    le.arg = __cpu_to_le32(hdr->arg);
+    le.status = __cpu_to_le32(hdr->status);
+    le.len = __cpu_to_le32(hdr->len);
+    memcpy(buf, &le, MTSRV_HDR_SIZE);
+}
+
+static inline void mtsrv_hdr_unpack(const u_int8_t *buf, mtsrv_frame_hdr_t *hdr)
+{
+    memcpy(hdr, buf, MTSRV_HDR_SIZE);
+    hdr->magic = __le16_to_cpu(hdr->magic);
+    hdr->id = __le32_to_cpu(hdr->id);
+    hdr->addr = __le32_to_cpu(hdr->addr);
+    hdr->arg = __le32_to_cpu(hdr->arg);
+    hdr->status = __le32_to_cpu(hdr->status);
+    hdr->len = __le32_to_cpu(hdr->len);
+}
+
+#endif
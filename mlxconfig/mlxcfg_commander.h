@@ -65,6 +65,8 @@ public:
                             std::string& tlvDump) = 0;
     virtual void backupCfgs(vector<BackupView>& views) = 0;
     virtual void updateParamViewValue(ParamView&, std::string val) = 0;
+    // submit the reads needed by queryAll() to q, they are used once q is drained
+    virtual void prefetchQuery(maccess_reg_queue *q, QueryType qt = QueryNext) { (void)q; (void)qt; }
     void setExtResourceType(bool extT) { _extResource = extT; }
     static string getDefaultDBName(bool isSwitch);
     mfile* mf() { return _mf;}
@@ -40,6 +40,8 @@
 #define MLXCFG_FACTORY_H_
 
 #include <vector>
+#include <map>
+#include <string>
 #include <exception>
 
 #include "mlxcfg_tlv.h"
@@ -49,26 +51,53 @@
 class MlxcfgDBManager {
 
 private:
+    /*
+     * A table loaded once from the database. All the strings live in data,
+     * cells points to them row by row (NULL for SQL NULL) in the layout
+     * TLVConf and Param parse.
+     */
+    class DBTable {
+    public:
+        DBTable() {}
+        std::vector<char> data;
+        std::vector<char*> header;
+        std::vector<char*> cells;
+        int columns() const { return (int)header.size(); }
+        size_t rows() const { return header.empty() ? 0 : cells.size() / header.size(); }
+        char** row(size_t r) { return &cells[r * header.size()]; }
+        const char* cell(size_t r, int c) const { return c < 0 ? NULL : cells[r * header.size() + c]; }
+        int column(const char *name) const;
+    private:
+        DBTable(const DBTable&);
+        DBTable& operator=(const DBTable&);
+    };
+
     std::string _dbName;
     sqlite3 *_db;
     const unsigned int _supportedVersion;
+    DBTable _tlvsTable;
+    DBTable _paramsTable;
+    std::map<std::pair<std::string, u_int8_t>, size_t> _tlvByNameAndPort;
+    std::map<std::pair<u_int32_t, int>, std::vector<size_t> > _tlvsByIndexAndClass;
+    std::map<std::string, std::vector<size_t> > _tlvsByParamMlxconfigName;
+    std::vector<std::vector<size_t> > _tlvParams;
+    std::vector<TLVConf*> _tlvObjects;
+    std::vector<size_t> _tlvFetchPos;
+    long _orphanParam;
+    bool _isLoaded;
 
-    static int selectAndCreateNewTLVCallBack(void *object, int argc, char **argv, char **azColName);
-    static int selectTLVCallBack(void*, int, char**, char**);
-    static int selectAndCreateParamCallBack(void *object, int argc, char **argv, char **azColName);
-    static int selectParamCallBack(void*, int, char**, char**);
-    static int selectParamByMlxconfigNameCallBack(void*, int, char**, char**);
     void openDB();
     void checkDBVersion();
+    void loadTable(const char *sql, DBTable& table);
+    void loadDB();
     inline bool isDBFileExists(const std::string& name);
-    TLVConf* fetchTLVByName(std::string n, u_int8_t port);
-    TLVConf* fetchTLVByIndexAndClass(u_int32_t id, TLVClass c);
+    TLVConf* createTLV(size_t tlvRow, bool track);
+    TLVConf* fetchTLV(size_t tlvRow);
+    TLVConf* getFirstFetchedTLV(const std::vector<size_t>& tlvRows);
 public:
     MlxcfgDBManager(std::string dbName);
     ~MlxcfgDBManager();
-    std::string _callBackErr;
     bool _isAllFetched;
-    Param *_paramSqlResult;
     std::vector<TLVConf*> fetchedTLVs;
     std::vector<Param*> fetchedParams;
     void getAllTLVs();
@@ -78,8 +107,6 @@ public:
     TLVConf* getAndCreateTLVByName(std::string n, u_int8_t port);
     TLVConf* getTLVByParamMlxconfigName(std::string n);
     TLVConf* getTLVByIndexAndClass(u_int32_t id, TLVClass c);
-    void execSQL(sqlite3_callback f, void *obj, const char *stat, ...);
-
 };
 
 #endif
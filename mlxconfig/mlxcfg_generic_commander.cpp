@@ -554,6 +554,16 @@ void GenericCommander::queryAll(vector<ParamView>& params, vector<string>& faile
     }
 }
 
+void GenericCommander::prefetchQuery(maccess_reg_queue *q, QueryType qt)
+{
+    _dbManager->getAllTLVs();
+    VECTOR_ITERATOR(TLVConf*, _dbManager->fetchedTLVs, it) {
+        if (!(*it)->_cap && (*it)->isMlxconfigSupported()) {
+            (*it)->prefetchQuery(q, _mf, qt);
+        }
+    }
+}
+
 void GenericCommander::getCfg(ParamView& pv, QueryType qt)
 {
     vector<ParamView> pc;
@@ -73,6 +73,8 @@ TLVConf::TLVConf(int columnsCount, char **dataRow, char **headerRow) :
     _isCapFound(false), _isTargetFound(false), _isClassFound(false),
     _isVersion(false), _isDescriptionFound(false),
     _isMlxconfigNameFound(false), _isPortFound(false),
+    _prefetchQueue(NULL), _prefetchMf(NULL), _prefetchQt(QueryNext),
+    _nvqcRc(ME_OK), _nvqcValid(false), _nvdaRc(ME_OK), _nvdaValid(false),
     _maxTlvVersionSuppByFw(0)
 {
 
@@ -176,7 +178,15 @@ bool TLVConf::isFWSupported(mfile *mf, bool read_write)
         return true;
     }
 
-    if (nvqcCom5thGen(mf, getTlvTypeBe(), suppRead, suppWrite, _maxTlvVersionSuppByFw)) {
+    if (_nvqcValid && _prefetchMf == mf) {
+        _nvqcValid = false;
+        if (_nvqcRc) {
+            return false;
+        }
+        suppRead = _nvqc.support_rd;
+        suppWrite = _nvqc.support_wr;
+        _maxTlvVersionSuppByFw = _nvqc.version;
+    } else if (nvqcCom5thGen(mf, getTlvTypeBe(), suppRead, suppWrite, _maxTlvVersionSuppByFw)) {
         //Don't throw exception if we fail to run nvqc, maybe its an old fw
         return false;
     }
@@ -389,6 +399,50 @@ void TLVConf::parseParamValue(string paramMlxconfigName, string valToParse, u_in
     p->_value->parseValue(valToParse, val, strVal);
 }
 
+/*
+ * Submit the NVQC and (if the TLV is readable) the NVDA of this TLV to q.
+ * Once the queue is drained the next isFWSupported() and query() on the same
+ * mfile consume the fetched values instead of accessing the device.
+ */
+void TLVConf::prefetchQuery(maccess_reg_queue *q, mfile *mf, QueryType qT)
+{
+    _prefetchQueue = q;
+    _prefetchMf = mf;
+    _prefetchQt = qT;
+    _nvqcValid = false;
+    _nvdaValid = false;
+    if (_target == EXP_ROM) {
+        prefetchNvqcDone(ME_OK, this);
+        return;
+    }
+    memset(&_nvqc, 0, sizeof(_nvqc));
+    _nvqc.type.tlv_type_dw.tlv_type_dw = __be32_to_cpu(getTlvTypeBe());
+    reg_access_nvqc_async(q, mf, REG_ACCESS_METHOD_GET, &_nvqc, prefetchNvqcDone, this);
+}
+
+void TLVConf::prefetchNvqcDone(reg_access_status_t rc, void *ctx)
+{
+    TLVConf *tlv = (TLVConf*)ctx;
+    if (tlv->_target != EXP_ROM) {
+        tlv->_nvqcRc = rc;
+        tlv->_nvqcValid = true;
+        if (rc || !tlv->_nvqc.support_rd) {
+            return;
+        }
+    }
+    mnvaPrepare5thGen(tlv->_prefetchMf, tlv->_nvda, tlv->_buff.data(), tlv->_size, tlv->getTlvTypeBe(),
+                      REG_ACCESS_METHOD_GET, tlv->_prefetchQt);
+    reg_access_nvda_async(tlv->_prefetchQueue, tlv->_prefetchMf, REG_ACCESS_METHOD_GET, &tlv->_nvda,
+                          prefetchNvdaDone, tlv);
+}
+
+void TLVConf::prefetchNvdaDone(reg_access_status_t rc, void *ctx)
+{
+    TLVConf *tlv = (TLVConf*)ctx;
+    tlv->_nvdaRc = rc;
+    tlv->_nvdaValid = true;
+}
+
 vector<pair<ParamView, string> > TLVConf::query(mfile *mf, QueryType qT)
 {
     bool defaultQueried = false;
@@ -396,7 +450,16 @@ vector<pair<ParamView, string> > TLVConf::query(mfile *mf, QueryType qT)
     vector<pair<ParamView, string> > queryResult;
     vector<u_int8_t> defaultBuff(_size, 0);
 
-    mnva(mf, _buff.data(), _size, getTlvTypeBe(), REG_ACCESS_METHOD_GET, qT);
+    if (_nvdaValid && _prefetchMf == mf && _prefetchQt == qT) {
+        _nvdaValid = false;
+        if (_nvdaRc == ME_OK) {
+            memcpy(_buff.data(), _nvda.data, _size);
+        } else if (_nvdaRc != ME_REG_ACCESS_RES_NOT_AVLBL) {
+            throw MlxcfgException("Failed to get %s settings %s", _name.c_str(), m_err2str(_nvdaRc));
+        }
+    } else {
+        mnva(mf, _buff.data(), _size, getTlvTypeBe(), REG_ACCESS_METHOD_GET, qT);
+    }
 
     unpack(_buff.data());
 
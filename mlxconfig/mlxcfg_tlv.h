@@ -82,6 +82,19 @@ private:
     static TLVTarget str2TLVTarget(char *s);
     static TLVClass str2TLVClass(char *s);
 
+    // state of the asynchronous prefetch (see prefetchQuery)
+    maccess_reg_queue *_prefetchQueue;
+    mfile *_prefetchMf;
+    QueryType _prefetchQt;
+    struct tools_open_nvqc _nvqc;
+    MError _nvqcRc;
+    bool _nvqcValid;
+    struct tools_open_nvda _nvda;
+    MError _nvdaRc;
+    bool _nvdaValid;
+    static void prefetchNvqcDone(reg_access_status_t rc, void *ctx);
+    static void prefetchNvdaDone(reg_access_status_t rc, void *ctx);
+
 public:
     std::string _name;
     u_int32_t _id;
@@ -104,6 +117,7 @@ public:
     bool isMlxconfigSupported();
     void getView(TLVConfView& tlvConfView);
     bool isFWSupported(mfile *mf, bool read_write);
+    void prefetchQuery(maccess_reg_queue *q, mfile *mf, QueryType qT);
     Param* getValidBitParam(std::string n);
     bool checkParamValidBit(Param *p);
     std::vector<std::pair<ParamView, std::string> > query(mfile *mf, QueryType qT);
@@ -42,6 +42,7 @@
 #include <errno.h>
 
 #include <tools_dev_types.h>
+#include <mft_sig_handler.h>
 
 #include "mlxcfg_ui.h"
 #include "mlxcfg_utils.h"
@@ -260,6 +261,18 @@ mlxCfgStatus MlxCfg::queryDevsCfg()
         //printf("-D- num of dev: %d , 1st dev : %s\n", numOfDev, buf);
         dev_info  *devPtr = dev;
         char pcibuf[32] = {0};
+        vector<Commander*> commanders(numOfDev, (Commander*)NULL);
+        vector<string> openErrs(numOfDev);
+
+        // open all the devices first so their configurations are read in parallel
+        for (int i = 0; i < numOfDev; i++) {
+            try {
+                commanders[i] = Commander::create(string(dev[i].pci.conf_dev), _mlxParams.dbName);
+            } catch (MlxcfgException& e) {
+                openErrs[i] = e._err;
+            }
+        }
+        prefetchCfgs(commanders);
 
         for (int i = 0; i < numOfDev; i++) {
 #ifdef __FREEBSD__
@@ -269,10 +282,15 @@ mlxCfgStatus MlxCfg::queryDevsCfg()
 #endif
             snprintf(pcibuf, 32, device_name_ptrn, devPtr->pci.domain, devPtr->pci.bus, \
                      devPtr->pci.dev, devPtr->pci.func);
-            if (queryDevCfg(devPtr->pci.conf_dev, pcibuf, i + 1)) {
+            if (!commanders[i]) {
+                err(false, "%s", openErrs[i].c_str());
+                printErr();
+                shouldFail = true;
+            } else if (queryDevCfg(commanders[i], devPtr->pci.conf_dev, pcibuf, i + 1)) {
                 printErr();
                 shouldFail = true;
             }
+            delete commanders[i];
             devPtr++;
         }
         mdevices_info_destroy(dev, numOfDev);
@@ -583,11 +601,44 @@ mlxCfgStatus MlxCfg::queryDevCfg(const char *dev, const char *pci,
         return err(false, "%s", e._err.c_str());
     }
 
+    if (!printNewCfg) {
+        vector<Commander*> commanders(1, commander);
+        prefetchCfgs(commanders);
+    }
     rc = queryDevCfg(commander, dev, pci, devIndex, printNewCfg);
     delete commander;
     return rc;
 }
 
+/*
+ * Read the configurations of all the devices through one asynchronous queue,
+ * accesses to different devices overlap. Only done for full queries, queries
+ * of specific parameters read just their TLVs.
+ */
+void MlxCfg::prefetchCfgs(vector<Commander*>& commanders)
+{
+    if (!_mlxParams.setParams.empty()) {
+        return;
+    }
+    maccess_reg_queue *q = maccess_reg_queue_create((int)commanders.size());
+    if (!q) {
+        return; // queryAll falls back to synchronous access
+    }
+    // "suspend" signals as we are going to take semaphores
+    mft_signal_set_handling(1);
+    VECTOR_ITERATOR(Commander*, commanders, c) {
+        if (*c) {
+            try {
+                (*c)->prefetchQuery(q, QueryNext);
+            } catch (MlxcfgException&) {
+                // errors are reported by the query itself
+            }
+        }
+    }
+    maccess_reg_queue_destroy(q);
+    dealWithSignal();
+}
+
 const char * MlxCfg::getConfigWarning(const string & mlx_config_name,
         const string & set_val)
 {
@@ -123,6 +123,7 @@ private:
     mlxCfgStatus queryDevsCfg();
     mlxCfgStatus queryDevCfg(const char *dev, const char *pci = (const char*)NULL, int devIndex = 1, bool printNewCfg = false);
     mlxCfgStatus queryDevCfg(Commander *commander, const char *dev, const char *pci = (const char*)NULL, int devIndex = 1, bool printNewCfg = false);
+    void prefetchCfgs(std::vector<Commander*>& commanders);
 
     // Set cmd
     mlxCfgStatus setDevCfg();
@@ -71,10 +71,9 @@ void dealWithSignal()
     return;
 }
 
-MError mnvaCom5thGen(mfile *mf, u_int8_t *buff, u_int16_t len, u_int32_t tlvType,
-                     reg_access_method_t method, QueryType qT)
+void mnvaPrepare5thGen(mfile *mf, struct tools_open_nvda& mnvaTlv, u_int8_t *buff, u_int16_t len,
+                       u_int32_t tlvType, reg_access_method_t method, QueryType qT)
 {
-    struct tools_open_nvda mnvaTlv;
     memset(&mnvaTlv, 0, sizeof(struct tools_open_nvda));
 
     if (method == REG_ACCESS_METHOD_GET && mf->tp != MST_IB) {
@@ -93,6 +92,13 @@ MError mnvaCom5thGen(mfile *mf, u_int8_t *buff, u_int16_t len, u_int32_t tlvType
     // tlvType should be in the correct endianess
     mnvaTlv.nv_hdr.type.tlv_type_dw.tlv_type_dw =  __be32_to_cpu(tlvType);
     memcpy(mnvaTlv.data, buff, len);
+}
+
+MError mnvaCom5thGen(mfile *mf, u_int8_t *buff, u_int16_t len, u_int32_t tlvType,
+                     reg_access_method_t method, QueryType qT)
+{
+    struct tools_open_nvda mnvaTlv;
+    mnvaPrepare5thGen(mf, mnvaTlv, buff, len, tlvType, method, qT);
     MError rc;
     // "suspend" signals as we are going to take semaphores
     mft_signal_set_handling(1);
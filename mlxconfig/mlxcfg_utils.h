@@ -128,6 +128,8 @@ typedef enum {
 
 void dealWithSignal();
 
+void mnvaPrepare5thGen(mfile *mf, struct tools_open_nvda& mnvaTlv, u_int8_t *buff, u_int16_t len, u_int32_t tlvType,
+                       reg_access_method_t method, QueryType qT = QueryNext);
 MError mnvaCom5thGen(mfile *mf, u_int8_t *buff, u_int16_t len, u_int32_t tlvType, reg_access_method_t method, QueryType qT = QueryNext);
 
 MError nvqcCom5thGen(mfile *mf, u_int32_t tlvType, bool& suppRead,
@@ -101,6 +101,7 @@
 
 #include <vector>
 #include <compatibility.h>
+#include <tools_swab.h>
 #include "mlxfwops_com.h"
 
 static inline void be_guid_to_cpu(guid_t *to, guid_t *from)
@@ -119,14 +120,12 @@ namespace std {}; using namespace std;
 } while (0)
 #define TOCPUn(s, n) do {                                          \
         u_int32_t *p = (u_int32_t*)(s);                               \
-        for (u_int32_t ii = 0; ii < (n); ii++, p++)                         \
-            *p = __be32_to_cpu(*p);                                    \
+        tools_be32_to_cpu_buf(p, p, (n));                             \
 } while (0)
 
 #define CPUTOn(s, n) do {                                          \
         u_int32_t *p = (u_int32_t*)(s);                               \
-        for (u_int32_t ii = 0; ii < (n); ii++, p++)                         \
-            *p = __cpu_to_be32(*p);                                    \
+        tools_cpu_to_be32_buf(p, p, (n));                             \
 } while (0)
 
 #define TOCPUBY(s) do {                                            \
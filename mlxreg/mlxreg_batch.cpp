@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <time.h>
+#include <fstream>
+#include <sstream>
+#include <json/reader.h>
+#include "mlxreg_batch.h"
+#include "mlxreg_parser.h"
+
+using namespace mlxreg;
+
+/************************************
+* Function: nowUsec
+************************************/
+static double nowUsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/************************************
+* Function: jsonToUint64
+*
+* This JSON reader keeps numbers above 32 bits as doubles, they are taken
+* while they are exact (up to 2^53), larger values can be given as strings.
+************************************/
+static bool jsonToUint64(const Json::Value &val, u_int64_t &uint)
+{
+    if (val.isIntegral()) {
+        if (val.isInt() && val.asInt() < 0) {
+            return false;
+        }
+        uint = val.asUInt();
+        return true;
+    }
+    if (val.isDouble()) {
+        double d = val.asDouble();
+        if (d < 0 || d > 9007199254740992.0 || d != (double)(u_int64_t)d) {
+            return false;
+        }
+        uint = (u_int64_t)d;
+        return true;
+    }
+    return false;
+}
+
+/************************************
+* Function: jsonToAssignments
+*
+* JSON indexes and SET data are given either as the command line string
+* ("name=val,...") or as an object of names and values.
+************************************/
+static string jsonToAssignments(const Json::Value &val, const char *key)
+{
+    if (val.isNull()) {
+        return "";
+    }
+    if (val.isString()) {
+        return val.asString();
+    }
+    if (!val.isObject()) {
+        throw MlxRegException("\"%s\" must be a string or an object", key);
+    }
+    string str;
+    Json::Value::Members names = val.getMemberNames();
+    for (size_t i = 0; i < names.size(); i++) {
+        const Json::Value &field = val[names[i]];
+        string fieldVal;
+        u_int64_t uintVal;
+        if (field.isString()) {
+            fieldVal = field.asString();
+        } else if (jsonToUint64(field, uintVal)) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "0x%" U64H_FMT_GEN, uintVal);
+            fieldVal = buf;
+        } else {
+            throw MlxRegException("Invalid value of \"%s\" in \"%s\"", names[i].c_str(), key);
+        }
+        str += (i ? "," : "") + names[i] + "=" + fieldVal;
+    }
+    return str;
+}
+
+/************************************
+* Function: jsonStr
+************************************/
+static string jsonStr(const string &str)
+{
+    string res = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        char c = str[i];
+        if (c == '"' || c == '\\') {
+            res += '\\';
+            res += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            res += buf;
+        } else {
+            res += c;
+        }
+    }
+    return res + "\"";
+}
+
+/************************************
+* Function: csvStr
+************************************/
+static string csvStr(const string &str)
+{
+    if (str.find_first_of(",\"\n") == string::npos) {
+        return str;
+    }
+    string res = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"') {
+            res += '"';
+        }
+        res += str[i];
+    }
+    return res + "\"";
+}
+
+/************************************
+* Function: MlxRegBatch
+************************************/
+MlxRegBatch::MlxRegBatch(MlxRegLib *mlxRegLib, bool allowSet) :
+    _mlxRegLib(mlxRegLib), _allowSet(allowSet), _totalTime(0)
+{
+}
+
+/************************************
+* Function: load
+************************************/
+void MlxRegBatch::load(string fileName)
+{
+    std::stringstream content;
+    if (fileName == "-") {
+        content << std::cin.rdbuf();
+    } else {
+        std::ifstream file(fileName.c_str());
+        if (!file) {
+            throw MlxRegException("Failed to open batch file: %s", fileName.c_str());
+        }
+        content << file.rdbuf();
+    }
+
+    string str = content.str();
+    size_t first = str.find_first_not_of(" \t\r\n");
+    if (first != string::npos && (str[first] == '[' || str[first] == '{')) {
+        parseJson(str);
+    } else {
+        parseScript(str);
+    }
+    if (_ops.empty()) {
+        throw MlxRegException("No operations found in batch file: %s", fileName.c_str());
+    }
+    for (size_t i = 0; i < _ops.size(); i++) {
+        if (_ops[i].isSet && !_allowSet) {
+            throw MlxRegException("Batch SET operations require --yes");
+        }
+    }
+}
+
+/************************************
+* Function: parseScript
+************************************/
+void MlxRegBatch::parseScript(const string &content)
+{
+    std::istringstream lines(content);
+    string line;
+    int lineNum = 0;
+    while (std::getline(lines, line)) {
+        lineNum++;
+        std::istringstream tokens(line);
+        std::vector<string> args;
+        string token;
+        while (tokens >> token) {
+            if (token[0] == '#') {
+                break;
+            }
+            args.push_back(token);
+        }
+        if (args.empty()) {
+            continue;
+        }
+
+        BatchOp op;
+        if (args[0] == "set") {
+            op.isSet = true;
+        } else if (args[0] != "get") {
+            throw MlxRegException("Line %d: unknown operation \"%s\", expected get or set", lineNum, args[0].c_str());
+        }
+        if (args.size() < 3 || args.size() > 4 || (op.isSet && args.size() != 4)) {
+            throw MlxRegException("Line %d: expected \"%s <register> <indexes|-> %s\"", lineNum, args[0].c_str(),
+                                  op.isSet ? "<data>" : "[fields]");
+        }
+        op.regName = args[1];
+        op.indexes = args[2] == "-" ? "" : args[2];
+        if (op.isSet) {
+            op.data = args[3];
+        } else if (args.size() == 4) {
+            std::istringstream fields(args[3]);
+            string field;
+            while (std::getline(fields, field, ',')) {
+                op.fields.push_back(field);
+            }
+        }
+        _ops.push_back(op);
+    }
+}
+
+/************************************
+* Function: parseJson
+************************************/
+void MlxRegBatch::parseJson(const string &content)
+{
+    Json::Reader reader;
+    Json::Value root;
+    if (!reader.parse(content, root, false)) {
+        throw MlxRegException("Failed to parse batch JSON: %s", reader.getFormatedErrorMessages().c_str());
+    }
+    if (root.isObject()) {
+        root = root["operations"];
+    }
+    if (!root.isArray()) {
+        throw MlxRegException("Batch JSON must be an array of operations");
+    }
+
+    for (Json::Value::UInt i = 0; i < root.size(); i++) {
+        const Json::Value &entry = root[i];
+        if (!entry.isObject() || !entry["register"].isString()) {
+            throw MlxRegException("Batch operation %u: \"register\" name is missing", i);
+        }
+        BatchOp op;
+        op.regName = entry["register"].asString();
+        op.indexes = jsonToAssignments(entry["indexes"], "indexes");
+        if (entry.isMember("set")) {
+            op.isSet = true;
+            op.data = jsonToAssignments(entry["set"], "set");
+        }
+        const Json::Value &fields = entry["fields"];
+        if (fields.isString()) {
+            std::istringstream fieldsStr(fields.asString());
+            string field;
+            while (std::getline(fieldsStr, field, ',')) {
+                op.fields.push_back(field);
+            }
+        } else if (fields.isArray()) {
+            for (Json::Value::UInt j = 0; j < fields.size(); j++) {
+                if (!fields[j].isString()) {
+                    throw MlxRegException("Batch operation %u: \"fields\" must be names", i);
+                }
+                op.fields.push_back(fields[j].asString());
+            }
+        } else if (!fields.isNull()) {
+            throw MlxRegException("Batch operation %u: \"fields\" must be an array of names", i);
+        }
+        _ops.push_back(op);
+    }
+}
+
+/************************************
+* Function: getPlan
+************************************/
+AdbFieldPlan& MlxRegBatch::getPlan(const string &regName, AdbInstance *regNode)
+{
+    std::map<string, AdbFieldPlan>::iterator it = _plans.find(regName);
+    if (it == _plans.end()) {
+        it = _plans.insert(std::make_pair(regName, AdbFieldPlan(regNode))).first;
+    }
+    return it->second;
+}
+
+/************************************
+* Function: runOp
+************************************/
+void MlxRegBatch::runOp(BatchOp &op)
+{
+    AdbInstance *regNode = _mlxRegLib->findAdbNode(op.regName);
+    AdbFieldPlan &plan = getPlan(op.regName, regNode);
+    std::vector<int> fieldIdxs;
+    for (size_t i = 0; i < op.fields.size(); i++) {
+        int idx = plan.findField(op.fields[i]);
+        if (idx < 0) {
+            throw MlxRegException("Can't find field name: \"%s\"", op.fields[i].c_str());
+        }
+        fieldIdxs.push_back(idx);
+    }
+
+    RegAccessParser parser("", op.indexes, regNode, (u_int32_t)0, plan);
+    std::vector<u_int32_t> buff = parser.genBuff();
+    double start = nowUsec();
+    _mlxRegLib->sendRegister(op.regName, MACCESS_REG_METHOD_GET, buff);
+    op.latency = nowUsec() - start;
+    if (op.isSet) {
+        // Same as a single SET: update the fields in the current data
+        RegAccessParser setParser(op.data, op.indexes, regNode, buff, plan);
+        buff = setParser.genBuff();
+        start = nowUsec();
+        _mlxRegLib->sendRegister(op.regName, MACCESS_REG_METHOD_SET, buff);
+        op.setLatency = nowUsec() - start;
+    }
+
+    std::vector<u_int64_t> values;
+    plan.decode((u_int8_t*)&buff[0], values);
+    const std::vector<AdbInstance*> &leaves = plan.getFields();
+    if (fieldIdxs.empty()) {
+        for (size_t i = 0; i < leaves.size(); i++) {
+            op.values.push_back(std::make_pair(leaves[i]->name, values[i]));
+        }
+    } else {
+        for (size_t i = 0; i < fieldIdxs.size(); i++) {
+            op.values.push_back(std::make_pair(op.fields[i], values[fieldIdxs[i]]));
+        }
+    }
+}
+
+/************************************
+* Function: run
+************************************/
+int MlxRegBatch::run()
+{
+    int failed = 0;
+    double start = nowUsec();
+    for (size_t i = 0; i < _ops.size(); i++) {
+        try {
+            runOp(_ops[i]);
+        } catch (MlxRegException& exp) {
+            _ops[i].failed = true;
+            _ops[i].error = exp.what();
+        } catch (AdbException& exp) {
+            _ops[i].failed = true;
+            _ops[i].error = exp.what();
+        }
+        if (_ops[i].failed) {
+            failed++;
+        }
+    }
+    _totalTime = nowUsec() - start;
+    return failed;
+}
+
+/************************************
+* Function: print
+************************************/
+void MlxRegBatch::print(FILE *out, BatchOutFormat format)
+{
+    if (format == BATCH_OUT_CSV) {
+        printCsv(out);
+    } else {
+        printJson(out);
+    }
+}
+
+/*
+ * Per register statistics of the successful operations, the GETs (of all
+ * the operations) and the SETs are counted separately
+ */
+typedef struct {
+    unsigned int count;
+    double total;
+    double min;
+    double max;
+} LatencyStats;
+
+typedef struct {
+    unsigned int errors;
+    LatencyStats get;
+    LatencyStats set;
+} RegStats;
+
+static void addLatency(LatencyStats &s, double latency)
+{
+    if (!s.count || latency < s.min) {
+        s.min = latency;
+    }
+    if (!s.count || latency > s.max) {
+        s.max = latency;
+    }
+    s.count++;
+    s.total += latency;
+}
+
+static std::map<string, RegStats> regStats(const std::vector<BatchOp> &ops)
+{
+    std::map<string, RegStats> stats;
+    for (size_t i = 0; i < ops.size(); i++) {
+        std::map<string, RegStats>::iterator it = stats.find(ops[i].regName);
+        if (it == stats.end()) {
+            RegStats s = {0, {0, 0, 0, 0}, {0, 0, 0, 0}};
+            it = stats.insert(std::make_pair(ops[i].regName, s)).first;
+        }
+        RegStats &s = it->second;
+        if (ops[i].failed) {
+            s.errors++;
+            continue;
+        }
+        addLatency(s.get, ops[i].latency);
+        if (ops[i].isSet) {
+            addLatency(s.set, ops[i].setLatency);
+        }
+    }
+    return stats;
+}
+
+/************************************
+* Function: printJson
+************************************/
+void MlxRegBatch::printJson(FILE *out)
+{
+    fprintf(out, "{\n    \"operations\": [");
+    for (size_t i = 0; i < _ops.size(); i++) {
+        const BatchOp &op = _ops[i];
+        fprintf(out, "%s\n        {\n", i ? "," : "");
+        fprintf(out, "            \"register\": %s,\n", jsonStr(op.regName).c_str());
+        fprintf(out, "            \"method\": \"%s\",\n", op.isSet ? "SET" : "GET");
+        fprintf(out, "            \"indexes\": %s,\n", jsonStr(op.indexes).c_str());
+        if (op.isSet) {
+            fprintf(out, "            \"data\": %s,\n", jsonStr(op.data).c_str());
+        }
+        if (op.failed) {
+            fprintf(out, "            \"status\": \"error\",\n");
+            fprintf(out, "            \"error\": %s\n", jsonStr(op.error).c_str());
+        } else {
+            fprintf(out, "            \"status\": \"OK\",\n");
+            fprintf(out, "            \"latency_us\": %.1f,\n", op.latency);
+            if (op.isSet) {
+                fprintf(out, "            \"set_latency_us\": %.1f,\n", op.setLatency);
+            }
+            fprintf(out, "            \"fields\": {");
+            for (size_t j = 0; j < op.values.size(); j++) {
+                fprintf(out, "%s\n                %s: %" U64D_FMT_GEN, j ? "," : "",
+                        jsonStr(op.values[j].first).c_str(), op.values[j].second);
+            }
+            fprintf(out, "\n            }\n");
+        }
+        fprintf(out, "        }");
+    }
+    fprintf(out, "\n    ],\n    \"registers\": {");
+
+    std::map<string, RegStats> stats = regStats(_ops);
+    for (std::map<string, RegStats>::iterator it = stats.begin(); it != stats.end(); it++) {
+        const RegStats &s = it->second;
+        fprintf(out, "%s\n        %s: {\n", it == stats.begin() ? "" : ",", jsonStr(it->first).c_str());
+        fprintf(out, "            \"count\": %u,\n", s.get.count);
+        fprintf(out, "            \"errors\": %u,\n", s.errors);
+        fprintf(out, "            \"avg_latency_us\": %.1f,\n", s.get.count ? s.get.total / s.get.count : 0.0);
+        fprintf(out, "            \"min_latency_us\": %.1f,\n", s.get.min);
+        fprintf(out, "            \"max_latency_us\": %.1f,\n", s.get.max);
+        if (s.set.count) {
+            fprintf(out, "            \"set_count\": %u,\n", s.set.count);
+            fprintf(out, "            \"avg_set_latency_us\": %.1f,\n", s.set.total / s.set.count);
+            fprintf(out, "            \"min_set_latency_us\": %.1f,\n", s.set.min);
+            fprintf(out, "            \"max_set_latency_us\": %.1f,\n", s.set.max);
+        }
+        fprintf(out, "            \"rate_per_sec\": %.1f\n",
+                s.get.total + s.set.total > 0 ? s.get.count * 1e6 / (s.get.total + s.set.total) : 0.0);
+        fprintf(out, "        }");
+    }
+    fprintf(out, "\n    },\n    \"total_time_us\": %.1f\n}\n", _totalTime);
+}
+
+/************************************
+* Function: printCsv
+************************************/
+void MlxRegBatch::printCsv(FILE *out)
+{
+    // One row per reported field, or per failed operation
+    fprintf(out, "op,register,method,indexes,status,latency_us,set_latency_us,field,value,error\n");
+    for (size_t i = 0; i < _ops.size(); i++) {
+        const BatchOp &op = _ops[i];
+        string prefix = csvStr(op.regName) + "," + (op.isSet ? "SET" : "GET") + "," + csvStr(op.indexes);
+        if (op.failed) {
+            fprintf(out, "%u,%s,error,,,,,%s\n", (unsigned int)i, prefix.c_str(), csvStr(op.error).c_str());
+            continue;
+        }
+        char setLatency[32] = "";
+        if (op.isSet) {
+            snprintf(setLatency, sizeof(setLatency), "%.1f", op.setLatency);
+        }
+        for (size_t j = 0; j < op.values.size(); j++) {
+            fprintf(out, "%u,%s,OK,%.1f,%s,%s,0x%" U64H_FMT_GEN ",\n", (unsigned int)i, prefix.c_str(), op.latency,
+                    setLatency, csvStr(op.values[j].first).c_str(), op.values[j].second);
+        }
+    }
+
+    // Per register summary
+    fprintf(out, "\nregister,count,errors,avg_latency_us,min_latency_us,max_latency_us,"
+            "set_count,avg_set_latency_us,min_set_latency_us,max_set_latency_us,rate_per_sec\n");
+    std::map<string, RegStats> stats = regStats(_ops);
+    for (std::map<string, RegStats>::iterator it = stats.begin(); it != stats.end(); it++) {
+        const RegStats &s = it->second;
+        double total = s.get.total + s.set.total;
+        fprintf(out, "%s,%u,%u,%.1f,%.1f,%.1f,%u,%.1f,%.1f,%.1f,%.1f\n", csvStr(it->first).c_str(), s.get.count,
+                s.errors, s.get.count ? s.get.total / s.get.count : 0.0, s.get.min, s.get.max, s.set.count,
+                s.set.count ? s.set.total / s.set.count : 0.0, s.set.min, s.set.max,
+                total > 0 ? s.get.count * 1e6 / total : 0.0);
+    }
+}
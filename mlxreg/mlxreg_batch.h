@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mlxreg_batch.h - batch mode of mstreg.
+ *
+ * Runs a list of GET/SET operations with the device opened and the ADB
+ * loaded once. The operations are read from a script, one per line:
+ *
+ *     # <get|set> <register> <indexes|-> [fields|data]
+ *     get PPCNT local_port=1,pnat=0,grp=0x0,prio_tc=0
+ *     get PAOS local_port=1,swid=0 oper_status,admin_status
+ *     set PAOS local_port=1,swid=0 e=0x1
+ *
+ * or from a JSON array of operations:
+ *
+ *     [{"register": "PAOS", "indexes": {"local_port": 1, "swid": 0},
+ *       "fields": ["oper_status", "admin_status"]},
+ *      {"register": "PAOS", "indexes": "local_port=1,swid=0", "set": "e=0x1"}]
+ *
+ * The results of all the operations, with the access latency of each one
+ * and the rate and latency per register, are printed as one JSON document
+ * or as CSV. A SET reads the register first, its GET and SET latencies are
+ * reported separately.
+ */
+
+#ifndef MLXREG_BATCH_H
+#define MLXREG_BATCH_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <adb_parser/adb_field_plan.h>
+#include "mlxreg_lib.h"
+
+namespace mlxreg {
+
+typedef enum {
+    BATCH_OUT_JSON = 0,
+    BATCH_OUT_CSV
+} BatchOutFormat;
+
+class BatchOp
+{
+public:
+    BatchOp() : isSet(false), failed(false), latency(0), setLatency(0) {}
+    string regName;
+    string indexes;
+    string data;                  // SET data
+    std::vector<string> fields;   // fields to report, all when empty
+    bool isSet;
+    // Results
+    bool failed;
+    string error;
+    double latency;               // register GET time (usec)
+    double setLatency;            // register SET time of a SET (usec)
+    std::vector<std::pair<string, u_int64_t> > values;
+};
+
+class MlxRegBatch
+{
+public:
+    MlxRegBatch(MlxRegLib *mlxRegLib, bool allowSet);
+    void load(string fileName);
+    int run(); // Returns the number of failed operations
+    void print(FILE *out, BatchOutFormat format);
+    const std::vector<BatchOp>& getOps() const { return _ops; }
+
+private:
+    void parseScript(const string &content);
+    void parseJson(const string &content);
+    void runOp(BatchOp &op);
+    AdbFieldPlan& getPlan(const string &regName, AdbInstance *regNode);
+    void printJson(FILE *out);
+    void printCsv(FILE *out);
+
+    MlxRegLib *_mlxRegLib;
+    bool _allowSet;
+    std::vector<BatchOp> _ops;
+    std::map<string, AdbFieldPlan> _plans;
+    double _totalTime; // usec
+};
+
+}
+#endif /* MLXREG_BATCH_H */
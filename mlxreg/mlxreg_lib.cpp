@@ -33,12 +33,14 @@
  */
 
 #include <sstream>
+#include <boost/unordered_set.hpp>
 #include "mlxreg_lib.h"
 #include "cmdif/icmd_cif_open.h"
 #ifndef MST_UL
 #include <tools_layouts/adb_dbs.h>
 #endif
 #include <tools_layouts/prm_adb_db.h>
+#include <adb_parser/adb_cache.h>
 #include <common/tools_utils.h>
 #include <mlxreg_exception.h>
 
@@ -84,25 +86,25 @@ MlxRegLib::MlxRegLib(mfile *mf, string extAdbFile, bool onlyKnown, bool isExtern
     _mf = mf;
     _onlyKnownRegs = onlyKnown;
     _isExternal = isExternal;
+    _adb = NULL;
+    _regAccessRootNode = NULL;
+    string unionNode = REG_ACCESS_UNION_NODE;
+    string rootNode  = unionNode + "_selector";
+    if (_isExternal) {
+        rootNode  = rootNode + "_ext";
+    }
     try {
         if (_isExternal && extAdbFile == "") {
             dm_dev_id_t devID = getDevId();
             extAdbFile = PrmAdbDB::getDefaultDBName(dm_dev_is_switch(devID));
         }
-        initAdb(extAdbFile);
+        initAdb(extAdbFile, rootNode);
     } catch (MlxRegException& adbInitExp) {
         if (_adb) {
             delete _adb;
         }
         throw adbInitExp;
     }
-    string unionNode = REG_ACCESS_UNION_NODE;
-    string rootNode  = unionNode + "_selector";
-    if (_isExternal) {
-        rootNode  = rootNode + "_ext";
-    }
-
-    _regAccessRootNode  = _adb->createLayout(rootNode);
     if (!_regAccessRootNode) {
         throw MlxRegException("No supported access registers found");
     }
@@ -115,7 +117,8 @@ MlxRegLib::MlxRegLib(mfile *mf, string extAdbFile, bool onlyKnown, bool isExtern
     }
     try
     {
-        _regAccessMap = _regAccessUnionNode->unionSelector->getEnumMap();
+        _regAccessMap = _regAccessUnionNode->getUnionSelector()->getEnumMap();
+        indexRegisters();
         _supportedRegAccessMap = genSuppRegsList(_regAccessMap);
     }
     catch (AdbException& exp)
@@ -164,16 +167,57 @@ bool MlxRegLib::isDeviceSupported(mfile *mf)
     return devID != DeviceConnectX2 && devID != DeviceConnectX3 && devID != DeviceConnectX3Pro && devID != DeviceSwitchX;
 }
 
-void MlxRegLib::initAdb(string extAdbFile)
+void MlxRegLib::initAdb(string extAdbFile, string rootNode)
 {
+    if (extAdbFile == "") {
+        throw MlxRegException("No Adabe was provided, please provide Adabe file to continue");
+    }
+    // The parsed Adabe is kept in a binary cache (see adb_cache.h), and only
+    // the parts of the layout that are accessed are created
+    AdbCache adbCache(extAdbFile);
     _adb = new Adb();
-    if (extAdbFile != "") {
+    if (!adbCache.load(_adb)) {
         if (!_adb->load(extAdbFile, false, NULL, false)) {
             throw MlxRegException("Failure in loading Adabe file. %s", _adb->getLastError().c_str());
         }
-    } else {
-        throw MlxRegException("No Adabe was provided, please provide Adabe file to continue");
+        adbCache.save(_adb);
+    }
+    _regAccessRootNode = _adb->createLayout(rootNode, false, NULL, -1, false, false, true);
+}
+
+/************************************
+* Function: indexRegisters
+************************************/
+void MlxRegLib::indexRegisters()
+{
+    // The registers are the sub-instances of the access registers union,
+    // selected by their name
+    for (size_t i = 0; i < _regAccessUnionNode->subItems.size(); i++) {
+        AdbInstance *regNode = _regAccessUnionNode->subItems[i];
+        AttrsMap::iterator it = regNode->attrs.find("selected_by");
+        if (it != regNode->attrs.end()) {
+            _regNodesByName.insert(std::make_pair(it->second, regNode));
+        }
+    }
+    for (std::map<string, u_int64_t>::iterator it = _regAccessMap.begin(); it != _regAccessMap.end(); it++) {
+        boost::unordered_map<string, AdbInstance*>::iterator node = _regNodesByName.find(it->first);
+        if (node != _regNodesByName.end()) {
+            _regNodesById.insert(std::make_pair(it->second, node->second));
+        }
+    }
+}
+
+/************************************
+* Function: getRegNode
+************************************/
+AdbInstance* MlxRegLib::getRegNode(string regName)
+{
+    boost::unordered_map<string, AdbInstance*>::iterator it = _regNodesByName.find(regName);
+    if (it == _regNodesByName.end()) {
+        // not in the union, let the parser report it
+        return _regAccessUnionNode->getUnionSelectedNodeName(regName);
     }
+    return it->second;
 }
 
 /************************************
@@ -184,7 +228,21 @@ AdbInstance* MlxRegLib::findAdbNode(string name)
     if (_supportedRegAccessMap.find(name) == _supportedRegAccessMap.end()) {
         throw MlxRegException("Can't find access register name: %s", name.c_str());
     }
-    return _regAccessUnionNode->getUnionSelectedNodeName(name);
+    AdbInstance *adbNode = getRegNode(name);
+    adbNode->expand(true);
+    return adbNode;
+}
+
+/************************************
+* Function: findAdbNode
+************************************/
+AdbInstance* MlxRegLib::findAdbNode(u_int16_t regId)
+{
+    boost::unordered_map<u_int64_t, AdbInstance*>::iterator it = _regNodesById.find(regId);
+    if (it == _regNodesById.end()) {
+        throw MlxRegException("Can't find access register id: 0x%x", regId);
+    }
+    return findAdbNode(it->second->attrs["selected_by"]);
 }
 
 /************************************
@@ -317,7 +375,7 @@ std::map<string, u_int64_t> MlxRegLib::genSuppRegsList(std::map<string, u_int64_
 ************************************/
 bool MlxRegLib::isRegSizeSupported(string regName)
 {
-    AdbInstance *adbNode = _regAccessUnionNode->getUnionSelectedNodeName(regName);
+    AdbInstance *adbNode = getRegNode(regName);
     return (((adbNode->size >> 3) <= (u_int32_t)mget_max_reg_size(_mf, MACCESS_REG_METHOD_SET)) ||
             ((adbNode->size >> 3) <= (u_int32_t)mget_max_reg_size(_mf, MACCESS_REG_METHOD_GET)));
 }
@@ -327,14 +385,13 @@ bool MlxRegLib::isRegSizeSupported(string regName)
 ************************************/
 bool MlxRegLib::isRegAccessSupported(u_int64_t regID)
 {
-    u_int64_t *suppRegId = (u_int64_t*)_gSupportedRegisters;
-    while (*suppRegId) {
-        if (*suppRegId == regID) {
-            return true;
+    static boost::unordered_set<u_int64_t> supportedRegs;
+    if (supportedRegs.empty()) {
+        for (const u_int64_t *suppRegId = _gSupportedRegisters; *suppRegId; suppRegId++) {
+            supportedRegs.insert(*suppRegId);
         }
-        suppRegId++;
     }
-    return false;
+    return supportedRegs.find(regID) != supportedRegs.end();
 }
 
 /************************************
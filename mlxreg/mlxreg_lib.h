@@ -36,6 +36,7 @@
 #define MLXREG_LIB_H
 
 #include <vector>
+#include <boost/unordered_map.hpp>
 #include <mtcr.h>
 #include <adb_parser/adb_parser.h>
 #include <dev_mgt/tools_dev_types.h>
@@ -58,6 +59,7 @@ public:
     * library Getters/Setters *
     * * * * * * * * * * * * * */
     AdbInstance* findAdbNode(string name);
+    AdbInstance* findAdbNode(u_int16_t regId);
     AdbInstance* getAdbTable() { return _regAccessRootNode; };
     /* * * * * * * *
     * library API *
@@ -80,7 +82,9 @@ protected:
     bool isRegAccessSupported(u_int64_t regID);
     bool isRegSizeSupported(string regName);
     int sendMaccessReg(u_int16_t regId, int method, std::vector<u_int32_t> &data);
-    void initAdb(string extAdbFile);
+    void initAdb(string extAdbFile, string rootNode);
+    void indexRegisters();
+    AdbInstance* getRegNode(string regName);
 
     /* Data Members */
     mfile *_mf;
@@ -93,6 +97,8 @@ protected:
     AdbInstance *_regAccessUnionNode;
     std::map<string, u_int64_t>   _regAccessMap;
     std::map<string, u_int64_t>   _supportedRegAccessMap;
+    boost::unordered_map<string, AdbInstance*>    _regNodesByName; // union sub-instance per register name
+    boost::unordered_map<u_int64_t, AdbInstance*> _regNodesById;
     bool _onlyKnownRegs;
     bool _isExternal;
 };
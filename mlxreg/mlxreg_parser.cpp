@@ -32,7 +32,9 @@
  *
  */
 
+#include <errno.h>
 #include <sstream>
+#include <common/compatibility.h>
 #include <common/bit_slice.h>
 #include <common/tools_utils.h>
 #include "mlxreg_parser.h"
@@ -42,38 +44,76 @@ using namespace mlxreg;
 /************************************
 * Function: RegParser
 ************************************/
-RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, std::vector<u_int32_t> buffer)
+RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, std::vector<u_int32_t> buffer) :
+    _data(data), _indexes(indexes), _regNode(regNode), _plan(&_ownPlan)
 {
-    _data      = data;
-    _indexes   = indexes;
-    _regNode   = regNode;
-    if (!regNode) {
-        _parseMode = Pm_Unknown;
-    } else {
-        _parseMode = Pm_Known;
+    if (regNode) {
+        _ownPlan = AdbFieldPlan(regNode);
     }
+    initBuffer(buffer);
+}
+
+/************************************
+* Function: RegParser
+************************************/
+RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, u_int32_t len) :
+    _data(data), _indexes(indexes), _regNode(regNode), _plan(&_ownPlan)
+{
+    if (regNode) {
+        _ownPlan = AdbFieldPlan(regNode);
+    }
+    initLen(len);
+}
+
+/************************************
+* Function: RegParser
+************************************/
+RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, std::vector<u_int32_t> buffer,
+                                 const AdbFieldPlan &plan) :
+    _data(data), _indexes(indexes), _regNode(regNode), _plan(&plan)
+{
+    initBuffer(buffer);
+}
+
+/************************************
+* Function: RegParser
+************************************/
+RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, u_int32_t len,
+                                 const AdbFieldPlan &plan) :
+    _data(data), _indexes(indexes), _regNode(regNode), _plan(&plan)
+{
+    initLen(len);
+}
+
+/************************************
+* Function: initBuffer
+************************************/
+void RegAccessParser::initBuffer(std::vector<u_int32_t> buffer)
+{
+    _parseMode = _regNode ? Pm_Known : Pm_Unknown;
     _len    = buffer.size();
     _buffer = buffer;
     /*
      * Initiate byte-swapping
      * At this point we know the the buffer <buffer> argument already been trough byte-
      * swapping process, we need to re-commit this process so the data will be correct.
+     * Known registers are encoded by the field plan directly in this format.
      */
-    for (std::vector<u_int32_t>::size_type j = 0; j < _buffer.size(); j++) {
-        _buffer[j] = CPU_TO_BE32((_buffer[j]));
+    if (_parseMode == Pm_Unknown) {
+        for (std::vector<u_int32_t>::size_type j = 0; j < _buffer.size(); j++) {
+            _buffer[j] = CPU_TO_BE32((_buffer[j]));
+        }
     }
 }
+
 /************************************
-* Function: RegParser
+* Function: initLen
 ************************************/
-RegAccessParser::RegAccessParser(string data, string indexes, AdbInstance *regNode, u_int32_t len)
+void RegAccessParser::initLen(u_int32_t len)
 {
-    _data      = data;
-    _indexes   = indexes;
-    _regNode   = regNode;
-    _len       = len;
+    _len = len;
     // Set parsing method
-    if (!regNode) {
+    if (!_regNode) {
         if (_len > MAX_REG_SIZE) {
             throw MlxRegException("Register length: 0x%08x is too large", _len);
         }
@@ -104,15 +144,12 @@ std::vector<u_int32_t> RegAccessParser::genBuff()
 ************************************/
 std::vector<u_int32_t> RegAccessParser::genBuffKnown()
 {
+    // The buffer is kept in BE32, fields are pushed by the plan
     parseIndexes();
     // Update buffer with data values
     if (_data != "") {
         parseData();
     }
-    // Convert to BE32
-    for (std::vector<u_int32_t>::size_type j = 0; j < _buffer.size(); j++) {
-        _buffer[j] = CPU_TO_BE32((_buffer[j]));
-    }
     return _buffer;
 }
 
@@ -142,9 +179,10 @@ void RegAccessParser::parseIndexes()
         std::vector<std::string> idx = strSplit(idxTokens[i], '=', true);
         string idxName = idx[0];
         string idxVal  = idx[1];
-        u_int32_t uintVal;
-        strToUint32((char*)idxVal.c_str(), uintVal);
-        AdbInstance *field = getField(idxName);
+        u_int64_t uintVal;
+        strToUint64((char*)idxVal.c_str(), uintVal);
+        size_t fieldIdx = getFieldIdx(idxName);
+        checkFieldWidth(_plan->getFields()[fieldIdx], uintVal);
         // Make sure that the field is INDEX
         if (std::find(expectedIdxs.begin(), expectedIdxs.end(), idxName) != expectedIdxs.end()) {
             if (std::find(foundIdxs.begin(), foundIdxs.end(), idxName) != foundIdxs.end()) {
@@ -154,7 +192,7 @@ void RegAccessParser::parseIndexes()
         } else {
             throw MlxRegException("Field: %s is not an index.", idxName.c_str());
         }
-        updateBuffer(field->offset, field->size, uintVal);
+        _plan->push((u_int8_t*)&_buffer[0], fieldIdx, uintVal);
     }
     // Make sure that all the indexes are set
     for (std::vector<std::string>::size_type i = 0; i != expectedIdxs.size(); i++) {
@@ -181,13 +219,14 @@ void RegAccessParser::parseData()
         std::vector<std::string> dat = strSplit(datTokens[i], '=', true);
         string datName = dat[0];
         string datVal  = dat[1];
-        u_int32_t uintVal;
-        strToUint32((char*)datVal.c_str(), uintVal);
-        AdbInstance *field = getField(datName);
-        if (isRO(field)) {
+        u_int64_t uintVal;
+        strToUint64((char*)datVal.c_str(), uintVal);
+        size_t fieldIdx = getFieldIdx(datName);
+        if (isRO(_plan->getFields()[fieldIdx])) {
             throw MlxRegException("Field: %s is ReadOnly", datName.c_str());
         }
-        updateBuffer(field->offset, field->size, uintVal);
+        checkFieldWidth(_plan->getFields()[fieldIdx], uintVal);
+        _plan->push((u_int8_t*)&_buffer[0], fieldIdx, uintVal);
     }
 }
 
@@ -205,14 +244,6 @@ void RegAccessParser::parseUnknown()
     }
 }
 
-/************************************
-* Function: updateBuffer
-************************************/
-void RegAccessParser::updateBuffer(u_int32_t offset, u_int32_t size, u_int32_t val)
-{
-    _buffer[offset >> 5] = MERGE(_buffer[offset >> 5], val, (offset % 32), size);
-}
-
 /************************************
 * Function: updateBufferUnknown
 *
@@ -316,18 +347,52 @@ void RegAccessParser::strToUint32(char *str, u_int32_t &uint)
     return;
 }
 
+/************************************
+* Function: strToUint64
+************************************/
+void RegAccessParser::strToUint64(char *str, u_int64_t &uint)
+{
+    char *endp;
+    errno = 0;
+    uint = strtoull(str, &endp, 0);
+    if (*endp || !*str || errno == ERANGE) {
+        throw MlxRegException("Argument: %s is invalid.", str);
+    }
+    if (str[0] == '-') {
+        throw MlxRegException("Argument: %s is invalid. It must be non-negative.", str);
+    }
+    return;
+}
+
+/************************************
+* Function: checkFieldWidth
+************************************/
+void RegAccessParser::checkFieldWidth(AdbInstance *field, u_int64_t value)
+{
+    if (field->size < 64 && (value >> field->size)) {
+        throw MlxRegException("Value 0x%" U64H_FMT_GEN " does not fit field: %s (%u bits)", value,
+                              field->name.c_str(), (unsigned int)field->size);
+    }
+}
+
 /************************************
 * Function: getField
 ************************************/
 AdbInstance* RegAccessParser::getField(string name)
 {
-    std::vector<AdbInstance*> subItems = _regNode->getLeafFields();
-    for (std::vector<AdbInstance*>::size_type i = 0; i != subItems.size(); i++) {
-        if (subItems[i]->name == name) {
-            return subItems[i];
-        }
+    return _plan->getFields()[getFieldIdx(name)];
+}
+
+/************************************
+* Function: getFieldIdx
+************************************/
+size_t RegAccessParser::getFieldIdx(string name)
+{
+    int idx = _plan->findField(name);
+    if (idx < 0) {
+        throw MlxRegException("Can't find field name: \"%s\"", name.c_str());
     }
-    throw MlxRegException("Can't find field name: \"%s\"", name.c_str());
+    return (size_t)idx;
 }
 
 /************************************
@@ -372,12 +437,10 @@ std::vector<string> RegAccessParser::getAllIndexes(AdbInstance *node)
 
 void RegAccessParser::updateField(string field_name, u_int32_t value)
 {
-    AdbInstance *field = getField(field_name);
-    updateBuffer(field->offset, field->size, value);
+    _plan->push((u_int8_t*)&_buffer[0], getFieldIdx(field_name), value);
 }
 
 u_int32_t RegAccessParser::getFieldValue(string field_name, std::vector<u_int32_t>& buff)
 {
-    AdbInstance *field = getField(field_name);
-    return (u_int32_t)field->popBuf((u_int8_t*)&buff[0]);
+    return (u_int32_t)_plan->pop((u_int8_t*)&buff[0], getFieldIdx(field_name));
 }
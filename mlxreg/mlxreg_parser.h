@@ -38,6 +38,7 @@
 #include <string>
 #include <algorithm>
 #include <adb_parser/adb_parser.h>
+#include <adb_parser/adb_field_plan.h>
 #include "mlxreg_exception.h"
 
 namespace mlxreg {
@@ -54,30 +55,44 @@ class RegAccessParser
 public:
     RegAccessParser(string data, string indexes, AdbInstance *regNode, std::vector<u_int32_t> buffer);
     RegAccessParser(string data, string indexes, AdbInstance *regNode, u_int32_t len);
+    // Known register with a field plan the caller keeps alive (e.g. cached across accesses)
+    RegAccessParser(string data, string indexes, AdbInstance *regNode, std::vector<u_int32_t> buffer,
+                    const AdbFieldPlan &plan);
+    RegAccessParser(string data, string indexes, AdbInstance *regNode, u_int32_t len, const AdbFieldPlan &plan);
     std::vector<u_int32_t> genBuff();
     u_int32_t getDataLen() {return _len;};
     static void strToUint32(char *str, u_int32_t &uint);
+    static void strToUint64(char *str, u_int64_t &uint);
 protected:
     string _data;
     string _indexes;
     u_int32_t _len;
     AdbInstance *_regNode;
+    AdbFieldPlan _ownPlan;
+    const AdbFieldPlan *_plan; // _ownPlan or the caller's
     parseMode _parseMode;
     std::vector<u_int32_t>    _buffer;
     std::vector<u_int32_t> genBuffUnknown();
     std::vector<u_int32_t> genBuffKnown();
+    void initBuffer(std::vector<u_int32_t> buffer);
+    void initLen(u_int32_t len);
     void parseIndexes();
     void parseData();
     void parseUnknown();
     AdbInstance* getField(string name);
+    size_t getFieldIdx(string name);
+    void checkFieldWidth(AdbInstance *field, u_int64_t value);
     std::vector<string> strSplit(string str, char delimiter, bool forcePairs);
-    void updateBuffer(u_int32_t offset, u_int32_t size, u_int32_t val);
     void updateBufferUnknwon(std::vector<string> fieldTokens);
     void updateField(string field_name, u_int32_t value);
     u_int32_t getFieldValue(string field_name, std::vector<u_int32_t>& buff);
     bool isRO(AdbInstance *field);
     bool isIndex(AdbInstance *field);
     std::vector<string> getAllIndexes(AdbInstance *node);
+private:
+    // _plan may point to _ownPlan
+    RegAccessParser(const RegAccessParser&);
+    RegAccessParser& operator=(const RegAccessParser&);
 };
 
 }
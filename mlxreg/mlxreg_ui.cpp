@@ -113,6 +113,12 @@
 #define IGNORE_REG_CHECK_FLAG_SHORT ' '
 #define FORCE_FLAG                  "yes"
 #define FORCE_FLAG_SHORT            ' '
+#define OP_BATCH_FLAG               "batch"
+#define OP_BATCH_FLAG_SHORT         ' '
+#define OUTPUT_FORMAT_FLAG          "output_format"
+#define OUTPUT_FORMAT_FLAG_SHORT    ' '
+#define WATCH_FLAG                  "watch"
+#define WATCH_FLAG_SHORT            ' '
 
 using namespace mlxreg;
 
@@ -137,6 +143,9 @@ MlxRegUi::MlxRegUi() :
     _op             = CMD_UNKNOWN;
     _mlxRegLib      = NULL;
     _force          = false;
+    _batchFile      = "";
+    _batchFormat    = BATCH_OUT_JSON;
+    _watchInterval  = 0;
 #if defined(EXTERNAL) || defined(MST_UL)
     _isExternal     = true;
 #else
@@ -178,6 +187,9 @@ void MlxRegUi::initCmdParser()
     AddOptions(OP_SHOW_REGS_FLAG, OP_SHOW_REGS_FLAG_SHORT, "", "Print available registers names and exit");
     AddOptions(OP_SHOW_ALL_REGS_FLAG, OP_SHOW_ALL_REGS_FLAG_SHORT, "", "");
     AddOptions(FORCE_FLAG, FORCE_FLAG_SHORT, "", "");
+    AddOptions(OP_BATCH_FLAG,     OP_BATCH_FLAG_SHORT, "BatchFile", "Run the register accesses listed in a file");
+    AddOptions(OUTPUT_FORMAT_FLAG, OUTPUT_FORMAT_FLAG_SHORT, "Format", "Batch output format: json or csv");
+    AddOptions(WATCH_FLAG,        WATCH_FLAG_SHORT, "Interval", "Sample the GET registers every <Interval> seconds");
     _cmdParser.AddRequester(this);
 }
 
@@ -227,6 +239,9 @@ void MlxRegUi::printHelp()
     printFlagLine(OP_SET_FLAG_SHORT,        OP_SET_FLAG,       "reg_dataStr", "Register access SET");
     printFlagLine(OP_SHOW_REG_FLAG_SHORT,   OP_SHOW_REG_FLAG,  "reg_name", "Print the fields of a given reg access (must have reg_name)");
     printFlagLine(OP_SHOW_REGS_FLAG_SHORT,  OP_SHOW_REGS_FLAG, "", "Print all available reg access'");
+    printFlagLine(OP_BATCH_FLAG_SHORT,      OP_BATCH_FLAG,     "file", "Run the GET/SET operations listed in a script or JSON file ('-' for stdin)");
+    printFlagLine(OUTPUT_FORMAT_FLAG_SHORT, OUTPUT_FORMAT_FLAG, "json|csv", "Output format of --batch (default json)");
+    printFlagLine(WATCH_FLAG_SHORT,         WATCH_FLAG,        "interval", "Repeat --get or the GETs of --batch every <interval> seconds, print changes and counter rates");
     printFlagLine(FORCE_FLAG_SHORT,         FORCE_FLAG,        "", "Non-interactive mode, answer yes to all questions");
 
     // print usage examples
@@ -238,6 +253,9 @@ void MlxRegUi::printHelp()
            MLXREG_EXEC " -d <device> --get --reg_name PAOS --indexes \"local_port=0x1,swid=0x5\"");
     printf(IDENT2 "%-40s: \n" IDENT3 "%s\n", "SET PAOS with indexes: local port 0x1 and swid 0x5, and data: e 0x0",
            MLXREG_EXEC " -d <device> --set \"e=0x0\" --reg_name PAOS --indexes \"local_port=0x1,swid=0x5\"");
+    printf(IDENT2 "%-40s: %s\n", "Run the operations of a batch file as CSV", MLXREG_EXEC " -d <device> --batch ops.txt --output_format csv");
+    printf(IDENT2 "%-40s: \n" IDENT3 "%s\n", "Watch PPCNT counters of local port 0x1 every second",
+           MLXREG_EXEC " -d <device> --get --reg_name PPCNT --indexes \"local_port=0x1,swid=0x0,pnat=0x0,grp=0x0,prio_tc=0x0\" --watch 1");
     printf("\n");
 }
 
@@ -296,7 +314,10 @@ void MlxRegUi::printRegNames(std::vector<string> regs)
 ************************************/
 void MlxRegUi::printAdbContext(AdbInstance *node, std::vector<u_int32_t> buff)
 {
-    std::vector<AdbInstance*> subItems = node->getLeafFields();
+    AdbFieldPlan plan(node);
+    std::vector<u_int64_t> values;
+    plan.decode((u_int8_t*)&buff[0], values);
+    const std::vector<AdbInstance*> &subItems = plan.getFields();
     int largestName = (int)getLongestNodeLen(subItems);
     printf("%-*s | %-8s\n", largestName, "Field Name", "Data");
     PRINT_LINE(largestName + 14);
@@ -304,7 +325,7 @@ void MlxRegUi::printAdbContext(AdbInstance *node, std::vector<u_int32_t> buff)
         printf("%-*s | 0x%08x\n",
                largestName,
                subItems[i]->name.c_str(),
-               (unsigned int)subItems[i]->popBuf((u_int8_t*)&buff[0]));
+               (unsigned int)values[i]);
     }
     PRINT_LINE(largestName + 14);
 }
@@ -344,6 +365,28 @@ bool MlxRegUi::askUser(const char *question)
     return true;
 }
 
+/************************************
+* Function: watch
+************************************/
+void MlxRegUi::watch()
+{
+    MlxRegWatch watcher(_mlxRegLib, _watchInterval);
+    if (_op == CMD_BATCH) {
+        MlxRegBatch batch(_mlxRegLib, true);
+        batch.load(_batchFile);
+        const std::vector<BatchOp> &ops = batch.getOps();
+        for (size_t i = 0; i < ops.size(); i++) {
+            if (ops[i].isSet) {
+                throw MlxRegException("--%s can only repeat GET operations", WATCH_FLAG);
+            }
+            watcher.addRegister(ops[i].regName, ops[i].indexes, ops[i].fields);
+        }
+    } else {
+        watcher.addRegister(_regName, _indexesStr, std::vector<string>());
+    }
+    watcher.run(stdout);
+}
+
 /************************************
 * Function: HandleOption
 ************************************/
@@ -416,6 +459,27 @@ ParseStatus MlxRegUi::HandleOption(string name, string value)
         CHECK_UNIQUE_OP(_op);
         _op = CMD_SHOW_ALL_REGS;
         return PARSE_OK;
+    } else if (name == OP_BATCH_FLAG) {
+        CHECK_UNIQUE_OP(_op);
+        _op = CMD_BATCH;
+        _batchFile = value;
+        return PARSE_OK;
+    } else if (name == WATCH_FLAG) {
+        char *end;
+        _watchInterval = strtod(value.c_str(), &end);
+        if (*end || _watchInterval <= 0) {
+            throw MlxRegException("invalid watch interval \"%s\", expected seconds", value.c_str());
+        }
+        return PARSE_OK;
+    } else if (name == OUTPUT_FORMAT_FLAG) {
+        if (value == "json") {
+            _batchFormat = BATCH_OUT_JSON;
+        } else if (value == "csv") {
+            _batchFormat = BATCH_OUT_CSV;
+        } else {
+            throw MlxRegException("unknown output format \"%s\", expected json or csv", value.c_str());
+        }
+        return PARSE_OK;
     }
 
     return PARSE_ERROR;
@@ -454,6 +518,12 @@ void MlxRegUi::paramValidate()
     if (_op == CMD_SET && _dataStr == "") {
         throw MlxRegException("you must provide registers data string to use SET");
     }
+    if (_op == CMD_BATCH && (_regName != "" || _regID != 0 || _indexesStr != "")) {
+        throw MlxRegException("the register and indexes of --batch are given in the batch file");
+    }
+    if (_watchInterval != 0 && !((_op == CMD_GET && _regName != "") || _op == CMD_BATCH)) {
+        throw MlxRegException("--%s can be used with --get by register name or with --batch", WATCH_FLAG);
+    }
 }
 
 void MlxRegUi::run(int argc, char **argv)
@@ -516,6 +586,10 @@ void MlxRegUi::run(int argc, char **argv)
         break;
 
     case CMD_GET:
+        if (_watchInterval != 0) {
+            watch();
+            break;
+        }
         {
             if (_regName != "") {
                 regNode = _mlxRegLib->findAdbNode(_regName);
@@ -567,6 +641,22 @@ void MlxRegUi::run(int argc, char **argv)
         }
         break;
 
+    case CMD_BATCH:
+        {
+            if (_watchInterval != 0) {
+                watch();
+                break;
+            }
+            MlxRegBatch batch(_mlxRegLib, _force);
+            batch.load(_batchFile);
+            int failed = batch.run();
+            batch.print(stdout, _batchFormat);
+            if (failed) {
+                throw MlxRegException("%d batch operations failed", failed);
+            }
+        }
+        break;
+
     default:
         break;
     }
@@ -42,6 +42,8 @@
 #include <mtcr.h>
 #include "mlxreg_lib.h"
 #include "mlxreg_parser.h"
+#include "mlxreg_batch.h"
+#include "mlxreg_watch.h"
 
 using namespace mlxreg;
 
@@ -53,6 +55,7 @@ typedef enum {
     CMD_SHOW_REG,
     CMD_SHOW_REGS,
     CMD_SHOW_ALL_REGS,
+    CMD_BATCH,
     CMD_UNKNOWN
 } MlxRegOper;
 
@@ -76,6 +79,8 @@ private:
     void printAdbContext(AdbInstance *node, std::vector<u_int32_t> buff);
     void printBuff(std::vector<u_int32_t> buff);
 
+    void watch();
+
     CommandLineParser _cmdParser;
     string _device;
     mfile *_mf;
@@ -91,6 +96,9 @@ private:
     bool _force;
     MlxRegLib *_mlxRegLib;
     bool _isExternal;
+    string _batchFile;
+    BatchOutFormat _batchFormat;
+    double _watchInterval;
 };
 
 #endif /* MLXREG_UI_H */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <mft_utils/mft_sig_handler.h>
+#include "mlxreg_watch.h"
+#include "mlxreg_parser.h"
+
+using namespace mlxreg;
+
+#define USEC_PER_SEC 1000000.0
+
+/************************************
+* Function: clockUsec
+************************************/
+static double clockUsec(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / 1000.0;
+}
+
+/************************************
+* Function: sleepUntil
+************************************/
+static void sleepUntil(double usec)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(usec / USEC_PER_SEC);
+    ts.tv_nsec = (long)((usec - ts.tv_sec * USEC_PER_SEC) * 1000);
+    // Interrupted by a signal: return and let the caller check it
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/************************************
+* Function: isCounterField
+************************************/
+static bool isCounterField(AdbInstance *field)
+{
+    AttrsMap::iterator it = field->fieldDesc->attrs.find("access");
+    return it != field->fieldDesc->attrs.end() && it->second == "RO" && field->size >= 32;
+}
+
+/************************************
+* Function: MlxRegWatch
+************************************/
+MlxRegWatch::MlxRegWatch(MlxRegLib *mlxRegLib, double interval) :
+    _mlxRegLib(mlxRegLib), _interval(interval * USEC_PER_SEC)
+{
+    if (_interval <= 0) {
+        throw MlxRegException("Watch interval must be positive");
+    }
+}
+
+/************************************
+* Function: addRegister
+************************************/
+void MlxRegWatch::addRegister(const string &regName, const string &indexes, const std::vector<string> &fields)
+{
+    AdbInstance *regNode = _mlxRegLib->findAdbNode(regName);
+    _regs.push_back(WatchReg());
+    WatchReg &reg = _regs.back();
+    reg.regName = regName;
+    reg.indexes = indexes;
+    reg.plan = AdbFieldPlan(regNode);
+    reg.prevTime = 0;
+    RegAccessParser parser("", indexes, regNode, (u_int32_t)0, reg.plan);
+    reg.request = parser.genBuff();
+
+    const std::vector<AdbInstance*> &leaves = reg.plan.getFields();
+    std::vector<int> idxs;
+    if (fields.empty()) {
+        for (size_t i = 0; i < leaves.size(); i++) {
+            idxs.push_back((int)i);
+        }
+    } else {
+        for (size_t i = 0; i < fields.size(); i++) {
+            int idx = reg.plan.findField(fields[i]);
+            if (idx < 0) {
+                throw MlxRegException("Can't find field name: \"%s\"", fields[i].c_str());
+            }
+            idxs.push_back(idx);
+        }
+    }
+
+    std::vector<bool> used(leaves.size(), false);
+    for (size_t i = 0; i < idxs.size(); i++) {
+        int idx = idxs[i];
+        if (used[idx]) {
+            continue;
+        }
+        used[idx] = true;
+        WatchField field;
+        field.name = leaves[idx]->name;
+        field.idx = idx;
+        field.bits = leaves[idx]->size;
+        field.isCounter = isCounterField(leaves[idx]);
+
+        // <name>_high/<name>_low: one 64 bit counter
+        const string high = "_high";
+        if (field.isCounter && field.bits == 32 && field.name.size() > high.size() &&
+            !field.name.compare(field.name.size() - high.size(), high.size(), high)) {
+            string base = field.name.substr(0, field.name.size() - high.size());
+            int lowIdx = reg.plan.findField(base + "_low");
+            if (lowIdx >= 0 && leaves[lowIdx]->size == 32 && isCounterField(leaves[lowIdx])) {
+                field.name = base;
+                field.lowIdx = lowIdx;
+                field.bits = 64;
+                used[lowIdx] = true;
+            }
+        }
+        reg.fields.push_back(field);
+    }
+    // The low half may be listed before its high half
+    for (size_t i = 0; i < reg.fields.size(); i++) {
+        for (size_t j = 0; j < reg.fields.size(); j++) {
+            if (reg.fields[i].idx == reg.fields[j].lowIdx) {
+                reg.fields.erase(reg.fields.begin() + i--);
+                break;
+            }
+        }
+    }
+}
+
+/************************************
+* Function: append
+************************************/
+void MlxRegWatch::append(const char *fmt, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len > 0) {
+        _out.append(line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+    }
+}
+
+/************************************
+* Function: sample
+************************************/
+void MlxRegWatch::sample(WatchReg &reg, double elapsed, bool first)
+{
+    _buff = reg.request;
+    double now = clockUsec(CLOCK_MONOTONIC);
+    _mlxRegLib->sendRegister(reg.regName, MACCESS_REG_METHOD_GET, _buff);
+    reg.plan.decode((u_int8_t*)&_buff[0], _values);
+
+    _curr.resize(reg.fields.size());
+    for (size_t i = 0; i < reg.fields.size(); i++) {
+        const WatchField &field = reg.fields[i];
+        _curr[i] = _values[field.idx];
+        if (field.lowIdx >= 0) {
+            _curr[i] = (_curr[i] << 32) | _values[field.lowIdx];
+        }
+    }
+
+    bool header = false;
+    for (size_t i = 0; i < reg.fields.size(); i++) {
+        const WatchField &field = reg.fields[i];
+        if (!first && _curr[i] == reg.prev[i]) {
+            continue;
+        }
+        if (!header) {
+            append("[%10.3f] %s %s\n", elapsed / USEC_PER_SEC, reg.regName.c_str(), reg.indexes.c_str());
+            header = true;
+        }
+        if (first) {
+            append("    %-40s : 0x%" U64H_FMT_GEN "\n", field.name.c_str(), _curr[i]);
+        } else if (field.isCounter) {
+            // Counters wrap at their own width
+            u_int64_t delta = _curr[i] - reg.prev[i];
+            if (field.bits < 64) {
+                delta &= (1ULL << field.bits) - 1;
+            }
+            append("    %-40s : %-20" U64D_FMT_GEN " +%-14" U64D_FMT_GEN " %.1f/s\n", field.name.c_str(),
+                   _curr[i], delta, delta * USEC_PER_SEC / (now - reg.prevTime));
+        } else {
+            append("    %-40s : 0x%" U64H_FMT_GEN " -> 0x%" U64H_FMT_GEN "\n", field.name.c_str(),
+                   reg.prev[i], _curr[i]);
+        }
+    }
+    reg.prev.swap(_curr);
+    reg.prevTime = now;
+}
+
+/************************************
+* Function: run
+************************************/
+void MlxRegWatch::run(FILE *out)
+{
+    unsigned int samples = 0, missed = 0;
+    double jitterSum = 0, jitterMax = 0, cpuSum = 0;
+    double start = clockUsec(CLOCK_MONOTONIC);
+    double deadline = start;
+
+    _out.reserve(4096);
+    while (!mft_signal_is_fired()) {
+        double cpuStart = clockUsec(CLOCK_PROCESS_CPUTIME_ID);
+        double wake = clockUsec(CLOCK_MONOTONIC);
+        double jitter = wake - deadline;
+        jitterSum += jitter;
+        if (jitter > jitterMax) {
+            jitterMax = jitter;
+        }
+
+        _out.clear();
+        for (size_t i = 0; i < _regs.size(); i++) {
+            sample(_regs[i], deadline - start, samples == 0);
+        }
+        if (!_out.empty()) {
+            fwrite(_out.data(), 1, _out.size(), out);
+            fflush(out);
+        }
+        samples++;
+        cpuSum += clockUsec(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+
+        // Next deadline is relative to the start, not to this sample
+        deadline += _interval;
+        double now = clockUsec(CLOCK_MONOTONIC);
+        if (now >= deadline + _interval) {
+            unsigned int skip = (unsigned int)((now - deadline) / _interval);
+            missed += skip;
+            deadline += skip * _interval;
+        }
+        sleepUntil(deadline);
+    }
+
+    fprintf(out, "\n%u samples, %u missed, interval %.0f us\n", samples, missed, _interval);
+    if (samples) {
+        fprintf(out, "Sampling jitter: avg %.1f us, max %.1f us\n", jitterSum / samples, jitterMax);
+        fprintf(out, "CPU time per sample: %.1f us\n", cpuSum / samples);
+    }
+}
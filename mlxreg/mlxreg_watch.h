@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mlxreg_watch.h - watch mode of mstreg.
+ *
+ * Samples a set of registers at a fixed interval with the device and the
+ * ADB opened once. Samples are scheduled on absolute deadlines so delays
+ * of one sample do not shift the following ones; a sample whose deadline
+ * already passed by a whole interval is skipped and counted as missed.
+ *
+ * The first sample prints all the selected fields, the following ones print
+ * only what changed. Counter fields are printed with their per-second rate.
+ * A counter is an RO field of 32 bits or more, or a pair of RO 32 bit
+ * fields named <name>_high/<name>_low, which are reported as one 64 bit
+ * counter <name>. When the watch is interrupted the sampling jitter and the
+ * CPU time per sample are printed.
+ */
+
+#ifndef MLXREG_WATCH_H
+#define MLXREG_WATCH_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <adb_parser/adb_field_plan.h>
+#include "mlxreg_lib.h"
+
+namespace mlxreg {
+
+class MlxRegWatch
+{
+public:
+    MlxRegWatch(MlxRegLib *mlxRegLib, double interval); // interval in seconds
+    // Empty fields means all the fields of the register
+    void addRegister(const string &regName, const string &indexes, const std::vector<string> &fields);
+    void run(FILE *out); // Until interrupted
+
+private:
+    struct WatchField {
+        WatchField() : idx(0), lowIdx(-1), isCounter(false), bits(0) {}
+        string name;
+        int idx;
+        int lowIdx;   // low half of a _high/_low counter, or -1
+        bool isCounter;
+        u_int32_t bits;
+    };
+
+    struct WatchReg {
+        string regName;
+        string indexes;
+        AdbFieldPlan plan;
+        std::vector<u_int32_t> request; // GET buffer with the indexes set
+        std::vector<WatchField> fields;
+        std::vector<u_int64_t> prev;
+        double prevTime;                // usec
+    };
+
+    void sample(WatchReg &reg, double elapsed, bool first);
+    void append(const char *fmt, ...);
+
+    MlxRegLib *_mlxRegLib;
+    double _interval; // usec
+    std::vector<WatchReg> _regs;
+    std::vector<u_int32_t> _buff;
+    std::vector<u_int64_t> _values;
+    std::vector<u_int64_t> _curr;
+    std::string _out; // output of the current sample, written at once
+};
+
+}
+#endif /* MLXREG_WATCH_H */
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_bin.c - binary mstdump output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "crdump.h"
+#include "crd_bin.h"
+#ifdef CRD_ENABLE_XZ
+#include <xz_utils/xz_utils.h>
+#endif
+
+u_int32_t crd_bin_get_ranges(const crd_dword_t *dwords, u_int32_t count, crd_bin_range_t *ranges)
+{
+    u_int32_t range_count = 0;
+    u_int32_t len = 0;
+    u_int32_t i;
+
+    for (i = 0; i < count; i++) {
+        if (i == 0 || dwords[i].addr != dwords[i - 1].addr + 4) {
+            if (ranges && range_count) {
+                ranges[range_count - 1].len = __cpu_to_le32(len);
+            }
+            if (ranges) {
+                ranges[range_count].addr = __cpu_to_le32(dwords[i].addr);
+            }
+            range_count++;
+            len = 0;
+        }
+        len++;
+    }
+    if (ranges && range_count) {
+        ranges[range_count - 1].len = __cpu_to_le32(len);
+    }
+    return range_count;
+}
+
+int crd_bin_set_addrs(const crd_bin_range_t *ranges, u_int32_t range_count, crd_dword_t *dwords, u_int32_t count)
+{
+    u_int32_t total = 0;
+    u_int32_t addr;
+    u_int32_t len;
+    u_int32_t r;
+    u_int32_t j;
+
+    for (r = 0; r < range_count; r++) {
+        addr = __le32_to_cpu(ranges[r].addr);
+        len = __le32_to_cpu(ranges[r].len);
+        if (len > count - total) {
+            return CRD_CSV_BAD_FORMAT;
+        }
+        for (j = 0; j < len; j++, total++) {
+            dwords[total].addr = addr + j * 4;
+        }
+    }
+    return total == count ? CRD_OK : CRD_CSV_BAD_FORMAT;
+}
+
+int crd_bin_write(FILE *fd, const crd_bin_info_t *info, const crd_dword_t *dwords, u_int32_t count,
+                  char *err, size_t err_len)
+{
+    crd_bin_hdr_t hdr;
+    crd_bin_range_t *ranges;
+    u_int32_t *data;
+    u_int8_t *payload;
+    u_int8_t *out;
+    u_int32_t range_count = crd_bin_get_ranges(dwords, count, NULL);
+    u_int32_t raw_size = range_count * sizeof(crd_bin_range_t) + count * sizeof(u_int32_t);
+    u_int32_t out_size = raw_size;
+    u_int32_t i;
+    int rc = CRD_OK;
+
+#ifndef CRD_ENABLE_XZ
+    if (info->flags & CRD_BIN_FLAG_XZ) {
+        snprintf(err, err_len, "Compressed output is not supported, built without xz");
+        return CRD_NOT_SUPPORTED;
+    }
+#endif
+    payload = (u_int8_t*)malloc(raw_size + 1);
+    if (payload == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the dump");
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    ranges = (crd_bin_range_t*)payload;
+    data = (u_int32_t*)(payload + (size_t)range_count * sizeof(crd_bin_range_t));
+    crd_bin_get_ranges(dwords, count, ranges);
+    for (i = 0; i < count; i++) {
+        data[i] = __cpu_to_le32(dwords[i].data);
+    }
+
+    out = payload;
+#ifdef CRD_ENABLE_XZ
+    if (info->flags & CRD_BIN_FLAG_XZ) {
+        int32_t size;
+        /* xz adds a few bytes per 64KB to data it cannot compress */
+        u_int32_t bound = raw_size + raw_size / 64 + 1024;
+        out = (u_int8_t*)malloc(bound);
+        if (out == NULL) {
+            snprintf(err, err_len, "Failed to allocate memory for the dump");
+            free(payload);
+            return CRD_MEM_ALLOCATION_ERR;
+        }
+        size = xz_compress(CRD_BIN_XZ_PRESET, payload, raw_size, out, bound);
+        if (size < 0) {
+            snprintf(err, err_len, "Failed to compress the dump (%d)", size);
+            rc = CRD_EXCEED_VALUE;
+            goto cleanup;
+        }
+        out_size = (u_int32_t)size;
+    }
+#endif
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = __cpu_to_le32(CRD_BIN_MAGIC);
+    hdr.version = __cpu_to_le16(CRD_BIN_VERSION);
+    hdr.flags = __cpu_to_le16(info->flags);
+    hdr.dev_type = __cpu_to_le32(info->dev_type);
+    hdr.hw_dev_id = __cpu_to_le32(info->hw_dev_id);
+    hdr.hw_rev = __cpu_to_le32(info->hw_rev);
+    for (i = 0; i < 3; i++) {
+        hdr.fw_ver[i] = __cpu_to_le32(info->fw_ver[i]);
+    }
+    hdr.timestamp = __cpu_to_le64(info->timestamp);
+    hdr.range_count = __cpu_to_le32(range_count);
+    hdr.dword_count = __cpu_to_le32(count);
+    hdr.payload_size = __cpu_to_le32(out_size);
+    hdr.raw_size = __cpu_to_le32(raw_size);
+    if (fwrite(&hdr, sizeof(hdr), 1, fd) != 1 || (out_size && fwrite(out, out_size, 1, fd) != 1) || fflush(fd)) {
+        snprintf(err, err_len, "Failed to write the dump: %s", strerror(errno));
+        rc = CRD_OPEN_FILE_ERROR;
+    }
+
+#ifdef CRD_ENABLE_XZ
+cleanup:
+#endif
+    if (out != payload) {
+        free(out);
+    }
+    free(payload);
+    return rc;
+}
+
+/* The bytes left in the file after the current position, -1 when unknown */
+static int64_t crd_bin_bytes_left(FILE *fd)
+{
+    struct stat st;
+    long pos = ftell(fd);
+
+    if (pos < 0 || fstat(fileno(fd), &st) || !S_ISREG(st.st_mode)) {
+        return -1;
+    }
+    return (int64_t)st.st_size - pos;
+}
+
+int crd_bin_read(FILE *fd, crd_bin_info_t *info, crd_dword_t **dwords, u_int32_t *count,
+                 char *err, size_t err_len)
+{
+    crd_bin_hdr_t hdr;
+    crd_bin_range_t *ranges;
+    u_int32_t *data;
+    u_int8_t *stored = NULL;
+    u_int8_t *payload = NULL;
+    u_int32_t range_count;
+    u_int32_t dword_count;
+    u_int32_t payload_size;
+    u_int32_t raw_size;
+    u_int32_t r;
+    int64_t left;
+    int rc = CRD_CSV_BAD_FORMAT;
+
+    *dwords = NULL;
+    *count = 0;
+    if (fread(&hdr, sizeof(hdr), 1, fd) != 1 || __le32_to_cpu(hdr.magic) != CRD_BIN_MAGIC) {
+        snprintf(err, err_len, "Not a binary dump");
+        return CRD_CSV_BAD_FORMAT;
+    }
+    if (__le16_to_cpu(hdr.version) != CRD_BIN_VERSION) {
+        snprintf(err, err_len, "Unsupported binary dump version %d", __le16_to_cpu(hdr.version));
+        return CRD_NOT_SUPPORTED;
+    }
+    info->flags = __le16_to_cpu(hdr.flags);
+    info->dev_type = __le32_to_cpu(hdr.dev_type);
+    info->hw_dev_id = __le32_to_cpu(hdr.hw_dev_id);
+    info->hw_rev = __le32_to_cpu(hdr.hw_rev);
+    for (r = 0; r < 3; r++) {
+        info->fw_ver[r] = __le32_to_cpu(hdr.fw_ver[r]);
+    }
+    info->timestamp = __le64_to_cpu(hdr.timestamp);
+    range_count = __le32_to_cpu(hdr.range_count);
+    dword_count = __le32_to_cpu(hdr.dword_count);
+    payload_size = __le32_to_cpu(hdr.payload_size);
+    raw_size = __le32_to_cpu(hdr.raw_size);
+    if ((u_int64_t)range_count * sizeof(crd_bin_range_t) + (u_int64_t)dword_count * sizeof(u_int32_t) != raw_size) {
+        snprintf(err, err_len, "Corrupted binary dump header");
+        return CRD_CSV_BAD_FORMAT;
+    }
+#ifndef CRD_ENABLE_XZ
+    if (info->flags & CRD_BIN_FLAG_XZ) {
+        snprintf(err, err_len, "Compressed dumps are not supported, built without xz");
+        return CRD_NOT_SUPPORTED;
+    }
+#endif
+    // the sizes are checked before they are used to allocate and read
+    left = crd_bin_bytes_left(fd);
+    if (left >= 0 && payload_size > left) {
+        snprintf(err, err_len, "Truncated binary dump");
+        return CRD_CSV_BAD_FORMAT;
+    }
+    if (!(info->flags & CRD_BIN_FLAG_XZ) && payload_size != raw_size) {
+        snprintf(err, err_len, "Corrupted binary dump header");
+        return CRD_CSV_BAD_FORMAT;
+    }
+
+    stored = (u_int8_t*)malloc((size_t)payload_size + 1);
+    *dwords = (crd_dword_t*)malloc(sizeof(crd_dword_t) * ((size_t)dword_count + 1));
+    if (stored == NULL || *dwords == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the dump");
+        rc = CRD_MEM_ALLOCATION_ERR;
+        goto cleanup;
+    }
+    if (payload_size && fread(stored, payload_size, 1, fd) != 1) {
+        snprintf(err, err_len, "Truncated binary dump");
+        goto cleanup;
+    }
+    payload = stored;
+#ifdef CRD_ENABLE_XZ
+    if (info->flags & CRD_BIN_FLAG_XZ) {
+        payload = (u_int8_t*)malloc((size_t)raw_size + 1);
+        if (payload == NULL) {
+            snprintf(err, err_len, "Failed to allocate memory for the dump");
+            rc = CRD_MEM_ALLOCATION_ERR;
+            goto cleanup;
+        }
+        if (xz_decompress(stored, payload_size, payload, raw_size) != (int32_t)raw_size) {
+            snprintf(err, err_len, "Failed to decompress the dump");
+            goto cleanup;
+        }
+    }
+#endif
+
+    ranges = (crd_bin_range_t*)payload;
+    data = (u_int32_t*)(payload + (size_t)range_count * sizeof(crd_bin_range_t));
+    if (crd_bin_set_addrs(ranges, range_count, *dwords, dword_count)) {
+        snprintf(err, err_len, "Corrupted binary dump range table");
+        goto cleanup;
+    }
+    for (r = 0; r < dword_count; r++) {
+        (*dwords)[r].data = __le32_to_cpu(data[r]);
+    }
+    *count = dword_count;
+    rc = CRD_OK;
+
+cleanup:
+    if (payload != stored) {
+        free(payload);
+    }
+    free(stored);
+    if (rc) {
+        free(*dwords);
+        *dwords = NULL;
+    }
+    return rc;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_bin.h - binary mstdump output.
+ *
+ * A binary dump is a header followed by the payload: a table of the dumped
+ * ranges ({addr, dwords} per range) and the dumped data, all little endian.
+ * With CRD_BIN_FLAG_XZ the payload is xz compressed.
+ */
+
+#ifndef _CRD_BIN_H_
+#define _CRD_BIN_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <common/compatibility.h>
+#include "crdump.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRD_BIN_MAGIC           0x44445243 /* "CRDD" */
+#define CRD_BIN_VERSION         1
+#define CRD_BIN_XZ_PRESET       3
+
+/* header flags */
+#define CRD_BIN_FLAG_XZ         0x1 /* payload is xz compressed */
+#define CRD_BIN_FLAG_FULL       0x2 /* dumped with -full */
+
+typedef struct crd_bin_hdr {
+    u_int32_t magic;
+    u_int16_t version;
+    u_int16_t flags;
+    u_int32_t dev_type; /* dm_dev_id_t */
+    u_int32_t hw_dev_id;
+    u_int32_t hw_rev;
+    u_int32_t fw_ver[3]; /* major, minor, sub minor, zero when unknown */
+    u_int64_t timestamp; /* seconds since the epoch */
+    u_int32_t range_count;
+    u_int32_t dword_count;
+    u_int32_t payload_size; /* bytes stored after the header */
+    u_int32_t raw_size; /* payload bytes before compression */
+} crd_bin_hdr_t;
+
+typedef struct crd_bin_range {
+    u_int32_t addr;
+    u_int32_t len; /* in dwords */
+} crd_bin_range_t;
+
+/* the header fields that describe the dump, in host order */
+typedef struct crd_bin_info {
+    u_int16_t flags;
+    u_int32_t dev_type;
+    u_int32_t hw_dev_id;
+    u_int32_t hw_rev;
+    u_int32_t fw_ver[3];
+    u_int64_t timestamp;
+} crd_bin_info_t;
+
+/*
+ * Write count dwords (as returned by crd_dump_data) to fd.
+ * CRD_NOT_SUPPORTED is returned for CRD_BIN_FLAG_XZ when built without xz.
+ */
+int crd_bin_write(FILE *fd, const crd_bin_info_t *info, const crd_dword_t *dwords, u_int32_t count,
+                  char *err, size_t err_len);
+
+/*
+ * Read a binary dump from fd, *dwords is allocated (free by caller).
+ */
+int crd_bin_read(FILE *fd, crd_bin_info_t *info, crd_dword_t **dwords, u_int32_t *count,
+                 char *err, size_t err_len);
+
+/*
+ * Fill ranges (when not NULL) with the little endian ranges of count
+ * dwords, return the number of ranges.
+ */
+u_int32_t crd_bin_get_ranges(const crd_dword_t *dwords, u_int32_t count, crd_bin_range_t *ranges);
+
+/*
+ * Fill the addresses of count dwords from little endian ranges.
+ */
+int crd_bin_set_addrs(const crd_bin_range_t *ranges, u_int32_t range_count, crd_dword_t *dwords, u_int32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CRD_BIN_H_
@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_db.c - mstdump address databases (CSV parser and binary database).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef __WIN__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "crdump.h"
+#include "crd_db.h"
+
+#define CRD_DB_EMPTY   "EMPTY"
+#define CRD_DB_MAXFLDS 3
+
+static u_int32_t crd_db_parse_enable(const char *str)
+{
+    char *end;
+    u_int32_t addr;
+
+    if (*str == '\0' || !strcmp(str, CRD_DB_EMPTY)) {
+        return CRD_DB_NO_ENABLE;
+    }
+    addr = (u_int32_t)strtoul(str, &end, 0);
+    if (*end != '\0' || addr == CRD_DB_NO_ENABLE) {
+        return CRD_DB_UNKNOWN_ENABLE; // e.g. "UNKNOWN"
+    }
+    return addr;
+}
+
+/*
+ * Strip a CSV line the way the original line reader did: comments ('#' to
+ * the end of the line) and spaces are dropped.
+ */
+static void crd_db_strip_line(char *line)
+{
+    char *src = line;
+    char *dst = line;
+
+    for (; *src && *src != '#' && *src != '\r'; src++) {
+        if (*src != ' ' && *src != '\t') {
+            *dst++ = *src;
+        }
+    }
+    *dst = '\0';
+}
+
+static int crd_db_block_cmp(const void *a, const void *b)
+{
+    const crd_parsed_csv_t *ba = (const crd_parsed_csv_t*)a;
+    const crd_parsed_csv_t *bb = (const crd_parsed_csv_t*)b;
+
+    if (ba->addr != bb->addr) {
+        return ba->addr < bb->addr ? -1 : 1;
+    }
+    if (ba->len != bb->len) {
+        return ba->len < bb->len ? -1 : 1;
+    }
+    return ba->enable_addr < bb->enable_addr ? -1 : (ba->enable_addr > bb->enable_addr);
+}
+
+/*
+ * Sort by address and merge blocks that continue each other and share the
+ * enable address. Overlapping blocks are kept as is, so the dumped dwords
+ * are exactly the ones listed in the CSV.
+ */
+static u_int32_t crd_db_coalesce(crd_parsed_csv_t *blocks, u_int32_t block_count)
+{
+    u_int32_t i;
+    u_int32_t n = 0;
+    int sorted = 1;
+
+    for (i = 1; i < block_count && sorted; i++) {
+        sorted = blocks[i - 1].addr <= blocks[i].addr;
+    }
+    if (!sorted) {
+        qsort(blocks, block_count, sizeof(crd_parsed_csv_t), crd_db_block_cmp);
+    }
+    for (i = 0; i < block_count; i++) {
+        if (blocks[i].len == 0) {
+            continue;
+        }
+        if (n && blocks[n - 1].enable_addr == blocks[i].enable_addr &&
+            (u_int64_t)blocks[n - 1].addr + (u_int64_t)blocks[n - 1].len * 4 == blocks[i].addr) {
+            blocks[n - 1].len += blocks[i].len;
+        } else {
+            blocks[n++] = blocks[i];
+        }
+    }
+    return n;
+}
+
+static char* crd_db_read_file(const char *path, size_t *size)
+{
+    FILE *fd = fopen(path, "rb");
+    char *buf = NULL;
+    long len;
+
+    if (fd == NULL) {
+        return NULL;
+    }
+    if (fseek(fd, 0, SEEK_END) || (len = ftell(fd)) < 0 || fseek(fd, 0, SEEK_SET)) {
+        goto cleanup;
+    }
+    buf = (char*)malloc(len + 1);
+    if (buf == NULL) {
+        goto cleanup;
+    }
+    if (fread(buf, 1, len, fd) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+        goto cleanup;
+    }
+    buf[len] = '\0';
+    *size = len;
+cleanup:
+    fclose(fd);
+    return buf;
+}
+
+int crd_db_parse_csv(const char *csv_path, crd_parsed_csv_t **blocks, u_int32_t *block_count,
+                     char *err, size_t err_len)
+{
+    char *arr[CRD_DB_MAXFLDS];
+    crd_parsed_csv_t *tmp;
+    u_int32_t count = 0;
+    u_int32_t alloc = 0;
+    size_t size = 0;
+    char *content;
+    char *line;
+    char *next;
+
+    *blocks = NULL;
+    *block_count = 0;
+    content = crd_db_read_file(csv_path, &size);
+    if (content == NULL) {
+        snprintf(err, err_len, "Failed to open csv file : '%s'", csv_path);
+        return CRD_OPEN_FILE_ERROR;
+    }
+
+    for (line = content; line; line = next) {
+        int field_count = 0;
+        char *p;
+
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        crd_db_strip_line(line);
+        if (*line == '\0') {
+            continue;
+        }
+        for (p = strtok(line, ","); p && field_count < CRD_DB_MAXFLDS; p = strtok(NULL, ",")) {
+            arr[field_count++] = p;
+        }
+        if (field_count < 2) {
+            snprintf(err, err_len, "CSV File has bad format, line : %s", line);
+            free(content);
+            free(*blocks);
+            *blocks = NULL;
+            return CRD_CSV_BAD_FORMAT;
+        }
+        if (count == alloc) {
+            alloc = alloc ? alloc * 2 : 1024;
+            tmp = (crd_parsed_csv_t*)realloc(*blocks, alloc * sizeof(crd_parsed_csv_t));
+            if (tmp == NULL) {
+                free(content);
+                free(*blocks);
+                *blocks = NULL;
+                return CRD_MEM_ALLOCATION_ERR;
+            }
+            *blocks = tmp;
+        }
+        (*blocks)[count].addr = (u_int32_t)strtol(arr[0], NULL, 0);
+        (*blocks)[count].len = atoi(arr[1]);
+        (*blocks)[count].enable_addr = field_count > 2 ? crd_db_parse_enable(arr[2]) : CRD_DB_NO_ENABLE;
+        count++;
+    }
+    free(content);
+    *block_count = crd_db_coalesce(*blocks, count);
+    return CRD_OK;
+}
+
+/* FNV-1a, a dword at a time */
+static u_int64_t crd_db_hash(const char *buf, size_t size)
+{
+    u_int64_t hash = 0xcbf29ce484222325ULL;
+    u_int32_t word;
+    size_t i;
+
+    for (i = 0; i + sizeof(word) <= size; i += sizeof(word)) {
+        memcpy(&word, buf + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ (u_int8_t)buf[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int crd_db_csv_id(const char *csv_path, u_int64_t *csv_size, u_int64_t *csv_hash)
+{
+    size_t size = 0;
+    char *content = crd_db_read_file(csv_path, &size);
+
+    if (content == NULL) {
+        return -1;
+    }
+    *csv_size = size;
+    *csv_hash = crd_db_hash(content, size);
+    free(content);
+    return 0;
+}
+
+int crd_db_write(const char *db_path, const crd_parsed_csv_t *blocks, u_int32_t block_count,
+                 u_int64_t csv_size, u_int64_t csv_hash, char *err, size_t err_len)
+{
+    crd_db_hdr_t hdr;
+    crd_parsed_csv_t block;
+    u_int32_t i;
+    FILE *fd;
+    int ok;
+
+    fd = fopen(db_path, "wb");
+    if (fd == NULL) {
+        snprintf(err, err_len, "Failed to open '%s' for writing: %s", db_path, strerror(errno));
+        return CRD_OPEN_FILE_ERROR;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = __cpu_to_le32(CRD_DB_MAGIC);
+    hdr.version = __cpu_to_le32(CRD_DB_VERSION);
+    hdr.block_count = __cpu_to_le32(block_count);
+    hdr.csv_size = __cpu_to_le64(csv_size);
+    hdr.csv_hash = __cpu_to_le64(csv_hash);
+    ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1;
+    for (i = 0; ok && i < block_count; i++) {
+        block.addr = __cpu_to_le32(blocks[i].addr);
+        block.len = __cpu_to_le32(blocks[i].len);
+        block.enable_addr = __cpu_to_le32(blocks[i].enable_addr);
+        ok = fwrite(&block, sizeof(block), 1, fd) == 1;
+    }
+    if (fclose(fd) || !ok) {
+        snprintf(err, err_len, "Failed to write '%s'", db_path);
+        remove(db_path);
+        return CRD_OPEN_FILE_ERROR;
+    }
+    return CRD_OK;
+}
+
+void crd_db_bin_path(const char *csv_path, char *db_path, size_t len)
+{
+    size_t path_len = strlen(csv_path);
+
+    if (path_len > 4 && !strcmp(csv_path + path_len - 4, ".csv")) {
+        path_len -= 4;
+    }
+    snprintf(db_path, len, "%.*s%s", (int)path_len, csv_path, CRD_DB_SUFFIX);
+}
+
+#ifndef __WIN__
+/*
+ * Map the binary database, return 0 on success.
+ * It is used only if it matches the content of the CSV next to it (when
+ * there is one).
+ */
+static int crd_db_map(const char *csv_path, crd_db_t *db)
+{
+    char db_path[1024];
+    const crd_db_hdr_t *hdr;
+    struct stat st;
+    u_int64_t csv_size;
+    u_int64_t csv_hash;
+    u_int32_t count;
+    u_int32_t i;
+    int fd;
+
+    crd_db_bin_path(csv_path, db_path, sizeof(db_path));
+    fd = open(db_path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(crd_db_hdr_t)) {
+        close(fd);
+        return -1;
+    }
+    db->map_size = st.st_size;
+    db->map = mmap(NULL, db->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (db->map == MAP_FAILED) {
+        db->map = NULL;
+        return -1;
+    }
+    hdr = (const crd_db_hdr_t*)db->map;
+    count = __le32_to_cpu(hdr->block_count);
+    if (__le32_to_cpu(hdr->magic) != CRD_DB_MAGIC || __le32_to_cpu(hdr->version) != CRD_DB_VERSION ||
+        db->map_size != sizeof(crd_db_hdr_t) + (size_t)count * sizeof(crd_parsed_csv_t) ||
+        (!crd_db_csv_id(csv_path, &csv_size, &csv_hash) &&
+         (csv_size != __le64_to_cpu(hdr->csv_size) || csv_hash != __le64_to_cpu(hdr->csv_hash)))) {
+        goto map_failed;
+    }
+    db->block_count = count;
+    db->blocks = (crd_parsed_csv_t*)(hdr + 1);
+    if (__le32_to_cpu(CRD_DB_MAGIC) != CRD_DB_MAGIC) {
+        // big endian host, convert a copy
+        crd_parsed_csv_t *blocks = (crd_parsed_csv_t*)malloc(count * sizeof(crd_parsed_csv_t) + 1);
+        if (blocks == NULL) {
+            goto map_failed;
+        }
+        for (i = 0; i < count; i++) {
+            blocks[i].addr = __le32_to_cpu(db->blocks[i].addr);
+            blocks[i].len = __le32_to_cpu(db->blocks[i].len);
+            blocks[i].enable_addr = __le32_to_cpu(db->blocks[i].enable_addr);
+        }
+        munmap(db->map, db->map_size);
+        db->map = NULL;
+        db->blocks = blocks;
+        db->blocks_owned = 1;
+    }
+    return 0;
+
+map_failed:
+    munmap(db->map, db->map_size);
+    db->map = NULL;
+    db->blocks = NULL;
+    db->block_count = 0;
+    return -1;
+}
+#endif
+
+int crd_db_load(const char *csv_path, crd_db_t *db, char *err, size_t err_len)
+{
+    memset(db, 0, sizeof(*db));
+#ifndef __WIN__
+    if (!crd_db_map(csv_path, db)) {
+        return CRD_OK;
+    }
+#endif
+    db->blocks_owned = 1;
+    return crd_db_parse_csv(csv_path, &db->blocks, &db->block_count, err, err_len);
+}
+
+void crd_db_free(crd_db_t *db)
+{
+    if (db->blocks_owned) {
+        free(db->blocks);
+    }
+#ifndef __WIN__
+    if (db->map) {
+        munmap(db->map, db->map_size);
+    }
+#endif
+    memset(db, 0, sizeof(*db));
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_db.h - mstdump address databases.
+ *
+ * The CSV databases ("addr, dwords, enable addr" per line) are parsed into
+ * blocks sorted by address, where adjacent blocks with the same enable
+ * address are coalesced. The same blocks are compiled at build time into a
+ * binary database (<device>.crdb, little endian) that is mmapped at runtime
+ * instead of parsing the CSV.
+ */
+
+#ifndef _CRD_DB_H_
+#define _CRD_DB_H_
+
+#include <stddef.h>
+#include <compatibility.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRD_DB_MAGIC            0x42445243 /* "CRDB" */
+#define CRD_DB_VERSION          2
+#define CRD_DB_SUFFIX           ".crdb"
+
+/* enable_addr values that are not addresses */
+#define CRD_DB_NO_ENABLE        0xffffffff /* always dumped */
+#define CRD_DB_UNKNOWN_ENABLE   0xfffffffe /* dumped only in full mode */
+
+typedef struct crd_parsed_csv {
+    u_int32_t addr;
+    u_int32_t len; /* in dwords */
+    u_int32_t enable_addr;
+} crd_parsed_csv_t;
+
+typedef struct crd_db_hdr {
+    u_int32_t magic;
+    u_int32_t version;
+    u_int32_t block_count;
+    u_int32_t reserved;
+    u_int64_t csv_size; /* size of the source CSV */
+    u_int64_t csv_hash; /* hash of the source CSV content, a changed CSV makes the binary stale */
+} crd_db_hdr_t;
+
+typedef struct crd_db {
+    crd_parsed_csv_t *blocks;
+    u_int32_t block_count;
+    int blocks_owned; /* otherwise blocks point into map */
+    void *map;
+    size_t map_size;
+} crd_db_t;
+
+/*
+ * Parse a CSV database, *blocks is allocated (free by caller).
+ * Return CRD_* code, err is filled on failure.
+ */
+int crd_db_parse_csv(const char *csv_path, crd_parsed_csv_t **blocks, u_int32_t *block_count,
+                     char *err, size_t err_len);
+
+/*
+ * Size and content hash of a CSV database, as kept in the binary database.
+ * Return 0 on success.
+ */
+int crd_db_csv_id(const char *csv_path, u_int64_t *csv_size, u_int64_t *csv_hash);
+
+/*
+ * Write the binary database of blocks parsed from a CSV (see crd_db_csv_id).
+ */
+int crd_db_write(const char *db_path, const crd_parsed_csv_t *blocks, u_int32_t block_count,
+                 u_int64_t csv_size, u_int64_t csv_hash, char *err, size_t err_len);
+
+/*
+ * Load the blocks of csv_path: from the matching binary database if it is
+ * present and up to date, otherwise from the CSV.
+ */
+int crd_db_load(const char *csv_path, crd_db_t *db, char *err, size_t err_len);
+
+void crd_db_free(crd_db_t *db);
+
+/* csv_path with the .csv suffix replaced by CRD_DB_SUFFIX */
+void crd_db_bin_path(const char *csv_path, char *db_path, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CRD_DB_H_
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_dbgen - compile an mstdump CSV database into its binary form.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "crdump.h"
+#include "crd_db.h"
+
+int main(int argc, char *argv[])
+{
+    crd_parsed_csv_t *blocks = NULL;
+    u_int32_t block_count = 0;
+    char err[256] = {0};
+    u_int64_t csv_size;
+    u_int64_t csv_hash;
+    int rc;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <db.csv> <db" CRD_DB_SUFFIX ">\n", argv[0]);
+        return 1;
+    }
+    if (crd_db_csv_id(argv[1], &csv_size, &csv_hash)) {
+        fprintf(stderr, "-E- Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    rc = crd_db_parse_csv(argv[1], &blocks, &block_count, err, sizeof(err));
+    if (rc == CRD_OK) {
+        rc = crd_db_write(argv[2], blocks, block_count, csv_size, csv_hash, err, sizeof(err));
+    }
+    free(blocks);
+    if (rc != CRD_OK) {
+        fprintf(stderr, "-E- %s\n", err[0] ? err : "Memory allocation error");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_sample.c - mstdump sample files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "crdump.h"
+#include "crd_bin.h"
+#include "crd_sample.h"
+
+typedef struct crd_sample_key {
+    u_int64_t offset;
+    u_int32_t frames; /* the key frame and the deltas that follow it */
+} crd_sample_key_t;
+
+struct crd_sample_writer {
+    FILE *fd;
+    crd_sample_hdr_t hdr; /* host order */
+    u_int32_t *prev; /* previous sample */
+    u_int32_t *payload; /* little endian frame payload */
+    int has_prev;
+    u_int32_t seq;
+    u_int32_t since_key;
+    crd_sample_key_t *keys; /* key frames in the ring, oldest first, circular */
+    u_int32_t key_head;
+    u_int32_t key_count;
+    u_int32_t key_max;
+};
+
+struct crd_sample_reader {
+    FILE *fd;
+    crd_sample_hdr_t hdr; /* host order */
+    crd_dword_t *dwords;
+    u_int32_t *payload;
+    u_int64_t pos;
+    u_int32_t left;
+    int has_key;
+};
+
+/* converts between host and little endian order, both ways */
+static void crd_sample_hdr_swap(crd_sample_hdr_t *dst, const crd_sample_hdr_t *src)
+{
+    int i;
+
+    dst->magic = __cpu_to_le32(src->magic);
+    dst->version = __cpu_to_le16(src->version);
+    dst->flags = __cpu_to_le16(src->flags);
+    dst->dev_type = __cpu_to_le32(src->dev_type);
+    dst->hw_dev_id = __cpu_to_le32(src->hw_dev_id);
+    dst->hw_rev = __cpu_to_le32(src->hw_rev);
+    for (i = 0; i < 3; i++) {
+        dst->fw_ver[i] = __cpu_to_le32(src->fw_ver[i]);
+    }
+    dst->timestamp = __cpu_to_le64(src->timestamp);
+    dst->range_count = __cpu_to_le32(src->range_count);
+    dst->dword_count = __cpu_to_le32(src->dword_count);
+    dst->interval_ms = __cpu_to_le32(src->interval_ms);
+    dst->key_interval = __cpu_to_le32(src->key_interval);
+    dst->ring_offset = __cpu_to_le64(src->ring_offset);
+    dst->ring_size = __cpu_to_le64(src->ring_size);
+    dst->first = __cpu_to_le64(src->first);
+    dst->tail = __cpu_to_le64(src->tail);
+    dst->frame_count = __cpu_to_le32(src->frame_count);
+    dst->reserved = 0;
+}
+
+static int crd_sample_write_at(FILE *fd, u_int64_t offset, const void *data, size_t size)
+{
+    if (fseek(fd, (long)offset, SEEK_SET) || (size && fwrite(data, size, 1, fd) != 1)) {
+        return CRD_OPEN_FILE_ERROR;
+    }
+    return CRD_OK;
+}
+
+static int crd_sample_read_at(FILE *fd, u_int64_t offset, void *data, size_t size)
+{
+    if (fseek(fd, (long)offset, SEEK_SET) || (size && fread(data, size, 1, fd) != 1)) {
+        return CRD_CSV_BAD_FORMAT;
+    }
+    return CRD_OK;
+}
+
+static u_int64_t crd_sample_key_size(u_int32_t dword_count)
+{
+    return sizeof(crd_sample_frame_t) + (u_int64_t)dword_count * sizeof(u_int32_t);
+}
+
+int crd_sample_open(const char *path, const crd_bin_info_t *info, const crd_dword_t *dwords, u_int32_t count,
+                    u_int32_t interval_ms, u_int32_t key_interval, u_int64_t ring_size,
+                    crd_sample_writer_t **writer, char *err, size_t err_len)
+{
+    crd_sample_writer_t *w;
+    crd_sample_hdr_t hdr;
+    crd_bin_range_t *ranges = NULL;
+    u_int32_t range_count = crd_bin_get_ranges(dwords, count, NULL);
+    u_int64_t key_size = crd_sample_key_size(count);
+    int i;
+
+    if (ring_size < 2 * key_size) {
+        snprintf(err, err_len, "The sample ring must hold at least two full samples (%llu bytes)",
+                 (unsigned long long)(2 * key_size));
+        return CRD_INVALID_PARM;
+    }
+    w = (crd_sample_writer_t*)calloc(1, sizeof(*w));
+    if (w == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the sample file");
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    w->key_max = (u_int32_t)(ring_size / key_size) + 2;
+    w->prev = (u_int32_t*)malloc(sizeof(u_int32_t) * (count + 1));
+    w->payload = (u_int32_t*)malloc(sizeof(u_int32_t) * (count + 1));
+    w->keys = (crd_sample_key_t*)malloc(sizeof(crd_sample_key_t) * w->key_max);
+    ranges = (crd_bin_range_t*)malloc(sizeof(crd_bin_range_t) * (range_count + 1));
+    if (w->prev == NULL || w->payload == NULL || w->keys == NULL || ranges == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the sample file");
+        free(ranges);
+        crd_sample_close(w);
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    crd_bin_get_ranges(dwords, count, ranges);
+
+    w->hdr.magic = CRD_SAMPLE_MAGIC;
+    w->hdr.version = CRD_SAMPLE_VERSION;
+    w->hdr.flags = info->flags;
+    w->hdr.dev_type = info->dev_type;
+    w->hdr.hw_dev_id = info->hw_dev_id;
+    w->hdr.hw_rev = info->hw_rev;
+    for (i = 0; i < 3; i++) {
+        w->hdr.fw_ver[i] = info->fw_ver[i];
+    }
+    w->hdr.timestamp = info->timestamp;
+    w->hdr.range_count = range_count;
+    w->hdr.dword_count = count;
+    w->hdr.interval_ms = interval_ms;
+    w->hdr.key_interval = key_interval;
+    w->hdr.ring_offset = sizeof(crd_sample_hdr_t) + (u_int64_t)range_count * sizeof(crd_bin_range_t);
+    w->hdr.ring_size = ring_size;
+
+    w->fd = fopen(path, "wb+");
+    if (w->fd == NULL) {
+        snprintf(err, err_len, "Failed to open %s: %s", path, strerror(errno));
+        free(ranges);
+        crd_sample_close(w);
+        return CRD_OPEN_FILE_ERROR;
+    }
+    crd_sample_hdr_swap(&hdr, &w->hdr);
+    if (fwrite(&hdr, sizeof(hdr), 1, w->fd) != 1 ||
+        (range_count && fwrite(ranges, sizeof(crd_bin_range_t) * range_count, 1, w->fd) != 1) || fflush(w->fd)) {
+        snprintf(err, err_len, "Failed to write %s: %s", path, strerror(errno));
+        free(ranges);
+        crd_sample_close(w);
+        return CRD_OPEN_FILE_ERROR;
+    }
+    free(ranges);
+    *writer = w;
+    return CRD_OK;
+}
+
+/*
+   Find where a frame of size bytes goes and how many of the oldest key
+   frames (with their deltas) it overwrites. A frame that does not fit
+   before the end of the ring goes to its start, the key frames between the
+   tail and the end are then dropped as well.
+ */
+static u_int32_t crd_sample_place(crd_sample_writer_t *w, u_int64_t size, u_int64_t *pos, int *wrap)
+{
+    u_int32_t drop = 0;
+    u_int64_t offset;
+
+    *pos = w->hdr.tail;
+    *wrap = *pos + size > w->hdr.ring_size;
+    if (*wrap) {
+        *pos = 0;
+    }
+    while (drop < w->key_count) {
+        offset = w->keys[(w->key_head + drop) % w->key_max].offset;
+        if ((*wrap && offset >= w->hdr.tail) || (offset >= *pos && offset < *pos + size)) {
+            drop++;
+        } else {
+            break;
+        }
+    }
+    return drop;
+}
+
+int crd_sample_write(crd_sample_writer_t *w, const crd_dword_t *dwords, u_int64_t timestamp_us,
+                     u_int32_t *changed, char *err, size_t err_len)
+{
+    crd_sample_frame_t frame;
+    crd_sample_hdr_t hdr;
+    crd_sample_key_t *key;
+    u_int32_t count = w->hdr.dword_count;
+    u_int32_t diff = 0;
+    u_int32_t pairs = 0;
+    u_int32_t drop;
+    u_int32_t i;
+    u_int64_t size;
+    u_int64_t pos;
+    int is_key;
+    int wrap;
+    int rc;
+
+    for (i = 0; i < count; i++) {
+        if (!w->has_prev || w->prev[i] != dwords[i].data) {
+            diff++;
+        }
+    }
+    /* a delta frame is kept only while it is smaller than a key frame */
+    is_key = !w->has_prev || w->since_key + 1 >= w->hdr.key_interval || diff * 2 >= count;
+    size = is_key ? crd_sample_key_size(count) : sizeof(frame) + (u_int64_t)diff * 2 * sizeof(u_int32_t);
+    drop = crd_sample_place(w, size, &pos, &wrap);
+    if (!is_key && drop == w->key_count) {
+        /* the delta would overwrite the key frame it depends on */
+        is_key = 1;
+        size = crd_sample_key_size(count);
+        drop = crd_sample_place(w, size, &pos, &wrap);
+    }
+
+    if (is_key) {
+        for (i = 0; i < count; i++) {
+            w->payload[i] = __cpu_to_le32(dwords[i].data);
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            if (w->prev[i] != dwords[i].data) {
+                w->payload[pairs * 2] = __cpu_to_le32(i);
+                w->payload[pairs * 2 + 1] = __cpu_to_le32(dwords[i].data);
+                pairs++;
+            }
+        }
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = __cpu_to_le32(CRD_SAMPLE_FRAME_MAGIC);
+    if (wrap && w->hdr.ring_size - w->hdr.tail >= sizeof(frame)) {
+        frame.type = __cpu_to_le16(CRD_SAMPLE_WRAP);
+        rc = crd_sample_write_at(w->fd, w->hdr.ring_offset + w->hdr.tail, &frame, sizeof(frame));
+        if (rc) {
+            goto write_err;
+        }
+    }
+    frame.type = __cpu_to_le16(is_key ? CRD_SAMPLE_KEY : CRD_SAMPLE_DELTA);
+    frame.seq = __cpu_to_le32(w->seq);
+    frame.count = __cpu_to_le32(is_key ? count : pairs);
+    frame.timestamp_us = __cpu_to_le64(timestamp_us);
+    rc = crd_sample_write_at(w->fd, w->hdr.ring_offset + pos, &frame, sizeof(frame));
+    if (!rc) {
+        rc = crd_sample_write_at(w->fd, w->hdr.ring_offset + pos + sizeof(frame), w->payload, size - sizeof(frame));
+    }
+    if (rc) {
+        goto write_err;
+    }
+
+    for (i = 0; i < drop; i++) {
+        w->hdr.frame_count -= w->keys[w->key_head].frames;
+        w->key_head = (w->key_head + 1) % w->key_max;
+        w->key_count--;
+    }
+    if (is_key) {
+        key = &w->keys[(w->key_head + w->key_count) % w->key_max];
+        key->offset = pos;
+        key->frames = 0;
+        w->key_count++;
+        w->since_key = 0;
+    } else {
+        w->since_key++;
+    }
+    w->keys[(w->key_head + w->key_count - 1) % w->key_max].frames++;
+    w->hdr.frame_count++;
+    w->hdr.first = w->keys[w->key_head].offset;
+    w->hdr.tail = pos + size;
+
+    crd_sample_hdr_swap(&hdr, &w->hdr);
+    rc = crd_sample_write_at(w->fd, 0, &hdr, sizeof(hdr));
+    if (rc || fflush(w->fd)) {
+        goto write_err;
+    }
+    for (i = 0; i < count; i++) {
+        w->prev[i] = dwords[i].data;
+    }
+    w->has_prev = 1;
+    w->seq++;
+    if (changed) {
+        *changed = diff;
+    }
+    return CRD_OK;
+
+write_err:
+    snprintf(err, err_len, "Failed to write the sample file: %s", strerror(errno));
+    return CRD_OPEN_FILE_ERROR;
+}
+
+int crd_sample_close(crd_sample_writer_t *w)
+{
+    int rc = CRD_OK;
+
+    if (w == NULL) {
+        return CRD_OK;
+    }
+    if (w->fd && fclose(w->fd)) {
+        rc = CRD_OPEN_FILE_ERROR;
+    }
+    free(w->prev);
+    free(w->payload);
+    free(w->keys);
+    free(w);
+    return rc;
+}
+
+int crd_sample_reader_open(FILE *fd, crd_bin_info_t *info, crd_sample_reader_t **reader,
+                           char *err, size_t err_len)
+{
+    crd_sample_reader_t *r;
+    crd_sample_hdr_t hdr;
+    crd_bin_range_t *ranges;
+    int i;
+
+    if (crd_sample_read_at(fd, 0, &hdr, sizeof(hdr)) || __le32_to_cpu(hdr.magic) != CRD_SAMPLE_MAGIC) {
+        snprintf(err, err_len, "Not a sample file");
+        return CRD_CSV_BAD_FORMAT;
+    }
+    if (__le16_to_cpu(hdr.version) != CRD_SAMPLE_VERSION) {
+        snprintf(err, err_len, "Unsupported sample file version %d", __le16_to_cpu(hdr.version));
+        return CRD_NOT_SUPPORTED;
+    }
+    r = (crd_sample_reader_t*)calloc(1, sizeof(*r));
+    if (r == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the sample file");
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    crd_sample_hdr_swap(&r->hdr, &hdr);
+    if (r->hdr.ring_offset != sizeof(hdr) + (u_int64_t)r->hdr.range_count * sizeof(crd_bin_range_t) ||
+        r->hdr.first >= r->hdr.ring_size || r->hdr.tail > r->hdr.ring_size) {
+        snprintf(err, err_len, "Corrupted sample file header");
+        free(r);
+        return CRD_CSV_BAD_FORMAT;
+    }
+    r->dwords = (crd_dword_t*)malloc(sizeof(crd_dword_t) * ((size_t)r->hdr.dword_count + 1));
+    r->payload = (u_int32_t*)malloc(sizeof(u_int32_t) * ((size_t)r->hdr.dword_count + 1));
+    ranges = (crd_bin_range_t*)malloc(sizeof(crd_bin_range_t) * ((size_t)r->hdr.range_count + 1));
+    if (r->dwords == NULL || r->payload == NULL || ranges == NULL) {
+        snprintf(err, err_len, "Failed to allocate memory for the sample file");
+        free(ranges);
+        crd_sample_reader_close(r);
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    if (crd_sample_read_at(fd, sizeof(hdr), ranges, sizeof(crd_bin_range_t) * r->hdr.range_count) ||
+        crd_bin_set_addrs(ranges, r->hdr.range_count, r->dwords, r->hdr.dword_count)) {
+        snprintf(err, err_len, "Corrupted sample file address table");
+        free(ranges);
+        crd_sample_reader_close(r);
+        return CRD_CSV_BAD_FORMAT;
+    }
+    free(ranges);
+
+    info->flags = r->hdr.flags;
+    info->dev_type = r->hdr.dev_type;
+    info->hw_dev_id = r->hdr.hw_dev_id;
+    info->hw_rev = r->hdr.hw_rev;
+    for (i = 0; i < 3; i++) {
+        info->fw_ver[i] = r->hdr.fw_ver[i];
+    }
+    info->timestamp = r->hdr.timestamp;
+    r->fd = fd;
+    r->pos = r->hdr.first;
+    r->left = r->hdr.frame_count;
+    *reader = r;
+    return CRD_OK;
+}
+
+int crd_sample_next(crd_sample_reader_t *r, crd_sample_t *sample, int *end, char *err, size_t err_len)
+{
+    crd_sample_frame_t frame;
+    u_int32_t count = r->hdr.dword_count;
+    u_int32_t frame_count;
+    u_int32_t index;
+    u_int32_t i;
+    u_int16_t type = CRD_SAMPLE_WRAP;
+    int wraps = 0;
+
+    *end = !r->left;
+    if (*end) {
+        return CRD_OK;
+    }
+    while (type == CRD_SAMPLE_WRAP) {
+        if (r->hdr.ring_size - r->pos < sizeof(frame)) {
+            r->pos = 0;
+        }
+        if (crd_sample_read_at(r->fd, r->hdr.ring_offset + r->pos, &frame, sizeof(frame)) ||
+            __le32_to_cpu(frame.magic) != CRD_SAMPLE_FRAME_MAGIC) {
+            snprintf(err, err_len, "Corrupted sample frame at ring offset 0x%llx", (unsigned long long)r->pos);
+            return CRD_CSV_BAD_FORMAT;
+        }
+        type = __le16_to_cpu(frame.type);
+        if (type == CRD_SAMPLE_WRAP) {
+            if (wraps++) {
+                snprintf(err, err_len, "Corrupted sample frame at ring offset 0x%llx", (unsigned long long)r->pos);
+                return CRD_CSV_BAD_FORMAT;
+            }
+            r->pos = 0;
+        }
+    }
+
+    frame_count = __le32_to_cpu(frame.count);
+    if ((type == CRD_SAMPLE_KEY && frame_count != count) ||
+        (type == CRD_SAMPLE_DELTA && (!r->has_key || (u_int64_t)frame_count * 2 > count)) ||
+        (type != CRD_SAMPLE_KEY && type != CRD_SAMPLE_DELTA)) {
+        snprintf(err, err_len, "Corrupted sample frame at ring offset 0x%llx", (unsigned long long)r->pos);
+        return CRD_CSV_BAD_FORMAT;
+    }
+    if (crd_sample_read_at(r->fd, r->hdr.ring_offset + r->pos + sizeof(frame), r->payload,
+                           sizeof(u_int32_t) * (type == CRD_SAMPLE_KEY ? count : frame_count * 2))) {
+        snprintf(err, err_len, "Truncated sample file");
+        return CRD_CSV_BAD_FORMAT;
+    }
+    if (type == CRD_SAMPLE_KEY) {
+        sample->changed = 0;
+        for (i = 0; i < count; i++) {
+            u_int32_t data = __le32_to_cpu(r->payload[i]);
+            sample->changed += r->has_key && r->dwords[i].data != data;
+            r->dwords[i].data = data;
+        }
+        if (!r->has_key) {
+            sample->changed = count;
+        }
+        r->has_key = 1;
+    } else {
+        for (i = 0; i < frame_count; i++) {
+            index = __le32_to_cpu(r->payload[i * 2]);
+            if (index >= count) {
+                snprintf(err, err_len, "Corrupted sample frame at ring offset 0x%llx", (unsigned long long)r->pos);
+                return CRD_CSV_BAD_FORMAT;
+            }
+            r->dwords[index].data = __le32_to_cpu(r->payload[i * 2 + 1]);
+        }
+        sample->changed = frame_count;
+    }
+    r->pos += sizeof(frame) + sizeof(u_int32_t) * (type == CRD_SAMPLE_KEY ? count : frame_count * 2);
+    r->left--;
+
+    sample->seq = __le32_to_cpu(frame.seq);
+    sample->type = type;
+    sample->timestamp_us = __le64_to_cpu(frame.timestamp_us);
+    sample->count = count;
+    sample->dwords = r->dwords;
+    return CRD_OK;
+}
+
+void crd_sample_reader_close(crd_sample_reader_t *r)
+{
+    if (r == NULL) {
+        return;
+    }
+    if (r->fd) {
+        fclose(r->fd);
+    }
+    free(r->dwords);
+    free(r->payload);
+    free(r);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * crd_sample.h - mstdump sample files.
+ *
+ * A sample file holds periodic dumps of the same addresses. After the header
+ * and the address table (crd_bin_range_t, as in binary dumps) comes a ring
+ * of frames. A key frame holds all the dumped data, a delta frame holds the
+ * {index, data} pairs that changed since the previous sample. Once the ring
+ * is full the oldest key frame and its deltas are overwritten. All fields
+ * are little endian.
+ */
+
+#ifndef _CRD_SAMPLE_H_
+#define _CRD_SAMPLE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <common/compatibility.h>
+#include "crdump.h"
+#include "crd_bin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRD_SAMPLE_MAGIC        0x53445243 /* "CRDS" */
+#define CRD_SAMPLE_VERSION      1
+#define CRD_SAMPLE_FRAME_MAGIC  0x4d415246 /* "FRAM" */
+
+enum crd_sample_frame_type {
+    CRD_SAMPLE_KEY = 1,
+    CRD_SAMPLE_DELTA,
+    CRD_SAMPLE_WRAP /* the next frame is at the start of the ring */
+};
+
+typedef struct crd_sample_hdr {
+    u_int32_t magic;
+    u_int16_t version;
+    u_int16_t flags; /* CRD_BIN_FLAG_* */
+    u_int32_t dev_type;
+    u_int32_t hw_dev_id;
+    u_int32_t hw_rev;
+    u_int32_t fw_ver[3];
+    u_int64_t timestamp; /* seconds since the epoch at start */
+    u_int32_t range_count;
+    u_int32_t dword_count;
+    u_int32_t interval_ms;
+    u_int32_t key_interval; /* a key frame every key_interval samples */
+    u_int64_t ring_offset; /* file offset of the ring */
+    u_int64_t ring_size;
+    u_int64_t first; /* ring offset of the oldest key frame */
+    u_int64_t tail; /* ring offset after the newest frame */
+    u_int32_t frame_count; /* frames from first to tail */
+    u_int32_t reserved;
+} crd_sample_hdr_t;
+
+typedef struct crd_sample_frame {
+    u_int32_t magic;
+    u_int16_t type;
+    u_int16_t reserved;
+    u_int32_t seq;
+    u_int32_t count; /* data dwords of a key frame, {index, data} pairs of a delta frame */
+    u_int64_t timestamp_us; /* microseconds since the epoch */
+} crd_sample_frame_t;
+
+typedef struct crd_sample {
+    u_int32_t seq;
+    u_int16_t type;
+    u_int32_t changed; /* dwords changed since the previous sample */
+    u_int64_t timestamp_us;
+    u_int32_t count;
+    const crd_dword_t *dwords; /* the snapshot, valid until the next call */
+} crd_sample_t;
+
+typedef struct crd_sample_writer crd_sample_writer_t;
+typedef struct crd_sample_reader crd_sample_reader_t;
+
+/*
+ * Create a sample file of the count dwords (as returned by crd_dump_data)
+ * with a ring of ring_size bytes. The dwords are not written as a sample.
+ */
+int crd_sample_open(const char *path, const crd_bin_info_t *info, const crd_dword_t *dwords, u_int32_t count,
+                    u_int32_t interval_ms, u_int32_t key_interval, u_int64_t ring_size,
+                    crd_sample_writer_t **writer, char *err, size_t err_len);
+
+/*
+ * Append a sample of the same addresses given to crd_sample_open.
+ * *changed is set to the number of dwords changed since the previous sample.
+ */
+int crd_sample_write(crd_sample_writer_t *writer, const crd_dword_t *dwords, u_int64_t timestamp_us,
+                     u_int32_t *changed, char *err, size_t err_len);
+
+int crd_sample_close(crd_sample_writer_t *writer);
+
+/*
+ * Open a sample file for reading, on success fd is closed by crd_sample_reader_close.
+ */
+int crd_sample_reader_open(FILE *fd, crd_bin_info_t *info, crd_sample_reader_t **reader,
+                           char *err, size_t err_len);
+
+/*
+ * Reconstruct the next sample, *end is set when there are no more samples.
+ */
+int crd_sample_next(crd_sample_reader_t *reader, crd_sample_t *sample, int *end, char *err, size_t err_len);
+
+void crd_sample_reader_close(crd_sample_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CRD_SAMPLE_H_
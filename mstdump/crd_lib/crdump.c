@@ -36,11 +36,13 @@
 
 #define _GNU_SOURCE
 #include <crdump.h>
+#include "crd_db.h"
 #include <dev_mgt/tools_dev_types.h>
 #include <common/bit_slice.h>
 #include <ctype.h>
 #include <compatibility.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 #define CRD_SELECT_CSV_PATH(dev_name) \
     do {                              \
@@ -70,21 +72,26 @@
 #    define CRD_DEBUG(fmt, ...)
 #endif
 
-#define CRD_EMPTY  "EMPTY"
-#define CRD_UNKOWN "UNKNOWN"
-
 #define CRD_MAXLINESIZE 1024
-#define CRD_MAXFLDS 3 /* maximum possible number of fields */
-#define CRD_MAXFLDSIZE 32 /* longest possible field + 1 = 31 byte field */
 #define CRD_CSV_PATH_SIZE 1024
+#define CRD_ERROR_SIZE 256
+#define CRD_MAX_TRANSFER_DWORDS 0x4000 /* 64KB, the largest block in the databases */
 
-typedef struct crd_parsed_csv {
-
+/*
+   Read plan: transfers are the mread4_block calls, segments are the dumped
+   ranges (in block order) that each transfer serves.
+ */
+typedef struct crd_segment {
     u_int32_t addr;
     u_int32_t len;
-    char enable_addr[100];
+} crd_segment_t;
 
-} crd_parsed_csv_t;
+typedef struct crd_transfer {
+    u_int32_t addr;
+    u_int32_t len;
+    u_int32_t first_seg;
+    u_int32_t num_segs;
+} crd_transfer_t;
 
 
 struct crd_ctxt {
@@ -97,9 +104,37 @@ struct crd_ctxt {
     char csv_path[CRD_CSV_PATH_SIZE];
     u_int32_t block_count;
     crd_parsed_csv_t *blocks;
+    crd_db_t db;
+    u_int32_t max_gap;
+    crd_segment_t *segments;
+    u_int32_t seg_count;
+    crd_transfer_t *transfers;
+    u_int32_t transfer_count;
+    u_int32_t *buf;
+    u_int32_t cause_first; /* first address of the read found raising the cause bit */
+    char error[CRD_ERROR_SIZE];
 };
 
-static char crd_error[256];
+#if defined(_MSC_VER)
+#    define CRD_THREAD_LOCAL __declspec(thread)
+#else
+#    define CRD_THREAD_LOCAL __thread
+#endif
+
+/* last error of the calling thread, contexts keep their own copy */
+static CRD_THREAD_LOCAL char crd_error[CRD_ERROR_SIZE];
+
+static void crd_set_error(IN crd_ctxt_t *context, IN const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(crd_error, sizeof(crd_error), fmt, args);
+    va_end(args);
+    if (context) {
+        strcpy(context->error, crd_error);
+    }
+}
 
 /*
    Store the csv file path at csv_file_path.
@@ -107,32 +142,39 @@ static char crd_error[256];
 static int crd_get_csv_path(IN dm_dev_id_t dev_type, OUT char *csv_file_path, IN const char *db_path);
 
 /*
-   count number of dwords, and store all needed data from csv file at parsed_csv
+   count number of dwords of the blocks that are dumped
  */
-static int crd_count_double_word(IN char *csv_file_path, OUT u_int32_t *number_of_dwords,
-                                 OUT crd_parsed_csv_t blocks[], IN int is_full,
-                                 IN u_int8_t read_single_dword);
+static u_int32_t crd_count_double_word(IN crd_parsed_csv_t blocks[], IN u_int32_t block_count, IN int is_full);
 
 /*
-   Fill addresses at dword_arr
+   Compute the read plan of the dumped blocks
  */
-static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr);
+static int crd_build_plan(IN crd_ctxt_t *context);
+
+static void crd_free_plan(IN crd_ctxt_t *context);
+
+/*
+   Read the cause bit, set *is_set accordingly
+ */
+static int crd_read_cause(IN crd_ctxt_t *context, OUT int *is_set);
 
 /*
-   Read a line from csv file
+   Clear the cause bit, set *is_cleared if it reads back as clear
  */
-static int crd_read_line(IN FILE *fd, OUT char *tmp);
+static int crd_clear_cause(IN crd_ctxt_t *context, OUT int *is_cleared);
 
 /*
-   Tokenize line for address, len, and enable_adder
+   Bisect [addr, addr + len dwords) for the read that raises the cause bit
  */
+static int crd_find_cause(IN crd_ctxt_t *context, IN u_int32_t addr, IN u_int32_t len);
 
-static void crd_parse(IN char *record, IN char *delim, OUT char arr[][CRD_MAXFLDSIZE], OUT int *field_count);
+/*
+   Fill addresses at dword_arr
+ */
+static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr);
 
 static int crd_update_csv_path(IN OUT char *csv_file_path, IN const char *db_path);
 
-static int crd_count_blocks(IN char *csv_file_path, OUT u_int32_t *block_count, u_int8_t read_single_dword);
-
 #if !defined(__WIN__) && !defined(MST_UL)
 static char* crd_trim(char *s);
 
@@ -155,8 +197,6 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
     u_int32_t dev_id = 0;
     u_int32_t chip_rev = 0;
     u_int32_t number_of_dwords = 0;
-    u_int32_t block_count = 0;
-    u_int8_t read_single_dword = 0;
     char csv_file_path [CRD_CSV_PATH_SIZE] = {0x0};
 
 
@@ -164,15 +204,13 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
 
     CRD_CHECK_NULL(mf);
     CRD_CHECK_NULL(context);
+    *context = NULL;
 
     if (cause_addr >= 0 && cause_off < 0) {
         CRD_DEBUG("cause_off is negative : %d ", cause_off);
         return CRD_INVALID_PARM;
     }
 
-    if (cause_addr >= 0 && cause_off >= 0) {
-        read_single_dword = 1;
-    }
     CRD_DEBUG("getting device id\n");
     if (dm_get_device_id(mf, &dev_type, &dev_id, &chip_rev)) {
         CRD_DEBUG("Failed to identify device.");
@@ -191,26 +229,19 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
         CRD_DEBUG("Failed to allocate memmory for context \n");
         return CRD_MEM_ALLOCATION_ERR;
     }
+    memset(*context, 0, sizeof(crd_ctxt_t));
 
-    rc = crd_count_blocks(csv_file_path, &block_count, read_single_dword);
-    if (rc) {
-        free(*context);
-        return rc;
-    }
-
-    CRD_DEBUG("Block count : %d\n", block_count);
-    (*context)->blocks = (crd_parsed_csv_t*) malloc(sizeof(crd_parsed_csv_t) * block_count);
-    if ((*context)->blocks == NULL) {
-        CRD_DEBUG("Failed to allocate memmory for csv blocks\n");
-        free(*context);
-        return CRD_MEM_ALLOCATION_ERR;
-    }
-
-
-    rc = crd_count_double_word(csv_file_path, &number_of_dwords, (*context)->blocks, is_full, read_single_dword);
+    // the compiled database is used when available, the csv otherwise
+    rc = crd_db_load(csv_file_path, &(*context)->db, (*context)->error, sizeof((*context)->error));
     if (rc) {
+        crd_set_error(*context, "%s", (*context)->error);
         goto Cleanup;
     }
+    (*context)->blocks      = (*context)->db.blocks;
+    (*context)->block_count = (*context)->db.block_count;
+    CRD_DEBUG("Block count : %d\n", (*context)->block_count);
+
+    number_of_dwords = crd_count_double_word((*context)->blocks, (*context)->block_count, is_full);
 
     mset_addr_space(mf, AS_ND_CRSPACE);
 
@@ -219,14 +250,19 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
     (*context)->dev_type         = dev_type;
     (*context)->number_of_dwords = number_of_dwords;
     (*context)->is_full          = is_full;
-    (*context)->block_count      = block_count;
     (*context)->cause_addr       = cause_addr;
     (*context)->cause_off        = cause_off;
     strcpy((*context)->csv_path, csv_file_path);
+
+    rc = crd_build_plan(*context);
+    if (rc) {
+        goto Cleanup;
+    }
     return rc;
 
 Cleanup:
     crd_free(*context);
+    *context = NULL;
     return rc;
 }
 
@@ -247,16 +283,27 @@ int crd_get_addr_list(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
     return CRD_OK;
 }
 
+int crd_set_max_gap(IN crd_ctxt_t *context, IN u_int32_t max_gap)
+{
+    CRD_CHECK_NULL(context);
+    context->max_gap = max_gap;
+    return crd_build_plan(context);
+}
+
 int crd_dump_data(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr, IN crd_callback_t func)
 {
     u_int32_t i = 0;
     u_int32_t j = 0;
+    u_int32_t k = 0;
     u_int32_t rc;
     u_int32_t addr;
-    u_int32_t cause_reg = 0;
+    u_int32_t end;
+    int cause_set = 0;
+    u_int32_t *data;
+    crd_transfer_t *transfer;
+    crd_segment_t *seg;
 
     int total = 0;
-    char *data;
     crd_dword_t tmp_dword;
 
     CRD_CHECK_NULL(context);
@@ -266,60 +313,58 @@ int crd_dump_data(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr, IN crd_cal
         return CRD_INVALID_PARM;
     }
 
-    for (i = 0; i < context->block_count; i++) {
-        if (!context->is_full && strcmp(context->blocks[i].enable_addr, CRD_EMPTY)) {
-            continue;
-        }
-
-        data = (char*) malloc(context->blocks[i].len * sizeof(u_int32_t));
-        if (data == NULL) {
-            return CRD_MEM_ALLOCATION_ERR;
-        }
-        memset(data, 0, context->blocks[i].len * sizeof(u_int32_t));
-
-        rc = mread4_block(context->mf, context->blocks[i].addr, (u_int32_t*)data, context->blocks[i].len * sizeof(u_int32_t));
-        if (context->blocks[i].len * sizeof(u_int32_t) != rc) {
-            sprintf(crd_error, "Cr read (0x%08x) failed: %s(%d)", context->blocks[i].addr, strerror(errno), (u_int32_t)errno);
-            free(data);
+    for (i = 0; i < context->transfer_count; i++) {
+        transfer = &context->transfers[i];
+        rc = mread4_block(context->mf, transfer->addr, context->buf, transfer->len * sizeof(u_int32_t));
+        if (transfer->len * sizeof(u_int32_t) != rc) {
+            crd_set_error(context, "Cr read (0x%08x) failed: %s(%d)", transfer->addr, strerror(errno), (u_int32_t)errno);
             return CRD_CR_READ_ERR;
         }
 
-        for (j = 0; j < context->blocks[i].len; j++) {
-            if ((u_int32_t)total >= context->number_of_dwords) { // dummy check tadah!
-                CRD_DEBUG("value exceeded, something wrong in calculation!");
-                free(data);
-                return CRD_EXCEED_VALUE;
+        /* check the cause bit once per transfer, bisect it only when raised */
+        end = transfer->addr + transfer->len * sizeof(u_int32_t);
+        if (context->cause_addr >= 0) {
+            rc = crd_read_cause(context, &cause_set);
+            if (rc) {
+                return rc;
             }
-            addr =  context->blocks[i].addr + (j * sizeof(u_int32_t));
-
-            if (context->cause_addr >= 0) {  /* if we want to check cause bit - read it and verify it hasn't been raised */
-                if (mread4(context->mf, context->cause_addr, &cause_reg) != sizeof(u_int32_t)) {
-                    CRD_DEBUG("Cr read (0x%08x) failed: %s(%d)\n", context->cause_addr, strerror(errno), (u_int32_t)errno);
-                    sprintf(crd_error, "Cr read (0x%08x) failed: %s(%d)", context->cause_addr, strerror(errno), (u_int32_t)errno);
-                    free(data);
-                    return CRD_CR_READ_ERR;
+            if (cause_set) {
+                rc = crd_find_cause(context, transfer->addr, transfer->len);
+                if (rc != CRD_CAUSE_BIT) {
+                    return rc;
                 }
-                cause_reg = EXTRACT(cause_reg, context->cause_off, 1);
-                if (cause_reg) {
-                    CRD_DEBUG("Cause bit set by read from address 0x%x\n", addr);
-                    sprintf(crd_error, "Cause bit set by read from address 0x%x", addr);
-                    free(data);
+                end = context->cause_first;
+            }
+        }
+
+        for (k = 0; k < transfer->num_segs; k++) {
+            seg = &context->segments[transfer->first_seg + k];
+            data = context->buf + (seg->addr - transfer->addr) / sizeof(u_int32_t);
+            for (j = 0; j < seg->len; j++) {
+                if ((u_int32_t)total >= context->number_of_dwords) { // dummy check tadah!
+                    CRD_DEBUG("value exceeded, something wrong in calculation!");
+                    return CRD_EXCEED_VALUE;
+                }
+                addr = seg->addr + (j * sizeof(u_int32_t));
+                if (addr >= end) {  /* dwords from the offending read on are not reported */
                     return CRD_CAUSE_BIT;
                 }
-            }
 
-            if (dword_arr != NULL) {
-                dword_arr[total].addr = addr;
-                dword_arr[total].data = ((u_int32_t*)data)[j];
-            }
-            if (func != NULL) {
-                tmp_dword.addr = addr;
-                tmp_dword.data = ((u_int32_t*)data)[j];
-                func(&tmp_dword);
+                if (dword_arr != NULL) {
+                    dword_arr[total].addr = addr;
+                    dword_arr[total].data = data[j];
+                }
+                if (func != NULL) {
+                    tmp_dword.addr = addr;
+                    tmp_dword.data = data[j];
+                    func(&tmp_dword);
+                }
+                total += 1;
             }
-            total += 1;
         }
-        free(data);
+        if (cause_set) {
+            return CRD_CAUSE_BIT;
+        }
     }
     return CRD_OK;
 }
@@ -354,130 +399,216 @@ static int crd_get_csv_path(IN dm_dev_id_t dev_type, OUT char *csv_file_path, IN
     return CRD_OK;
 }
 
-static void crd_parse(IN char *record, IN char *delim, OUT char arr[][CRD_MAXFLDSIZE],
-                      OUT int *field_count)
+static u_int32_t crd_count_double_word(IN crd_parsed_csv_t blocks[], IN u_int32_t block_count, IN int is_full)
 {
+    u_int32_t number_of_dwords = 0;
+    u_int32_t i;
 
-    char *p = strtok(record, delim);
-    int field = 0;
-    strcpy(arr[0], "\0");
-    strcpy(arr[1], "\0");
-    strcpy(arr[2], "\0");
-    while (p) {
-        strcpy(arr[field], p);
-        field++;
-        p = strtok(NULL, delim);
-    }
-    *field_count = field;
+    for (i = 0; i < block_count; i++) {
+        if (is_full || blocks[i].enable_addr == CRD_DB_NO_ENABLE) {
+            number_of_dwords += blocks[i].len;
+        }
+    }
+    return number_of_dwords;
 }
 
-static int crd_count_blocks(IN char *csv_file_path,
-                            OUT u_int32_t *block_count, u_int8_t read_single_dword)
+static void crd_free_plan(IN crd_ctxt_t *context)
 {
+    free(context->segments);
+    free(context->transfers);
+    free(context->buf);
+    context->segments       = NULL;
+    context->transfers      = NULL;
+    context->buf            = NULL;
+    context->seg_count      = 0;
+    context->transfer_count = 0;
+}
 
-    char tmp[1024] = {0x0};
-    char arr[CRD_MAXFLDS][CRD_MAXFLDSIZE];
-    int field_count = 0;
-    *block_count = 0;
-
-    CRD_DEBUG("CSV file path : %s\n", csv_file_path);
-    FILE *fd = fopen(csv_file_path, "r");
-    if (fd == NULL) {
-        CRD_DEBUG("Failed to open csv file : '%s'\n", csv_file_path);
-        sprintf(crd_error, "Failed to open csv file : '%s'", csv_file_path);
-        return CRD_OPEN_FILE_ERROR;
+/*
+   Dumped blocks are split to segments of at most CRD_MAX_TRANSFER_DWORDS,
+   consecutive segments are read by one transfer while it stays within
+   CRD_MAX_TRANSFER_DWORDS. A gap of up to max_gap dwords between two dumped
+   blocks is read and dropped, unless a skipped block (one that needs an
+   enable address) lies in it.
+ */
+static int crd_build_plan(IN crd_ctxt_t *context)
+{
+    u_int32_t max_transfer = CRD_MAX_TRANSFER_DWORDS;
+    u_int32_t max_len = 0;
+    u_int32_t count = 0;
+    u_int32_t i;
+    u_int32_t off;
+    int prev_dumped = 0;
+    crd_transfer_t *cur = NULL;
+
+    crd_free_plan(context);
+    for (i = 0; i < context->block_count; i++) {
+        count += (context->blocks[i].len + max_transfer - 1) / max_transfer;
     }
-    while (!feof(fd)) {
-        if (crd_read_line(fd, tmp) == CRD_SKIP) {
+    context->segments = (crd_segment_t*)malloc(sizeof(crd_segment_t) * (count + 1));
+    context->transfers = (crd_transfer_t*)malloc(sizeof(crd_transfer_t) * (count + 1));
+    if (context->segments == NULL || context->transfers == NULL) {
+        CRD_DEBUG("Failed to allocate memmory for the read plan\n");
+        crd_free_plan(context);
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+
+    for (i = 0; i < context->block_count; i++) {
+        crd_parsed_csv_t *block = &context->blocks[i];
+        if (!context->is_full && block->enable_addr != CRD_DB_NO_ENABLE) {
+            prev_dumped = 0;
             continue;
         }
-        crd_parse(tmp, ",", arr, &field_count); /* whack record into fields */
-        if (field_count < 2) {
-            CRD_DEBUG("CSV File has bad format, line : %s\n", tmp);
-            sprintf(crd_error, "CSV File has bad format, line : %s", tmp);
-            fclose(fd);
-            return CRD_CSV_BAD_FORMAT;
-        }
-        if (read_single_dword) {
-            *block_count += atoi(arr[1]);
-        } else {
-            *block_count += 1;
+        for (off = 0; off < block->len; off += max_transfer) {
+            crd_segment_t *seg = &context->segments[context->seg_count];
+            u_int64_t cur_end;
+            seg->addr = block->addr + off * 4;
+            seg->len = block->len - off > max_transfer ? max_transfer : block->len - off;
+
+            cur_end = cur ? (u_int64_t)cur->addr + (u_int64_t)cur->len * 4 : 0;
+            if (cur && (off || prev_dumped) && seg->addr >= cur_end &&
+                seg->addr - cur_end <= (u_int64_t)context->max_gap * 4 &&
+                (u_int64_t)seg->addr + seg->len * 4 - cur->addr <= (u_int64_t)max_transfer * 4) {
+                cur->len = (seg->addr - cur->addr) / 4 + seg->len;
+                cur->num_segs++;
+            } else {
+                cur = &context->transfers[context->transfer_count++];
+                cur->addr = seg->addr;
+                cur->len = seg->len;
+                cur->first_seg = context->seg_count;
+                cur->num_segs = 1;
+            }
+            if (cur->len > max_len) {
+                max_len = cur->len;
+            }
+            context->seg_count++;
         }
+        prev_dumped = 1;
     }
-    fclose(fd);
+
+    context->buf = (u_int32_t*)malloc(sizeof(u_int32_t) * (max_len + 1));
+    if (context->buf == NULL) {
+        CRD_DEBUG("Failed to allocate memmory for the read buffer\n");
+        crd_free_plan(context);
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    CRD_DEBUG("Read plan: %d blocks, %d transfers\n", context->block_count, context->transfer_count);
     return CRD_OK;
 }
 
-static int crd_count_double_word(IN char *csv_file_path, OUT u_int32_t *number_of_dwords,
-                                 OUT crd_parsed_csv_t blocks[], IN int is_full,
-                                 IN u_int8_t read_single_dword)
+static int crd_read_cause(IN crd_ctxt_t *context, OUT int *is_set)
 {
+    u_int32_t cause_reg = 0;
 
-    int field_count       = 0;
-    int block_count       = 0;
-    u_int32_t addr        = 0;
-    u_int32_t len         = 0;
-    u_int32_t i           = 0;
-    char enable_addr[100] = {0};
-    char tmp[1024]  = {0x0};
-    char arr[CRD_MAXFLDS][CRD_MAXFLDSIZE];
+    if (mread4(context->mf, context->cause_addr, &cause_reg) != sizeof(u_int32_t)) {
+        CRD_DEBUG("Cr read (0x%08x) failed: %s(%d)\n", context->cause_addr, strerror(errno), (u_int32_t)errno);
+        crd_set_error(context, "Cr read (0x%08x) failed: %s(%d)", context->cause_addr, strerror(errno), (u_int32_t)errno);
+        return CRD_CR_READ_ERR;
+    }
+    *is_set = EXTRACT(cause_reg, context->cause_off, 1);
+    return CRD_OK;
+}
 
-    *number_of_dwords = 0;
+/*
+   Cause registers are either write-1-to-clear or plain read-write, try the
+   former first and fall back to writing the bit as zero.
+ */
+static int crd_clear_cause(IN crd_ctxt_t *context, OUT int *is_cleared)
+{
+    u_int32_t cause_reg = 0;
+    int is_set = 0;
+    int rc;
 
-    CRD_DEBUG("CSV file path : %s\n", csv_file_path);
-    FILE *fd = fopen(csv_file_path, "r");
-    if (fd == NULL) {
-        CRD_DEBUG("Failed to open csv file : '%s'\n", csv_file_path);
-        sprintf(crd_error, "Failed to open csv file : '%s'", csv_file_path);
-        return CRD_OPEN_FILE_ERROR;
+    *is_cleared = 0;
+    if (mwrite4(context->mf, context->cause_addr, 1U << context->cause_off) != sizeof(u_int32_t)) {
+        return CRD_OK;
+    }
+    rc = crd_read_cause(context, &is_set);
+    if (rc || !is_set) {
+        *is_cleared = !rc;
+        return rc;
+    }
+    if (mread4(context->mf, context->cause_addr, &cause_reg) != sizeof(u_int32_t) ||
+        mwrite4(context->mf, context->cause_addr, cause_reg & ~(1U << context->cause_off)) != sizeof(u_int32_t)) {
+        return CRD_OK;
     }
+    rc = crd_read_cause(context, &is_set);
+    *is_cleared = !rc && !is_set;
+    return rc;
+}
 
-    while (!feof(fd)) {
-        if (crd_read_line(fd, tmp) == CRD_SKIP) {
-            continue;
-        }
-        crd_parse(tmp, ",", arr, &field_count); /* whack record into fields */
-        if (field_count < 2) {
-            CRD_DEBUG("CSV File has bad format, line : %s\n", tmp);
-            sprintf(crd_error, "CSV File has bad format, line : %s", tmp);
-            fclose(fd);
-            return CRD_CSV_BAD_FORMAT;
+/*
+   The cause bit was raised by one of the reads in [addr, addr + len dwords).
+   Clear it and re-read halves of the range until a single dword is left.
+   When the bit cannot be cleared, or none of the halves raise it again, the
+   whole remaining range is reported. context->cause_first is set to the
+   first address of the reported range.
+ */
+static int crd_find_cause(IN crd_ctxt_t *context, IN u_int32_t addr, IN u_int32_t len)
+{
+    u_int32_t half;
+    u_int32_t part_addr;
+    u_int32_t part_len;
+    u_int32_t *tmp = NULL;
+    int part;
+    int is_set = 0;
+    int is_cleared = 0;
+    int rc = CRD_OK;
+
+    /* context->buf still holds the transfer data for the caller, the parts
+       are read into tmp which fits the largest one (the first upper half) */
+    if (len > 1) {
+        tmp = (u_int32_t*)malloc((len - len / 2) * sizeof(u_int32_t));
+        if (tmp == NULL) {
+            CRD_DEBUG("Failed to allocate memmory for the read buffer\n");
+            return CRD_MEM_ALLOCATION_ERR;
         }
-        addr = (u_int32_t)strtol(arr[0], NULL, 0);
-        len  = atoi(arr[1]);
-        if (!read_single_dword) {
-            blocks[block_count].addr = addr;
-            blocks[block_count].len  = len;
-            if (field_count > 2) {
-                strcpy(blocks[block_count].enable_addr, arr[2]);
-                if (is_full || (!is_full && !strcmp(blocks[block_count].enable_addr, CRD_EMPTY))) {
-                    *number_of_dwords += len;
-                }
-            } else   {
-                strcpy(blocks[block_count].enable_addr, CRD_EMPTY);
-                *number_of_dwords += len;
+    }
+
+    while (len > 1) {
+        half = len / 2;
+        is_set = 0;
+        for (part = 0; part < 2 && !is_set; part++) {
+            part_addr = part ? addr + half * sizeof(u_int32_t) : addr;
+            part_len = part ? len - half : half;
+            rc = crd_clear_cause(context, &is_cleared);
+            if (rc) {
+                goto Cleanup;
             }
-            block_count += 1;
-        } else {
-            if (field_count > 2) {
-                strcpy(enable_addr, arr[2]);
-            } else {
-                strcpy(enable_addr, CRD_EMPTY);
+            if (!is_cleared) {
+                break;
             }
-            if (is_full || (!is_full && !strcmp(enable_addr, CRD_EMPTY))) {
-                *number_of_dwords += len;
+            rc = mread4_block(context->mf, part_addr, tmp, part_len * sizeof(u_int32_t));
+            if ((u_int32_t)rc != part_len * sizeof(u_int32_t)) {
+                crd_set_error(context, "Cr read (0x%08x) failed: %s(%d)", part_addr, strerror(errno), (u_int32_t)errno);
+                rc = CRD_CR_READ_ERR;
+                goto Cleanup;
             }
-            for (i = 0; i < len; i++) {
-                blocks[block_count].addr = addr;
-                blocks[block_count].len  = 1;
-                strcpy(blocks[block_count].enable_addr, enable_addr);
-                block_count += 1;
-                addr += 4;
+            rc = crd_read_cause(context, &is_set);
+            if (rc) {
+                goto Cleanup;
             }
         }
+        if (!is_set) {
+            break;
+        }
+        addr = part_addr;
+        len = part_len;
     }
-    fclose(fd);
-    return CRD_OK;
+
+    context->cause_first = addr;
+    if (len == 1) {
+        CRD_DEBUG("Cause bit set by read from address 0x%x\n", addr);
+        crd_set_error(context, "Cause bit set by read from address 0x%x", addr);
+    } else {
+        CRD_DEBUG("Cause bit set by read from addresses 0x%x-0x%x\n", addr, addr + (len - 1) * 4);
+        crd_set_error(context, "Cause bit set by read from addresses 0x%x-0x%x", addr, addr + (len - 1) * 4);
+    }
+    rc = CRD_CAUSE_BIT;
+
+Cleanup:
+    free(tmp);
+    return rc;
 }
 
 static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
@@ -490,7 +621,7 @@ static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
         for (j = 0; j < context->blocks[i].len; j++) {
 
             //CRD_UNKOWN, CRD_EMPTY
-            if (!context->is_full && strcmp(context->blocks[i].enable_addr, CRD_EMPTY)) {
+            if (!context->is_full && context->blocks[i].enable_addr != CRD_DB_NO_ENABLE) {
                 break;
             }
             if ((u_int32_t)total >= context->number_of_dwords) {
@@ -504,41 +635,6 @@ static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
     return CRD_OK;
 }
 
-static int crd_read_line(IN FILE *fd, OUT char *tmp)
-{
-
-    int i = 0;
-    int j = 0;
-    for (i = 0; i < CRD_MAXLINESIZE;) { // This loop to read line by line no matter the length of the line.
-        if (!feof(fd)) {
-            int c = fgetc(fd);
-            if (c == '#') {
-                if (!fgets(tmp, 300, fd)) {  // Avoid warning
-                }
-                tmp[0] = 0;
-                continue;
-            } else if (c == '\r')   {
-                break;
-            } else if (c == '\n')   {
-                break;
-            } else if (c == ' ')   {
-                continue;
-            } else   {
-                j++;
-                tmp[i] = c;
-                i++;
-            }
-        } else   {
-            return CRD_SKIP;
-        }
-    }
-    if (!j) {
-        return CRD_SKIP;
-    }
-    tmp[i] = 0;
-    return CRD_OK;
-}
-
 #if defined(__WIN__)
 
 static int crd_replace(INOUT char *st, IN char *orig, IN char *repl)
@@ -641,7 +737,7 @@ static int crd_update_csv_path(IN OUT char *csv_file_path, IN const char *db_pat
     fd = fopen(conf_path, "r");
     if (fd == NULL) {
         CRD_DEBUG("Failed to open conf file : %s\n", conf_path);
-        sprintf(crd_error, "Failed to open conf file : %s", conf_path);
+        crd_set_error(NULL, "Failed to open conf file : %s", conf_path);
         return CRD_OPEN_FILE_ERROR;
     }
 
@@ -679,7 +775,8 @@ static int crd_update_csv_path(IN OUT char *csv_file_path, IN const char *db_pat
 
 void crd_free(IN crd_ctxt_t *context)
 {
-    free(context->blocks);
+    crd_free_plan(context);
+    crd_db_free(&context->db);
     free(context);
 }
 
@@ -726,3 +823,19 @@ const char* crd_err_str(int rc)
         return "Unknown error";
     }
 }
+
+const char* crd_ctx_err_str(IN crd_ctxt_t *context, int rc)
+{
+    switch (rc) {
+    case CRD_CR_READ_ERR:
+    case CRD_CSV_BAD_FORMAT:
+    case CRD_OPEN_FILE_ERROR:
+    case CRD_CAUSE_BIT:
+        if (context) {
+            return context->error;
+        }
+    /* fall through */
+    default:
+        return crd_err_str(rc);
+    }
+}
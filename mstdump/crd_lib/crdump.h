@@ -109,16 +109,27 @@ CRD_DLL_EXPORT int crd_get_dword_num(IN crd_ctxt_t *context, OUT u_int32_t *arr_
  */
 CRD_DLL_EXPORT int crd_get_addr_list(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr); // caller well allocate the array and addresses will be filled.
 
+/*
+   Allow reading gaps of up to max_gap dwords between dumped blocks, so they are
+   read by one transfer (default 0). Use only when the gap addresses are safe to read.
+ */
+CRD_DLL_EXPORT int crd_set_max_gap(IN crd_ctxt_t *context, IN u_int32_t max_gap);
+
 /*
    Store all addresses and data in dword_arr, if func is not null, it will be called on each dword
  */
 CRD_DLL_EXPORT int crd_dump_data(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr, IN crd_callback_t func);// values will be filled.
 
 /*
-   Return string representation of the error code
+   Return string representation of the error code, messages are of the last error in the calling thread
  */
 CRD_DLL_EXPORT const char* crd_err_str(int rc);
 
+/*
+   Return string representation of the error code, messages are of the last error of context
+ */
+CRD_DLL_EXPORT const char* crd_ctx_err_str(IN crd_ctxt_t *context, int rc);
+
 /*
    Free context
  */
@@ -31,14 +31,43 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+#include <time.h>
+#include <ctype.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/stat.h>
 #include <crdump.h>
+#include <crd_bin.h>
+#include <crd_sample.h>
 #include <dev_mgt/tools_dev_types.h>
+#include <reg_access/reg_access.h>
 #include <common/tools_version.h>
 #include <common/bit_slice.h>
 
 
 #define CAUSE_FLAG "--cause"
+#define MAX_GAP_FLAG "--max-gap"
+#define BIN_FLAG "--bin"
+#define XZ_FLAG "--xz"
+#define DECODE_FLAG "--decode"
+#define INTERVAL_FLAG "--interval"
+#define COUNT_FLAG "--count"
+#define KEY_FLAG "--key"
+#define RING_FLAG "--ring"
+#define SAMPLE_FLAG "--sample"
+#define OUT_DIR_FLAG "--out-dir"
+#define ALL_DEVICES "all"
+#define MAX_DEVICES 256
+#define DEF_KEY_INTERVAL 64
+#define DEF_RING_MB 64
+#define MAX_RING_MB 1024
 #define MAX_DEV_LEN 512
+#define OUT_BUF_SIZE 0x10000
+#define DWORD_LINE_LEN 22 /* "0x%8.8x 0x%8.8x\n" */
 
 #ifndef MSTDUMP_NAME
 #define MSTDUMP_NAME "mstdump"
@@ -51,18 +80,694 @@
 
 // string explaining the cmd-line structure
 char correct_cmdline[] = "   Mellanox "MSTDUMP_NAME " utility, dumps device internal configuration data\n\
-   Usage: "MSTDUMP_NAME " [-full] <device> [i2c-slave] [-v[ersion] [-h[elp]]]\n\n\
+   Usage: "MSTDUMP_NAME " [-full] <device> [i2c-slave] [--max-gap=<dwords>] [--bin=<file> [--xz]] [-v[ersion] [-h[elp]]]\n\
+          "MSTDUMP_NAME " [-full] <device> [i2c-slave] --bin=<file> --interval=<ms> [--count=<n>] [--key=<n>] [--ring=<MB>]\n\
+          "MSTDUMP_NAME " [-full] <device>,<device>[,...] | all [--max-gap=<dwords>] [--out-dir=<dir>] [--bin [--xz]]\n\
+          "MSTDUMP_NAME " --decode=<file> [--sample=<n>]\n\n\
    -full              :  Dump more expanded list of addresses\n\
                          Note : be careful when using this flag, None safe addresses might be read.\n\
+   --max-gap=<dwords> :  Read gaps of up to <dwords> between dumped ranges within one transfer\n\
+                         Note : the gap addresses are read too, use only when they are safe to read.\n\
+   --bin=<file>       :  Write a binary dump to <file> instead of the text output\n\
+   --xz               :  Compress the binary dump with xz\n\
+   --interval=<ms>    :  Sample the device every <ms> milliseconds into the --bin file, only changed dwords are stored\n\
+   --count=<n>        :  Stop after <n> samples (default: until interrupted)\n\
+   --key=<n>          :  Store a full sample every <n> samples (default: 64)\n\
+   --ring=<MB>        :  Size of the sample ring, the oldest samples are overwritten (default: 64)\n\
+   --out-dir=<dir>    :  Directory of the per-device dumps when dumping devices in parallel (default: current)\n\
+   --bin              :  Write binary per-device dumps when dumping devices in parallel\n\
+   --decode=<file>    :  Print a binary dump in the text format, or list the samples of a sample file\n\
+   --sample=<n>       :  Print sample <n> of a sample file in the text format\n\
    -v | --version     :  Display version info\n\
    -h | --help        :  Print this help message\n\
    Example :\n\
             "MSTDUMP_NAME " "DEV_EXAMPLE "\n";
 
 
+#if defined(_MSC_VER)
+#define MSTDUMP_THREAD_LOCAL __declspec(thread)
+#else
+#define MSTDUMP_THREAD_LOCAL __thread
+#endif
+
+typedef struct dword_writer {
+    FILE *fd;
+    size_t len;
+    char buf[OUT_BUF_SIZE];
+} dword_writer_t;
+
+static dword_writer_t stdout_writer;
+
+static int writer_flush(dword_writer_t *w)
+{
+    int rc = 0;
+
+    if (w->len) {
+        rc = fwrite(w->buf, 1, w->len, w->fd) != w->len;
+        w->len = 0;
+    }
+    return fflush(w->fd) || rc;
+}
+
+static char* put_hex(char *p, u_int32_t val)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    int shift;
+
+    *p++ = '0';
+    *p++ = 'x';
+    for (shift = 28; shift >= 0; shift -= 4) {
+        *p++ = hex_digits[(val >> shift) & 0xf];
+    }
+    return p;
+}
+
+// same output as fprintf(fd, "0x%8.8x 0x%8.8x\n"), buffered until writer_flush()
+static void writer_put(dword_writer_t *w, const crd_dword_t *dword)
+{
+    char *p;
+
+    if (w->len + DWORD_LINE_LEN > OUT_BUF_SIZE) {
+        writer_flush(w);
+    }
+    p = put_hex(w->buf + w->len, dword->addr);
+    *p++ = ' ';
+    p = put_hex(p, dword->data);
+    *p++ = '\n';
+    w->len = p - w->buf;
+}
+
+static void flush_dwords(void)
+{
+    if (stdout_writer.fd) {
+        writer_flush(&stdout_writer);
+    }
+}
+
 void print_dword(crd_dword_t *dword)
 {
-    printf("0x%8.8x 0x%8.8x\n", dword->addr, dword->data);
+    stdout_writer.fd = stdout;
+    writer_put(&stdout_writer, dword);
+}
+
+// per thread, as the parallel dumps collect through the same callback
+static MSTDUMP_THREAD_LOCAL crd_dword_t *bin_dwords = NULL;
+static MSTDUMP_THREAD_LOCAL u_int32_t bin_count = 0;
+static MSTDUMP_THREAD_LOCAL u_int32_t bin_size = 0;
+
+void collect_dword(crd_dword_t *dword)
+{
+    if (bin_count < bin_size) {
+        bin_dwords[bin_count++] = *dword;
+    }
+}
+
+static int is_dump_flag(const char *arg)
+{
+    return !strncmp(arg, CAUSE_FLAG, strlen(CAUSE_FLAG)) || !strncmp(arg, MAX_GAP_FLAG, strlen(MAX_GAP_FLAG)) ||
+           !strncmp(arg, BIN_FLAG, strlen(BIN_FLAG)) || !strcmp(arg, XZ_FLAG) ||
+           !strncmp(arg, INTERVAL_FLAG, strlen(INTERVAL_FLAG)) || !strncmp(arg, COUNT_FLAG, strlen(COUNT_FLAG)) ||
+           !strncmp(arg, KEY_FLAG, strlen(KEY_FLAG)) || !strncmp(arg, RING_FLAG, strlen(RING_FLAG)) ||
+           !strncmp(arg, OUT_DIR_FLAG, strlen(OUT_DIR_FLAG));
+}
+
+static int parse_uint_flag(const char *arg, const char *flag, u_int32_t *val)
+{
+    char *endptr;
+    size_t len = strlen(flag);
+
+    if (strncmp(arg, flag, len) || arg[len] != '=' || !arg[len + 1]) {
+        return 1;
+    }
+    *val = (u_int32_t)strtoul(arg + len + 1, &endptr, 0);
+    return *endptr != '\0';
+}
+
+static void get_bin_info(mfile *mf, crd_bin_info_t *info)
+{
+    dm_dev_id_t dev_type = DeviceUnknown;
+    struct tools_open_mgir mgir;
+
+    if (!dm_get_device_id(mf, &dev_type, &info->hw_dev_id, &info->hw_rev)) {
+        info->dev_type = dev_type;
+    }
+    memset(&mgir, 0, sizeof(mgir));
+    if (reg_access_mgir(mf, REG_ACCESS_METHOD_GET, &mgir) == ME_OK) {
+        if (mgir.fw_info.extended_major || mgir.fw_info.extended_minor || mgir.fw_info.extended_sub_minor) {
+            info->fw_ver[0] = mgir.fw_info.extended_major;
+            info->fw_ver[1] = mgir.fw_info.extended_minor;
+            info->fw_ver[2] = mgir.fw_info.extended_sub_minor;
+        } else {
+            info->fw_ver[0] = mgir.fw_info.major;
+            info->fw_ver[1] = mgir.fw_info.minor;
+            info->fw_ver[2] = mgir.fw_info.sub_minor;
+        }
+    }
+    info->timestamp = (u_int64_t)time(NULL);
+}
+
+static int write_bin_dump(const char *path, crd_bin_info_t *info, const crd_dword_t *dwords, u_int32_t count)
+{
+    char err[256] = {0};
+    FILE *fd;
+    int rc;
+
+    fd = fopen(path, "wb");
+    if (fd == NULL) {
+        fprintf(stderr, "-E- Failed to open %s: %s\n", path, strerror(errno));
+        return CRD_OPEN_FILE_ERROR;
+    }
+    rc = crd_bin_write(fd, info, dwords, count, err, sizeof(err));
+    if (fclose(fd) && !rc) {
+        snprintf(err, sizeof(err), "Failed to write %s: %s", path, strerror(errno));
+        rc = CRD_OPEN_FILE_ERROR;
+    }
+    if (rc) {
+        fprintf(stderr, "-E- %s\n", err);
+        remove(path);
+    }
+    return rc;
+}
+
+static volatile sig_atomic_t stop_sampling = 0;
+
+static void stop_sampling_handler(int sig)
+{
+    (void)sig;
+    stop_sampling = 1;
+}
+
+static u_int64_t mono_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static u_int64_t wall_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (u_int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+   Dump every interval_ms into a sample file until count samples were taken
+   (or forever when count is 0). Samples are scheduled on a fixed grid, a
+   sample that takes longer than the interval skips the missed slots.
+ */
+static int sample_dumps(crd_ctxt_t *context, u_int32_t arr_size, const char *path, crd_bin_info_t *info,
+                        u_int32_t interval_ms, u_int32_t count, u_int32_t key_interval, u_int64_t ring_size)
+{
+    char err[256] = {0};
+    crd_sample_writer_t *writer = NULL;
+    crd_dword_t *dwords;
+    u_int64_t interval_us = (u_int64_t)interval_ms * 1000;
+    u_int64_t next;
+    u_int64_t now;
+    u_int64_t missed = 0;
+    u_int32_t samples = 0;
+    struct timespec ts;
+    int rc;
+
+    dwords = (crd_dword_t*)malloc(sizeof(crd_dword_t) * (arr_size + 1));
+    if (dwords == NULL) {
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    next = mono_time_us();
+    rc = crd_dump_data(context, dwords, NULL);
+    if (rc) {
+        free(dwords);
+        return rc;
+    }
+    rc = crd_sample_open(path, info, dwords, arr_size, interval_ms, key_interval, ring_size, &writer, err, sizeof(err));
+    if (rc) {
+        fprintf(stderr, "-E- %s\n", err);
+        free(dwords);
+        return rc;
+    }
+    signal(SIGINT, stop_sampling_handler);
+    signal(SIGTERM, stop_sampling_handler);
+
+    while (1) {
+        rc = crd_sample_write(writer, dwords, wall_time_us(), NULL, err, sizeof(err));
+        if (rc) {
+            fprintf(stderr, "-E- %s\n", err);
+            break;
+        }
+        samples++;
+        if ((count && samples >= count) || stop_sampling) {
+            break;
+        }
+        next += interval_us;
+        now = mono_time_us();
+        if (now > next) {
+            missed += (now - next) / interval_us + 1;
+            next += ((now - next) / interval_us + 1) * interval_us;
+        }
+        ts.tv_sec = (next - now) / 1000000;
+        ts.tv_nsec = ((next - now) % 1000000) * 1000;
+        if (nanosleep(&ts, NULL) && stop_sampling) {
+            break;
+        }
+        rc = crd_dump_data(context, dwords, NULL);
+        if (rc) {
+            break;
+        }
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if (crd_sample_close(writer) && !rc) {
+        fprintf(stderr, "-E- Failed to write %s\n", path);
+        rc = CRD_OPEN_FILE_ERROR;
+    }
+    if (missed) {
+        fprintf(stderr, "-W- %llu sampling intervals were missed, the device could not be read within %u ms\n",
+                (unsigned long long)missed, interval_ms);
+    }
+    free(dwords);
+    return rc;
+}
+
+// list the samples, or print sample seq (when not negative) in the text format
+static int decode_sample_file(FILE *fd, const char *path, long long seq)
+{
+    char err[256] = {0};
+    crd_bin_info_t info;
+    crd_sample_reader_t *reader = NULL;
+    crd_sample_t sample;
+    u_int32_t i;
+    int found = 0;
+    int end = 0;
+    int rc;
+
+    rc = crd_sample_reader_open(fd, &info, &reader, err, sizeof(err));
+    if (rc) {
+        fclose(fd);
+        fprintf(stderr, "-E- %s: %s\n", path, err);
+        return rc;
+    }
+    if (seq < 0) {
+        printf("Sample  Time                        Frame  Changed dwords\n");
+    }
+    while (!found) {
+        rc = crd_sample_next(reader, &sample, &end, err, sizeof(err));
+        if (rc || end) {
+            break;
+        }
+        if (seq < 0) {
+            time_t sec = (time_t)(sample.timestamp_us / 1000000);
+            char tbuf[32] = {0};
+            strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+            printf("%-7u %s.%06u  %-6s %u\n", sample.seq, tbuf, (u_int32_t)(sample.timestamp_us % 1000000),
+                   sample.type == CRD_SAMPLE_KEY ? "key" : "delta", sample.changed);
+        } else if (sample.seq == (u_int64_t)seq) {
+            for (i = 0; i < sample.count; i++) {
+                print_dword((crd_dword_t*)&sample.dwords[i]);
+            }
+            flush_dwords();
+            found = 1;
+        }
+    }
+    crd_sample_reader_close(reader);
+    if (rc) {
+        fprintf(stderr, "-E- %s: %s\n", path, err);
+    } else if (seq >= 0 && !found) {
+        fprintf(stderr, "-E- Sample %lld is not in %s\n", seq, path);
+        rc = CRD_INVALID_PARM;
+    }
+    return rc;
+}
+
+static int decode_bin_dump(const char *path, long long seq)
+{
+    char err[256] = {0};
+    crd_bin_info_t info;
+    crd_dword_t *dwords = NULL;
+    u_int32_t count = 0;
+    u_int32_t magic = 0;
+    u_int32_t i;
+    FILE *fd;
+    int rc;
+
+    fd = fopen(path, "rb");
+    if (fd == NULL) {
+        fprintf(stderr, "-E- Failed to open %s: %s\n", path, strerror(errno));
+        return CRD_OPEN_FILE_ERROR;
+    }
+    if (fread(&magic, sizeof(magic), 1, fd) == 1 && __le32_to_cpu(magic) == CRD_SAMPLE_MAGIC) {
+        return decode_sample_file(fd, path, seq);
+    }
+    if (seq >= 0) {
+        fclose(fd);
+        fprintf(stderr, "-E- " SAMPLE_FLAG " flag applies only to sample files\n");
+        return CRD_INVALID_PARM;
+    }
+    rewind(fd);
+    rc = crd_bin_read(fd, &info, &dwords, &count, err, sizeof(err));
+    fclose(fd);
+    if (rc) {
+        fprintf(stderr, "-E- %s: %s\n", path, err);
+        return rc;
+    }
+    for (i = 0; i < count; i++) {
+        print_dword(&dwords[i]);
+    }
+    flush_dwords();
+    free(dwords);
+    return 0;
+}
+
+typedef struct dump_job {
+    char device[MAX_DEV_LEN];
+    char out_path[MAX_DEV_LEN * 2];
+    int full;
+    int cause_addr;
+    int cause_off;
+    int max_gap;
+    int binary;
+    u_int16_t bin_flags;
+    int rc;
+    char error[MAX_DEV_LEN * 2 + 128];     /* fits a message about out_path */
+    int pinned;
+    u_int32_t dwords;
+    u_int64_t time_us;
+    pthread_t thread;
+} dump_job_t;
+
+#if defined(__linux__)
+/*
+   Run the calling thread on the CPUs local to the PCI device of mf, return 1
+   when pinned.
+ */
+static int pin_to_device_cpus(mfile *mf)
+{
+    char path[256];
+    char list[1024] = {0};
+    char *p = list;
+    char *end;
+    unsigned long first;
+    unsigned long last;
+    cpu_set_t set;
+    FILE *fd;
+
+    if (!mf->dinfo || mf->dinfo->type != MDEVS_TAVOR_CR) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/local_cpulist", mf->dinfo->pci.domain,
+             mf->dinfo->pci.bus, mf->dinfo->pci.dev, mf->dinfo->pci.func);
+    fd = fopen(path, "r");
+    if (fd == NULL) {
+        return 0;
+    }
+    if (!fgets(list, sizeof(list), fd)) {
+        fclose(fd);
+        return 0;
+    }
+    fclose(fd);
+
+    // "0-11,24-35"
+    CPU_ZERO(&set);
+    while (*p && *p != '\n') {
+        first = strtoul(p, &end, 10);
+        if (end == p) {
+            return 0;
+        }
+        last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+        }
+        for (; first <= last && first < CPU_SETSIZE; first++) {
+            CPU_SET(first, &set);
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(&set) && !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#else
+static int pin_to_device_cpus(mfile *mf)
+{
+    (void)mf;
+    return 0;
+}
+#endif
+
+static void* dump_device(void *arg)
+{
+    dump_job_t *job = (dump_job_t*)arg;
+    crd_ctxt_t *context = NULL;
+    crd_bin_info_t info;
+    dword_writer_t *writer = NULL;
+    u_int64_t start = mono_time_us();
+    u_int32_t arr_size = 0;
+    u_int32_t i;
+    mfile *mf;
+    int rc;
+
+    mf = mopen_adv(job->device, (MType)(MST_DEFAULT | MST_CABLE));
+    if (mf == NULL) {
+        snprintf(job->error, sizeof(job->error), "Unable to open device");
+        job->rc = 1;
+        goto out;
+    }
+    job->pinned = pin_to_device_cpus(mf);
+    memset(&info, 0, sizeof(info));
+    if (job->binary) {
+        get_bin_info(mf, &info);
+        info.flags = job->bin_flags | (job->full ? CRD_BIN_FLAG_FULL : 0);
+    }
+
+    rc = crd_init(&context, mf, job->full, job->cause_addr, job->cause_off, NULL);
+    if (!rc && job->max_gap) {
+        rc = crd_set_max_gap(context, job->max_gap);
+    }
+    if (!rc) {
+        rc = crd_get_dword_num(context, &arr_size);
+    }
+    if (!rc) {
+        bin_dwords = (crd_dword_t*)malloc(sizeof(crd_dword_t) * (arr_size + 1));
+        bin_size = bin_dwords ? arr_size : 0;
+        bin_count = 0;
+        rc = bin_dwords ? crd_dump_data(context, NULL, collect_dword) : CRD_MEM_ALLOCATION_ERR;
+    }
+    if (rc) {
+        snprintf(job->error, sizeof(job->error), "%s", context ? crd_ctx_err_str(context, rc) : crd_err_str(rc));
+        job->rc = rc;
+    }
+    job->dwords = bin_count;
+
+    // the dwords read before a failure are written as well
+    if (bin_dwords && bin_count) {
+        if (job->binary) {
+            if (write_bin_dump(job->out_path, &info, bin_dwords, bin_count) && !job->rc) {
+                snprintf(job->error, sizeof(job->error), "Failed to write %s", job->out_path);
+                job->rc = CRD_OPEN_FILE_ERROR;
+            }
+        } else {
+            writer = (dword_writer_t*)malloc(sizeof(*writer));
+            if (writer) {
+                writer->len = 0;
+                writer->fd = fopen(job->out_path, "w");
+            }
+            if (writer == NULL || writer->fd == NULL) {
+                if (!job->rc) {
+                    snprintf(job->error, sizeof(job->error), "Failed to open %s: %s", job->out_path, strerror(errno));
+                    job->rc = CRD_OPEN_FILE_ERROR;
+                }
+            } else {
+                for (i = 0; i < bin_count; i++) {
+                    writer_put(writer, &bin_dwords[i]);
+                }
+                if ((writer_flush(writer) | fclose(writer->fd)) && !job->rc) {
+                    snprintf(job->error, sizeof(job->error), "Failed to write %s", job->out_path);
+                    job->rc = CRD_OPEN_FILE_ERROR;
+                }
+            }
+            free(writer);
+        }
+    }
+    free(bin_dwords);
+    bin_dwords = NULL;
+    if (context) {
+        crd_free(context);
+    }
+    mclose(mf);
+
+out:
+    job->time_us = mono_time_us() - start;
+    return NULL;
+}
+
+/*
+   Return 0, or fail the job when the path does not fit out_path
+ */
+static int set_out_path(dump_job_t *job, const char *out_dir)
+{
+    const char *name = strrchr(job->device, '/');
+    char *p;
+    size_t dir_len;
+    int len;
+
+    // a remote device is named after its server as well
+    if (strchr(job->device, ',')) {
+        name = job->device;
+    } else {
+        name = name ? name + 1 : job->device;
+    }
+    len = snprintf(job->out_path, sizeof(job->out_path), "%s/%s.%s", out_dir, name, job->binary ? "crdd" : "dump");
+    if (len < 0 || (size_t)len >= sizeof(job->out_path)) {
+        snprintf(job->error, sizeof(job->error), "Output path for %s in %.256s... is too long", job->device, out_dir);
+        job->rc = CRD_INVALID_PARM;
+        return 1;
+    }
+    dir_len = strlen(out_dir) + 1;
+    for (p = job->out_path + dir_len; *p; p++) {
+        if (*p == ':' || *p == ',' || *p == '/') {
+            *p = '_';
+        }
+    }
+    return 0;
+}
+
+/* "<host>:<port>", the server part of a remote device name */
+static int is_server_addr(const char *s)
+{
+    const char *port = strrchr(s, ':');
+
+    if (port == NULL || port == s || !port[1]) {
+        return 0;
+    }
+    for (port++; *port; port++) {
+        if (!isdigit((unsigned char)*port)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+   Get the next device of a comma separated list (strtok_r style). A
+   "<host>:<port>" entry takes the following entry as its device, as in the
+   remote device name "<host>:<port>,<device>".
+ */
+static int next_device(char *list, char **save, char *dev)
+{
+    char *tok = strtok_r(list, ",", save);
+    char *remote;
+
+    if (tok == NULL) {
+        return 0;
+    }
+    if (is_server_addr(tok) && (remote = strtok_r(NULL, ",", save))) {
+        snprintf(dev, MAX_DEV_LEN, "%s,%s", tok, remote);
+    } else {
+        snprintf(dev, MAX_DEV_LEN, "%s", tok);
+    }
+    return 1;
+}
+
+static int count_devices(const char *devices)
+{
+    char list[MAX_DEVICES * 16];
+    char dev[MAX_DEV_LEN];
+    char *save = NULL;
+    int count = 0;
+
+    strncpy(list, devices, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+    while (next_device(count ? NULL : list, &save, dev)) {
+        count++;
+    }
+    return count;
+}
+
+/*
+   Dump devices ("all" or a comma separated list) in parallel, one thread per
+   device, each into its own file in out_dir. Print a summary with the
+   time each device took.
+ */
+static int dump_devices(const char *devices, const char *out_dir, const dump_job_t *opts)
+{
+    dump_job_t *jobs;
+    dev_info *devs = NULL;
+    char list[MAX_DEVICES * 16];
+    char dev[MAX_DEV_LEN];
+    char *save = NULL;
+    int devs_len = 0;
+    int count = 0;
+    int failed = 0;
+    int i;
+    u_int64_t start;
+    u_int64_t total_us = 0;
+
+    jobs = (dump_job_t*)calloc(MAX_DEVICES, sizeof(dump_job_t));
+    if (jobs == NULL) {
+        fprintf(stderr, "-E- Memory allocation error\n");
+        return 1;
+    }
+    if (!strcmp(devices, ALL_DEVICES)) {
+        devs = mdevices_info(MDEVS_TAVOR_CR, &devs_len);
+        for (i = 0; i < devs_len && count < MAX_DEVICES; i++) {
+            jobs[count] = *opts;
+            strncpy(jobs[count++].device, devs[i].dev_name, MAX_DEV_LEN - 1);
+        }
+        if (devs) {
+            mdevices_info_destroy(devs, devs_len);
+        }
+    } else {
+        strncpy(list, devices, sizeof(list) - 1);
+        list[sizeof(list) - 1] = '\0';
+        while (count < MAX_DEVICES && next_device(count ? NULL : list, &save, dev)) {
+            jobs[count] = *opts;
+            strcpy(jobs[count++].device, dev);
+        }
+    }
+    if (!count) {
+        fprintf(stderr, "-E- No devices to dump\n");
+        free(jobs);
+        return 1;
+    }
+    if (mkdir(out_dir, 0755) && errno != EEXIST) {
+        fprintf(stderr, "-E- Failed to create %s: %s\n", out_dir, strerror(errno));
+        free(jobs);
+        return 1;
+    }
+
+    start = mono_time_us();
+    for (i = 0; i < count; i++) {
+        if (set_out_path(&jobs[i], out_dir)) {
+            jobs[i].thread = pthread_self();
+            continue;
+        }
+        if (pthread_create(&jobs[i].thread, NULL, dump_device, &jobs[i])) {
+            // run it here when no thread is available
+            jobs[i].thread = pthread_self();
+            dump_device(&jobs[i]);
+        }
+    }
+    for (i = 0; i < count; i++) {
+        if (!pthread_equal(jobs[i].thread, pthread_self())) {
+            pthread_join(jobs[i].thread, NULL);
+        }
+    }
+
+    printf("%-32s %-6s %-8s %-10s %s\n", "Device", "Status", "Dwords", "Time(ms)", "Output");
+    for (i = 0; i < count; i++) {
+        printf("%-32s %-6s %-8u %-10.1f %s%s\n", jobs[i].device, jobs[i].rc ? "FAIL" : "OK", jobs[i].dwords,
+               jobs[i].time_us / 1000.0, jobs[i].dwords ? jobs[i].out_path : "-", jobs[i].pinned ? " (NUMA local)" : "");
+        if (jobs[i].rc) {
+            printf("    -E- %s\n", jobs[i].error);
+            failed++;
+        }
+        total_us += jobs[i].time_us;
+    }
+    printf("-I- Dumped %d/%d devices in %.1f ms (%.1f ms one after the other)\n", count - failed, count,
+           (mono_time_us() - start) / 1000.0, total_us / 1000.0);
+    free(jobs);
+    return failed ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
@@ -72,11 +777,41 @@ int main(int argc, char *argv[])
     int rc;
     int full = 0;
     int cause_addr = -1, cause_off = -1;
+    int max_gap = 0;
     crd_ctxt_t *context;
     u_int32_t arr_size = 0;
     char *endptr;
     u_int8_t new_i2c_slave = 0;
     char device[MAX_DEV_LEN] = {0};
+    const char *bin_path = NULL;
+    const char *decode_path = NULL;
+    crd_bin_info_t bin_info;
+    u_int32_t interval_ms = 0;
+    u_int32_t sample_count = 0;
+    u_int32_t key_interval = DEF_KEY_INTERVAL;
+    u_int32_t ring_mb = DEF_RING_MB;
+    u_int32_t seq = 0;
+    long long decode_seq = -1;
+    const char *out_dir = NULL;
+    int bin_bare = 0;
+    dump_job_t opts;
+
+    memset(&bin_info, 0, sizeof(bin_info));
+    // decoding does not access a device
+    for (i = 1; i < argc; ++i) {
+        if (!strncmp(argv[i], DECODE_FLAG "=", strlen(DECODE_FLAG "="))) {
+            decode_path = argv[i] + strlen(DECODE_FLAG "=");
+        } else if (!strncmp(argv[i], SAMPLE_FLAG, strlen(SAMPLE_FLAG))) {
+            if (parse_uint_flag(argv[i], SAMPLE_FLAG, &seq)) {
+                fprintf(stderr, "Invalid parameter to " SAMPLE_FLAG " flag\n");
+                return 1;
+            }
+            decode_seq = seq;
+        }
+    }
+    if (decode_path) {
+        return decode_bin_dump(decode_path, decode_seq);
+    }
 #if defined(__linux__) || defined(__FreeBSD__)
     if (geteuid() != 0) {
         printf("-E- Permission denied: User is not root\n");
@@ -84,7 +819,7 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    if (argc < 2 || argc > 4) {
+    if (argc < 2) {
         fprintf(stderr, "%s", correct_cmdline);
         return 2;
     }
@@ -107,8 +842,58 @@ int main(int argc, char *argv[])
                 fprintf(stderr, "Parameters to " CAUSE_FLAG " flag must be non-negative values\n");
                 exit(1);
             }
+        } else if (!strncmp(argv[i], MAX_GAP_FLAG, strlen(MAX_GAP_FLAG)))   {
+            if (sscanf(argv[i], MAX_GAP_FLAG "=%i", &max_gap) != 1 || max_gap < 0) {
+                fprintf(stderr, "Invalid parameter to " MAX_GAP_FLAG " flag\n");
+                fprintf(stdout, "%s", correct_cmdline);
+                exit(1);
+            }
+        } else if (!strncmp(argv[i], BIN_FLAG "=", strlen(BIN_FLAG "=")) && argv[i][strlen(BIN_FLAG "=")])   {
+            bin_path = argv[i] + strlen(BIN_FLAG "=");
+        } else if (!strcmp(argv[i], BIN_FLAG))   {
+            bin_bare = 1;
+        } else if (!strncmp(argv[i], OUT_DIR_FLAG "=", strlen(OUT_DIR_FLAG "=")) && argv[i][strlen(OUT_DIR_FLAG "=")])   {
+            out_dir = argv[i] + strlen(OUT_DIR_FLAG "=");
+        } else if (!strncmp(argv[i], BIN_FLAG, strlen(BIN_FLAG)))   {
+            fprintf(stderr, "Invalid parameter to " BIN_FLAG " flag\n");
+            fprintf(stdout, "%s", correct_cmdline);
+            exit(1);
+        } else if (!strcmp(argv[i], XZ_FLAG))   {
+            bin_info.flags |= CRD_BIN_FLAG_XZ;
+        } else if (!strncmp(argv[i], INTERVAL_FLAG, strlen(INTERVAL_FLAG)))   {
+            if (parse_uint_flag(argv[i], INTERVAL_FLAG, &interval_ms) || !interval_ms) {
+                fprintf(stderr, "Invalid parameter to " INTERVAL_FLAG " flag\n");
+                exit(1);
+            }
+        } else if (!strncmp(argv[i], COUNT_FLAG, strlen(COUNT_FLAG)))   {
+            if (parse_uint_flag(argv[i], COUNT_FLAG, &sample_count) || !sample_count) {
+                fprintf(stderr, "Invalid parameter to " COUNT_FLAG " flag\n");
+                exit(1);
+            }
+        } else if (!strncmp(argv[i], KEY_FLAG, strlen(KEY_FLAG)))   {
+            if (parse_uint_flag(argv[i], KEY_FLAG, &key_interval) || !key_interval) {
+                fprintf(stderr, "Invalid parameter to " KEY_FLAG " flag\n");
+                exit(1);
+            }
+        } else if (!strncmp(argv[i], RING_FLAG, strlen(RING_FLAG)))   {
+            if (parse_uint_flag(argv[i], RING_FLAG, &ring_mb) || !ring_mb || ring_mb > MAX_RING_MB) {
+                fprintf(stderr, "Invalid parameter to " RING_FLAG " flag, 1 to %d MB\n", MAX_RING_MB);
+                exit(1);
+            }
         }
     }
+    if ((bin_info.flags & CRD_BIN_FLAG_XZ) && !bin_path && !bin_bare) {
+        fprintf(stderr, XZ_FLAG " flag requires the " BIN_FLAG " flag\n");
+        exit(1);
+    }
+    if (interval_ms && !bin_path) {
+        fprintf(stderr, INTERVAL_FLAG " flag requires the " BIN_FLAG " flag\n");
+        exit(1);
+    }
+    if (interval_ms && (bin_info.flags & CRD_BIN_FLAG_XZ)) {
+        fprintf(stderr, XZ_FLAG " flag is not supported with the " INTERVAL_FLAG " flag\n");
+        exit(1);
+    }
 
     i = 1;  // i points to the current command line argument
 
@@ -122,13 +907,34 @@ int main(int argc, char *argv[])
         return 1;
     }
     strncpy(device, argv[i], MAX_DEV_LEN - 1);
+    if (!strcmp(device, ALL_DEVICES) || count_devices(device) > 1) {
+        while (++i < argc && is_dump_flag(argv[i])) {
+        }
+        if (i < argc || bin_path || interval_ms) {
+            fprintf(stderr, "Multiple devices are dumped only to files in " OUT_DIR_FLAG
+                    ", without i2c-slave, " BIN_FLAG "=<file> or " INTERVAL_FLAG "\n");
+            return 1;
+        }
+        memset(&opts, 0, sizeof(opts));
+        opts.full = full;
+        opts.cause_addr = cause_addr;
+        opts.cause_off = cause_off;
+        opts.max_gap = max_gap;
+        opts.binary = bin_bare || (bin_info.flags & CRD_BIN_FLAG_XZ);
+        opts.bin_flags = bin_info.flags;
+        return dump_devices(device, out_dir ? out_dir : ".", &opts);
+    }
+    if (bin_bare || out_dir) {
+        fprintf(stderr, BIN_FLAG " without a file and " OUT_DIR_FLAG " apply only to multiple devices\n");
+        return 1;
+    }
     if (!( mf = mopen_adv((const char*)device, (MType)(MST_DEFAULT | MST_CABLE)))) {
         fprintf(stderr, "Unable to open device %s. Exiting.\n", argv[i]);
         return 1;
     }
     ++i;    // move past the device parameter
 
-    if (i < argc && !strncmp(argv[i], CAUSE_FLAG, strlen(CAUSE_FLAG))) {
+    while (i < argc && is_dump_flag(argv[i])) {
         i++;
     }
     if (i < argc) {
@@ -149,6 +955,13 @@ int main(int argc, char *argv[])
             return 1;
         }
     }
+    if (bin_path) {
+        // query the device before crd_init() moves to the cr-space
+        get_bin_info(mf, &bin_info);
+        if (full) {
+            bin_info.flags |= CRD_BIN_FLAG_FULL;
+        }
+    }
     rc = CRD_OK;
     rc = crd_init(&context, mf, full, cause_addr, cause_off, NULL);
     if (rc) {
@@ -156,6 +969,15 @@ int main(int argc, char *argv[])
         goto error;
     }
 
+    if (max_gap) {
+        rc = crd_set_max_gap(context, max_gap);
+        if (rc) {
+            crd_free(context);
+            mclose(mf);
+            goto error;
+        }
+    }
+
     //printf("Number of blocks : 0x%d\n",(context)->block_count);
 
     rc = crd_get_dword_num(context, &arr_size);
@@ -165,17 +987,42 @@ int main(int argc, char *argv[])
         goto error;
     }
 
-    rc = crd_dump_data(context, NULL, print_dword);
+    if (interval_ms) {
+        rc = sample_dumps(context, arr_size, bin_path, &bin_info, interval_ms, sample_count, key_interval,
+                          (u_int64_t)ring_mb << 20);
+    } else if (bin_path) {
+        bin_dwords = (crd_dword_t*)malloc(sizeof(crd_dword_t) * (arr_size + 1));
+        if (bin_dwords == NULL) {
+            rc = CRD_MEM_ALLOCATION_ERR;
+            crd_free(context);
+            mclose(mf);
+            goto error;
+        }
+        bin_size = arr_size;
+        // the dwords read before a failure are written as well, like the text output
+        rc = crd_dump_data(context, NULL, collect_dword);
+        if (write_bin_dump(bin_path, &bin_info, bin_dwords, bin_count) && !rc) {
+            free(bin_dwords);
+            crd_free(context);
+            mclose(mf);
+            return 1;
+        }
+        free(bin_dwords);
+    } else {
+        rc = crd_dump_data(context, NULL, print_dword);
+    }
     if (rc) {
         crd_free(context);
         mclose(mf);
         goto error;
     }
+    flush_dwords();
     crd_free(context);
     mclose(mf);
     return 0;
 
 error:
+    flush_dwords();
     printf("-E- %s\n", crd_err_str(rc));
     return rc;
 }
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * ibmad_stub.c - A libibmad replacement for testing the in-band access
+ * without a fabric, loaded by mtcr through MTCR_IBMAD_LIB.
+ *
+ * The device is a 1MB CR-Space in memory. The synchronous calls
+ * (smp_query_via()/smp_set_via()/ib_vendor_call_via()) access it directly,
+ * the umad calls queue one response per sent MAD and deliver them according
+ * to the environment:
+ *
+ *   STUB_IBMAD_ORDER  fifo (default), lifo or random response order
+ *   STUB_IBMAD_DROP   the n-th sent MAD (1 based) is lost: umad_recv()
+ *                     returns it timed out and the device response is
+ *                     delivered later, with the stale transaction id
+ *   STUB_IBMAD_MKEY   the M_Key of the port, SMPs carrying another key
+ *                     are dropped like the SMA does
+ *
+ * stub_ibmad_get_stats() returns the counters of the MADs sent through umad.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <infiniband/mad.h>
+#include "ibmad_stub.h"
+
+#define STUB_CR_SIZE        0x100000
+#define STUB_DATA_INDEX     8
+#define STUB_MAX_PENDING    256
+#define STUB_SMP_CR_ACCESS  0xff50
+#define STUB_VS_CR_ACCESS   0x50
+#define STUB_DEVID_ADDR     0xf0014
+#define STUB_DEVID          0x1017
+
+enum {
+    STUB_ORDER_FIFO,
+    STUB_ORDER_LIFO,
+    STUB_ORDER_RANDOM
+};
+
+struct stub_umad {
+    int status;
+    int length;
+    u_int8_t mad[];
+};
+
+/* The header of the MADs built by mad_build_pkt(), the data starts at rpc->dataoffs */
+struct stub_mad_hdr {
+    u_int64_t trid;
+    u_int64_t mkey;
+    u_int32_t attr_mod;
+    u_int16_t attr_id;
+    u_int8_t method;
+    u_int8_t status;
+};
+
+struct stub_pending {
+    int status;
+    int late;
+    u_int8_t mad[IB_MAD_SIZE];
+};
+
+struct ibmad_port {
+    int order;
+    int drop;
+    u_int64_t mkey;
+};
+
+static struct ibmad_port stub_port;
+static u_int32_t stub_cr[STUB_CR_SIZE / 4];
+static int stub_cr_init;
+static struct stub_pending stub_pending[STUB_MAX_PENDING];
+static int stub_pending_num;
+static int stub_outstanding;
+static struct stub_pending stub_late;
+static int stub_late_valid;
+static u_int64_t stub_trid;
+static stub_ibmad_stats stub_stats;
+
+int ibdebug;
+
+void stub_ibmad_get_stats(stub_ibmad_stats *stats)
+{
+    *stats = stub_stats;
+}
+
+static u_int32_t stub_cr_addr(u_int32_t mod)
+{
+    return ((mod & 0xffff) | (((mod >> 24) & 0xff) << 16)) % STUB_CR_SIZE;
+}
+
+/* data points to the vkey followed by the dwords, in big endian */
+static void stub_cr_access(int method, u_int32_t addr, int dwords, u_int8_t *data)
+{
+    u_int32_t *dw = (u_int32_t*)(data + STUB_DATA_INDEX);
+    int i;
+
+    for (i = 0; i < dwords; i++, addr = (addr + 4) % STUB_CR_SIZE) {
+        if (method == IB_MAD_METHOD_GET) {
+            dw[i] = htonl(stub_cr[addr / 4]);
+        } else {
+            stub_cr[addr / 4] = ntohl(dw[i]);
+        }
+    }
+}
+
+struct ibmad_port* mad_rpc_open_port(char *dev_name, int dev_port, int *mgmt_classes, int num_classes)
+{
+    const char *order = getenv("STUB_IBMAD_ORDER");
+    const char *drop = getenv("STUB_IBMAD_DROP");
+    const char *mkey = getenv("STUB_IBMAD_MKEY");
+    u_int32_t i;
+
+    (void)dev_name;
+    (void)dev_port;
+    (void)mgmt_classes;
+    (void)num_classes;
+    if (!stub_cr_init) {
+        for (i = 0; i < STUB_CR_SIZE / 4; i++) {
+            stub_cr[i] = i * 2654435761U;
+        }
+        stub_cr[STUB_DEVID_ADDR / 4] = STUB_DEVID;
+        stub_cr_init = 1;
+    }
+    memset(&stub_port, 0, sizeof(stub_port));
+    if (order && !strcmp(order, "lifo")) {
+        stub_port.order = STUB_ORDER_LIFO;
+    } else if (order && !strcmp(order, "random")) {
+        stub_port.order = STUB_ORDER_RANDOM;
+    }
+    stub_port.drop = drop ? atoi(drop) : 0;
+    stub_port.mkey = mkey ? strtoull(mkey, NULL, 0) : 0;
+    memset(&stub_stats, 0, sizeof(stub_stats));
+    stub_pending_num = 0;
+    stub_outstanding = 0;
+    stub_late_valid = 0;
+    srand(1);
+    return &stub_port;
+}
+
+void mad_rpc_close_port(struct ibmad_port *srcport)
+{
+    (void)srcport;
+}
+
+void mad_rpc_set_retries(struct ibmad_port *port, int retries)
+{
+    (void)port;
+    (void)retries;
+}
+
+void mad_rpc_set_timeout(struct ibmad_port *port, int timeout)
+{
+    (void)port;
+    (void)timeout;
+}
+
+int mad_rpc_portid(struct ibmad_port *srcport)
+{
+    (void)srcport;
+    return 3;
+}
+
+int mad_rpc_class_agent(struct ibmad_port *srcport, int cls)
+{
+    (void)srcport;
+    return cls;
+}
+
+uint64_t smp_mkey_get(const struct ibmad_port *srcport)
+{
+    return srcport->mkey;
+}
+
+int ib_resolve_portid_str_via(ib_portid_t *portid, char *addr_str, enum MAD_DEST dest, ib_portid_t *sm_id,
+                              const struct ibmad_port *srcport)
+{
+    (void)sm_id;
+    (void)srcport;
+    memset(portid, 0, sizeof(*portid));
+    if (dest == IB_DEST_DRPATH) {
+        portid->drpath.drslid = 0xffff;
+        portid->drpath.drdlid = 0xffff;
+    } else {
+        portid->lid = strtol(addr_str, NULL, 0);
+    }
+    return 0;
+}
+
+char* portid2str(ib_portid_t *portid)
+{
+    static char buf[32];
+    snprintf(buf, sizeof(buf), "Lid %d", portid->lid);
+    return buf;
+}
+
+uint8_t* smp_query_via(void *buf, ib_portid_t *id, unsigned attrid, unsigned mod, unsigned timeout,
+                       const struct ibmad_port *srcport)
+{
+    (void)id;
+    (void)timeout;
+    (void)srcport;
+    if (attrid != STUB_SMP_CR_ACCESS) {
+        return NULL;
+    }
+    stub_cr_access(IB_MAD_METHOD_GET, stub_cr_addr(mod), (mod >> 16) & 0x3f, (u_int8_t*)buf);
+    return (uint8_t*)buf;
+}
+
+uint8_t* smp_set_via(void *buf, ib_portid_t *id, unsigned attrid, unsigned mod, unsigned timeout,
+                     const struct ibmad_port *srcport)
+{
+    (void)id;
+    (void)timeout;
+    (void)srcport;
+    if (attrid != STUB_SMP_CR_ACCESS) {
+        return NULL;
+    }
+    stub_cr_access(IB_MAD_METHOD_SET, stub_cr_addr(mod), (mod >> 16) & 0x3f, (u_int8_t*)buf);
+    return (uint8_t*)buf;
+}
+
+uint8_t* ib_vendor_call_via(void *data, ib_portid_t *portid, ib_vendor_call_t *call, struct ibmad_port *srcport)
+{
+    (void)portid;
+    (void)srcport;
+    if (call->attrid != STUB_VS_CR_ACCESS) {
+        return NULL;
+    }
+    stub_cr_access(call->method, stub_cr_addr(call->mod), (call->mod >> 16) & 0xff, (u_int8_t*)data);
+    return (uint8_t*)data;
+}
+
+uint32_t mad_get_field(void *buf, int base_offs, enum MAD_FIELDS field)
+{
+    struct stub_mad_hdr *hdr = (struct stub_mad_hdr*)((u_int8_t*)buf + base_offs);
+
+    switch (field) {
+    case IB_MAD_STATUS_F:
+    case IB_DRSMP_STATUS_F:
+        return hdr->status;
+
+    case IB_NODE_DEVID_F:
+        return STUB_DEVID;
+
+    default:
+        return 0;
+    }
+}
+
+uint64_t mad_get_field64(void *buf, int base_offs, enum MAD_FIELDS field)
+{
+    struct stub_mad_hdr *hdr = (struct stub_mad_hdr*)((u_int8_t*)buf + base_offs);
+    return field == IB_MAD_TRID_F ? hdr->trid : 0;
+}
+
+uint64_t mad_trid(void)
+{
+    return ++stub_trid;
+}
+
+int mad_build_pkt(void *umad, ib_rpc_t *rpc, ib_portid_t *dport, ib_rmpp_hdr_t *rmpp, void *data)
+{
+    struct stub_umad *u = (struct stub_umad*)umad;
+    struct stub_mad_hdr *hdr = (struct stub_mad_hdr*)u->mad;
+
+    (void)dport;
+    (void)rmpp;
+    if (rpc->dataoffs < sizeof(*hdr) || rpc->dataoffs + rpc->datasz > IB_MAD_SIZE) {
+        return -1;
+    }
+    hdr->trid = rpc->trid;
+    hdr->mkey = rpc->mkey;
+    hdr->attr_mod = rpc->attr.mod;
+    hdr->attr_id = (u_int16_t)rpc->attr.id;
+    hdr->method = (u_int8_t)rpc->method;
+    hdr->status = 0;
+    if (rpc->mgtclass == IB_SMI_CLASS || rpc->mgtclass == IB_SMI_DIRECT_CLASS) {
+        hdr->method |= 0x80;    // mark as SMP for the M_Key check
+    }
+    memcpy(u->mad + rpc->dataoffs, data, rpc->datasz);
+    u->length = rpc->dataoffs;
+    return IB_MAD_SIZE;
+}
+
+size_t umad_size(void)
+{
+    return sizeof(struct stub_umad);
+}
+
+void* umad_get_mad(void *umad)
+{
+    return ((struct stub_umad*)umad)->mad;
+}
+
+int umad_status(void *umad)
+{
+    return ((struct stub_umad*)umad)->status;
+}
+
+int umad_send(int fd, int agentid, void *umad, int length, int timeout_ms, int retries)
+{
+    struct stub_umad *u = (struct stub_umad*)umad;
+    struct stub_mad_hdr *hdr = (struct stub_mad_hdr*)u->mad;
+    struct stub_pending *resp;
+    int is_smp = hdr->method & 0x80;
+    int method = hdr->method & 0x7f;
+    int dwords = (hdr->attr_mod >> 16) & (is_smp ? 0x3f : 0xff);
+    u_int16_t attr_id = is_smp ? STUB_SMP_CR_ACCESS : STUB_VS_CR_ACCESS;
+
+    (void)fd;
+    (void)agentid;
+    (void)length;
+    (void)timeout_ms;
+    (void)retries;
+    if (stub_pending_num == STUB_MAX_PENDING || hdr->attr_id != attr_id) {
+        errno = EINVAL;
+        return -1;
+    }
+    stub_stats.sends++;
+    resp = &stub_pending[stub_pending_num++];
+    memcpy(resp->mad, u->mad, IB_MAD_SIZE);
+    resp->status = 0;
+    resp->late = 0;
+    if (++stub_outstanding > stub_stats.max_outstanding) {
+        stub_stats.max_outstanding = stub_outstanding;
+    }
+    if (is_smp && hdr->mkey != stub_port.mkey) {
+        stub_stats.mkey_errors++;
+        resp->status = ETIMEDOUT;
+        return 0;
+    }
+    if (stub_stats.sends == stub_port.drop) {
+        // the response arrives after the kernel timed out the request
+        resp->status = ETIMEDOUT;
+        stub_late = *resp;
+        stub_late.status = 0;
+        stub_late.late = 1;
+        stub_late_valid = 1;
+        stub_cr_access(method, stub_cr_addr(hdr->attr_mod), dwords, stub_late.mad + u->length);
+        return 0;
+    }
+    stub_cr_access(method, stub_cr_addr(hdr->attr_mod), dwords, resp->mad + u->length);
+    return 0;
+}
+
+int umad_recv(int fd, void *umad, int *length, int timeout_ms)
+{
+    struct stub_umad *u = (struct stub_umad*)umad;
+    int i;
+
+    (void)fd;
+    (void)timeout_ms;
+    if (!stub_pending_num) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    switch (stub_port.order) {
+    case STUB_ORDER_LIFO:
+        i = stub_pending_num - 1;
+        break;
+
+    case STUB_ORDER_RANDOM:
+        i = rand() % stub_pending_num;
+        break;
+
+    default:
+        i = 0;
+    }
+    u->status = stub_pending[i].status;
+    memcpy(u->mad, stub_pending[i].mad, IB_MAD_SIZE);
+    if (stub_pending[i].late) {
+        stub_stats.stale++;
+    } else {
+        stub_outstanding--;
+    }
+    memmove(&stub_pending[i], &stub_pending[i + 1], (stub_pending_num - i - 1) * sizeof(stub_pending[0]));
+    stub_pending_num--;
+    if (u->status) {
+        stub_stats.timeouts++;
+        if (stub_late_valid) {
+            // the device response of the lost MAD follows its timeout
+            stub_pending[stub_pending_num++] = stub_late;
+            stub_late_valid = 0;
+        }
+    }
+    *length = IB_MAD_SIZE;
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mib_window_test.c - checks the windowed in-band block access against the
+ * dword access, over the libibmad stub (ibmad_stub.so), for SMP and VS MADs,
+ * several window sizes, in order/reordered responses and a lost MAD:
+ *
+ *   mib_window_test [stub library path]
+ *
+ * Exits with 1 on the first failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "mtcr.h"
+#include "ibmad_stub.h"
+
+#define TEST_OFFSET 0x10000
+#define TEST_SIZE   (8192 + 20)
+#define TEST_MKEY   "0x1234abcd5678ef01"
+
+static f_stub_ibmad_get_stats get_stats;
+
+static int check_block(mfile *mf, u_int32_t *data, const char *what)
+{
+    u_int32_t val;
+    int i;
+
+    for (i = 0; i < TEST_SIZE / 4; i++) {
+        if (mread4(mf, TEST_OFFSET + i * 4, &val) != 4) {
+            fprintf(stderr, "-E- %s: mread4 failed\n", what);
+            return 1;
+        }
+        if (val != data[i]) {
+            fprintf(stderr, "-E- %s: 0x%x: 0x%08x, expected 0x%08x\n", what, TEST_OFFSET + i * 4, data[i], val);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_stats(const char *what, int window, int drop)
+{
+    stub_ibmad_stats stats;
+
+    get_stats(&stats);
+    if (window == 1) {
+        if (stats.sends) {
+            fprintf(stderr, "-E- %s: window 1 used the windowed access\n", what);
+            return 1;
+        }
+        return 0;
+    }
+    if (stats.max_outstanding > window || stats.max_outstanding < 2) {
+        fprintf(stderr, "-E- %s: %d MADs outstanding\n", what, stats.max_outstanding);
+        return 1;
+    }
+    if (stats.mkey_errors) {
+        fprintf(stderr, "-E- %s: %d SMPs with a wrong M_Key\n", what, stats.mkey_errors);
+        return 1;
+    }
+    if (stats.timeouts != (drop ? 1 : 0)) {
+        fprintf(stderr, "-E- %s: %d MADs timed out\n", what, stats.timeouts);
+        return 1;
+    }
+    return 0;
+}
+
+static int run_case(const char *dev, int window, const char *order, int drop)
+{
+    u_int32_t data[TEST_SIZE / 4];
+    char what[128];
+    char val[16];
+    mfile *mf;
+    int rc = 1;
+    int i;
+
+    snprintf(what, sizeof(what), "%s window %d %s drop %d", dev, window, order, drop);
+    snprintf(val, sizeof(val), "%d", window);
+    setenv("MTCR_IB_WINDOW", val, 1);
+    snprintf(val, sizeof(val), "%d", drop);
+    setenv("STUB_IBMAD_DROP", val, 1);
+    setenv("STUB_IBMAD_ORDER", order, 1);
+    if (!(mf = mopen(dev))) {
+        fprintf(stderr, "-E- %s: mopen failed\n", what);
+        return 1;
+    }
+
+    memset(data, 0, sizeof(data));
+    if (mread4_block(mf, TEST_OFFSET, data, TEST_SIZE) != TEST_SIZE) {
+        fprintf(stderr, "-E- %s: read failed\n", what);
+        goto cleanup;
+    }
+    if (check_stats(what, window, drop) || check_block(mf, data, what)) {
+        goto cleanup;
+    }
+
+    // the stub counters are reset by the open
+    mclose(mf);
+    if (!(mf = mopen(dev))) {
+        fprintf(stderr, "-E- %s: mopen failed\n", what);
+        return 1;
+    }
+    for (i = 0; i < TEST_SIZE / 4; i++) {
+        data[i] = (u_int32_t)rand();
+    }
+    if (mwrite4_block(mf, TEST_OFFSET, data, TEST_SIZE) != TEST_SIZE) {
+        fprintf(stderr, "-E- %s: write failed\n", what);
+        goto cleanup;
+    }
+    if (check_stats(what, window, drop) || check_block(mf, data, what)) {
+        goto cleanup;
+    }
+    printf("%-32s OK\n", what);
+    rc = 0;
+
+cleanup:
+    mclose(mf);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *devs[] = {"ibdr-0", "lid-1"};
+    static const int windows[] = {1, 2, 4, 16, 64};
+    static const char *orders[] = {"fifo", "lifo", "random"};
+    static const int drops[] = {0, 1, 5};
+    const char *lib = argc > 1 ? argv[1] : "./ibmad_stub.so";
+    void *handle;
+    unsigned int d, w, o, r;
+
+    // mtcr loads the same instance
+    if (!(handle = dlopen(lib, RTLD_NOW)) ||
+        !(get_stats = (f_stub_ibmad_get_stats)dlsym(handle, "stub_ibmad_get_stats"))) {
+        fprintf(stderr, "-E- Failed to load %s: %s\n", lib, dlerror());
+        return 1;
+    }
+    setenv("MTCR_IBMAD_LIB", lib, 1);
+    setenv("STUB_IBMAD_MKEY", TEST_MKEY, 1);
+    for (d = 0; d < sizeof(devs) / sizeof(devs[0]); d++) {
+        for (w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+            for (o = 0; o < sizeof(orders) / sizeof(orders[0]); o++) {
+                for (r = 0; r < sizeof(drops) / sizeof(drops[0]); r++) {
+                    if (windows[w] == 1 && (o || r)) {
+                        continue;
+                    }
+                    if (run_case(devs[d], windows[w], orders[o], drops[r])) {
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    dlclose(handle);
+    return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * msession_test.c - runs several threads over one msession wrapping a stub
+ * mfile whose address spaces are separate memories. Every thread works on
+ * its own address space with dword, block and locked read-modify-write
+ * transactions and checks what it reads back:
+ *
+ *   msession_test [threads] [iterations]
+ *
+ * The stub also checks that gateway accesses never overlap and that no
+ * write lands in another thread's space. Exits with 1 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include "mtcr.h"
+#include "mtcr_mf.h"
+#include "mtcr_int_defs.h"
+#include "mtcr_session.h"
+
+#define SPACE_SIZE    0x4000
+#define COUNTER_ADDR  0x0
+#define PRIVATE_BASE  0x1000
+#define PRIVATE_SIZE  0x100
+#define PATTERN_BASE  0x2000
+#define BLOCK_SIZE    64
+#define MAX_THREADS   ((PATTERN_BASE - PRIVATE_BASE) / PRIVATE_SIZE)
+
+static const int test_spaces[] = {AS_CR_SPACE, AS_ICMD, AS_ICMD_EXT, AS_SEMAPHORE};
+#define NUM_SPACES ((int)(sizeof(test_spaces) / sizeof(test_spaces[0])))
+
+static u_int32_t *banks[AS_END];
+static volatile int in_flight;
+static volatile int overlaps;
+
+static u_int32_t pattern(int space, unsigned int offset)
+{
+    return 0x5a000000 ^ ((u_int32_t)space << 16) ^ offset;
+}
+
+/*
+ * Stub gateway: a transaction must have the mfile for itself from the space
+ * switch to the restore, yield in the middle to let the threads interleave.
+ */
+static u_int32_t* stub_enter(mfile *mf, unsigned int offset, int byte_len)
+{
+    if (__sync_add_and_fetch(&in_flight, 1) != 1) {
+        __sync_add_and_fetch(&overlaps, 1);
+    }
+    sched_yield();
+    if (!banks[mf->address_space] || offset % 4 || offset + byte_len > SPACE_SIZE) {
+        return NULL;
+    }
+    return banks[mf->address_space] + offset / 4;
+}
+
+static void stub_leave(void)
+{
+    __sync_sub_and_fetch(&in_flight, 1);
+}
+
+static int stub_mread4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    u_int32_t *p = stub_enter(mf, offset, byte_len);
+    if (p) {
+        memcpy(data, p, byte_len);
+    }
+    stub_leave();
+    return p ? byte_len : -1;
+}
+
+static int stub_mwrite4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    u_int32_t *p = stub_enter(mf, offset, byte_len);
+    if (p) {
+        memcpy(p, data, byte_len);
+    }
+    stub_leave();
+    return p ? byte_len : -1;
+}
+
+static int stub_mread4(mfile *mf, unsigned int offset, u_int32_t *value)
+{
+    return stub_mread4_block(mf, offset, value, 4);
+}
+
+static int stub_mwrite4(mfile *mf, unsigned int offset, u_int32_t value)
+{
+    return stub_mwrite4_block(mf, offset, &value, 4);
+}
+
+typedef struct thread_ctx {
+    msession *ms;
+    int id;
+    int space;
+    int iterations;
+    int increments;
+    int errors;
+} thread_ctx_t;
+
+#define CHECK(ctx, cond, ...) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "-E- thread %d space 0x%x: ", (ctx)->id, (ctx)->space); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            (ctx)->errors++; \
+            return -1; \
+        } \
+    } while (0)
+
+static int locked_increment(thread_ctx_t *ctx, unsigned int priv)
+{
+    u_int32_t val, tmp;
+
+    CHECK(ctx, msession_read4(ctx->ms, AS_CR_SPACE, COUNTER_ADDR, &val) == 4, "counter read failed");
+    CHECK(ctx, msession_read4(ctx->ms, ctx->space, priv, &tmp) == 4, "read4 0x%x failed", priv);
+    CHECK(ctx, msession_write4(ctx->ms, AS_CR_SPACE, COUNTER_ADDR, val + 1) == 4, "counter write failed");
+    return 0;
+}
+
+static int run_iteration(thread_ctx_t *ctx, int iter, unsigned int *seed)
+{
+    unsigned int priv = PRIVATE_BASE + ctx->id * PRIVATE_SIZE;
+    unsigned int off = PATTERN_BASE + (rand_r(seed) % ((SPACE_SIZE - PATTERN_BASE - BLOCK_SIZE) / 4)) * 4;
+    u_int32_t wdata[BLOCK_SIZE / 4];
+    u_int32_t rdata[BLOCK_SIZE / 4];
+    u_int32_t val;
+    int i;
+
+    // read only data of the thread's space
+    CHECK(ctx, msession_read4(ctx->ms, ctx->space, off, &val) == 4, "read4 0x%x failed", off);
+    CHECK(ctx, val == pattern(ctx->space, off), "read4 0x%x: 0x%08x, expected 0x%08x", off, val,
+          pattern(ctx->space, off));
+    CHECK(ctx, msession_read4_block(ctx->ms, ctx->space, off, rdata, BLOCK_SIZE) == BLOCK_SIZE,
+          "read4_block 0x%x failed", off);
+    for (i = 0; i < BLOCK_SIZE / 4; i++) {
+        CHECK(ctx, rdata[i] == pattern(ctx->space, off + i * 4), "read4_block 0x%x: 0x%08x, expected 0x%08x",
+              off + i * 4, rdata[i], pattern(ctx->space, off + i * 4));
+    }
+
+    // the handle is back on the cr-space between transactions
+    CHECK(ctx, msession_read4(ctx->ms, MSESSION_CURR_SPACE, off, &val) == 4, "read4 0x%x failed", off);
+    CHECK(ctx, val == pattern(AS_CR_SPACE, off), "current space read4 0x%x: 0x%08x, expected 0x%08x", off, val,
+          pattern(AS_CR_SPACE, off));
+
+    // the thread's own words
+    val = ((u_int32_t)ctx->id << 24) | iter;
+    CHECK(ctx, msession_write4(ctx->ms, ctx->space, priv, val) == 4, "write4 0x%x failed", priv);
+    CHECK(ctx, msession_read4(ctx->ms, ctx->space, priv, &rdata[0]) == 4, "read4 0x%x failed", priv);
+    CHECK(ctx, rdata[0] == val, "read4 0x%x: 0x%08x, expected 0x%08x", priv, rdata[0], val);
+    for (i = 0; i < BLOCK_SIZE / 4; i++) {
+        wdata[i] = (u_int32_t)rand_r(seed);
+    }
+    CHECK(ctx, msession_write4_block(ctx->ms, ctx->space, priv + 4, wdata, BLOCK_SIZE) == BLOCK_SIZE,
+          "write4_block 0x%x failed", priv + 4);
+    CHECK(ctx, msession_read4_block(ctx->ms, ctx->space, priv + 4, rdata, BLOCK_SIZE) == BLOCK_SIZE,
+          "read4_block 0x%x failed", priv + 4);
+    CHECK(ctx, !memcmp(wdata, rdata, BLOCK_SIZE), "read4_block 0x%x differs from the written data", priv + 4);
+
+    // a locked sequence: cr-space counter increment with a nested transaction on the thread's space
+    if (iter % 8 == 0) {
+        int locked_rc;
+        msession_lock(ctx->ms);
+        locked_rc = locked_increment(ctx, priv);
+        msession_unlock(ctx->ms);
+        if (locked_rc) {
+            return -1;
+        }
+        ctx->increments++;
+    }
+    return 0;
+}
+
+static void* thread_main(void *arg)
+{
+    thread_ctx_t *ctx = (thread_ctx_t*)arg;
+    unsigned int seed = ctx->id + 1;
+    int iter;
+
+    for (iter = 0; iter < ctx->iterations; iter++) {
+        if (run_iteration(ctx, iter, &seed)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* Every private region a thread does not own must still hold the initial pattern */
+static int check_isolation(thread_ctx_t *ctxs, int num_threads)
+{
+    unsigned int off, end;
+    int s, t;
+
+    for (s = 0; s < NUM_SPACES; s++) {
+        for (t = 0; t < MAX_THREADS; t++) {
+            if (t < num_threads && ctxs[t].space == test_spaces[s]) {
+                continue;
+            }
+            end = PRIVATE_BASE + (t + 1) * PRIVATE_SIZE;
+            for (off = end - PRIVATE_SIZE; off < end; off += 4) {
+                if (banks[test_spaces[s]][off / 4] != pattern(test_spaces[s], off)) {
+                    fprintf(stderr, "-E- space 0x%x: 0x%x was written by another space\n", test_spaces[s], off);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int num_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+    thread_ctx_t ctxs[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    ul_ctx_t ul_ctx;
+    mfile mf;
+    msession *ms;
+    u_int32_t val;
+    unsigned int off;
+    int increments = 0;
+    int created = 0;
+    int rc = 1;
+    int i;
+
+    if (num_threads < 1 || num_threads > MAX_THREADS || iterations < 1) {
+        fprintf(stderr, "-E- Usage: %s [threads 1-%d] [iterations]\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+    for (i = 0; i < NUM_SPACES; i++) {
+        banks[test_spaces[i]] = (u_int32_t*)malloc(SPACE_SIZE);
+        if (!banks[test_spaces[i]]) {
+            fprintf(stderr, "-E- Out of memory\n");
+            return 1;
+        }
+        for (off = 0; off < SPACE_SIZE; off += 4) {
+            banks[test_spaces[i]][off / 4] = pattern(test_spaces[i], off);
+        }
+    }
+    banks[AS_CR_SPACE][COUNTER_ADDR / 4] = 0;
+
+    memset(&ul_ctx, 0, sizeof(ul_ctx));
+    ul_ctx.mread4 = stub_mread4;
+    ul_ctx.mwrite4 = stub_mwrite4;
+    ul_ctx.mread4_block = stub_mread4_block;
+    ul_ctx.mwrite4_block = stub_mwrite4_block;
+    memset(&mf, 0, sizeof(mf));
+    mf.tp = MST_PCICONF;
+    mf.ul_ctx = &ul_ctx;
+    mf.vsec_supp = 1;
+    mf.vsec_cap_mask = (1 << VCC_INITIALIZED) | (1 << VCC_CRSPACE_SPACE_SUPPORTED) |
+                       (1 << VCC_ICMD_SPACE_SUPPORTED) | (1 << VCC_ICMD_EXT_SPACE_SUPPORTED) |
+                       (1 << VCC_SEMAPHORE_SPACE_SUPPORTED);
+    mf.address_space = AS_CR_SPACE;
+
+    if (!(ms = msession_attach(&mf))) {
+        fprintf(stderr, "-E- msession_attach failed\n");
+        goto cleanup;
+    }
+
+    // a space the device does not have fails without touching the handle
+    errno = 0;
+    if (msession_read4(ms, AS_MAC, PATTERN_BASE, &val) != -1 || errno != ENOTSUP ||
+        mf.address_space != AS_CR_SPACE) {
+        fprintf(stderr, "-E- access to an unsupported space did not fail\n");
+        goto cleanup;
+    }
+
+    memset(ctxs, 0, sizeof(ctxs));
+    for (i = 0; i < num_threads; i++) {
+        ctxs[i].ms = ms;
+        ctxs[i].id = i;
+        ctxs[i].space = test_spaces[i % NUM_SPACES];
+        ctxs[i].iterations = iterations;
+        if (pthread_create(&threads[i], NULL, thread_main, &ctxs[i])) {
+            fprintf(stderr, "-E- pthread_create failed\n");
+            break;
+        }
+        created++;
+    }
+    for (i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (created != num_threads) {
+        goto cleanup;
+    }
+    for (i = 0; i < num_threads; i++) {
+        if (ctxs[i].errors) {
+            goto cleanup;
+        }
+        increments += ctxs[i].increments;
+    }
+
+    if (overlaps) {
+        fprintf(stderr, "-E- %d overlapping gateway accesses\n", overlaps);
+        goto cleanup;
+    }
+    if (mf.address_space != AS_CR_SPACE) {
+        fprintf(stderr, "-E- the handle was left on space 0x%x\n", mf.address_space);
+        goto cleanup;
+    }
+    if (banks[AS_CR_SPACE][COUNTER_ADDR / 4] != (u_int32_t)increments) {
+        fprintf(stderr, "-E- counter is %u, expected %d increments\n", banks[AS_CR_SPACE][COUNTER_ADDR / 4],
+                increments);
+        goto cleanup;
+    }
+    if (check_isolation(ctxs, num_threads)) {
+        goto cleanup;
+    }
+    printf("%d threads x %d iterations on %d spaces OK\n", num_threads, iterations, NUM_SPACES);
+    rc = 0;
+
+cleanup:
+    msession_close(ms);
+    for (i = 0; i < NUM_SPACES; i++) {
+        free(banks[test_spaces[i]]);
+    }
+    return rc;
+}
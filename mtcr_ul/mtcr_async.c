@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mtcr_async.c - Asynchronous register access queue.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mtcr.h"
+#include "mtcr_async.h"
+
+typedef struct areg_req {
+    struct areg_req *next;
+    mfile *mf;
+    u_int16_t reg_id;
+    maccess_reg_method_t reg_method;
+    void *reg_data;
+    u_int32_t reg_size;
+    u_int32_t r_size_reg;
+    u_int32_t w_size_reg;
+    int rc;
+    int reg_status;
+    maccess_reg_cb_t cb;
+    void *cb_ctx;
+} areg_req;
+
+typedef struct areg_list {
+    areg_req *head;
+    areg_req *tail;
+} areg_list;
+
+struct maccess_reg_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    areg_list pending;
+    areg_list done;
+    int outstanding;             /* submitted and not yet moved to done */
+    int stop;
+    int num_workers;
+    pthread_t *workers;
+    mfile **busy;                /* mfile currently served by each worker */
+};
+
+static void areg_list_append(areg_list *l, areg_req *r)
+{
+    r->next = NULL;
+    if (l->tail) {
+        l->tail->next = r;
+    } else {
+        l->head = r;
+    }
+    l->tail = r;
+}
+
+static int areg_mf_busy(maccess_reg_queue *q, mfile *mf)
+{
+    int i;
+    for (i = 0; i < q->num_workers; i++) {
+        if (q->busy[i] == mf) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Unlink the first pending request whose mfile is not being served,
+ * keeps the per mfile submission order. Called with the queue locked.
+ */
+static areg_req* areg_take_runnable(maccess_reg_queue *q)
+{
+    areg_req *prev = NULL;
+    areg_req *r;
+    for (r = q->pending.head; r; prev = r, r = r->next) {
+        if (areg_mf_busy(q, r->mf)) {
+            continue;
+        }
+        if (prev) {
+            prev->next = r->next;
+        } else {
+            q->pending.head = r->next;
+        }
+        if (q->pending.tail == r) {
+            q->pending.tail = prev;
+        }
+        r->next = NULL;
+        return r;
+    }
+    return NULL;
+}
+
+typedef struct areg_worker_arg {
+    maccess_reg_queue *q;
+    int idx;
+} areg_worker_arg;
+
+static void* areg_worker(void *arg)
+{
+    maccess_reg_queue *q = ((areg_worker_arg*)arg)->q;
+    int idx = ((areg_worker_arg*)arg)->idx;
+    areg_req *r;
+
+    free(arg);
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        r = areg_take_runnable(q);
+        if (!r) {
+            if (q->stop) {
+                break;
+            }
+            pthread_cond_wait(&q->work_cond, &q->lock);
+            continue;
+        }
+        q->busy[idx] = r->mf;
+        pthread_mutex_unlock(&q->lock);
+
+        r->rc = maccess_reg(r->mf, r->reg_id, r->reg_method, r->reg_data, r->reg_size, r->r_size_reg,
+                            r->w_size_reg, &r->reg_status);
+
+        pthread_mutex_lock(&q->lock);
+        q->busy[idx] = NULL;
+        areg_list_append(&q->done, r);
+        q->outstanding--;
+        pthread_cond_broadcast(&q->done_cond);
+        // requests of this mfile may have been skipped by other workers
+        pthread_cond_broadcast(&q->work_cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+static void areg_stop_workers(maccess_reg_queue *q, int num_started)
+{
+    int i;
+    pthread_mutex_lock(&q->lock);
+    q->stop = 1;
+    pthread_cond_broadcast(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    for (i = 0; i < num_started; i++) {
+        pthread_join(q->workers[i], NULL);
+    }
+}
+
+static void areg_queue_free(maccess_reg_queue *q)
+{
+    pthread_cond_destroy(&q->done_cond);
+    pthread_cond_destroy(&q->work_cond);
+    pthread_mutex_destroy(&q->lock);
+    free(q->busy);
+    free(q->workers);
+    free(q);
+}
+
+maccess_reg_queue* maccess_reg_queue_create(int num_workers)
+{
+    maccess_reg_queue *q;
+    areg_worker_arg *arg;
+    int i;
+
+    if (num_workers <= 0) {
+        num_workers = MACCESS_REG_QUEUE_DEF_WORKERS;
+    }
+    q = (maccess_reg_queue*)calloc(1, sizeof(maccess_reg_queue));
+    if (!q) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    q->num_workers = num_workers;
+    q->workers = (pthread_t*)calloc(num_workers, sizeof(pthread_t));
+    q->busy = (mfile**)calloc(num_workers, sizeof(mfile*));
+    if (!q->workers || !q->busy) {
+        free(q->busy);
+        free(q->workers);
+        free(q);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work_cond, NULL);
+    pthread_cond_init(&q->done_cond, NULL);
+
+    for (i = 0; i < num_workers; i++) {
+        arg = (areg_worker_arg*)malloc(sizeof(areg_worker_arg));
+        if (!arg) {
+            goto create_failed;
+        }
+        arg->q = q;
+        arg->idx = i;
+        if (pthread_create(&q->workers[i], NULL, areg_worker, arg)) {
+            free(arg);
+            goto create_failed;
+        }
+    }
+    return q;
+
+create_failed:
+    areg_stop_workers(q, i);
+    areg_queue_free(q);
+    errno = ENOMEM;
+    return NULL;
+}
+
+int maccess_reg_async(maccess_reg_queue *q, mfile *mf, u_int16_t reg_id, maccess_reg_method_t reg_method,
+                      void *reg_data, u_int32_t reg_size, u_int32_t r_size_reg, u_int32_t w_size_reg,
+                      maccess_reg_cb_t cb, void *cb_ctx)
+{
+    areg_req *r;
+    if (!q || !mf || !reg_data) {
+        errno = EINVAL;
+        return -1;
+    }
+    r = (areg_req*)calloc(1, sizeof(areg_req));
+    if (!r) {
+        errno = ENOMEM;
+        return -1;
+    }
+    r->mf = mf;
+    r->reg_id = reg_id;
+    r->reg_method = reg_method;
+    r->reg_data = reg_data;
+    r->reg_size = reg_size;
+    r->r_size_reg = r_size_reg;
+    r->w_size_reg = w_size_reg;
+    r->cb = cb;
+    r->cb_ctx = cb_ctx;
+
+    pthread_mutex_lock(&q->lock);
+    areg_list_append(&q->pending, r);
+    q->outstanding++;
+    pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+static int areg_complete(areg_req *r)
+{
+    int cnt = 0;
+    areg_req *next;
+    for (; r; r = next) {
+        next = r->next;
+        if (r->cb) {
+            r->cb(r->rc, r->reg_status, r->reg_data, r->cb_ctx);
+        }
+        free(r);
+        cnt++;
+    }
+    return cnt;
+}
+
+int maccess_reg_poll(maccess_reg_queue *q)
+{
+    areg_req *r;
+    if (!q) {
+        return 0;
+    }
+    pthread_mutex_lock(&q->lock);
+    r = q->done.head;
+    q->done.head = q->done.tail = NULL;
+    pthread_mutex_unlock(&q->lock);
+    return areg_complete(r);
+}
+
+int maccess_reg_drain(maccess_reg_queue *q)
+{
+    areg_req *r;
+    int cnt = 0;
+    if (!q) {
+        return 0;
+    }
+    pthread_mutex_lock(&q->lock);
+    // callbacks may submit follow-up accesses, drain those as well
+    while (q->outstanding || q->done.head) {
+        while (q->outstanding) {
+            pthread_cond_wait(&q->done_cond, &q->lock);
+        }
+        r = q->done.head;
+        q->done.head = q->done.tail = NULL;
+        pthread_mutex_unlock(&q->lock);
+        cnt += areg_complete(r);
+        pthread_mutex_lock(&q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return cnt;
+}
+
+void maccess_reg_queue_destroy(maccess_reg_queue *q)
+{
+    if (!q) {
+        return;
+    }
+    maccess_reg_drain(q);
+    areg_stop_workers(q, q->num_workers);
+    areg_queue_free(q);
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * mtcr_dev_cache.c - Per boot cache of the PCI device probe results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "mtcr.h"
+#include "mtcr_dev_cache.h"
+
+#define MDEV_CACHE_ENV          "MTCR_DEV_CACHE"
+#define MDEV_CACHE_DEBUG_ENV    "MTCR_DEV_CACHE_DEBUG"
+#define MDEV_CACHE_DEF_PATH     "/tmp/mstflint_dev_cache"
+#define MDEV_CACHE_BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+#define MDEV_CACHE_MAGIC        0x4d444556 /* "MDEV" */
+#define MDEV_CACHE_VERSION      2
+#define MDEV_CACHE_MAX_ENTRIES  256
+#define MDEV_CACHE_BOOT_ID_LEN  40
+
+enum {
+    MDEV_CACHE_VSEC   = 0x1,
+    MDEV_CACHE_DEV_ID = 0x2
+};
+
+typedef struct mdev_cache_hdr {
+    u_int32_t magic;
+    u_int32_t version;
+    char boot_id[MDEV_CACHE_BOOT_ID_LEN];
+    u_int32_t num_entries;
+    u_int32_t reserved;
+} mdev_cache_hdr;
+
+typedef struct mdev_cache_entry {
+    u_int16_t domain;
+    u_int8_t bus;
+    u_int8_t dev;
+    u_int8_t func;
+    u_int8_t flags;
+    u_int16_t reserved;
+    mdev_pci_ids ids;
+    u_int32_t vsec_addr;
+    u_int32_t vsec_cap_mask;
+    int32_t vsec_supp;
+    int32_t dev_type;
+    u_int32_t hw_dev_id;
+    u_int32_t hw_rev;
+} mdev_cache_entry;
+
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_cache_loaded = 0;
+static int g_cache_disabled = 0;
+static char g_cache_path[256];
+static char g_boot_id[MDEV_CACHE_BOOT_ID_LEN];
+static mdev_cache_entry g_entries[MDEV_CACHE_MAX_ENTRIES];
+/* entries whose ids were checked against the device in this process */
+static u_int8_t g_validated[MDEV_CACHE_MAX_ENTRIES];
+static u_int32_t g_num_entries = 0;
+
+u_int64_t mdev_cache_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int mdev_cache_debug(void)
+{
+    return getenv(MDEV_CACHE_DEBUG_ENV) != NULL;
+}
+
+static int read_boot_id(char *boot_id)
+{
+    FILE *f = fopen(MDEV_CACHE_BOOT_ID_PATH, "r");
+    if (!f) {
+        return -1;
+    }
+    memset(boot_id, 0, MDEV_CACHE_BOOT_ID_LEN);
+    if (!fgets(boot_id, MDEV_CACHE_BOOT_ID_LEN, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    boot_id[strcspn(boot_id, "\n")] = '\0';
+    return boot_id[0] ? 0 : -1;
+}
+
+/*
+ * Read the cache file into entries, only a regular file owned by us and
+ * writable only by us is trusted (the default location is /tmp).
+ * Return the number of entries, an invalid or stale file has none.
+ */
+static u_int32_t read_cache_file(mdev_cache_entry *entries)
+{
+    mdev_cache_hdr hdr;
+    struct stat st;
+    u_int32_t num = 0;
+    int fd = open(g_cache_path, O_RDONLY | O_NOFOLLOW);
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        goto cleanup;
+    }
+    if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        goto cleanup;
+    }
+    if (hdr.magic != MDEV_CACHE_MAGIC || hdr.version != MDEV_CACHE_VERSION ||
+        strncmp(hdr.boot_id, g_boot_id, MDEV_CACHE_BOOT_ID_LEN) || hdr.num_entries > MDEV_CACHE_MAX_ENTRIES) {
+        goto cleanup;
+    }
+    if (read(fd, entries, hdr.num_entries * sizeof(mdev_cache_entry)) !=
+        (ssize_t)(hdr.num_entries * sizeof(mdev_cache_entry))) {
+        goto cleanup;
+    }
+    num = hdr.num_entries;
+cleanup:
+    close(fd);
+    return num;
+}
+
+static void load_cache(void)
+{
+    const char *env_path;
+
+    if (g_cache_loaded) {
+        return;
+    }
+    g_cache_loaded = 1;
+    env_path = getenv(MDEV_CACHE_ENV);
+    if (env_path && !strcmp(env_path, "0")) {
+        g_cache_disabled = 1;
+        return;
+    }
+    snprintf(g_cache_path, sizeof(g_cache_path), "%s", env_path && *env_path ? env_path : MDEV_CACHE_DEF_PATH);
+    if (read_boot_id(g_boot_id)) {
+        g_cache_disabled = 1;
+        return;
+    }
+    g_num_entries = read_cache_file(g_entries);
+}
+
+static int same_bdf(const mdev_cache_entry *a, const mdev_cache_entry *b)
+{
+    return a->domain == b->domain && a->bus == b->bus && a->dev == b->dev && a->func == b->func;
+}
+
+static int same_ids(const mdev_pci_ids *a, const mdev_pci_ids *b)
+{
+    return a->id == b->id && a->rev == b->rev && a->subsys == b->subsys;
+}
+
+static int find_entry(const mdev_cache_entry *key)
+{
+    u_int32_t i;
+    for (i = 0; i < g_num_entries; i++) {
+        if (same_bdf(&g_entries[i], key)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Write the cache atomically (temp file + rename). Entries added by other
+ * processes since we loaded the file are merged in.
+ */
+static void save_cache(void)
+{
+    mdev_cache_entry disk_entries[MDEV_CACHE_MAX_ENTRIES];
+    u_int32_t disk_num = read_cache_file(disk_entries);
+    char tmp_path[sizeof(g_cache_path) + 8];
+    mdev_cache_hdr hdr;
+    u_int32_t i;
+    int fd;
+    int ok;
+
+    for (i = 0; i < disk_num && g_num_entries < MDEV_CACHE_MAX_ENTRIES; i++) {
+        if (find_entry(&disk_entries[i]) < 0) {
+            g_validated[g_num_entries] = 0;
+            g_entries[g_num_entries++] = disk_entries[i];
+        }
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MDEV_CACHE_MAGIC;
+    hdr.version = MDEV_CACHE_VERSION;
+    memcpy(hdr.boot_id, g_boot_id, MDEV_CACHE_BOOT_ID_LEN);
+    hdr.num_entries = g_num_entries;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", g_cache_path);
+    fd = mkstemp(tmp_path); /* created with mode 0600 */
+    if (fd < 0) {
+        return;
+    }
+    ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+         write(fd, g_entries, g_num_entries * sizeof(mdev_cache_entry)) ==
+         (ssize_t)(g_num_entries * sizeof(mdev_cache_entry));
+    close(fd);
+    if (!ok || rename(tmp_path, g_cache_path)) {
+        unlink(tmp_path);
+    }
+}
+
+static int init_key(mfile *mf, mdev_cache_entry *key)
+{
+    if (!mf || !mf->dinfo) {
+        return -1;
+    }
+    memset(key, 0, sizeof(*key));
+    key->domain = mf->dinfo->pci.domain;
+    key->bus = mf->dinfo->pci.bus;
+    key->dev = mf->dinfo->pci.dev;
+    key->func = mf->dinfo->pci.func;
+    return 0;
+}
+
+/* called with g_cache_lock held, return the entry index or -1 */
+static int lookup(mfile *mf, mdev_cache_entry *key)
+{
+    if (init_key(mf, key)) {
+        return -1;
+    }
+    load_cache();
+    if (g_cache_disabled) {
+        return -1;
+    }
+    return find_entry(key);
+}
+
+int mdev_cache_get_vsec(mfile *mf, const mdev_pci_ids *ids)
+{
+    mdev_cache_entry key;
+    int rc = -1;
+    int i;
+
+    pthread_mutex_lock(&g_cache_lock);
+    i = lookup(mf, &key);
+    if (i >= 0 && (g_entries[i].flags & MDEV_CACHE_VSEC) && same_ids(&g_entries[i].ids, ids)) {
+        mf->vsec_addr = g_entries[i].vsec_addr;
+        mf->vsec_supp = g_entries[i].vsec_supp;
+        mf->vsec_cap_mask = g_entries[i].vsec_cap_mask;
+        g_validated[i] = 1;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+    return rc;
+}
+
+void mdev_cache_set_vsec(mfile *mf, const mdev_pci_ids *ids)
+{
+    mdev_cache_entry key;
+    int i;
+
+    pthread_mutex_lock(&g_cache_lock);
+    i = lookup(mf, &key);
+    if (g_cache_disabled || (i < 0 && g_num_entries == MDEV_CACHE_MAX_ENTRIES)) {
+        goto cleanup;
+    }
+    if (i < 0 || !same_ids(&g_entries[i].ids, ids)) {
+        // new device or the function changed (flash recovery, new HW revision or FW), start over
+        if (i < 0) {
+            i = g_num_entries++;
+        }
+        g_entries[i] = key;
+    }
+    g_entries[i].ids = *ids;
+    g_entries[i].vsec_addr = mf->vsec_addr;
+    g_entries[i].vsec_supp = mf->vsec_supp;
+    g_entries[i].vsec_cap_mask = mf->vsec_cap_mask;
+    g_entries[i].flags |= MDEV_CACHE_VSEC;
+    g_validated[i] = 1;
+    save_cache();
+cleanup:
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+int mdev_cache_get_dev_id(mfile *mf, int *dev_type, u_int32_t *hw_dev_id, u_int32_t *hw_rev)
+{
+    mdev_cache_entry key;
+    int rc = -1;
+    int i;
+
+    pthread_mutex_lock(&g_cache_lock);
+    i = lookup(mf, &key);
+    if (i >= 0 && g_validated[i] && (g_entries[i].flags & MDEV_CACHE_DEV_ID)) {
+        *dev_type = g_entries[i].dev_type;
+        *hw_dev_id = g_entries[i].hw_dev_id;
+        *hw_rev = g_entries[i].hw_rev;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+    return rc;
+}
+
+void mdev_cache_set_dev_id(mfile *mf, int dev_type, u_int32_t hw_dev_id, u_int32_t hw_rev)
+{
+    mdev_cache_entry key;
+    int i;
+
+    pthread_mutex_lock(&g_cache_lock);
+    i = lookup(mf, &key);
+    // only devices validated at open time are cached
+    if (i >= 0 && g_validated[i]) {
+        g_entries[i].dev_type = dev_type;
+        g_entries[i].hw_dev_id = hw_dev_id;
+        g_entries[i].hw_rev = hw_rev;
+        g_entries[i].flags |= MDEV_CACHE_DEV_ID;
+        save_cache();
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+}
@@ -64,6 +64,7 @@
 #endif
 
 #include "mtcr_ib.h"
+#include "tools_swab.h"
 
 #ifndef __WIN__
 #include "mtcr_mf.h"
@@ -179,20 +180,11 @@
 #define I2C_DEVICE_ID   0x56
 #define I2C_MEMORY_ADDR 0
 
+#define MTCR_IBMAD_LIB    "MTCR_IBMAD_LIB"
+
 #define UNSUPP_DEVS_NUM   15
 #define DEVID_ADDRESS     0xf0014
 
-// Convert BYTES - DWORDS with MEMCPY BE
-#define BYTES_TO_DWORD_BE(dw_dest, byte_src) do {   u_int32_t tmp; \
-                                                    memcpy(&tmp, byte_src, 4); \
-                                                    *(dw_dest) = __be32_to_cpu(tmp); \
-} while (0)
-
-#define DWORD_TO_BYTES_BE(bytes_dest, dw_src) do { u_int32_t tmp; \
-                                                   tmp = __cpu_to_be32(*(dw_src)); \
-                                                   memcpy(bytes_dest, &tmp, 4); \
-} while (0)
-
 
 typedef struct ibmad_port*IBMAD_CALL_CONV (*f_mad_rpc_open_port)(char *dev_name, int dev_port,
                                                                  int *mgmt_classes,
@@ -217,6 +209,20 @@ typedef uint32_t IBMAD_CALL_CONV (*f_mad_get_field)(void *buf, int base_offs, en
 
 typedef char*IBMAD_CALL_CONV (*f_portid2str)(ib_portid_t *portid);
 
+// used by the windowed block access, optional (the sync path is used when missing)
+typedef int IBMAD_CALL_CONV (*f_mad_build_pkt)(void *umad, ib_rpc_t *rpc, ib_portid_t *dport,
+                                               ib_rmpp_hdr_t *rmpp, void *data);
+typedef uint64_t IBMAD_CALL_CONV (*f_mad_trid)(void);
+typedef int IBMAD_CALL_CONV (*f_mad_rpc_portid)(struct ibmad_port *srcport);
+typedef int IBMAD_CALL_CONV (*f_mad_rpc_class_agent)(struct ibmad_port *srcport, int cls);
+typedef uint64_t IBMAD_CALL_CONV (*f_mad_get_field64)(void *buf, int base_offs, enum MAD_FIELDS field);
+typedef int IBMAD_CALL_CONV (*f_umad_send)(int portid, int agentid, void *umad, int length, int timeout_ms, int retries);
+typedef int IBMAD_CALL_CONV (*f_umad_recv)(int portid, void *umad, int *length, int timeout_ms);
+typedef void*IBMAD_CALL_CONV (*f_umad_get_mad)(void *umad);
+typedef int IBMAD_CALL_CONV (*f_umad_status)(void *umad);
+typedef size_t IBMAD_CALL_CONV (*f_umad_size)(void);
+typedef uint64_t IBMAD_CALL_CONV (*f_smp_mkey_get)(const struct ibmad_port *srcport);
+
 
 struct __ibvsmad_hndl_t
 {
@@ -230,6 +236,7 @@ struct __ibvsmad_hndl_t
 
     int timeout;
     int retries_num;
+    int window;
     u_int64_t vkey;
     enum MAD_DEST dest_type;
 
@@ -248,6 +255,18 @@ struct __ibvsmad_hndl_t
     f_mad_get_field mad_get_field;
     f_portid2str portid2str;
 
+    f_mad_build_pkt mad_build_pkt;
+    f_mad_trid mad_trid;
+    f_mad_rpc_portid mad_rpc_portid;
+    f_mad_rpc_class_agent mad_rpc_class_agent;
+    f_mad_get_field64 mad_get_field64;
+    f_umad_send umad_send;
+    f_umad_recv umad_recv;
+    f_umad_get_mad umad_get_mad;
+    f_umad_status umad_status;
+    f_umad_size umad_size;
+    f_smp_mkey_get smp_mkey_get;
+
     void *ibdebug;
 };
 
@@ -270,7 +289,6 @@ static int verbose = 0;
 static uint64_t ibvsmad_craccess_rw_smp(ibvs_mad *h, u_int32_t memory_address, int method, u_int8_t num_of_dwords, u_int32_t *data)
 {
     u_int8_t mad_data[IB_SMP_DATA_SIZE] = {0};
-    int i;
     u_int32_t att_mod = 0;
     u_int8_t *p;
     u_int64_t vkey;
@@ -300,13 +318,9 @@ static uint64_t ibvsmad_craccess_rw_smp(ibvs_mad *h, u_int32_t memory_address, i
             return BAD_RET_VAL;
         }
 
-        for (i = 0; i < num_of_dwords; i++) {
-            BYTES_TO_DWORD_BE(data + i, mad_data + IB_DATA_INDEX + i * 4);
-        }
+        tools_be32_to_cpu_buf(data, mad_data + IB_DATA_INDEX, num_of_dwords);
     } else {
-        for (i = 0; i < num_of_dwords; i++) {
-            DWORD_TO_BYTES_BE(mad_data + IB_DATA_INDEX + i * 4, data + i);
-        }
+        tools_cpu_to_be32_buf(mad_data + IB_DATA_INDEX, data, num_of_dwords);
         p = h->smp_set_via(mad_data, &h->portid, IB_SMP_ATTR_CR_ACCESS, att_mod, 0, h->srcport);
         if (!p) {
             return BAD_RET_VAL;
@@ -324,7 +338,6 @@ static uint64_t ibvsmad_craccess_rw_vs(ibvs_mad *h, u_int32_t memory_address, in
 {
     u_int8_t vsmad_data[IB_VENDOR_RANGE1_DATA_SIZE] = {0};
     ib_vendor_call_t call;
-    int i;
     u_int8_t *p;
     u_int64_t vkey;
 
@@ -364,9 +377,7 @@ static uint64_t ibvsmad_craccess_rw_vs(ibvs_mad *h, u_int32_t memory_address, in
     memcpy(vsmad_data, &vkey, 8);
 
     if (method == IB_MAD_METHOD_SET) {
-        for (i = 0; i < num_of_dwords; i++) {
-            DWORD_TO_BYTES_BE(vsmad_data + IB_DATA_INDEX + i * 4, data + i);
-        }
+        tools_cpu_to_be32_buf(vsmad_data + IB_DATA_INDEX, data, num_of_dwords);
     }
 
     p = h->ib_vendor_call_via(vsmad_data, &h->portid, &call, h->srcport);
@@ -374,9 +385,7 @@ static uint64_t ibvsmad_craccess_rw_vs(ibvs_mad *h, u_int32_t memory_address, in
         return BAD_RET_VAL;
     }
 
-    for (i = 0; i < num_of_dwords; i++) {
-        BYTES_TO_DWORD_BE(data + i, vsmad_data + IB_DATA_INDEX + i * 4);
-    }
+    tools_be32_to_cpu_buf(data, vsmad_data + IB_DATA_INDEX, num_of_dwords);
 
     return 0;
 }
@@ -391,6 +400,205 @@ static uint64_t ibvsmad_craccess_rw(ibvs_mad *h, u_int32_t memory_address, int m
     return 0;
 }
 
+/********************************************************
+**
+*    Windowed block access: keeps up to h->window CR-Space MADs outstanding,
+*    sending/receiving through umad directly and matching the responses by
+*    transaction id. Each MAD is timed out by the kernel and re-sent (with a
+*    new TID) up to h->retries_num times.
+*
+*/
+#define MIB_DEF_WINDOW  16
+#define MIB_MAX_WINDOW  64
+
+typedef struct mib_mad_slot {
+    void *umad;
+    u_int32_t trid;
+    u_int32_t t_offset;
+    int dwords;
+    int retries_left;
+} mib_mad_slot;
+
+typedef struct mib_window_ctx {
+    ibvs_mad *h;
+    ib_portid_t portid;
+    ib_rpc_t rpc;
+    int fd;
+    int agent;
+    int method;
+    unsigned int offset;
+    u_int32_t *data;
+    int status_field;
+} mib_window_ctx;
+
+static int mib_window_supported(ibvs_mad *h)
+{
+    return h->window > 1 && h->mad_build_pkt && h->mad_trid && h->mad_rpc_portid && h->mad_rpc_class_agent &&
+           h->mad_get_field64 && h->umad_send && h->umad_recv && h->umad_get_mad && h->umad_status && h->umad_size;
+}
+
+static int mib_window_send(mib_window_ctx *ctx, mib_mad_slot *slot)
+{
+    ibvs_mad *h = ctx->h;
+    u_int8_t payload[IB_VENDOR_RANGE1_DATA_SIZE] = {0};
+    u_int64_t vkey = __cpu_to_be64(h->vkey);
+    u_int32_t addr = ctx->offset + slot->t_offset;
+
+    memcpy(payload, &vkey, 8);
+    if (ctx->method == IB_MAD_METHOD_SET) {
+        tools_cpu_to_be32_buf(payload + IB_DATA_INDEX, ctx->data + slot->t_offset / 4, slot->dwords);
+    }
+    // same attribute modifier layout for the SMP and the VS MADs
+    ctx->rpc.attr.mod = EXTRACT(addr, 0, 16) | ((slot->dwords << 16) & 0x00ff0000) |
+                        (EXTRACT(addr, 16, 8) << 24);
+    ctx->rpc.trid = h->mad_trid();
+    slot->trid = (u_int32_t)ctx->rpc.trid;
+
+    memset(slot->umad, 0, h->umad_size() + IB_MAD_SIZE);
+    if (h->mad_build_pkt(slot->umad, &ctx->rpc, &ctx->portid, NULL, payload) < 0) {
+        return -1;
+    }
+    if (h->umad_send(ctx->fd, ctx->agent, slot->umad, IB_MAD_SIZE, h->timeout, 0) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int mib_block_op_windowed(ibvs_mad *h, unsigned int offset, u_int32_t *data, int length, int method)
+{
+    mib_window_ctx ctx;
+    mib_mad_slot slots[MIB_MAX_WINDOW];
+    mib_mad_slot *slot;
+    void *recv_umad = NULL;
+    int chunk_size = h->use_smp ? MAX_IB_SMP_DATA_SIZE : MAX_VS_DATA_SIZE;
+    int window = h->window > MIB_MAX_WINDOW ? MIB_MAX_WINDOW : h->window;
+    int next_offset = 0;
+    int outstanding = 0;
+    int rc = -1;
+    int i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(slots, 0, sizeof(slots));
+    ctx.h = h;
+    ctx.portid = h->portid;
+    ctx.method = method;
+    ctx.offset = offset;
+    ctx.data = data;
+    ctx.rpc.method = method;
+    ctx.rpc.timeout = h->timeout;
+    if (h->use_smp) {
+        // as smp_query_via()/smp_set_via()
+        ctx.portid.sl = 0;
+        ctx.portid.qp = 0;
+        if (ctx.portid.lid <= 0 || ctx.portid.drpath.drslid == 0xffff || ctx.portid.drpath.drdlid == 0xffff) {
+            ctx.rpc.mgtclass = IB_SMI_DIRECT_CLASS;
+            ctx.status_field = IB_DRSMP_STATUS_F;
+        } else {
+            ctx.rpc.mgtclass = IB_SMI_CLASS;
+            ctx.status_field = IB_MAD_STATUS_F;
+        }
+        ctx.rpc.attr.id = IB_SMP_ATTR_CR_ACCESS;
+        // libibmad versions without M_Key support send 0
+        ctx.rpc.mkey = h->smp_mkey_get ? h->smp_mkey_get(h->srcport) : 0;
+        ctx.rpc.datasz = IB_SMP_DATA_SIZE;
+        ctx.rpc.dataoffs = IB_SMP_DATA_OFFS;
+    } else {
+        // as ib_vendor_call_via() for a range 1 class
+        ctx.portid.qp = 1;
+        if (!ctx.portid.qkey) {
+            ctx.portid.qkey = IB_DEFAULT_QP1_QKEY;
+        }
+        ctx.rpc.mgtclass = IB_VENDOR_SPECIFIC_CLASS_0x9;
+        ctx.status_field = IB_MAD_STATUS_F;
+        ctx.rpc.attr.id = IB_VS_ATTR_CR_ACCESS;
+        ctx.rpc.datasz = IB_VENDOR_RANGE1_DATA_SIZE;
+        ctx.rpc.dataoffs = IB_VENDOR_RANGE1_DATA_OFFS;
+        ctx.rpc.oui = IB_OPENIB_OUI;
+    }
+    ctx.fd = h->mad_rpc_portid(h->srcport);
+    ctx.agent = h->mad_rpc_class_agent(h->srcport, ctx.rpc.mgtclass);
+    if (ctx.fd < 0 || ctx.agent < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < window; i++) {
+        if (!(slots[i].umad = calloc(1, h->umad_size() + IB_MAD_SIZE))) {
+            goto cleanup;
+        }
+    }
+    if (!(recv_umad = calloc(1, h->umad_size() + IB_MAD_SIZE))) {
+        goto cleanup;
+    }
+
+    while (next_offset < length || outstanding) {
+        u_int8_t *mad;
+        u_int32_t trid;
+        int recv_len = IB_MAD_SIZE;
+
+        // fill the window
+        for (i = 0; i < window && next_offset < length; i++) {
+            if (slots[i].dwords) {
+                continue;
+            }
+            slots[i].t_offset = next_offset;
+            slots[i].dwords = (length - next_offset > chunk_size ? chunk_size : length - next_offset) / 4;
+            slots[i].retries_left = h->retries_num;
+            if (mib_window_send(&ctx, &slots[i])) {
+                goto cleanup;
+            }
+            next_offset += chunk_size;
+            outstanding++;
+        }
+
+        // the kernel times out every send, so a response (or a timeout) always arrives
+        if (h->umad_recv(ctx.fd, recv_umad, &recv_len, -1) < 0) {
+            goto cleanup;
+        }
+        mad = (u_int8_t*)h->umad_get_mad(recv_umad);
+        trid = (u_int32_t)h->mad_get_field64(mad, 0, IB_MAD_TRID_F);
+        slot = NULL;
+        for (i = 0; i < window; i++) {
+            if (slots[i].dwords && slots[i].trid == trid) {
+                slot = &slots[i];
+                break;
+            }
+        }
+        if (!slot) {
+            DEBUG(("dropping stale MAD response (trid 0x%08x)", trid));
+            continue;
+        }
+        if (h->umad_status(recv_umad)) {
+            if (slot->retries_left-- <= 0) {
+                DEBUG(("MAD to 0x%08x timed out", offset + slot->t_offset));
+                goto cleanup;
+            }
+            if (mib_window_send(&ctx, slot)) {
+                goto cleanup;
+            }
+            continue;
+        }
+        if (h->mad_get_field(mad, 0, ctx.status_field)) {
+            DEBUG(("MAD to 0x%08x failed with status 0x%x", offset + slot->t_offset,
+                   h->mad_get_field(mad, 0, ctx.status_field)));
+            goto cleanup;
+        }
+        if (method == IB_MAD_METHOD_GET) {
+            tools_be32_to_cpu_buf(data + slot->t_offset / 4, mad + ctx.rpc.dataoffs + IB_DATA_INDEX, slot->dwords);
+        }
+        slot->dwords = 0;
+        outstanding--;
+    }
+    rc = 0;
+
+cleanup:
+    // responses of MADs still in flight are dropped by libibmad as TID mismatches
+    for (i = 0; i < window; i++) {
+        free(slots[i].umad);
+    }
+    free(recv_umad);
+    return rc;
+}
+
 #ifdef __WIN__
 
 
@@ -434,14 +642,16 @@ int process_dynamic_linking(ibvs_mad *ivm, int mad_init)
 {
 
     char *libs[] = {"libibmad.so.5", "libibmad.so.12"};
+    char *env_lib = getenv(MTCR_IBMAD_LIB);
 
     u_int32_t i;
     (void)mad_init;
-    for (i = 0; i < sizeof(libs) / sizeof(libs[0]); i++) {
+    // allows loading an alternative (e.g. a stub) libibmad
+    if (env_lib) {
+        ivm->dl_handle = dlopen(env_lib, RTLD_LAZY);
+    }
+    for (i = 0; !ivm->dl_handle && i < sizeof(libs) / sizeof(libs[0]); i++) {
         ivm->dl_handle = dlopen(libs[i], RTLD_LAZY);
-        if (ivm->dl_handle) {
-            break;
-        }
     }
     if (!ivm->dl_handle) {
         const char *errstr = dlerror();
@@ -466,6 +676,19 @@ int process_dynamic_linking(ibvs_mad *ivm, int mad_init)
     MY_DLSYM(ivm, mad_get_field            );
     MY_DLSYM(ivm, portid2str               );
     MY_DLSYM(ivm, ibdebug                  );
+    // the umad symbols are resolved through libibmad's dependencies
+    MY_DLSYM_IGNORE_FAIL(ivm, mad_build_pkt      );
+    MY_DLSYM_IGNORE_FAIL(ivm, mad_trid           );
+    MY_DLSYM_IGNORE_FAIL(ivm, mad_rpc_portid     );
+    MY_DLSYM_IGNORE_FAIL(ivm, mad_rpc_class_agent);
+    MY_DLSYM_IGNORE_FAIL(ivm, mad_get_field64    );
+    MY_DLSYM_IGNORE_FAIL(ivm, umad_send          );
+    MY_DLSYM_IGNORE_FAIL(ivm, umad_recv          );
+    MY_DLSYM_IGNORE_FAIL(ivm, umad_get_mad       );
+    MY_DLSYM_IGNORE_FAIL(ivm, umad_status        );
+    MY_DLSYM_IGNORE_FAIL(ivm, umad_size          );
+    MY_DLSYM_IGNORE_FAIL(ivm, smp_mkey_get       );
+    dlerror();
     return 0;
 }
 
@@ -500,6 +723,7 @@ char* my_strdup(const char *name)
 #define MTCR_IB_RETRIES     "MTCR_IB_RETRIES"
 #define MTCR_IB_VKEY        "MTCR_IB_VKEY"
 #define MTCR_IBMAD_DEBUG "MTCR_IBMAD_DEBUG"
+#define MTCR_IB_WINDOW      "MTCR_IB_WINDOW"
 
 int get_env_var(char *env_name, int *env_var)
 {
@@ -525,6 +749,7 @@ int get_env_vars(ibvs_mad *ivm)
     get_env_var(MTCR_IB_TIMEOUT, &(ivm->timeout));
     get_env_var(MTCR_IB_RETRIES, &(ivm->retries_num));
     get_64_env_var(MTCR_IB_VKEY, &((ivm->vkey)));
+    get_env_var(MTCR_IB_WINDOW, &(ivm->window));
     return 0;
 }
 
@@ -665,6 +890,7 @@ int mib_open(const char *name, mfile *mf, int mad_init)
 
     ivm->retries_num = MAD_DEF_RETRIES;
     ivm->timeout     = MAD_DEF_TIMEOUT_MS;
+    ivm->window      = MIB_DEF_WINDOW;
     // Get env variables.
     get_env_vars(ivm);
     // The DR in the device name is a '.' separated list.
@@ -870,6 +1096,14 @@ int mib_block_op(mfile *mf, unsigned int offset, u_int32_t *data, int length, in
     CHECK_ALIGN(length);
     int chunk_size = mib_get_chunk_size(mf);
     int t_offset = 0;
+    if (length > chunk_size && mib_window_supported(h)) {
+        if (mib_block_op_windowed(h, offset, data, length, method)) {
+            IBERROR(("cr access %s to %s failed", op == BLOCKOP_READ ? "read" : "write",
+                     h->portid2str(&h->portid)));
+            return -1;
+        }
+        return length;
+    }
     while (t_offset < length) {
         int left_size = length - t_offset;
         int to_op = left_size > chunk_size ? chunk_size : left_size;
@@ -65,6 +65,7 @@ typedef struct ul_ctx {
     f_mwrite4_block res_mwrite4_block;
     /*************************************************************/
     int via_driver;
+    struct mtcr_remote *remote;     /* remote device state, see mtcr_remote.c */
 } ul_ctx_t;
 #endif
 
@@ -0,0 +1,713 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mtcr_remote.c - Devices served by a remote mstmtserver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mtcr.h"
+#include "mtcr_int_defs.h"
+#include "mtcr_remote.h"
+#include "mtserver_proto.h"
+
+#define RMT_WINDOW_ENV      "MTCR_REMOTE_WINDOW"
+#define RMT_BYPASS_ENV      "MTCR_REMOTE_BYPASS"
+#define RMT_DEBUG_ENV       "MTCR_REMOTE_DEBUG"
+#define RMT_DEF_WINDOW_US   0
+#define RMT_LINE_SIZE       64
+#define RMT_LINE_DWORDS     (RMT_LINE_SIZE / 4)
+#define RMT_LINES           256
+#define RMT_MAX_STATIC      16
+#define RMT_MAX_BYPASS      32
+#define RMT_HW_ID_ADDR      0xf0014
+
+typedef struct rmt_line {
+    u_int32_t addr;
+    u_int32_t valid;            /* dword mask */
+    u_int64_t stamp_us;
+    u_int32_t data[RMT_LINE_DWORDS];
+} rmt_line_t;
+
+typedef struct rmt_static {
+    u_int32_t addr;
+    u_int32_t value;
+    int valid;
+} rmt_static_t;
+
+typedef struct rmt_range {
+    u_int32_t addr;
+    u_int32_t size;
+} rmt_range_t;
+
+typedef struct mtcr_remote {
+    int sock;
+    int binary;                 /* the handshake switched the connection to the binary protocol */
+    u_int32_t next_id;
+    int space;                  /* -1 - the server default (CR-Space) */
+    u_int32_t window_us;
+    rmt_line_t lines[RMT_LINES];
+    rmt_static_t statics[RMT_MAX_STATIC];
+    int num_statics;
+    rmt_range_t bypass[RMT_MAX_BYPASS];
+    int num_bypass;
+    mtcr_remote_stats_t stats;
+} mtcr_remote_t;
+
+/* Semaphores and the flash gateway of the supported devices */
+static const rmt_range_t rmt_def_bypass[] = {
+    {0xf03a0, 0x60},            /* flash semaphores */
+    {0xf0400, 0x100},           /* flash gateway (command, address, data) */
+    {0xe27f8, 4},               /* icmd semaphores */
+    {0xe250c, 4},
+    {0xe74e0, 4},
+    {0xa24f8, 4},
+    {0xa68f8, 4},
+};
+
+static u_int64_t rmt_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static mtcr_remote_t* rmt_ctx(mfile *mf)
+{
+    ul_ctx_t *ctx = mf->ul_ctx;
+    return ctx ? ctx->remote : NULL;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Transport */
+
+static int rmt_send_all(int sock, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    ssize_t n;
+
+    while (iovcnt) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (iovcnt && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt) {
+            iov->iov_base = (u_int8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+static int rmt_recv_all(int sock, void *buf, size_t len)
+{
+    u_int8_t *p = buf;
+    ssize_t n;
+
+    while (len) {
+        n = recv(sock, p, len, 0);
+        if (n == 0) {
+            errno = ECONNRESET;
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * One request/response exchange. The response payload (at most "in_max"
+ * bytes) is stored in "in". Returns 0, or -1 with errno set to the transport
+ * error or the status of the response.
+ */
+static int rmt_call(mtcr_remote_t *r, u_int8_t op, u_int32_t addr, u_int32_t arg, const void *out,
+                    u_int32_t out_len, void *in, u_int32_t in_max, mtsrv_frame_hdr_t *rsp)
+{
+    u_int8_t hbuf[MTSRV_HDR_SIZE];
+    mtsrv_frame_hdr_t req;
+    struct iovec iov[2];
+
+    memset(&req, 0, sizeof(req));
+    req.magic = MTSRV_FRAME_MAGIC;
+    req.version = MTSRV_PROTO_VERSION;
+    req.op = op;
+    req.id = ++r->next_id;
+    req.addr = addr;
+    req.arg = arg;
+    req.len = out_len;
+    mtsrv_hdr_pack(hbuf, &req);
+    iov[0].iov_base = hbuf;
+    iov[0].iov_len = MTSRV_HDR_SIZE;
+    iov[1].iov_base = (void*)out;
+    iov[1].iov_len = out_len;
+
+    r->stats.round_trips++;
+    if (rmt_send_all(r->sock, iov, out_len ? 2 : 1) || rmt_recv_all(r->sock, hbuf, MTSRV_HDR_SIZE)) {
+        return -1;
+    }
+    mtsrv_hdr_unpack(hbuf, rsp);
+    if (rsp->magic != MTSRV_FRAME_MAGIC || rsp->id != req.id || rsp->op != op || rsp->len > in_max) {
+        /* the stream can not be trusted anymore */
+        shutdown(r->sock, SHUT_RDWR);
+        errno = EPROTO;
+        return -1;
+    }
+    if (rsp->len && rmt_recv_all(r->sock, in, rsp->len)) {
+        return -1;
+    }
+    if (rsp->status) {
+        errno = rsp->status;
+        return -1;
+    }
+    return 0;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Read cache */
+
+static int rmt_is_bypassed(mtcr_remote_t *r, u_int32_t addr)
+{
+    int i;
+
+    for (i = 0; i < r->num_bypass; i++) {
+        if (addr - r->bypass[i].addr < r->bypass[i].size) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static rmt_static_t* rmt_find_static(mtcr_remote_t *r, u_int32_t addr)
+{
+    int i;
+
+    for (i = 0; i < r->num_statics; i++) {
+        if (r->statics[i].addr == addr) {
+            return &r->statics[i];
+        }
+    }
+    return NULL;
+}
+
+static rmt_line_t* rmt_line(mtcr_remote_t *r, u_int32_t addr)
+{
+    return &r->lines[(addr / RMT_LINE_SIZE) % RMT_LINES];
+}
+
+static void rmt_invalidate(mtcr_remote_t *r, u_int32_t addr, u_int32_t len)
+{
+    u_int32_t a;
+    int i;
+
+    if (len / RMT_LINE_SIZE >= RMT_LINES) {
+        for (i = 0; i < RMT_LINES; i++) {
+            r->lines[i].valid = 0;
+        }
+    } else {
+        for (a = addr & ~(RMT_LINE_SIZE - 1); a < addr + len; a += RMT_LINE_SIZE) {
+            rmt_line_t *l = rmt_line(r, a);
+            if (l->addr == a) {
+                l->valid = 0;
+            }
+        }
+    }
+    for (i = 0; i < r->num_statics; i++) {
+        if (r->statics[i].addr - addr < len) {
+            r->statics[i].valid = 0;
+        }
+    }
+}
+
+static void rmt_flush(mtcr_remote_t *r)
+{
+    int i;
+
+    for (i = 0; i < RMT_LINES; i++) {
+        r->lines[i].valid = 0;
+    }
+}
+
+static int rmt_read4_direct(mtcr_remote_t *r, u_int32_t addr, u_int32_t *value)
+{
+    mtsrv_frame_hdr_t rsp;
+    u_int32_t le;
+
+    if (rmt_call(r, MTSRV_OP_READ4, addr, 0, NULL, 0, &le, sizeof(le), &rsp) || rsp.len != 4) {
+        return -1;
+    }
+    *value = __le32_to_cpu(le);
+    return 4;
+}
+
+/* Fetch the run of non volatile dwords of the line around "addr" */
+static int rmt_fetch_line(mtcr_remote_t *r, rmt_line_t *l, u_int32_t addr)
+{
+    u_int32_t base = addr & ~(RMT_LINE_SIZE - 1);
+    int first = (addr - base) / 4, last = first, i;
+    u_int32_t data[RMT_LINE_DWORDS];
+    mtsrv_frame_hdr_t rsp;
+    u_int32_t len;
+
+    while (first > 0 && !rmt_is_bypassed(r, base + (first - 1) * 4)) {
+        first--;
+    }
+    while (last < RMT_LINE_DWORDS - 1 && !rmt_is_bypassed(r, base + (last + 1) * 4)) {
+        last++;
+    }
+    len = (last - first + 1) * 4;
+    if (rmt_call(r, MTSRV_OP_READ_BLOCK, base + first * 4, len, NULL, 0, data, sizeof(data), &rsp) ||
+        rsp.len != len) {
+        return -1;
+    }
+    r->stats.line_fetches++;
+    l->addr = base;
+    l->valid = 0;
+    for (i = first; i <= last; i++) {
+        l->data[i] = __le32_to_cpu(data[i - first]);
+        l->valid |= 1U << i;
+    }
+    l->stamp_us = rmt_time_us();
+    return 0;
+}
+
+static int rmt_mread4(mfile *mf, unsigned int offset, u_int32_t *value)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    rmt_static_t *st;
+    rmt_line_t *l;
+    int dw;
+
+    r->stats.reads++;
+    if (offset % 4 || (r->space != -1 && r->space != AS_CR_SPACE)) {
+        return rmt_read4_direct(r, offset, value);
+    }
+    if ((st = rmt_find_static(r, offset))) {
+        if (!st->valid) {
+            if (rmt_read4_direct(r, offset, &st->value) != 4) {
+                return -1;
+            }
+            st->valid = 1;
+        } else {
+            r->stats.static_hits++;
+        }
+        *value = st->value;
+        return 4;
+    }
+    if (rmt_is_bypassed(r, offset)) {
+        r->stats.bypassed++;
+        return rmt_read4_direct(r, offset, value);
+    }
+    if (!r->window_us) {
+        return rmt_read4_direct(r, offset, value);
+    }
+
+    l = rmt_line(r, offset);
+    dw = (offset % RMT_LINE_SIZE) / 4;
+    if (l->addr == (offset & ~(RMT_LINE_SIZE - 1)) && (l->valid & (1U << dw)) &&
+        rmt_time_us() - l->stamp_us < r->window_us) {
+        r->stats.line_hits++;
+    } else if (rmt_fetch_line(r, l, offset)) {
+        return -1;
+    }
+    *value = l->data[dw];
+    return 4;
+}
+
+static int rmt_mwrite4(mfile *mf, unsigned int offset, u_int32_t value)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+
+    rmt_invalidate(r, offset, 4);
+    if (rmt_call(r, MTSRV_OP_WRITE4, offset, value, NULL, 0, NULL, 0, &rsp)) {
+        return -1;
+    }
+    return 4;
+}
+
+static int rmt_mread4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+    int done, chunk, i;
+
+    if (byte_len % 4) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (done = 0; done < byte_len; done += chunk) {
+        chunk = byte_len - done > MTSRV_MAX_PAYLOAD ? MTSRV_MAX_PAYLOAD : byte_len - done;
+        if (rmt_call(r, MTSRV_OP_READ_BLOCK, offset + done, chunk, NULL, 0, data + done / 4, chunk, &rsp) ||
+            (int)rsp.len != chunk) {
+            return done ? done : -1;
+        }
+    }
+    for (i = 0; i < byte_len / 4; i++) {
+        data[i] = __le32_to_cpu(data[i]);
+    }
+    return byte_len;
+}
+
+static int rmt_mwrite4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    u_int32_t buf[1024];
+    mtsrv_frame_hdr_t rsp;
+    int done, chunk, i;
+
+    if (byte_len % 4) {
+        errno = EINVAL;
+        return -1;
+    }
+    rmt_invalidate(r, offset, byte_len);
+    for (done = 0; done < byte_len; done += chunk) {
+        chunk = byte_len - done > (int)sizeof(buf) ? (int)sizeof(buf) : byte_len - done;
+        for (i = 0; i < chunk / 4; i++) {
+            buf[i] = __cpu_to_le32(data[done / 4 + i]);
+        }
+        if (rmt_call(r, MTSRV_OP_WRITE_BLOCK, offset + done, 0, buf, chunk, NULL, 0, &rsp)) {
+            return done ? done : -1;
+        }
+    }
+    return byte_len;
+}
+
+int mtcr_remote_access_reg(mfile *mf, u_int16_t reg_id, maccess_reg_method_t reg_method, void *reg_data,
+                           u_int32_t reg_size, int *reg_status)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+
+    /* the firmware may change any CR-Space word */
+    rmt_flush(r);
+    if (rmt_call(r, MTSRV_OP_REG_ACCESS, reg_id, reg_method, reg_data, reg_size, reg_data, reg_size, &rsp)) {
+        return ME_ERROR;
+    }
+    *reg_status = rsp.addr;
+    return rsp.arg;
+}
+
+int mtcr_remote_set_addr_space(mfile *mf, int space)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+
+    if (space == r->space) {
+        return 0;
+    }
+    if (rmt_call(r, MTSRV_OP_SET_ADDR_SPACE, 0, space, NULL, 0, NULL, 0, &rsp)) {
+        return -1;
+    }
+    rmt_flush(r);
+    r->space = space;
+    mf->address_space = space;
+    return 0;
+}
+
+static void rmt_pci_change(mfile *mf)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+
+    rmt_flush(r);
+    rmt_call(r, MTSRV_OP_PCI_CHANGE, 0, 0, NULL, 0, NULL, 0, &rsp);
+}
+
+static int rmt_mclose(mfile *mf)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+    mtsrv_frame_hdr_t rsp;
+
+    if (!r) {
+        return 0;
+    }
+    if (getenv(RMT_DEBUG_ENV)) {
+        fprintf(stderr, "-D- %s: %llu round trips, %llu reads (%llu line hits, %llu static hits, "
+                "%llu volatile), %llu line fetches\n", mf->dev_name,
+                (unsigned long long)r->stats.round_trips, (unsigned long long)r->stats.reads,
+                (unsigned long long)r->stats.line_hits, (unsigned long long)r->stats.static_hits,
+                (unsigned long long)r->stats.bypassed, (unsigned long long)r->stats.line_fetches);
+    }
+    if (r->sock >= 0) {
+        if (r->binary) {
+            rmt_call(r, MTSRV_OP_CLOSE, 0, 0, NULL, 0, NULL, 0, &rsp);
+        }
+        close(r->sock);
+    }
+    mf->sock = -1;
+    ((ul_ctx_t*)mf->ul_ctx)->remote = NULL;
+    free(r);
+    return 0;
+}
+
+int mtcr_remote_cache_bypass(mfile *mf, u_int32_t addr, u_int32_t size)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+
+    if (!r || r->num_bypass == RMT_MAX_BYPASS) {
+        return -1;
+    }
+    r->bypass[r->num_bypass].addr = addr;
+    r->bypass[r->num_bypass].size = size;
+    r->num_bypass++;
+    rmt_invalidate(r, addr, size);
+    return 0;
+}
+
+int mtcr_remote_cache_static(mfile *mf, u_int32_t addr)
+{
+    mtcr_remote_t *r = rmt_ctx(mf);
+
+    if (!r || r->num_statics == RMT_MAX_STATIC) {
+        return -1;
+    }
+    if (!rmt_find_static(r, addr)) {
+        r->statics[r->num_statics].addr = addr;
+        r->statics[r->num_statics].valid = 0;
+        r->num_statics++;
+    }
+    return 0;
+}
+
+int mtcr_remote_get_stats(mfile *mf, mtcr_remote_stats_t *stats)
+{
+    mtcr_remote_t *r = mf ? rmt_ctx(mf) : NULL;
+
+    if (!r || mf->tp != MST_REMOTE) {
+        return -1;
+    }
+    *stats = r->stats;
+    return 0;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Open */
+
+/* "<host>:<port>,<device>" */
+static int rmt_parse_name(const char *name, char *host, size_t host_len, char *port, size_t port_len,
+                          const char **dev)
+{
+    const char *comma = strchr(name, ',');
+    const char *colon;
+    size_t i;
+
+    if (!comma || comma[1] == '\0') {
+        return -1;
+    }
+    colon = memchr(name, ':', comma - name);
+    if (!colon || colon == name || colon + 1 == comma) {
+        return -1;
+    }
+    for (i = 1; colon + i < comma; i++) {
+        if (colon[i] < '0' || colon[i] > '9') {
+            return -1;
+        }
+    }
+    if ((size_t)(colon - name) >= host_len || (size_t)(comma - colon - 1) >= port_len) {
+        return -1;
+    }
+    memcpy(host, name, colon - name);
+    host[colon - name] = '\0';
+    memcpy(port, colon + 1, comma - colon - 1);
+    port[comma - colon - 1] = '\0';
+    *dev = comma + 1;
+    return 0;
+}
+
+int mtcr_remote_is_name(const char *name)
+{
+    char host[256], port[16];
+    const char *dev;
+
+    return name && !rmt_parse_name(name, host, sizeof(host), port, sizeof(port), &dev);
+}
+
+static int rmt_connect(const char *host, const char *port)
+{
+    struct addrinfo hints, *res, *ai;
+    int sock = -1, one = 1, rc;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    rc = getaddrinfo(host, port, &hints, &res);
+    if (rc) {
+        errno = rc == EAI_SYSTEM ? errno : EHOSTUNREACH;
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        if (!connect(sock, ai->ai_addr, ai->ai_addrlen)) {
+            break;
+        }
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock >= 0) {
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return sock;
+}
+
+/* Switch the connection from the ASCII protocol to the binary one */
+static int rmt_handshake(int sock)
+{
+    char cmd[16], reply[64];
+    struct iovec iov;
+    size_t n = 0;
+
+    snprintf(cmd, sizeof(cmd), "X %d", MTSRV_PROTO_VERSION);
+    iov.iov_base = cmd;
+    iov.iov_len = strlen(cmd) + 1;
+    if (rmt_send_all(sock, &iov, 1)) {
+        return -1;
+    }
+    do {
+        if (rmt_recv_all(sock, reply + n, 1)) {
+            return -1;
+        }
+    } while (reply[n] != '\0' && ++n < sizeof(reply));
+    if (n == sizeof(reply) || strncmp(reply, "O ", 2) || atoi(reply + 2) != MTSRV_PROTO_VERSION) {
+        errno = EPROTONOSUPPORT;
+        return -1;
+    }
+    return 0;
+}
+
+static void rmt_add_env_bypass(mfile *mf)
+{
+    char *env = getenv(RMT_BYPASS_ENV);
+    char *p = env, *end;
+
+    while (p && *p) {
+        u_int32_t addr = strtoul(p, &end, 0), size = 4;
+        if (end == p) {
+            break;
+        }
+        if (*end == '+') {
+            size = strtoul(end + 1, &end, 0);
+        }
+        mtcr_remote_cache_bypass(mf, addr, size);
+        p = *end == ',' ? end + 1 : end;
+    }
+}
+
+int mtcr_remote_open(mfile *mf, const char *name)
+{
+    ul_ctx_t *ctx = mf->ul_ctx;
+    char host[256], port[16];
+    const char *dev, *env;
+    mtsrv_frame_hdr_t rsp;
+    mtcr_remote_t *r;
+    unsigned int i;
+
+    if (rmt_parse_name(name, host, sizeof(host), port, sizeof(port), &dev)) {
+        errno = EINVAL;
+        return -1;
+    }
+    r = calloc(1, sizeof(*r));
+    if (!r) {
+        return -1;
+    }
+    r->space = -1;
+    r->window_us = RMT_DEF_WINDOW_US;
+    if ((env = getenv(RMT_WINDOW_ENV))) {
+        r->window_us = strtoul(env, NULL, 0);
+    }
+    ctx->remote = r;
+    ctx->mread4 = rmt_mread4;
+    ctx->mwrite4 = rmt_mwrite4;
+    ctx->mread4_block = rmt_mread4_block;
+    ctx->mwrite4_block = rmt_mwrite4_block;
+    ctx->mclose = rmt_mclose;
+    mf->tp = MST_REMOTE;
+    mf->flags = MDEVS_REM;
+    mf->mpci_change = rmt_pci_change;
+
+    for (i = 0; i < sizeof(rmt_def_bypass) / sizeof(rmt_def_bypass[0]); i++) {
+        mtcr_remote_cache_bypass(mf, rmt_def_bypass[i].addr, rmt_def_bypass[i].size);
+    }
+    rmt_add_env_bypass(mf);
+    mtcr_remote_cache_static(mf, RMT_HW_ID_ADDR);
+
+    r->sock = rmt_connect(host, port);
+    mf->sock = r->sock;
+    if (r->sock < 0 || rmt_handshake(r->sock)) {
+        return -1;
+    }
+    r->binary = 1;
+    if (rmt_call(r, MTSRV_OP_OPEN, 0, 0, dev, strlen(dev), NULL, 0, &rsp)) {
+        return -1;
+    }
+    /* address spaces are validated by the server */
+    mf->vsec_supp = rsp.arg;
+    if (mf->vsec_supp) {
+        mf->vsec_cap_mask = 0xffffffff;
+        mf->address_space = AS_CR_SPACE;
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * mtcr_session.c - Thread safe sessions on top of a single mfile.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mtcr.h"
+#include "mtcr_session.h"
+
+struct msession_t {
+    mfile *mf;
+    int owns_mf;
+    pthread_mutex_t lock;
+};
+
+static msession* msession_create(mfile *mf, int owns_mf)
+{
+    pthread_mutexattr_t attr;
+    msession *ms;
+
+    ms = (msession*)malloc(sizeof(msession));
+    if (!ms) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(ms, 0, sizeof(msession));
+    ms->mf = mf;
+    ms->owns_mf = owns_mf;
+    if (pthread_mutexattr_init(&attr)) {
+        goto create_failed;
+    }
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    if (pthread_mutex_init(&ms->lock, &attr)) {
+        pthread_mutexattr_destroy(&attr);
+        goto create_failed;
+    }
+    pthread_mutexattr_destroy(&attr);
+    return ms;
+
+create_failed:
+    free(ms);
+    errno = ENOMEM;
+    return NULL;
+}
+
+msession* msession_open(const char *name)
+{
+    msession *ms;
+    int err;
+    mfile *mf = mopen(name);
+    if (!mf) {
+        return NULL;
+    }
+    ms = msession_create(mf, 1);
+    if (!ms) {
+        err = errno;
+        mclose(mf);
+        errno = err;
+    }
+    return ms;
+}
+
+msession* msession_attach(mfile *mf)
+{
+    if (!mf) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return msession_create(mf, 0);
+}
+
+int msession_close(msession *ms)
+{
+    int rc = 0;
+    if (!ms) {
+        return 0;
+    }
+    if (ms->owns_mf) {
+        rc = mclose(ms->mf);
+    }
+    pthread_mutex_destroy(&ms->lock);
+    free(ms);
+    return rc;
+}
+
+mfile* msession_get_mfile(msession *ms)
+{
+    return ms->mf;
+}
+
+void msession_lock(msession *ms)
+{
+    pthread_mutex_lock(&ms->lock);
+}
+
+void msession_unlock(msession *ms)
+{
+    pthread_mutex_unlock(&ms->lock);
+}
+
+/*
+ * Switch the handle to the transaction's address space, must be called with
+ * the session locked. Handles without VSEC only have the cr-space.
+ */
+static int msession_enter_space(msession *ms, int space, int *prev_space)
+{
+    *prev_space = mget_addr_space(ms->mf);
+    if (space == MSESSION_CURR_SPACE || space == *prev_space) {
+        return 0;
+    }
+    if (!mget_vsec_supp(ms->mf)) {
+        return space == AS_CR_SPACE ? 0 : -1;
+    }
+    return mset_addr_space(ms->mf, space);
+}
+
+static void msession_leave_space(msession *ms, int prev_space)
+{
+    if (mget_addr_space(ms->mf) != prev_space) {
+        mset_addr_space(ms->mf, prev_space);
+    }
+}
+
+#define MSESSION_TRANSACTION(ms, space, op) \
+    do { \
+        int prev_space; \
+        if (!(ms)) { \
+            errno = EINVAL; \
+            return -1; \
+        } \
+        pthread_mutex_lock(&(ms)->lock); \
+        if (msession_enter_space(ms, space, &prev_space)) { \
+            pthread_mutex_unlock(&(ms)->lock); \
+            errno = ENOTSUP; \
+            return -1; \
+        } \
+        rc = op; \
+        msession_leave_space(ms, prev_space); \
+        pthread_mutex_unlock(&(ms)->lock); \
+    } while (0)
+
+int msession_read4(msession *ms, int space, unsigned int offset, u_int32_t *value)
+{
+    int rc;
+    MSESSION_TRANSACTION(ms, space, mread4(ms->mf, offset, value));
+    return rc;
+}
+
+int msession_write4(msession *ms, int space, unsigned int offset, u_int32_t value)
+{
+    int rc;
+    MSESSION_TRANSACTION(ms, space, mwrite4(ms->mf, offset, value));
+    return rc;
+}
+
+int msession_read4_block(msession *ms, int space, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    int rc;
+    MSESSION_TRANSACTION(ms, space, mread4_block(ms->mf, offset, data, byte_len));
+    return rc;
+}
+
+int msession_write4_block(msession *ms, int space, unsigned int offset, u_int32_t *data, int byte_len)
+{
+    int rc;
+    MSESSION_TRANSACTION(ms, space, mwrite4_block(ms->mf, offset, data, byte_len));
+    return rc;
+}
+
+int msession_access_reg(msession *ms, u_int16_t reg_id, maccess_reg_method_t reg_method, void *reg_data,
+                        u_int32_t reg_size, u_int32_t r_size_reg, u_int32_t w_size_reg, int *reg_status)
+{
+    int rc;
+    MSESSION_TRANSACTION(ms, MSESSION_CURR_SPACE,
+                         maccess_reg(ms->mf, reg_id, reg_method, reg_data, reg_size, r_size_reg, w_size_reg,
+                                     reg_status));
+    return rc;
+}
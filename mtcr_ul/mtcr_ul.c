@@ -36,6 +36,7 @@
 
 #include <mtcr_ul_com.h>
 #include <mtcr_ib.h>
+#include <mtcr_remote.h>
 #include <errno.h>
 #include <common/tools_utils.h>
 #include <stdlib.h>
@@ -247,6 +248,9 @@ MTCR_API int mset_addr_space(mfile *mf, int space)
     if (space < 0 || space >= AS_END) {
          return -1;
      }
+    if (mf->tp == MST_REMOTE) {
+        return mtcr_remote_set_addr_space(mf, space);
+    }
     if (VSEC_SUPPORTED_UL(mf) && (mf->vsec_cap_mask & (1 << space_to_cap_offset(space)))) {
          mf->address_space = space;
          return 0;
@@ -82,12 +82,15 @@
 
 #include <bit_slice.h>
 #include "tools_utils.h"
+#include "tools_swab.h"
 #include "mtcr_ul_com.h"
 #include "mtcr_int_defs.h"
 #include "mtcr_ib.h"
 #include "packets_layout.h"
 #include "mtcr_tools_cif.h"
 #include "mtcr_icmd_cif.h"
+#include "mtcr_dev_cache.h"
+#include "mtcr_remote.h"
 #ifndef MST_UL
 #include "../mtcr_mlnxos.h"
 #endif
@@ -1341,10 +1344,30 @@ int get_space_support_status(mfile *mf, u_int16_t space)
     return status;
 }
 
+// Config header ids of the function the probe cache is validated against, ids->id is 0 on failure
+static void mtcr_pciconf_read_ids(mfile *mf, mdev_pci_ids *ids)
+{
+    ul_ctx_t *pci_ctx = mf->ul_ctx;
+
+    memset(ids, 0, sizeof(*ids));
+    if (_flock_int(pci_ctx->fdlock, LOCK_EX)) {
+        return;
+    }
+    if (pread(mf->fd, &ids->id, sizeof(ids->id), PCI_VENDOR_ID) != sizeof(ids->id) ||
+        pread(mf->fd, &ids->rev, sizeof(ids->rev), PCI_REVISION_ID) != sizeof(ids->rev) ||
+        pread(mf->fd, &ids->subsys, sizeof(ids->subsys), PCI_SUBSYSTEM_VENDOR_ID) != sizeof(ids->subsys)) {
+        ids->id = 0;
+    }
+    _flock_int(pci_ctx->fdlock, LOCK_UN);
+}
+
 static
 int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
 {
     ul_ctx_t *ctx = mf->ul_ctx;
+    u_int64_t start_time = mdev_cache_time_us();
+    mdev_pci_ids ids;
+    int cached = 0;
     mf->fd = -1;
     mf->fd = open(name, O_RDWR | O_SYNC);
     if (mf->fd < 0) {
@@ -1353,9 +1376,14 @@ int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
 
     mf->tp = MST_PCICONF;
 
-    if ((mf->vsec_addr = pci_find_capability(mf, CAP_ID))) {
+    mtcr_pciconf_read_ids(mf, &ids);
+    if (!(adv_opt & Clear_Vsec_Semaphore) && ids.id && !mdev_cache_get_vsec(mf, &ids)) {
+        cached = 1;
+    } else {
+        mf->vsec_addr = pci_find_capability(mf, CAP_ID);
+    }
+    if (mf->vsec_addr) {
         mf->vsec_supp = 1;
-        // check if the needed spaces are supported
         if (adv_opt & Clear_Vsec_Semaphore) {
             mtcr_pciconf_cap9_sem(mf, 0);
         }
@@ -1365,19 +1393,40 @@ int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
             return -1;
         }
 
-        get_space_support_status(mf, AS_ICMD);
-        get_space_support_status(mf, AS_NODNIC_INIT_SEG);
-        get_space_support_status(mf, AS_EXPANSION_ROM);
-        get_space_support_status(mf, AS_ND_CRSPACE);
-        get_space_support_status(mf, AS_SCAN_CRSPACE);
-        get_space_support_status(mf, AS_MAC);
-        get_space_support_status(mf, AS_ICMD_EXT);
-        get_space_support_status(mf, AS_SEMAPHORE);
-        get_space_support_status(mf, AS_CR_SPACE);
-        mf->vsec_cap_mask |= (1 << VCC_INITIALIZED);
+        // the cached spaces must still match the device, otherwise probe them again
+        if (cached && (mf->vsec_cap_mask & (1 << VCC_CRSPACE_SPACE_SUPPORTED)) &&
+            mtcr_pciconf_set_addr_space(mf, AS_CR_SPACE) != ME_OK) {
+            cached = 0;
+        }
+        if (!cached) {
+            // check if the needed spaces are supported
+            mf->vsec_cap_mask = 0;
+            get_space_support_status(mf, AS_ICMD);
+            get_space_support_status(mf, AS_NODNIC_INIT_SEG);
+            get_space_support_status(mf, AS_EXPANSION_ROM);
+            get_space_support_status(mf, AS_ND_CRSPACE);
+            get_space_support_status(mf, AS_SCAN_CRSPACE);
+            get_space_support_status(mf, AS_MAC);
+            get_space_support_status(mf, AS_ICMD_EXT);
+            get_space_support_status(mf, AS_SEMAPHORE);
+            get_space_support_status(mf, AS_CR_SPACE);
+            mf->vsec_cap_mask |= (1 << VCC_INITIALIZED);
+        }
 
         mtcr_pciconf_cap9_sem(mf, 0);
     }
+    if (cached) {
+        if (mdev_cache_debug()) {
+            fprintf(stderr, "-D- %s: VSEC probe results taken from the cache (%lu usec)\n", name,
+                    (unsigned long)(mdev_cache_time_us() - start_time));
+        }
+    } else if (ids.id) {
+        if (mdev_cache_debug()) {
+            fprintf(stderr, "-D- %s: VSEC probe took %lu usec\n", name,
+                    (unsigned long)(mdev_cache_time_us() - start_time));
+        }
+        mdev_cache_set_vsec(mf, &ids);
+    }
 
     if (VSEC_SUPPORTED_UL(mf)) {
         mf->address_space = AS_CR_SPACE;
@@ -2241,7 +2290,7 @@ mfile* mopen_ul_int(const char *name, u_int32_t adv_opt)
     int err;
     int rc;
 
-    if (geteuid() != 0) {
+    if (geteuid() != 0 && !mtcr_remote_is_name(name)) {
         errno = EACCES;
         return NULL;
     }
@@ -2263,6 +2312,12 @@ mfile* mopen_ul_int(const char *name, u_int32_t adv_opt)
     mf->fd = -1;
     mf->res_fd = -1;
     mf->mpci_change = mpci_change_ul;
+    if (mtcr_remote_is_name(name)) {
+        if (mtcr_remote_open(mf, name)) {
+            goto open_failed;
+        }
+        return mf;
+    }
     dev_type = mtcr_parse_name(name, &force, &domain, &bus, &dev, &func);
     if (dev_type == MST_DRIVER_CR || dev_type == MST_DRIVER_CONF) {
         rc = mtcr_driver_open(mf, dev_type, domain, bus, dev, func);
@@ -2650,12 +2705,7 @@ int maccess_reg_mad_ul(mfile *mf, u_int8_t *data)
 
 static void mtcr_fix_endianness(u_int32_t *buf, int len)
 {
-    int i;
-
-    for (i = 0; i < (len / 4); ++i) {
-        u_int32_t tmp = buf[i];
-        buf[i] = __be32_to_cpu(tmp);
-    }
+    tools_be32_to_cpu_buf(buf, buf, len / 4);
 }
 
 int mread_buffer_ul(mfile *mf, unsigned int offset, u_int8_t *data, int byte_len)
@@ -2722,6 +2772,10 @@ int maccess_reg_ul(mfile *mf,
     if (mf == NULL || reg_data == NULL || reg_status == NULL || reg_size <= 0) {
         return ME_BAD_PARAMS;
     }
+    if (mf->tp == MST_REMOTE) {
+        // the server checks the size and picks the access method
+        return mtcr_remote_access_reg(mf, reg_id, reg_method, reg_data, reg_size, reg_status);
+    }
     // check register size
     unsigned int max_size = (unsigned int) mget_max_reg_size_ul(mf, reg_method);
     if (reg_size > (unsigned int) max_size) {
@@ -2980,6 +3034,8 @@ int mget_max_reg_size_ul(mfile *mf, maccess_reg_method_t reg_method)
 {
     if (mf->acc_reg_params.max_reg_size[reg_method]) {
         return mf->acc_reg_params.max_reg_size[reg_method];
+    } else if (mf->tp == MST_REMOTE) {
+        mf->acc_reg_params.max_reg_size[reg_method] = ICMD_MAX_REG_SIZE;
     } else if (supports_reg_access_gmp(mf, reg_method)) {
         mf->acc_reg_params.max_reg_size[reg_method] = INBAND_MAX_GMP_REG_SIZE;
     } else if (mf->tp == MST_IB) {
@@ -66,24 +66,53 @@ void push_to_buff_32(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_value
 
 
 /************************************/
-//the next function will push the field into the buffer by inserting it's MSB bits first
-//and therefore by doing it we save the CPU_TO_BE operation
+// loads/stores n (1-4) bytes as the MSBs of a big-endian dword
+static u_int32_t load_be_bytes(const u_int8_t *p, u_int32_t n)
+{
+    u_int32_t val = 0;
+    memcpy(&val, p, n);
+    return BE32_TO_CPU(val);
+}
+
+static void store_be_bytes(u_int8_t *p, u_int32_t n, u_int32_t val)
+{
+    val = CPU_TO_BE32(val);
+    memcpy(p, &val, n);
+}
+
+
+/************************************/
+//the next function will push the field_size (1-32) LSBs of field_value into bits bit_offset.. of the buffer,
+//counting from the MSB of byte 0, with one load/store of the (up to 5) bytes it covers
 void push_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
 {
-    u_int32_t i         = 0;
-    u_int32_t byte_n    = bit_offset / 8;
-    u_int32_t byte_n_offset = bit_offset % 8;
-    u_int32_t to_push;
-
-    //going over all bits in field
-    while (i < field_size) {
-        to_push = PCK_MIN(8 - byte_n_offset, field_size - i);
-        i += to_push;
-        //printf("Inserting %u bits(%u) to byte %u to bit %u\n", to_push, EXTRACT8(field_value, field_size - i, to_push), byte_n, 8 - to_push - byte_n_offset);
-        INSERTF_8(BYTE_N(buff, byte_n), 8 - to_push - byte_n_offset, field_value, field_size - i, to_push);
-        byte_n_offset  = 0; //(byte_n_offset + to_push) % 8;
-        byte_n++;
+    u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
+    u_int32_t shift, mask;
+    u_int64_t word, mask64;
+
+    if (field_size == 0) {
+        return;
+    }
+    if (!start && !(field_size % 8)) {
+        //whole bytes, no need to keep any bits of the buffer
+        store_be_bytes(p, n, field_value << (32 - field_size));
+        return;
     }
+    if (n <= 4) {
+        shift = 32 - start - field_size;
+        mask = (0xffffffffU >> (32 - field_size)) << shift;
+        store_be_bytes(p, n, (load_be_bytes(p, n) & ~mask) | ((field_value << shift) & mask));
+        return;
+    }
+    //5 bytes: dword at p and the byte after it
+    shift = 40 - start - field_size;
+    mask64 = (u_int64_t)(0xffffffffU >> (32 - field_size)) << shift;
+    word = ((u_int64_t)load_be_bytes(p, 4) << 8) | p[4];
+    word = (word & ~mask64) | (((u_int64_t)field_value << shift) & mask64);
+    store_be_bytes(p, 4, (u_int32_t)(word >> 8));
+    p[4] = (u_int8_t)word;
 }
 
 
@@ -108,26 +137,23 @@ u_int32_t pop_from_buff_32(u_int8_t *buff, u_int32_t bit_offset)
 
 
 /************************************/
-//the next function will pop the field into the buffer by removing it's MSB bits first
-//and therefore by doing it we save the BE_TO_CPU operation
+//the next function will pop field_size (1-32) bits from bits bit_offset.. of the buffer,
+//counting from the MSB of byte 0, with one load of the (up to 5) bytes it covers
 u_int32_t pop_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
 {
-    u_int32_t i         = 0;
-    u_int32_t byte_n    = bit_offset / 8;
-    u_int32_t byte_n_offset = bit_offset % 8;
-    u_int32_t field_32  = 0;
-    u_int32_t to_pop;
-
-    //going over all bits in field
-    while (i < field_size) {
-        to_pop =  PCK_MIN(8 - byte_n_offset, field_size - i);
-        i += to_pop;
-        //printf("Removing %u bits(%u) from byte %u to bit %u\n", to_pop, EXTRACT8(BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop), byte_n, field_size - i);
-        INSERTF_8(field_32, field_size - i, BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
-        byte_n_offset  = 0; //(byte_n_offset + to_pop) % 8;
-        byte_n++;
+    const u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
+
+    if (field_size == 0) {
+        return 0;
+    }
+    if (n <= 4) {
+        return (load_be_bytes(p, n) << start) >> (32 - field_size);
     }
-    return field_32;
+    //5 bytes: dword at p and the byte after it
+    return (u_int32_t)(((((u_int64_t)load_be_bytes(p, 4) << 8) | p[4]) >> (40 - start - field_size)) &
+                       (0xffffffffU >> (32 - field_size)));
 }
 
 /************************************
@@ -37,6 +37,7 @@ extern "C" {
 #endif
 
 #include <mtcr.h>
+#include <mtcr_async.h>
 #include <tools_layouts/register_access_open_layouts.h>
 #include <tools_layouts/register_access_sib_layouts.h>
 #include <tools_layouts/cibfw_layouts.h>
@@ -57,6 +58,9 @@ typedef enum {
 // we use the same error messages as mtcr
 typedef MError reg_access_status_t;
 
+// completion of an asynchronous access, the register struct was already unpacked
+typedef void (*reg_access_async_cb_t)(reg_access_status_t rc, void *cb_ctx);
+
 
 const char* reg_access_err2str(reg_access_status_t status);
 reg_access_status_t reg_access_mfba(mfile *mf, reg_access_method_t method, struct register_access_mfba *mfba);
@@ -92,6 +96,14 @@ reg_access_status_t reg_access_mcqs(mfile *mf, reg_access_method_t method, struc
 reg_access_status_t reg_access_mcqi(mfile *mf, reg_access_method_t method, struct reg_access_hca_mcqi_reg *mcqi);
 reg_access_status_t reg_access_mgir(mfile *mf, reg_access_method_t method, struct tools_open_mgir *mgir);
 reg_access_status_t reg_access_mtrc_cap(mfile *mf, reg_access_method_t method, struct reg_access_hca_mtrc_cap_reg *mtrc_cap);
+/*
+ * Asynchronous variants, the register struct must stay valid until cb is invoked
+ * (see maccess_reg_poll/maccess_reg_drain).
+ */
+reg_access_status_t reg_access_nvda_async(maccess_reg_queue *q, mfile *mf, reg_access_method_t method,
+                                          struct tools_open_nvda *nvda, reg_access_async_cb_t cb, void *cb_ctx);
+reg_access_status_t reg_access_nvqc_async(maccess_reg_queue *q, mfile *mf, reg_access_method_t method,
+                                          struct tools_open_nvqc *nvqc, reg_access_async_cb_t cb, void *cb_ctx);
 
 const char* reg_access_err2str(reg_access_status_t status);
 
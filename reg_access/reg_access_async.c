@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "reg_access.h"
+
+/*
+ * Kept apart from reg_access.c so tools that never use the asynchronous
+ * queue do not pull mtcr_async into their link.
+ */
+#define REG_ID_MNVA  0x9024
+#define REG_ID_NVQC  0x9030
+
+typedef void (*reg_access_unpack_t)(void *data_struct, const u_int8_t *buff);
+
+typedef struct reg_access_async_ctx {
+    void *data_struct;
+    u_int8_t *data;
+    reg_access_unpack_t unpack_func;
+    reg_access_async_cb_t cb;
+    void *cb_ctx;
+} reg_access_async_ctx;
+
+static void reg_access_async_done(int rc, int reg_status, void *reg_data, void *cb_ctx)
+{
+    reg_access_async_ctx *ctx = (reg_access_async_ctx*)cb_ctx;
+    (void)reg_data;
+    (void)reg_status;
+    ctx->unpack_func(ctx->data_struct, ctx->data);
+    if (ctx->cb) {
+        ctx->cb((reg_access_status_t)rc, ctx->cb_ctx);
+    }
+    free(ctx->data);
+    free(ctx);
+}
+
+/*
+ * data holds the packed register (max_data_size bytes), ownership moves to the queue
+ */
+static reg_access_status_t reg_access_async_submit(maccess_reg_queue *q, mfile *mf, reg_access_method_t method,
+                                                   u_int16_t reg_id, void *data_struct, u_int8_t *data,
+                                                   reg_access_unpack_t unpack_func, u_int32_t reg_size,
+                                                   u_int32_t r_size_reg, u_int32_t w_size_reg,
+                                                   reg_access_async_cb_t cb, void *cb_ctx)
+{
+    reg_access_async_ctx *ctx = (reg_access_async_ctx*)malloc(sizeof(reg_access_async_ctx));
+    if (!ctx) {
+        free(data);
+        return ME_MEM_ERROR;
+    }
+    ctx->data_struct = data_struct;
+    ctx->data = data;
+    ctx->unpack_func = unpack_func;
+    ctx->cb = cb;
+    ctx->cb_ctx = cb_ctx;
+    if (maccess_reg_async(q, mf, reg_id, (maccess_reg_method_t)method, data, reg_size, r_size_reg, w_size_reg,
+                          reg_access_async_done, ctx)) {
+        free(data);
+        free(ctx);
+        return ME_ERROR;
+    }
+    return ME_OK;
+}
+
+/*
+ * Unpack wrapper with the exact reg_access_unpack_t type, calling the typed
+ * layout function through a cast pointer would be undefined behavior
+ */
+#define REG_ACCESS_ASYNC_UNPACK(prefix, struct_name) \
+    static void prefix##_##struct_name##_unpack_any(void *data_struct, const u_int8_t *buff) \
+    { \
+        prefix##_##struct_name##_unpack((struct prefix##_##struct_name*)data_struct, buff); \
+    }
+
+REG_ACCESS_ASYNC_UNPACK(tools_open, nvda)
+REG_ACCESS_ASYNC_UNPACK(tools_open, nvqc)
+
+#define REG_ACCESS_ASYNC_VAR(q, mf, method, reg_id, data_struct, struct_name, reg_size, r_size_reg, w_size_reg, \
+                             prefix, cb, cb_ctx) \
+    int max_data_size = prefix##_##struct_name##_size(); \
+    u_int8_t *data; \
+    if (method != REG_ACCESS_METHOD_GET && method != REG_ACCESS_METHOD_SET) { \
+        return ME_REG_ACCESS_BAD_METHOD; \
+    } \
+    data = (u_int8_t*)malloc(max_data_size); \
+    if (!data) { return ME_MEM_ERROR;} \
+    memset(data, 0, max_data_size); \
+    prefix##_##struct_name##_pack(data_struct, data); \
+    return reg_access_async_submit(q, mf, method, reg_id, data_struct, data, \
+                                   prefix##_##struct_name##_unpack_any, reg_size, r_size_reg, \
+                                   w_size_reg, cb, cb_ctx)
+
+/************************************
+* Function: reg_access_nvda_async
+************************************/
+reg_access_status_t reg_access_nvda_async(maccess_reg_queue *q, mfile *mf, reg_access_method_t method,
+                                          struct tools_open_nvda *nvda, reg_access_async_cb_t cb, void *cb_ctx)
+{
+    u_int32_t reg_size = nvda->nv_hdr.length + tools_open_nv_hdr_fifth_gen_size();
+    u_int32_t r_size_reg = reg_size;
+    u_int32_t w_size_reg = reg_size;
+    if (method == REG_ACCESS_METHOD_GET) {
+        w_size_reg -= nvda->nv_hdr.length;
+    } else {
+        r_size_reg -= nvda->nv_hdr.length;
+    }
+    REG_ACCESS_ASYNC_VAR(q, mf, method, REG_ID_MNVA, nvda, nvda, reg_size, r_size_reg, w_size_reg, tools_open,
+                         cb, cb_ctx);
+}
+
+/************************************
+* Function: reg_access_nvqc_async
+************************************/
+reg_access_status_t reg_access_nvqc_async(maccess_reg_queue *q, mfile *mf, reg_access_method_t method,
+                                          struct tools_open_nvqc *nvqc, reg_access_async_cb_t cb, void *cb_ctx)
+{
+    u_int32_t reg_size = tools_open_nvqc_size();
+    if (method != REG_ACCESS_METHOD_GET) {  // this register supports only get method
+        return ME_REG_ACCESS_BAD_METHOD;
+    }
+    REG_ACCESS_ASYNC_VAR(q, mf, method, REG_ID_NVQC, nvqc, nvqc, reg_size, reg_size, reg_size, tools_open,
+                         cb, cb_ctx);
+}
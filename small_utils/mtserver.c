@@ -96,7 +96,7 @@
  *  Version:
  *       Send buff:  V
  *       Rcv  buff:  O   Version
- *                   O   1.4
+ *                   O   1.5
  *
  *  Mi2c_detect:
  *       Send buff:  S
@@ -110,16 +110,17 @@
  *  Mset_addr_space:
  *       Send buff:  A   <AddressSpace>
  *       Rcv  buff:  O
+ *
+ *  Switch to binary protocol (see mtserver_proto.h):
+ *       Send buff:  X   MaxVersion
+ *                   X   1
+ *       Rcv  buff:  O   Version
+ *                   O   1
+ *       All following messages on the connection are binary frames.
  */
 
-#ifndef __WIN__
-    #define PREP_SIGNAL(signal_handler) signal(SIGPIPE, signal_handler);
-    #define WIN_INIT()
-    #define WIN_CLOSE(mf, cmd)
-    #define WIN_WHILE()
-#else
+#ifdef __WIN__
     #include <winsock2.h>
-    #define PREP_SIGNAL(signal_handler)
     #define WIN_INIT() {                          \
         int rc;                                   \
         WSADATA wsaData;                          \
@@ -129,13 +130,6 @@
             exit(1);                            \
         }                                         \
 }
-    #define WIN_CLOSE(mf, cmd) { \
-        if (!mf && cmd != 'V') { \
-            break; \
-        } \
-}
-
-    #define WIN_WHILE() while (1)
 #endif
 
 #include <stdio.h>
@@ -143,12 +137,21 @@
 #include <string.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <time.h>
 #include <compatibility.h>
+#ifndef __WIN__
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+#endif
 
 #include "mtcr.h"
 #include "tcp.h"
+#include "mtserver.h"
+#include "mtserver_proto.h"
 #include "tools_version.h"
 #include "common/tools_utils.h"
+#include "common/tools_swab.h"
 
 /*
  * Constants
@@ -157,33 +160,75 @@
 #define MAX_DWORDS  128
 #define BUF_LEN  (MAX_DWORDS * 4 * 3)
 #define DEV_LEN  2048
+#define DEF_WORKERS 4
+#define MAX_WORKERS 64
 
 
 int sdebug = 0;
 int port = DEF_PORT;    /* Default port */
+static char *local_dev = NULL;
 
 
 /* ////////////////////////////////////////////////////////////////////// */
-static void writes_deb(int con, char *s)
+static u_int8_t* srv_reserve(srv_conn_t *c, int n)
 {
-    writes(con, s, PT_TCP);
-    if (sdebug) {
-        printf("-> %s\n", s);
+    if (c->out_len + n > c->out_size && c->out_pos) {
+        memmove(c->out, c->out + c->out_pos, c->out_len - c->out_pos);
+        c->out_len -= c->out_pos;
+        c->out_pos = 0;
+    }
+    if (c->out_len + n > c->out_size) {
+        int size = c->out_size ? c->out_size : 4096;
+        u_int8_t *out;
+        while (size < c->out_len + n) {
+            size *= 2;
+        }
+        out = (u_int8_t*)realloc(c->out, size);
+        if (!out) {
+            return NULL;
+        }
+        c->out = out;
+        c->out_size = size;
     }
+    return c->out + c->out_len;
+}
+
+/* Queue a reply - a connection that cannot be answered is dropped */
+static void srv_put(srv_conn_t *c, const void *data, int len)
+{
+    u_int8_t *p = srv_reserve(c, len);
+
+    if (!p) {
+        printf("-E- Out of memory - closing connection %d\n", c->id);
+        c->eof = 1;
+        return;
+    }
+    memcpy(p, data, len);
+    c->out_len += len;
 }
 
 /* ////////////////////////////////////////////////////////////////////// */
-void write_err(int con)
+static void writes_deb(srv_conn_t *con, char *s)
 {
-    writen(con, "E ", 2, PT_TCP);
-    writes(con, strerror(errno), PT_TCP);
+    srv_put(con, s, strlen(s) + 1);
+    if (*s == 'E') {
+        con->stats.errors++;
+    }
     if (sdebug) {
-        printf("-> E %s\n", strerror(errno));
+        printf("-> %s\n", s);
     }
 }
 
 /* ////////////////////////////////////////////////////////////////////// */
-void write_ok(int con)
+void write_err(srv_conn_t *con)
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg), "E %s", strerror(errno));
+    writes_deb(con, msg);
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+void write_ok(srv_conn_t *con)
 {
     writes_deb(con, "O");
 }
@@ -197,6 +242,7 @@ void write_ok(int con)
     #include <sys/stat.h>
     #include <fcntl.h>
     #include <unistd.h>
+    #include "mtserver_sim.h"
 
     #define FILE_PATH "/tmp/mmap.log"
     #define NUM_INTS  (0x200000)
@@ -204,15 +250,18 @@ void write_ok(int con)
 
 u_int32_t *cr_space;
 char sim_str[] = "\t-i[d]   <id>   - set the device id.\n"
-                 "\t-f[ile] <file> - load cr-space snapshot from dump file.\n";
+                 "\t-f[ile] <file> - load cr-space snapshot from dump file.\n"
+                 "\t-s[cript] <file> - simulator script (registers, icmd responses, semaphores, VSEC).\n"
+                 "\t-flash <image> - emulate the flash gateway on top of a flash image file.\n";
 int id;
 char *dump_file = NULL;
+char *sim_script = NULL;
+char *flash_image = NULL;
 int fd;
 mfile* mopen(const char *name)
 {
     TOOLS_UNUSED(name);
-    return (mfile*)0;
-
+    return (mfile*)1;
 }
 
 
@@ -239,16 +288,31 @@ int mdevices(char *buf, int len, int mask)
 
 int mread4(mfile *mf, unsigned int offset, u_int32_t *value)
 {
+    int rc;
+
     TOOLS_UNUSED(mf);
-    *value = __be32_to_cpu(cr_space[offset / 4]);
+    rc = sim_read4(offset, value);
+    if (rc < 0) {
+        return -1;
+    }
+    if (!rc) {
+        *value = __be32_to_cpu(cr_space[offset / 4]);
+    }
     return 4;
 }
 
 int mwrite4(mfile *mf, unsigned int offset, u_int32_t value)
 {
+    int rc;
+
     TOOLS_UNUSED(mf);
-    cr_space[offset / 4] = __cpu_to_be32(value);
-    //cr_space[offset/4] = value;
+    rc = sim_write4(offset, value);
+    if (rc < 0) {
+        return -1;
+    }
+    if (!rc) {
+        cr_space[offset / 4] = __cpu_to_be32(value);
+    }
     return 4;
 }
 int mi2c_detect(mfile *mf, u_int8_t slv_arr[SLV_ADDRS_NUM])
@@ -290,20 +354,16 @@ int mwrite4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
     }
     mf = NULL;
     for (i = 0; i < byte_len; i += 4) {
-        mwrite4(mf, offset + i, *(data++));
+        if (mwrite4(mf, offset + i, *(data++)) != 4) {
+            return -1;
+        }
     }
     return byte_len;
 }
 
 static void fix_endianness(u_int32_t *buf, int len)
 {
-    int i;
-
-    for (i = 0; i < (len / 4); ++i) {
-        //printf("-D- before: buf[%d] = %#x\n", i, buf[i]);
-        buf[i] = __be32_to_cpu(buf[i]);
-        //printf("-D- before: buf[%d] = %#x\n", i, buf[i]);
-    }
+    tools_be32_to_cpu_buf(buf, buf, len / 4);
 }
 
 int mwrite_buffer(mfile *mf, unsigned int offset, u_int8_t *data, int byte_len)
@@ -322,7 +382,9 @@ int mread4_block(mfile *mf, unsigned int offset, u_int32_t *data, int byte_len)
     }
     mf = NULL;
     for (i = 0; i < byte_len; i += 4) {
-        mread4(mf, offset + i, data++);
+        if (mread4(mf, offset + i, data++) != 4) {
+            return -1;
+        }
     }
     return byte_len;
 }
@@ -355,6 +417,26 @@ void check_file_arg(char *av[], int ac, int *i)
     dump_file = av[*i];
 }
 
+int check_sim_arg(char *av[], int ac, int *i)
+{
+    char **arg;
+
+    if (!strcmp(av[*i], "s")  ||  !strcmp(av[*i], "script")) {
+        arg = &sim_script;
+    } else if (!strcmp(av[*i], "flash")) {
+        arg = &flash_image;
+    } else {
+        return 0;
+    }
+    if (++(*i) >= ac) {
+        printf("After switch \"%s\" file name is expected.\n", av[--(*i)]);
+        printf("Type \"%s -h\" for help.\n", av[0]);
+        exit(1);
+    }
+    *arg = av[*i];
+    return 1;
+}
+
 void load_dump_file()
 {
     #define BUFSIZE 40
@@ -436,11 +518,16 @@ int prepare_the_map_file(void)
         mwrite4(NULL, 0xf0014, id);
     }
 
+    // device models on top of the snapshot
+    if (sim_init(cr_space, FILE_SIZE, id, sim_script, flash_image)) {
+        exit(1);
+    }
     return 0;
 }
 
 int unmap_and_close_file(void)
 {
+    sim_cleanup();
     if (munmap(cr_space, FILE_SIZE) == -1) {
         perror("Error un-mmapping the file");
     }
@@ -452,7 +539,7 @@ void mpci_change(mfile *mf)
     TOOLS_UNUSED(mf);
 }
 
-void get_devices_list(int con)
+void get_devices_list(srv_conn_t *con)
 {
     char dev_buf[DEV_LEN];
     int i, rc;
@@ -472,13 +559,17 @@ void get_devices_list(int con)
 int mget_vsec_supp(mfile *mf)
 {
     TOOLS_UNUSED(mf);
-    return 0;
+    return sim_vsec_supp();
 }
 int mset_addr_space(mfile *mf, int space)
 {
     TOOLS_UNUSED(mf);
-    TOOLS_UNUSED(space);
-    return 0;
+    return sim_set_space(space);
+}
+int mget_addr_space(mfile *mf)
+{
+    TOOLS_UNUSED(mf);
+    return sim_get_space();
 }
 #else
 extern void mpci_change(mfile *mf);
@@ -505,6 +596,14 @@ void check_file_arg(char *av[], int ac, int *i)
     exit(1);
 }
 
+int check_sim_arg(char *av[], int ac, int *i)
+{
+    (void)av;
+    (void)ac;
+    (void)i;
+    return 0;
+}
+
 int prepare_the_map_file(void)
 {
     return 0;
@@ -516,7 +615,7 @@ int unmap_and_close_file(void)
 
 }
 
-void get_devices_list(int con)
+void get_devices_list(srv_conn_t *con)
 {
 #ifndef MST_UL
     dev_info *mdevs_inf = NULL;
@@ -562,6 +661,7 @@ void usage(const char *s)
     printf("Usage:\n\t%s [switches]\n\n", s);
     printf("Switches may be:\n");
     printf("\t-p[ort] <port> - Listen to specify port (default is %d).\n", port);
+    printf("\t-w[orkers] <n> - Number of threads serving the clients (default is %d).\n", DEF_WORKERS);
     printf("\t-d[ebug]       - Print all socket traffic (for debugging only).\n");
     printf("%s", sim_str);
     printf("\t-h[elp]        - Print help message.\n");
@@ -569,12 +669,6 @@ void usage(const char *s)
     exit(1);
 }
 
-/* ////////////////////////////////////////////////////////////////////// */
-void mySignal()
-{
-    exit(0);
-}
-
 #define GET_PARAM(param, str, type, param_name, err_msg) { \
         char *end; \
         param = (type)strtoul(str, &end, 0); \
@@ -657,16 +751,773 @@ int copy_buff_to_str(char *str, u_int8_t *data, int size)
 
 /* ////////////////////////////////////////////////////////////////////// */
 #define CHK2(f, m) do { if ((f) < 0) { perror(m); exit(1); } } while (0)
-#define MSTSERVER_VERSION "1.4"
+#define MSTSERVER_VERSION "1.5"
 #define MSTSERVER_NAME    "mtserver"
 
-int main(int ac, char *av[])
+#define SRV_IN_SIZE   (BUF_LEN * 2)
+#define BIN_IN_SIZE   (MTSRV_HDR_SIZE + MTSRV_MAX_PAYLOAD)
+#define BIN_ERRNO()   (errno ? errno : EIO)
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+
+static srv_dev_t *srv_devs = NULL;
+static srv_lock_t srv_devs_lock;
+
+/* ////////////////////////////////////////////////////////////////////// */
+u_int64_t srv_time_us(void)
+{
+#ifndef __WIN__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (u_int64_t)GetTickCount64() * 1000;
+#endif
+}
+
+/*
+ * Connections that open the same device with the same type share one mfile,
+ * it is closed when the last of them closes it.
+ */
+static srv_dev_t* srv_dev_get(const char *name, DType dtype)
+{
+    srv_dev_t *dev;
+
+    SRV_LOCK(&srv_devs_lock);
+    for (dev = srv_devs; dev; dev = dev->next) {
+        if (dev->dtype == dtype && !strcmp(dev->name, name)) {
+            break;
+        }
+    }
+    if (!dev) {
+        mfile *mf = dtype ? mopend(name, dtype) : mopen(name);
+        if (mf) {
+            dev = (srv_dev_t*)calloc(1, sizeof(*dev));
+            if (!dev || !(dev->name = strdup(name))) {
+                free(dev);
+                dev = NULL;
+                mclose(mf);
+                errno = ENOMEM;
+            } else {
+                dev->dtype = dtype;
+                dev->mf = mf;
+                dev->def_space = mget_addr_space(mf);
+                SRV_LOCK_INIT(&dev->lock);
+                dev->next = srv_devs;
+                srv_devs = dev;
+            }
+        }
+    }
+    if (dev) {
+        dev->refs++;
+    }
+    SRV_UNLOCK(&srv_devs_lock);
+    return dev;
+}
+
+static void srv_dev_put(srv_dev_t *dev)
+{
+    srv_dev_t **p;
+
+    SRV_LOCK(&srv_devs_lock);
+    if (--dev->refs == 0) {
+        for (p = &srv_devs; *p != dev; p = &(*p)->next) {
+        }
+        *p = dev->next;
+        if (sdebug) {
+            printf("-D- closing %s\n", dev->name);
+        }
+        mclose(dev->mf);
+        SRV_LOCK_DESTROY(&dev->lock);
+        free(dev->name);
+        free(dev);
+    }
+    SRV_UNLOCK(&srv_devs_lock);
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+int srv_conn_init(srv_conn_t *c, int fd)
+{
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    c->space = -1;
+    c->in_size = SRV_IN_SIZE;
+    c->in = (u_int8_t*)malloc(c->in_size);
+    if (!c->in) {
+        errno = ENOMEM;
+        return -1;
+    }
+    c->stats.connected_us = srv_time_us();
+    return 0;
+}
+
+void srv_conn_release(srv_conn_t *c)
+{
+    if (c->dev) {
+        srv_dev_put(c->dev);
+        c->dev = NULL;
+    }
+    free(c->in);
+    free(c->out);
+    free(c->data);
+    c->in = c->out = NULL;
+    c->data = NULL;
+}
+
+int srv_conn_fill(srv_conn_t *c)
+{
+    int rc;
+
+    if (c->in_pos) {
+        memmove(c->in, c->in + c->in_pos, c->in_len - c->in_pos);
+        c->in_len -= c->in_pos;
+        c->in_pos = 0;
+    }
+    if (c->in_len == c->in_size) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    rc = readany(c->fd, c->in + c->in_len, c->in_size - c->in_len, PT_TCP);
+    if (rc > 0) {
+        c->in_len += rc;
+        c->stats.bytes_in += rc;
+    }
+    return rc;
+}
+
+int srv_conn_pending(srv_conn_t *c)
+{
+    int avail = c->in_len - c->in_pos;
+
+    if (c->bin_version) {
+        mtsrv_frame_hdr_t req;
+        if (avail < MTSRV_HDR_SIZE) {
+            return 0;
+        }
+        mtsrv_hdr_unpack(c->in + c->in_pos, &req);
+        if (req.magic != MTSRV_FRAME_MAGIC || req.version != c->bin_version || req.len > MTSRV_MAX_PAYLOAD) {
+            printf("-E- Bad binary frame (magic 0x%x version %d len %u) - closing connection\n",
+                   req.magic, req.version, req.len);
+            errno = EPROTO;
+            return -1;
+        }
+        return avail >= MTSRV_HDR_SIZE + (int)req.len;
+    }
+    if (memchr(c->in + c->in_pos, '\0', avail)) {
+        return 1;
+    }
+    if (avail >= BUF_LEN) {
+        printf("-E- Command exceeds %d bytes - closing connection\n", BUF_LEN);
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+int srv_conn_flush(srv_conn_t *c)
+{
+    int rc;
+
+    while (c->out_pos < c->out_len) {
+        do {
+            rc = send(c->fd, (char*)c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL);
+        } while (rc < 0 && errno == EINTR);
+        if (rc < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+        }
+        c->out_pos += rc;
+        c->stats.bytes_out += rc;
+    }
+    c->out_pos = c->out_len = 0;
+    return 0;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+static int bin_start(srv_conn_t *c, int version)
+{
+    if (!c->data && !(c->data = (u_int32_t*)malloc(MTSRV_MAX_PAYLOAD))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (c->in_size < BIN_IN_SIZE) {
+        u_int8_t *in = (u_int8_t*)realloc(c->in, BIN_IN_SIZE);
+        if (!in) {
+            errno = ENOMEM;
+            return -1;
+        }
+        c->in = in;
+        c->in_size = BIN_IN_SIZE;
+    }
+    c->bin_version = version > MTSRV_PROTO_VERSION ? MTSRV_PROTO_VERSION : version;
+    return 0;
+}
+
+static void bin_reply(srv_conn_t *c, const mtsrv_frame_hdr_t *req, u_int32_t status,
+                      u_int32_t addr, u_int32_t arg, u_int32_t len)
+{
+    mtsrv_frame_hdr_t rsp = *req;
+    u_int8_t *p = srv_reserve(c, MTSRV_HDR_SIZE + len);
+
+    if (!p) {
+        printf("-E- Out of memory - closing connection %d\n", c->id);
+        c->eof = 1;
+        return;
+    }
+    rsp.magic = MTSRV_FRAME_MAGIC;
+    rsp.version = c->bin_version;
+    rsp.addr = addr;
+    rsp.arg = arg;
+    rsp.status = status;
+    rsp.len = len;
+    mtsrv_hdr_pack(p, &rsp);
+    memcpy(p + MTSRV_HDR_SIZE, c->data, len);
+    c->out_len += MTSRV_HDR_SIZE + len;
+    if (status) {
+        c->stats.errors++;
+    }
+    if (sdebug) {
+        printf("-> op %d id %u status %u addr 0x%x arg 0x%x len %u\n",
+               rsp.op, rsp.id, status, addr, arg, len);
+    }
+}
+
+static int bin_exec(srv_conn_t *c)
+{
+    mtsrv_frame_hdr_t hdr, *req = &hdr;
+    const u_int8_t *payload = c->in + c->in_pos + MTSRV_HDR_SIZE;
+    mfile *mf = c->dev ? c->dev->mf : NULL;
+    u_int32_t status = 0, addr = 0, arg = 0, len = 0, i;
+
+    mtsrv_hdr_unpack(c->in + c->in_pos, req);
+    c->in_pos += MTSRV_HDR_SIZE + req->len;
+    if (sdebug) {
+        printf("<- op %d id %u addr 0x%x arg 0x%x len %u\n",
+               req->op, req->id, req->addr, req->arg, req->len);
+    }
+    if (req->op != MTSRV_OP_OPEN && !mf) {
+        bin_reply(c, req, ENODEV, 0, 0, 0);
+        return req->op;
+    }
+
+    errno = 0;
+    switch (req->op) {
+    case MTSRV_OP_OPEN:
+        if (mf) {
+            status = EBUSY;
+            break;
+        }
+#ifndef MST_UL
+        {
+            char name[DEV_LEN];
+            if (req->len == 0 || req->len >= DEV_LEN) {
+                status = EINVAL;
+                break;
+            }
+            memcpy(name, payload, req->len);
+            name[req->len] = '\0';
+            c->dev = srv_dev_get(name, (DType)req->arg);
+        }
+#else
+        c->dev = srv_dev_get(local_dev, (DType)0);
+#endif
+        if (!c->dev) {
+            status = BIN_ERRNO();
+        } else {
+            c->space = c->dev->def_space;
+            arg = mget_vsec_supp(c->dev->mf);
+        }
+        break;
+
+    case MTSRV_OP_CLOSE:
+        /* the device is closed when its last connection is done with it */
+        c->dev = NULL;
+        break;
+
+    case MTSRV_OP_READ4:
+        if (mread4(mf, req->addr, c->data) < 4) {
+            status = BIN_ERRNO();
+        } else {
+            c->data[0] = __cpu_to_le32(c->data[0]);
+            len = 4;
+        }
+        break;
+
+    case MTSRV_OP_WRITE4:
+        if (mwrite4(mf, req->addr, req->arg) < 4) {
+            status = BIN_ERRNO();
+        }
+        break;
+
+    case MTSRV_OP_READ_BLOCK:
+        if (req->arg > MTSRV_MAX_PAYLOAD || req->arg % 4) {
+            status = EINVAL;
+        } else if (mread4_block(mf, req->addr, c->data, req->arg) != (int)req->arg) {
+            status = BIN_ERRNO();
+        } else {
+            for (i = 0; i < req->arg / 4; i++) {
+                c->data[i] = __cpu_to_le32(c->data[i]);
+            }
+            len = req->arg;
+        }
+        break;
+
+    case MTSRV_OP_WRITE_BLOCK:
+        if (req->len % 4) {
+            status = EINVAL;
+            break;
+        }
+        memcpy(c->data, payload, req->len);
+        for (i = 0; i < req->len / 4; i++) {
+            c->data[i] = __le32_to_cpu(c->data[i]);
+        }
+        if (mwrite4_block(mf, req->addr, c->data, req->len) != (int)req->len) {
+            status = BIN_ERRNO();
+        }
+        break;
+
+    case MTSRV_OP_REG_ACCESS:
+#ifndef SIMULATOR
+        {
+            int reg_status = 0;
+            memcpy(c->data, payload, req->len);
+            arg = maccess_reg(mf, (u_int16_t)req->addr, (maccess_reg_method_t)req->arg, c->data,
+                              req->len, req->len, req->len, &reg_status);
+            addr = reg_status;
+            len = req->len;
+        }
+#else
+        {
+            int reg_status = 0;
+            memcpy(c->data, payload, req->len);
+            arg = sim_reg_access((u_int16_t)req->addr, (int)req->arg, (u_int8_t*)c->data, req->len,
+                                 &reg_status);
+            addr = reg_status;
+            len = req->len;
+        }
+#endif
+        break;
+
+    case MTSRV_OP_SET_ADDR_SPACE:
+        if (mset_addr_space(mf, (int)req->arg)) {
+            status = BIN_ERRNO();
+        } else {
+            c->space = (int)req->arg;
+        }
+        break;
+
+    case MTSRV_OP_PCI_CHANGE:
+        mpci_change(mf);
+        break;
+
+    default:
+        status = ENOSYS;
+        break;
+    }
+    bin_reply(c, req, status, addr, arg, len);
+    return req->op;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+static int ascii_exec(srv_conn_t *con)
 {
     char *end;
-    char *local_dev = NULL;
     char buf[BUF_LEN], dev_buf[DEV_LEN];
-    int i, con, rc;
-    mfile *mf = 0;
+    char *cmd = (char*)con->in + con->in_pos;
+    int bin_version, len = strlen(cmd);
+    mfile *mf = con->dev ? con->dev->mf : NULL;
+
+    /* Replies may be built in buf, keep the pipelined commands intact */
+    memcpy(buf, cmd, len + 1);
+    con->in_pos += len + 1;
+    if (sdebug) {
+        printf("<- %s\n", buf);
+    }
+    switch (*buf) {
+    case 'O':   /*  Open mfile */
+
+        if (mf) {
+            writes_deb(con, "E Already opened");
+        } else {
+#ifndef MST_UL
+            DType dtype = strtoul(buf + 2, &end, 0);
+            if (*end != ' ') {
+                /*  Old style (O DEV_NAME) */
+                con->dev = srv_dev_get(buf + 2, 0);
+            } else {
+                /*  New style (O FLAG DEV_NAME) */
+                con->dev = srv_dev_get(end + 1, dtype);
+            }
+#else
+            con->dev = srv_dev_get(local_dev, 0);
+#endif
+            if (con->dev) {
+                mf = con->dev->mf;
+                con->space = con->dev->def_space;
+            }
+            if (mf) {
+                // write Recv buffer
+                char res_buf[16];
+                snprintf(res_buf, 16, "O %d", mget_vsec_supp(mf));
+                writes_deb(con, res_buf);
+            } else {
+                write_err(con);
+            }
+        }
+        break;
+
+    case 'C':  /*  Close mfile */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            /* the device is closed when its last connection is done with it */
+            con->dev = NULL;
+            write_ok(con);
+        }
+        break;
+
+    case 'V':  /*  Get version */
+        writes_deb(con, "O "MSTSERVER_VERSION);
+        break;
+
+    case 'X':   /*  Switch to binary protocol */
+        bin_version = strtol(buf + 2, &end, 0);
+        if (*end || bin_version < 1) {
+            writes_deb(con, "E Invalid protocol version");
+        } else if (bin_start(con, bin_version)) {
+            write_err(con);
+        } else {
+            char vbuf[16];
+            sprintf(vbuf, "O %d", con->bin_version);
+            writes_deb(con, vbuf);
+        }
+        break;
+
+    case 'L':   /*  Get devices list */
+        if (local_dev == NULL) {
+            get_devices_list(con);
+        } else {
+            strcpy(dev_buf, "/dev/mst/mt25204_pci_cr0");
+            printf("-D- local_dev=%s dev_buf=%s\n", local_dev, dev_buf);
+            writes_deb(con, "O 1");
+            writes_deb(con, dev_buf);
+        }
+
+        break;
+
+    case 'R':   /*  Read word */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            unsigned int offset;
+            u_int32_t value;
+            offset = strtoul(buf + 2, &end, 0);
+            if (*end) {
+                writes_deb(con, "E Invalid offset");
+            } else {
+                if (mread4(mf, offset, &value) < 4) {
+                    write_err(con);
+                } else {
+                    char vbuf[16];
+                    sprintf(vbuf, "O 0x%08x", value);
+                    writes_deb(con, vbuf);
+                }
+            }
+        }
+        break;
+
+#ifndef MST_UL
+    case 'S':  /*  Scan I2C bus */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            u_int8_t slv_arr[SLV_ADDRS_NUM] = {0};
+            if (mi2c_detect(mf, slv_arr) < 0) {
+                write_err(con);
+            } else {
+                int i;
+                char *p, buf[1024];
+                sprintf(buf, "O");
+                p =  buf + 1;
+                for (i = 0; i < SLV_ADDRS_NUM; i++) {
+                    if (slv_arr[i]) {
+                        sprintf(p, " 0x%02x", i);
+                        p += strlen(p);
+                    }
+                }
+                writes_deb(con, buf);
+            }
+        }
+        break;
+
+    case 'B':
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            unsigned int offset;
+            int size;
+            u_int32_t buf_data[MAX_DWORDS];
+
+            offset = strtoul(buf + 2, &end, 0);
+            if (*end != ' ') {
+                writes_deb(con, "E Invalid offset");
+            }
+
+            size = strtoul(end, &end, 0);
+            if (*end != '\0') {
+                writes_deb(con, "E Invalid size");
+            }
+
+            if (mread4_block(mf, offset, buf_data, size) != size) {
+                write_err(con);
+            } else   {
+                int i;
+                int div4 = size >> 2;
+                int mod4 = size % 4;
+                sprintf(buf, "O");
+                char *last = buf + 1;
+                for (i = 0; i < div4; i++) {
+                    last += sprintf(last, " 0x%08x", buf_data[i]);
+                }
+                /* If the size is not divided by 4 need to read the remained bytes */
+                if (mod4) {
+                    last += sprintf(last, " 0x");
+                    for (i = mod4 - 1; i >= 0; i--) {
+                        last += sprintf(last, "%02x", ((u_int8_t*)buf_data)[div4 * 4 + i]);
+                    }
+                }
+                writes_deb(con, buf);
+            }
+        }
+        break;
+
+    case 'U':
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            unsigned int offset;
+            int size;
+            u_int32_t buf_data[MAX_DWORDS];
+            int i;
+
+            offset = strtoul(buf + 2, &end, 0);
+            if (*end != ' ') {
+                writes_deb(con, "E Invalid offset");
+            }
+
+            size = strtoul(end, &end, 0);
+            if (*end != ' ' || size > (MAX_DWORDS << 2)) {
+                writes_deb(con, "E Invalid size");
+            }
+
+            for (i = 0; i < (size + 3) >> 2; i++) {
+                ((u_int32_t*)buf_data)[i] = strtoul(end, &end, 0);
+
+                if (*end != (i < ((size + 3) >> 2) - 1 ? ' ' : '\0')) {
+                    writes_deb(con, "E Invalid data");
+                }
+            }
+
+            if (mwrite4_block(mf, offset, buf_data, size) != size) {
+                write_err(con);
+            } else   {
+                write_ok(con);
+            }
+        }
+        break;
+
+    case 'r':   /*  Read I2C */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            u_int8_t data[64];
+            char err_msg[256];
+            u_int8_t addr_width, slave_addr;
+            unsigned int offset;
+            int size, rc;
+
+            rc = parse_i2c_cmd(buf, &addr_width, &slave_addr, &size, &offset, data, err_msg);
+            if (rc) {
+                writes_deb(con, err_msg);
+            } else {
+                if (mread_i2cblock(mf, slave_addr, addr_width, offset, data, size) < size) {
+                    write_err(con);
+                } else {
+                    char vbuff[256];
+                    sprintf(vbuff, "O 0x%x ", size);
+                    copy_buff_to_str(&vbuff[strlen(vbuff)], data, size);
+                    writes_deb(con, vbuff);
+                }
+            }
+        }
+        break;
+
+    case 'w':   /*  Read I2C */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            u_int8_t data[64];
+            char err_msg[256];
+            u_int8_t addr_width, slave_addr;
+            unsigned int offset;
+            int size, rc;
+
+            rc = parse_i2c_cmd(buf, &addr_width, &slave_addr, &size, &offset, data, err_msg);
+            if (rc) {
+                writes_deb(con, err_msg);
+            } else {
+                if (mwrite_i2cblock(mf, slave_addr, addr_width, offset, data, size) < size) {
+                    write_err(con);
+                } else {
+                    write_ok(con);
+                }
+            }
+        }
+        break;
+#endif
+
+    case 'P':
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            mpci_change(mf);
+            write_ok(con);
+        }
+        break;
+
+    case 'W':   /*  Write word */
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            unsigned int offset;
+            u_int32_t value;
+            char *p = strchr(buf + 2, ' ');
+            if (!p) {
+                writes_deb(con, "E Invalid format (should be OFFS DATA)");
+            } else {
+                *p = '\0';
+                p++;
+                offset = strtoul(buf + 2, &end, 0);
+                if (*end) {
+                    writes_deb(con, "E Invalid offset");
+                } else {
+                    value = strtoul(p, &end, 0);
+                    if (*end) {
+                        writes_deb(con, "E Invalid data");
+                    } else {
+                        if (mwrite4(mf, offset, value) < 4) {
+                            write_err(con);
+                        } else {
+                            write_ok(con);
+                        }
+                    }
+                }
+            }
+        }
+        break;
+
+    case 'A':
+        if (!mf) {
+            writes_deb(con, "E Not opened");
+        } else {
+            char *p = buf + 2;
+            int space;
+            space = strtol(p, &end, 0);
+            if (*end) {
+                writes_deb(con, "E Invalid offset");
+            }
+            if (mset_addr_space(mf, space)) {
+                write_err(con);
+            } else {
+                con->space = space;
+                write_ok(con);
+            }
+        }
+        break;
+
+    default:
+        srv_put(con, "E Invalid command", strlen("E Invalid command") + 1);
+        con->stats.errors++;
+        if (sdebug) {
+            printf("-> E Invalid command (len:%d cmd:\"%s\")\n",
+                   (int)strlen(buf), buf);
+        }
+        break;
+    }
+    return *buf;
+}
+
+int srv_conn_exec(srv_conn_t *c)
+{
+    srv_dev_t *dev = c->dev;
+    u_int64_t start = 0;
+    int cmd;
+
+    if (dev) {
+        SRV_LOCK(&dev->lock);
+        start = srv_time_us();
+        /* the address space belongs to the connection, the mfile is shared */
+        if (mget_addr_space(dev->mf) != c->space) {
+            mset_addr_space(dev->mf, c->space);
+        }
+    }
+    cmd = c->bin_version ? bin_exec(c) : ascii_exec(c);
+    if (dev) {
+        c->stats.busy_us += srv_time_us() - start;
+        SRV_UNLOCK(&dev->lock);
+        if (c->dev != dev) {
+            srv_dev_put(dev);
+        }
+    }
+    c->stats.requests++;
+    return c->eof ? -1 : cmd;
+}
+
+#ifdef __WIN__
+/*
+ * In windows a client socket is handled in the main thread (single connection
+ * at a time). The connection is dropped if it sends a command other than V or X
+ * before opening the device.
+ */
+static void serve_connection(int con)
+{
+    srv_conn_t c;
+    int rc, cmd;
+
+    if (srv_conn_init(&c, con)) {
+        close(con);
+        return;
+    }
+    for (;;) {
+        rc = srv_conn_pending(&c);
+        if (rc > 0) {
+            cmd = srv_conn_exec(&c);
+            if (cmd < 0 || srv_conn_flush(&c)) {
+                break;
+            }
+            if (!c.dev && !c.bin_version && cmd != 'V' && cmd != 'X') {
+                break;
+            }
+            continue;
+        }
+        if (rc < 0 || srv_conn_fill(&c) <= 0) {
+            if (sdebug) {
+                printf("-D- read failed - closing connection. %s\n", strerror(errno));
+            }
+            break;
+        }
+    }
+    srv_conn_release(&c);
+    close(con);
+}
+#endif
+
+int main(int ac, char *av[])
+{
+    char *end;
+    int i;
+    int workers = DEF_WORKERS;
 
     /* Command line parsing. */
     for (i = 1; i < ac; i++) {
@@ -697,6 +1548,17 @@ int main(int ac, char *av[])
                 }
                 local_dev = av[i];
 
+            } else if (!strcmp(av[i], "w")  ||  !strcmp(av[i], "workers")) {
+                if (++i >= ac) {
+                    printf("After switch \"%s\" number of workers is expected.\n", av[--i]);
+                    printf("Type \"%s -h\" for help.\n", av[0]);
+                    exit(1);
+                }
+                workers = (int)strtol(av[i], &end, 0);
+                if (*end || workers < 1 || workers > MAX_WORKERS) {
+                    printf("-E- Invalid number of workers: \"%s\" (Range: 1-%d)\n", av[i], MAX_WORKERS);
+                    exit(1);
+                }
             } else if (!strcmp(av[i], "d")  ||  !strcmp(av[i], "debug")) {
                 sdebug = 1;
             } else if (!strcmp(av[i], "h")  ||  !strcmp(av[i], "help")) {
@@ -708,6 +1570,8 @@ int main(int ac, char *av[])
                 check_id_arg(av, ac, &i);
             } else if (!strcmp(av[i], "f")  ||  !strcmp(av[i], "file")) {
                 check_file_arg(av, ac, &i);
+            } else if (check_sim_arg(av, ac, &i)) {
+                continue;
             } else {
                 printf("Invalid switch \"%s\".\n", av[i]);
                 usage(av[0]);
@@ -735,351 +1599,21 @@ int main(int ac, char *av[])
 #endif
 
     prepare_the_map_file();
-    PREP_SIGNAL(mySignal);
-    WIN_INIT();
+    SRV_LOCK_INIT(&srv_devs_lock);
 
     /* Now open and start work */
     logset(1);
-    WIN_WHILE() {
-        con = open_serv_connection(port);
-        CHK2(con, "Open connection (server side)");
-
-        for (;;) {
-
-            memset(buf, 0, BUF_LEN);
-            rc = reads(con, buf, BUF_LEN, PT_TCP);
-            if (rc <= 0) {
-                if (sdebug) {
-                    printf("-D- read failed - closing connection. rc=%d, %s\n", rc, strerror(errno));
-                }
-                close(con);
-
-                // In windows:
-                // A client socket is handled in teh main thread (single connection at a time).
-                // On a connection close the socket and mf are closed and a new listening socket is opened.
-                // In Linux:
-                // The client socket is handled in a child process - which exits when teh client connection closes.
-                //
-                // TODO: Move to thread handling and unify Win and Lin behavior.
-                //
-
-                #ifndef __WIN__
-                if (rc < 0) {
-                    perror("");
-                    exit(1);
-                }
-                #endif
-                break;    /*  EOF */
-            }
-            if (sdebug) {
-                printf("<- %s\n", buf);
-            }
-            switch (*buf) {
-            case 'O':   /*  Open mfile */
-
-                if (mf) {
-                    writes_deb(con, "E Already opened");
-                } else {
-#ifndef MST_UL
-                    DType dtype = strtoul(buf + 2, &end, 0);
-                    if (*end != ' ') {
-                        /*  Old style (O DEV_NAME) */
-                        mf = mopen(buf + 2);
-                    } else {
-                        /*  New style (O FLAG DEV_NAME) */
-                        mf = mopend(end + 1, dtype);
-                    }
+#ifndef __WIN__
+    CHK2(serve_events(port, workers), "Start server");
 #else
-                    mf = mopen(local_dev);
-#endif
-                    if (mf) {
-                        // write Recv buffer
-                        char res_buf[16];
-                        snprintf(res_buf, 16, "O %d", mget_vsec_supp(mf));
-                        writes_deb(con, res_buf);
-                    } else {
-                        write_err(con);
-                    }
-                }
-                break;
-
-            case 'C':  /*  Close mfile */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    if (mclose(mf) < 0) {
-                        write_err(con);
-                    } else {
-                        write_ok(con);
-                        mf = 0;
-                    }
-                }
-                break;
-
-            case 'V':  /*  Get version */
-                writes_deb(con, "O "MSTSERVER_VERSION);
-                break;
-
-            case 'L':   /*  Get devices list */
-                if (local_dev == NULL) {
-                    get_devices_list(con);
-                } else {
-                    strcpy(dev_buf, "/dev/mst/mt25204_pci_cr0");
-                    printf("-D- local_dev=%s dev_buf=%s\n", local_dev, dev_buf);
-                    writes_deb(con, "O 1");
-                    writes_deb(con, dev_buf);
-                }
-
-                break;
-
-            case 'R':   /*  Read word */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    unsigned int offset;
-                    u_int32_t value;
-                    offset = strtoul(buf + 2, &end, 0);
-                    if (*end) {
-                        writes_deb(con, "E Invalid offset");
-                    } else {
-                        if (mread4(mf, offset, &value) < 4) {
-                            write_err(con);
-                        } else {
-                            char vbuf[16];
-                            sprintf(vbuf, "O 0x%08x", value);
-                            writes_deb(con, vbuf);
-                        }
-                    }
-                }
-                break;
-
-#ifndef MST_UL
-            case 'S':  /*  Scan I2C bus */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    u_int8_t slv_arr[SLV_ADDRS_NUM] = {0};
-                    if (mi2c_detect(mf, slv_arr) < 0) {
-                        write_err(con);
-                    } else {
-                        int i;
-                        char *p, buf[1024];
-                        sprintf(buf, "O");
-                        p =  buf + 1;
-                        for (i = 0; i < SLV_ADDRS_NUM; i++) {
-                            if (slv_arr[i]) {
-                                sprintf(p, " 0x%02x", i);
-                                p += strlen(p);
-                            }
-                        }
-                        writes_deb(con, buf);
-                    }
-                }
-                break;
-
-            case 'B':
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    unsigned int offset;
-                    int size;
-                    u_int32_t buf_data[MAX_DWORDS];
-
-                    offset = strtoul(buf + 2, &end, 0);
-                    if (*end != ' ') {
-                        writes_deb(con, "E Invalid offset");
-                    }
-
-                    size = strtoul(end, &end, 0);
-                    if (*end != '\0') {
-                        writes_deb(con, "E Invalid size");
-                    }
-
-                    if (mread4_block(mf, offset, buf_data, size) != size) {
-                        write_err(con);
-                    } else   {
-                        int i;
-                        int div4 = size >> 2;
-                        int mod4 = size % 4;
-                        sprintf(buf, "O");
-                        char *last = buf + 1;
-                        for (i = 0; i < div4; i++) {
-                            last += sprintf(last, " 0x%08x", buf_data[i]);
-                        }
-                        /* If the size is not divided by 4 need to read the remained bytes */
-                        if (mod4) {
-                            last += sprintf(last, " 0x");
-                            for (i = mod4 - 1; i >= 0; i--) {
-                                last += sprintf(last, "%02x", ((u_int8_t*)buf_data)[div4 * 4 + i]);
-                            }
-                        }
-                        writes_deb(con, buf);
-                    }
-                }
-                break;
-
-            case 'U':
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    unsigned int offset;
-                    int size;
-                    u_int32_t buf_data[MAX_DWORDS];
-                    int i;
-
-                    offset = strtoul(buf + 2, &end, 0);
-                    if (*end != ' ') {
-                        writes_deb(con, "E Invalid offset");
-                    }
-
-                    size = strtoul(end, &end, 0);
-                    if (*end != ' ' || size > (MAX_DWORDS << 2)) {
-                        writes_deb(con, "E Invalid size");
-                    }
-
-                    for (i = 0; i < (size + 3) >> 2; i++) {
-                        ((u_int32_t*)buf_data)[i] = strtoul(end, &end, 0);
-
-                        if (*end != (i < ((size + 3) >> 2) - 1 ? ' ' : '\0')) {
-                            writes_deb(con, "E Invalid data");
-                        }
-                    }
-
-                    if (mwrite4_block(mf, offset, buf_data, size) != size) {
-                        write_err(con);
-                    } else   {
-                        write_ok(con);
-                    }
-                }
-                break;
-
-            case 'r':   /*  Read I2C */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    u_int8_t data[64];
-                    char err_msg[256];
-                    u_int8_t addr_width, slave_addr;
-                    unsigned int offset;
-                    int size;
-
-                    rc = parse_i2c_cmd(buf, &addr_width, &slave_addr, &size, &offset, data, err_msg);
-                    if (rc) {
-                        writes_deb(con, err_msg);
-                    } else {
-                        if (mread_i2cblock(mf, slave_addr, addr_width, offset, data, size) < size) {
-                            write_err(con);
-                        } else {
-                            char vbuff[256];
-                            sprintf(vbuff, "O 0x%x ", size);
-                            copy_buff_to_str(&vbuff[strlen(vbuff)], data, size);
-                            writes_deb(con, vbuff);
-                        }
-                    }
-                }
-                break;
-
-            case 'w':   /*  Read I2C */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    u_int8_t data[64];
-                    char err_msg[256];
-                    u_int8_t addr_width, slave_addr;
-                    unsigned int offset;
-                    int size;
-
-                    rc = parse_i2c_cmd(buf, &addr_width, &slave_addr, &size, &offset, data, err_msg);
-                    if (rc) {
-                        writes_deb(con, err_msg);
-                    } else {
-                        if (mwrite_i2cblock(mf, slave_addr, addr_width, offset, data, size) < size) {
-                            write_err(con);
-                        } else {
-                            write_ok(con);
-                        }
-                    }
-                }
-                break;
-#endif
-
-            case 'P':
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    mpci_change(mf);
-                    write_ok(con);
-                }
-                break;
-
-            case 'W':   /*  Write word */
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    unsigned int offset;
-                    u_int32_t value;
-                    char *p = strchr(buf + 2, ' ');
-                    if (!p) {
-                        writes_deb(con, "E Invalid format (should be OFFS DATA)");
-                    } else {
-                        *p = '\0';
-                        p++;
-                        offset = strtoul(buf + 2, &end, 0);
-                        if (*end) {
-                            writes_deb(con, "E Invalid offset");
-                        } else {
-                            value = strtoul(p, &end, 0);
-                            if (*end) {
-                                writes_deb(con, "E Invalid data");
-                            } else {
-                                if (mwrite4(mf, offset, value) < 4) {
-                                    write_err(con);
-                                } else {
-                                    write_ok(con);
-                                }
-                            }
-                        }
-                    }
-                }
-                break;
-
-            case 'A':
-                if (!mf) {
-                    writes_deb(con, "E Not opened");
-                } else {
-                    char *p = buf + 2;
-                    int space;
-                    space = strtol(p, &end, 0);
-                    if (*end) {
-                        writes_deb(con, "E Invalid offset");
-                    }
-                    if (mset_addr_space(mf, space)) {
-                        write_err(con);
-                    } else {
-                        write_ok(con);
-                    }
-                }
-                break;
-
-            default:
-                writes(con, "E Invalid command", PT_TCP);
-                if (sdebug) {
-                    printf("-> E Invalid command (len:%d cmd:\"%s\")\n",
-                           (int)strlen(buf), buf);
-                }
-                break;
-            }
-            WIN_CLOSE(mf, *buf);
-        }
-
-        if (mf) {
-            if (sdebug) {
-                printf("-D- mf opened from a prev connection - closing\n");
-            }
-            mclose(mf);
-            mf = 0;
-        }
+    (void)workers;
+    WIN_INIT();
+    for (;;) {
+        int con = open_serv_connection(port);
+        CHK2(con, "Open connection (server side)");
+        serve_connection(con);
     }
+#endif
 
     unmap_and_close_file();
     return 0;
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ *
+ *  mtserver.h - mtserver connection and device handling shared by the
+ *               connection loops
+ *
+ */
+
+#ifndef MTSERVER_H
+#define MTSERVER_H
+
+#include <compatibility.h>
+#include "mtcr.h"
+
+#ifndef __WIN__
+    #include <pthread.h>
+    typedef pthread_mutex_t srv_lock_t;
+    #define SRV_LOCK_INIT(l)    pthread_mutex_init(l, NULL)
+    #define SRV_LOCK_DESTROY(l) pthread_mutex_destroy(l)
+    #define SRV_LOCK(l)         pthread_mutex_lock(l)
+    #define SRV_UNLOCK(l)       pthread_mutex_unlock(l)
+#else
+    typedef int srv_lock_t;
+    #define SRV_LOCK_INIT(l)    (void)(l)
+    #define SRV_LOCK_DESTROY(l) (void)(l)
+    #define SRV_LOCK(l)         (void)(l)
+    #define SRV_UNLOCK(l)       (void)(l)
+#endif
+
+/*
+ * An opened device, shared by all the connections that opened the same name
+ * with the same device type. Accesses of the connections are serialized by
+ * the device lock.
+ */
+typedef struct srv_dev {
+    struct srv_dev *next;
+    char *name;
+    DType dtype;            /* 0 - opened by mopen() */
+    mfile *mf;
+    int refs;
+    int def_space;
+    srv_lock_t lock;
+} srv_dev_t;
+
+typedef struct srv_stats {
+    u_int64_t connected_us;
+    u_int64_t requests;
+    u_int64_t errors;
+    u_int64_t bytes_in;
+    u_int64_t bytes_out;
+    u_int64_t busy_us;      /* time spent holding the device */
+    u_int64_t turns;        /* times the connection was scheduled */
+    u_int64_t wait_us;      /* time spent ready but not scheduled */
+    u_int64_t max_wait_us;
+} srv_stats_t;
+
+typedef struct srv_conn {
+    int fd;
+    int id;
+    int bin_version;
+    int space;              /* address space used by this connection */
+    int eof;
+    srv_dev_t *dev;
+    u_int8_t *in;
+    int in_pos;
+    int in_len;
+    int in_size;
+    u_int8_t *out;
+    int out_pos;
+    int out_len;
+    int out_size;
+    u_int32_t *data;        /* binary protocol block/register scratch */
+    srv_stats_t stats;
+    char peer[64];
+} srv_conn_t;
+
+extern int sdebug;
+
+u_int64_t srv_time_us(void);
+
+/*
+ * srv_conn_init - prepare a connection on socket "fd". Returns 0 or -1.
+ */
+int srv_conn_init(srv_conn_t *c, int fd);
+
+/*
+ * srv_conn_release - drop the connection device and buffers (the socket is
+ * left open).
+ */
+void srv_conn_release(srv_conn_t *c);
+
+/*
+ * srv_conn_fill - read available data into the input buffer.
+ * Returns number of bytes read, 0 on EOF or -1 on error (EAGAIN if nothing
+ * is available on a non blocking socket).
+ */
+int srv_conn_fill(srv_conn_t *c);
+
+/*
+ * srv_conn_pending - returns 1 if a complete request is buffered, 0 if not,
+ * -1 if the input is not a valid request.
+ */
+int srv_conn_pending(srv_conn_t *c);
+
+/*
+ * srv_conn_exec - execute the next buffered request and queue its reply.
+ * Returns the request command (ASCII letter or binary op) or -1 on error.
+ */
+int srv_conn_exec(srv_conn_t *c);
+
+/*
+ * srv_conn_flush - send the queued replies. Returns 0 when all were sent,
+ * 1 if the (non blocking) socket is full and -1 on error.
+ */
+int srv_conn_flush(srv_conn_t *c);
+
+static inline int srv_conn_out_pending(const srv_conn_t *c)
+{
+    return c->out_len - c->out_pos;
+}
+
+/*
+ * serve_events - accept and serve clients on "port" with "workers" threads
+ * until the process is killed. Returns -1 if the server could not start.
+ */
+int serve_events(int port, int workers);
+
+#endif
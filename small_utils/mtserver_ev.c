@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ *
+ *  mtserver_ev.c - mtserver event loop (Linux)
+ *
+ *  One thread waits on epoll for new connections and for sockets that became
+ *  readable or writable, and queues the ready connections. A pool of workers
+ *  serves the queue in FIFO order: each turn runs at most EV_QUANTUM requests
+ *  of a connection and puts it back at the end of the queue if it has more,
+ *  so a client streaming requests does not starve the others.
+ *
+ *  Sockets are registered with EPOLLONESHOT, a connection is owned by exactly
+ *  one of epoll, the run queue or a worker at any time.
+ *
+ *  SIGUSR1 prints the statistics of all connected clients.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "tcp.h"
+#include "mtserver.h"
+
+#define EV_MAX_EVENTS 64
+#define EV_QUANTUM    16
+#define EV_OUT_HIGH   (256 * 1024)    /* stop executing while this much output is queued */
+
+enum {
+    EV_WAIT_READ,
+    EV_WAIT_WRITE,
+    EV_RUN_AGAIN,
+    EV_CLOSE
+};
+
+typedef struct ev_client {
+    srv_conn_t conn;
+    /* copy of conn.stats taken after every turn, for ev_print_stats() */
+    srv_stats_t stats;
+    pthread_mutex_t stats_lock;
+    u_int64_t ready_us;
+    struct ev_client *run_next;
+    struct ev_client *prev;
+    struct ev_client *next;
+} ev_client_t;
+
+static int ev_fd = -1;
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_cond = PTHREAD_COND_INITIALIZER;
+static ev_client_t *run_head = NULL;
+static ev_client_t *run_tail = NULL;
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static ev_client_t *clients = NULL;
+static int last_client_id = 0;
+static volatile sig_atomic_t stats_requested = 0;
+
+static void ev_run_push(ev_client_t *cl)
+{
+    cl->ready_us = srv_time_us();
+    cl->run_next = NULL;
+    pthread_mutex_lock(&run_lock);
+    if (run_tail) {
+        run_tail->run_next = cl;
+    } else {
+        run_head = cl;
+    }
+    run_tail = cl;
+    pthread_cond_signal(&run_cond);
+    pthread_mutex_unlock(&run_lock);
+}
+
+static ev_client_t* ev_run_pop(void)
+{
+    ev_client_t *cl;
+
+    pthread_mutex_lock(&run_lock);
+    while (!run_head) {
+        pthread_cond_wait(&run_cond, &run_lock);
+    }
+    cl = run_head;
+    run_head = cl->run_next;
+    if (!run_head) {
+        run_tail = NULL;
+    }
+    pthread_mutex_unlock(&run_lock);
+    return cl;
+}
+
+static int ev_arm(ev_client_t *cl, u_int32_t events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = cl;
+    return epoll_ctl(ev_fd, EPOLL_CTL_MOD, cl->conn.fd, &ev);
+}
+
+static void ev_print_client(const srv_conn_t *c, const srv_stats_t *s, u_int64_t now)
+{
+    printf("%4d  %-21s %6llu %10llu %8llu %10llu %10llu %9llu %9llu %11llu\n",
+           c->id, c->peer,
+           (unsigned long long)((now - s->connected_us) / 1000000),
+           (unsigned long long)s->requests,
+           (unsigned long long)s->errors,
+           (unsigned long long)(s->bytes_in / 1024),
+           (unsigned long long)(s->bytes_out / 1024),
+           (unsigned long long)(s->busy_us / 1000),
+           (unsigned long long)(s->turns ? s->wait_us / s->turns : 0),
+           (unsigned long long)s->max_wait_us);
+}
+
+/* Called by the worker that owns the connection, conn.stats is stable */
+static void ev_publish_stats(ev_client_t *cl)
+{
+    pthread_mutex_lock(&cl->stats_lock);
+    cl->stats = cl->conn.stats;
+    pthread_mutex_unlock(&cl->stats_lock);
+}
+
+static void ev_print_header(void)
+{
+    printf("%4s  %-21s %6s %10s %8s %10s %10s %9s %9s %11s\n", "ID", "Peer", "Up[s]", "Requests", "Errors",
+           "In[KB]", "Out[KB]", "Busy[ms]", "Wait[us]", "MaxWait[us]");
+}
+
+static void ev_print_stats(void)
+{
+    u_int64_t now = srv_time_us();
+    ev_client_t *cl;
+    int n = 0;
+
+    pthread_mutex_lock(&clients_lock);
+    for (cl = clients; cl; cl = cl->next) {
+        n++;
+    }
+    printf("-I- %d connected client(s)\n", n);
+    if (n) {
+        ev_print_header();
+    }
+    for (cl = clients; cl; cl = cl->next) {
+        srv_stats_t stats;
+
+        /* the connection may be in a turn on a worker, print its last snapshot */
+        pthread_mutex_lock(&cl->stats_lock);
+        stats = cl->stats;
+        pthread_mutex_unlock(&cl->stats_lock);
+        ev_print_client(&cl->conn, &stats, now);
+    }
+    pthread_mutex_unlock(&clients_lock);
+    fflush(stdout);
+}
+
+static void ev_close(ev_client_t *cl)
+{
+    epoll_ctl(ev_fd, EPOLL_CTL_DEL, cl->conn.fd, NULL);
+    close(cl->conn.fd);
+
+    pthread_mutex_lock(&clients_lock);
+    if (cl->prev) {
+        cl->prev->next = cl->next;
+    } else {
+        clients = cl->next;
+    }
+    if (cl->next) {
+        cl->next->prev = cl->prev;
+    }
+    if (sdebug) {
+        printf("-D- client %d disconnected\n", cl->conn.id);
+        ev_print_header();
+        ev_print_client(&cl->conn, &cl->conn.stats, srv_time_us());
+    }
+    pthread_mutex_unlock(&clients_lock);
+
+    srv_conn_release(&cl->conn);
+    pthread_mutex_destroy(&cl->stats_lock);
+    free(cl);
+}
+
+/*
+ * One scheduling turn of a connection: send the replies left from the
+ * previous turn, read what arrived, execute up to EV_QUANTUM requests and
+ * send their replies.
+ */
+static int ev_serve(ev_client_t *cl)
+{
+    srv_conn_t *c = &cl->conn;
+    int rc, i;
+
+    rc = srv_conn_flush(c);
+    if (rc) {
+        return rc < 0 ? EV_CLOSE : EV_WAIT_WRITE;
+    }
+
+    while (!c->eof && c->in_len - c->in_pos < c->in_size) {
+        rc = srv_conn_fill(c);
+        if (rc == 0) {
+            c->eof = 1;
+        } else if (rc < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return EV_CLOSE;
+        }
+    }
+
+    for (i = 0; i < EV_QUANTUM && srv_conn_out_pending(c) < EV_OUT_HIGH; i++) {
+        rc = srv_conn_pending(c);
+        if (rc < 0) {
+            return EV_CLOSE;
+        }
+        if (rc == 0) {
+            break;
+        }
+        if (srv_conn_exec(c) < 0) {
+            return EV_CLOSE;
+        }
+    }
+
+    rc = srv_conn_flush(c);
+    if (rc < 0) {
+        return EV_CLOSE;
+    }
+    if (rc > 0) {
+        return EV_WAIT_WRITE;
+    }
+    if (srv_conn_pending(c) > 0) {
+        return EV_RUN_AGAIN;
+    }
+    return c->eof ? EV_CLOSE : EV_WAIT_READ;
+}
+
+static void* ev_worker(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ev_client_t *cl = ev_run_pop();
+        u_int64_t wait = srv_time_us() - cl->ready_us;
+        int rc;
+
+        cl->conn.stats.turns++;
+        cl->conn.stats.wait_us += wait;
+        if (wait > cl->conn.stats.max_wait_us) {
+            cl->conn.stats.max_wait_us = wait;
+        }
+
+        rc = ev_serve(cl);
+        ev_publish_stats(cl);
+        switch (rc) {
+        case EV_RUN_AGAIN:
+            ev_run_push(cl);
+            break;
+
+        case EV_WAIT_WRITE:
+            if (ev_arm(cl, EPOLLOUT)) {
+                ev_close(cl);
+            }
+            break;
+
+        case EV_WAIT_READ:
+            if (ev_arm(cl, EPOLLIN | EPOLLRDHUP)) {
+                ev_close(cl);
+            }
+            break;
+
+        default:
+            ev_close(cl);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void ev_accept(int lfd)
+{
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        struct epoll_event ev;
+        ev_client_t *cl;
+        int fd, one = 1;
+
+        fd = accept(lfd, (struct sockaddr*)&addr, &addr_len);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("-E- accept");
+            }
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        cl = (ev_client_t*)calloc(1, sizeof(*cl));
+        if (!cl || srv_conn_init(&cl->conn, fd)) {
+            printf("-E- Out of memory - rejecting connection\n");
+            free(cl);
+            close(fd);
+            continue;
+        }
+        snprintf(cl->conn.peer, sizeof(cl->conn.peer), "%s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+        cl->stats = cl->conn.stats;
+        pthread_mutex_init(&cl->stats_lock, NULL);
+
+        pthread_mutex_lock(&clients_lock);
+        cl->conn.id = ++last_client_id;
+        cl->next = clients;
+        if (clients) {
+            clients->prev = cl;
+        }
+        clients = cl;
+        pthread_mutex_unlock(&clients_lock);
+        if (sdebug) {
+            printf("-D- client %d connected from %s\n", cl->conn.id, cl->conn.peer);
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = cl;
+        if (epoll_ctl(ev_fd, EPOLL_CTL_ADD, fd, &ev)) {
+            ev_close(cl);
+        }
+    }
+}
+
+static void ev_stats_signal(int sig)
+{
+    (void)sig;
+    stats_requested = 1;
+}
+
+int serve_events(int port, int workers)
+{
+    struct epoll_event evs[EV_MAX_EVENTS];
+    struct sigaction sa;
+    sigset_t set, old;
+    pthread_t tid;
+    int lfd, i, n;
+
+    signal(SIGPIPE, SIG_IGN);
+    lfd = open_serv_socket(port);
+    if (lfd < 0) {
+        return -1;
+    }
+    fcntl(lfd, F_SETFL, fcntl(lfd, F_GETFL) | O_NONBLOCK);
+
+    ev_fd = epoll_create1(0);
+    if (ev_fd < 0) {
+        close(lfd);
+        return -1;
+    }
+    memset(&evs[0], 0, sizeof(evs[0]));
+    evs[0].events = EPOLLIN;
+    evs[0].data.ptr = NULL;
+    if (epoll_ctl(ev_fd, EPOLL_CTL_ADD, lfd, &evs[0])) {
+        return -1;
+    }
+
+    /* Only this thread takes SIGUSR1 */
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&tid, NULL, ev_worker, NULL)) {
+            return -1;
+        }
+        pthread_detach(tid);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = ev_stats_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    plog("Waiting for connections on port %d (%d workers)\n", port, workers);
+    for (;;) {
+        n = epoll_wait(ev_fd, evs, EV_MAX_EVENTS, -1);
+        if (stats_requested) {
+            stats_requested = 0;
+            ev_print_stats();
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            if (!evs[i].data.ptr) {
+                ev_accept(lfd);
+            } else {
+                ev_run_push((ev_client_t*)evs[i].data.ptr);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,859 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ *
+ *  mtserver_sim.c - cr-space device models for the mtserver simulator
+ *
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <compatibility.h>
+
+#include "mtcr.h"
+#include "mtserver.h"
+#include "mtserver_sim.h"
+#include "common/bit_slice.h"
+#include "common/tools_utils.h"
+
+#define SIM_PAGE_SHIFT  12
+#define HW_ID_ADDR      0xf0014
+
+/* icmd */
+#define ICMD_VERSION        1
+#define ICMD_MBOX_OFFSET    0x1000      /* mailbox address, from the cmd_ptr dword */
+#define ICMD_MBOX_SIZE      0x300
+#define ICMD_CTRL_OFFSET    0x3fc
+#define ICMD_CTRL_BUSY      0x1
+#define ICMD_STS_OK         0x0
+#define ICMD_STS_BAD_OPCODE 0x1
+#define ICMD_STS_BAD_SIZE   0x3
+#define ICMD_FLASH_REG_ACCESS   0x9001
+#define ICMD_QUERY_CAP          0x8400
+
+/* register access TLVs */
+#define OP_TLV_SIZE         16
+#define REG_TLV_HEADER_LEN  4
+#define TLV_OPERATION       1
+#define TLV_REG             3
+#define REG_STS_NOT_SUPP    4
+#define REG_STS_BAD_METHOD  6
+#define REG_STS_BAD_PARAM   7
+
+/* flash gateway */
+#define FLASH_GW_CMD    0xf0400
+#define FLASH_GW_ADDR   0xf0404
+#define FLASH_GW_DATA   0xf0410
+#define FGW_READ_OP     0
+#define FGW_CMD_PHASE   2
+#define FGW_ADDR_PHASE  3
+#define FGW_DATA_PHASE  4
+#define FGW_MSIZE       8
+#define FGW_CS          11
+#define FGW_CMD         16
+#define FGW_BUSY        30
+#define FLASH_VENDOR    0xef    /* Winbond W25Qxx */
+#define FLASH_TYPE      0x40
+
+/* VSEC gateway spaces, at the addresses of mtcr icmd_init_vcr() */
+#define VSEC_ICMD_CTRL      0x0
+#define VSEC_ICMD_CTRL_SIZE 0x10        /* control word and DMA address */
+#define VSEC_ICMD_MBOX_SIZE 0x1000
+#define VSEC_ICMD_MBOX      0x100000
+#define VSEC_SEMS           64          /* dwords of the semaphore space */
+
+typedef struct sim_reg {
+    struct sim_reg *next;
+    u_int16_t id;
+    int len;
+    u_int8_t data[ICMD_MBOX_SIZE];
+} sim_reg_t;
+
+typedef struct sim_icmd_resp {
+    struct sim_icmd_resp *next;
+    u_int16_t opcode;
+    u_int8_t status;
+    int len;
+    u_int8_t data[ICMD_MBOX_SIZE];
+} sim_icmd_resp_t;
+
+typedef struct sim_icmd {
+    u_int32_t cmd_ptr_addr;
+    u_int32_t mbox;
+    u_int32_t cfg_addr;         /* static_cfg_not_done */
+    u_int32_t cfg_bit;
+} sim_icmd_t;
+
+typedef struct sim_flash {
+    u_int8_t *image;
+    u_int32_t size;
+    int fd;
+    u_int8_t op;                /* command of the current (CS held) transaction */
+    int addressed;
+    u_int32_t pos;
+} sim_flash_t;
+
+/* Device types with an icmd interface, as probed by mtcr icmd_open() */
+static const struct sim_dev_info {
+    u_int16_t hw_id;
+    u_int32_t icmd_sem;
+    u_int32_t cmd_ptr_addr;
+    u_int32_t cfg_addr;
+    u_int32_t cfg_bit;
+} sim_dev_db[] = {
+    {0x1ff, 0xe27f8, 0x0,      0xb0004,  31},   /* ConnectIB */
+    {0x209, 0xe250c, 0x0,      0xb0004,  31},   /* ConnectX4 */
+    {0x20b, 0xe250c, 0x0,      0xb0004,  31},   /* ConnectX4LX */
+    {0x20d, 0xe74e0, 0x0,      0xb5e04,  31},   /* ConnectX5 */
+    {0x20f, 0xe74e0, 0x0,      0xb5f04,  31},   /* ConnectX6 */
+    {0x211, 0xe74e0, 0x0,      0xb5e04,  31},   /* BlueField */
+    {0x247, 0xa24f8, 0x80000,  0x80010,  0},    /* SwitchIB */
+    {0x249, 0xa24f8, 0x80000,  0x80010,  0},    /* Spectrum */
+    {0x24b, 0xa24f8, 0x80000,  0x80010,  0},    /* SwitchIB2 */
+    {0x24d, 0xa68f8, 0x100000, 0x100010, 0},    /* Quantum */
+    {0x24e, 0xa68f8, 0x100000, 0x100010, 0},    /* Spectrum2 */
+};
+
+/* Flash semaphores of the older devices, always modelled */
+static const u_int32_t sim_common_sems[] = {0xf03bc, 0xf03a0, 0xf03fc};
+
+static u_int32_t *sim_cr;
+static u_int32_t sim_cr_size;
+static u_int8_t *sim_pages;
+static sim_module_t *sim_modules;
+static sim_reg_t *sim_regs;
+static sim_icmd_resp_t *sim_icmd_resps;
+static sim_icmd_t sim_icmd;
+static sim_flash_t sim_flash;
+static u_int32_t sim_script_devid;
+static srv_lock_t sim_lock;
+/* the simulator is a single device, the server sets the space of each request */
+static int sim_vsec;
+static int sim_space = AS_CR_SPACE;
+static u_int32_t sim_vsec_ctrl[VSEC_ICMD_CTRL_SIZE / 4];
+static u_int32_t sim_vsec_mbox[ICMD_MBOX_SIZE / 4];     /* big endian, as cr-space */
+static u_int32_t sim_vsec_sems[VSEC_SEMS];
+
+static u_int32_t cr_get(u_int32_t addr)
+{
+    return __be32_to_cpu(sim_cr[addr / 4]);
+}
+
+static void cr_set(u_int32_t addr, u_int32_t val)
+{
+    sim_cr[addr / 4] = __cpu_to_be32(val);
+}
+
+/* cr-space keeps the dwords big endian, so a mailbox is its byte stream */
+static u_int8_t* cr_bytes(u_int32_t addr)
+{
+    return (u_int8_t*)sim_cr + addr;
+}
+
+int sim_register(sim_module_t *m)
+{
+    u_int32_t page;
+
+    if (m->base % 4 || m->size == 0 || m->base + m->size > sim_cr_size) {
+        printf("-E- Simulator model %s: bad range 0x%x+0x%x\n", m->name, m->base, m->size);
+        return -1;
+    }
+    for (page = m->base >> SIM_PAGE_SHIFT; page <= (m->base + m->size - 1) >> SIM_PAGE_SHIFT; page++) {
+        sim_pages[page] = 1;
+    }
+    m->next = sim_modules;
+    sim_modules = m;
+    return 0;
+}
+
+static sim_module_t* sim_find(u_int32_t addr)
+{
+    sim_module_t *m;
+
+    if (!sim_pages || addr >= sim_cr_size || !sim_pages[addr >> SIM_PAGE_SHIFT]) {
+        return NULL;
+    }
+    for (m = sim_modules; m; m = m->next) {
+        if (addr >= m->base && addr - m->base < m->size) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+static int vsec_read4(u_int32_t addr, u_int32_t *val);
+static int vsec_write4(u_int32_t addr, u_int32_t val);
+
+int sim_read4(u_int32_t addr, u_int32_t *val)
+{
+    sim_module_t *m;
+    int rc;
+
+    if (sim_space != AS_CR_SPACE) {
+        SRV_LOCK(&sim_lock);
+        rc = vsec_read4(addr, val);
+        SRV_UNLOCK(&sim_lock);
+        return rc ? -1 : 1;
+    }
+    m = sim_find(addr);
+    if (!m || !m->read4) {
+        return 0;
+    }
+    SRV_LOCK(&sim_lock);
+    rc = m->read4(m, addr, val);
+    SRV_UNLOCK(&sim_lock);
+    return rc == 0;
+}
+
+int sim_write4(u_int32_t addr, u_int32_t val)
+{
+    sim_module_t *m;
+    int rc;
+
+    if (sim_space != AS_CR_SPACE) {
+        SRV_LOCK(&sim_lock);
+        rc = vsec_write4(addr, val);
+        SRV_UNLOCK(&sim_lock);
+        return rc ? -1 : 1;
+    }
+    m = sim_find(addr);
+    if (!m || !m->write4) {
+        return 0;
+    }
+    SRV_LOCK(&sim_lock);
+    rc = m->write4(m, addr, val);
+    SRV_UNLOCK(&sim_lock);
+    return rc == 0;
+}
+
+static sim_module_t* sim_module_new(const char *name, u_int32_t base, u_int32_t size, void *ctx)
+{
+    sim_module_t *m = calloc(1, sizeof(*m));
+
+    if (!m) {
+        printf("-E- Simulator: %s\n", strerror(errno));
+        return NULL;
+    }
+    m->name = name;
+    m->base = base;
+    m->size = size;
+    m->ctx = ctx;
+    return m;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Read only dwords (device id, icmd cmd_ptr) */
+
+static int ro_write(sim_module_t *m, u_int32_t addr, u_int32_t val)
+{
+    TOOLS_UNUSED(m);
+    TOOLS_UNUSED(addr);
+    TOOLS_UNUSED(val);
+    return 0;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* HW semaphores */
+
+static int sem_read(sim_module_t *m, u_int32_t addr, u_int32_t *val)
+{
+    TOOLS_UNUSED(m);
+    *val = cr_get(addr);
+    cr_set(addr, 1);
+    return 0;
+}
+
+static int sem_add(u_int32_t addr)
+{
+    sim_module_t *m = sim_find(addr);
+
+    if (m && m->read4 == sem_read) {
+        return 0;
+    }
+    m = sim_module_new("semaphore", addr, 4, NULL);
+    if (!m) {
+        return -1;
+    }
+    m->read4 = sem_read;
+    cr_set(addr, 0);
+    return sim_register(m);
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Register table */
+
+static sim_reg_t* reg_find(u_int16_t id)
+{
+    sim_reg_t *r;
+
+    for (r = sim_regs; r; r = r->next) {
+        if (r->id == id) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Serve a register Get()/Set() on "data" in place, returns the operation TLV
+ * status.
+ */
+static int reg_exec(u_int16_t id, int method, u_int8_t *data, int len)
+{
+    sim_reg_t *r = reg_find(id);
+
+    if (!r) {
+        return REG_STS_NOT_SUPP;
+    }
+    if (len < 0 || len > (int)sizeof(r->data)) {
+        return REG_STS_BAD_PARAM;
+    }
+    switch (method) {
+    case MACCESS_REG_METHOD_GET:
+        memcpy(data, r->data, len);
+        break;
+
+    case MACCESS_REG_METHOD_SET:
+        memcpy(r->data, data, len);
+        if (len > r->len) {
+            r->len = len;
+        }
+        break;
+
+    default:
+        return REG_STS_BAD_METHOD;
+    }
+    return 0;
+}
+
+int sim_reg_access(u_int16_t reg_id, int method, u_int8_t *data, int len, int *reg_status)
+{
+    SRV_LOCK(&sim_lock);
+    *reg_status = reg_exec(reg_id, method, data, len);
+    SRV_UNLOCK(&sim_lock);
+    switch (*reg_status) {
+    case 0:
+        return ME_OK;
+
+    case REG_STS_NOT_SUPP:
+        return ME_REG_ACCESS_REG_NOT_SUPP;
+
+    case REG_STS_BAD_METHOD:
+        return ME_REG_ACCESS_METHOD_NOT_SUPP;
+
+    default:
+        return ME_REG_ACCESS_BAD_PARAM;
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* icmd mailbox */
+
+/* FLASH_REG_ACCESS: operation TLV, register TLV header and the register */
+static u_int8_t icmd_reg_access(u_int8_t *mbox)
+{
+    u_int32_t op0 = __be32_to_cpu(((u_int32_t*)mbox)[0]);
+    u_int32_t op1 = __be32_to_cpu(((u_int32_t*)mbox)[1]);
+    u_int32_t reg0 = __be32_to_cpu(((u_int32_t*)(mbox + OP_TLV_SIZE))[0]);
+    int len = EXTRACT(reg0, 16, 11) * 4 - REG_TLV_HEADER_LEN;
+    u_int32_t status;
+
+    if (EXTRACT(op0, 27, 5) != TLV_OPERATION || EXTRACT(reg0, 27, 5) != TLV_REG ||
+        len < 0 || len > ICMD_MBOX_SIZE - OP_TLV_SIZE - REG_TLV_HEADER_LEN) {
+        return ICMD_STS_BAD_SIZE;
+    }
+    status = reg_exec(EXTRACT(op1, 16, 16), EXTRACT(op1, 8, 7),
+                      mbox + OP_TLV_SIZE + REG_TLV_HEADER_LEN, len);
+    op0 = MERGE(op0, status, 8, 7);
+    op1 = MERGE(op1, 1, 15, 1);     /* response */
+    ((u_int32_t*)mbox)[0] = __cpu_to_be32(op0);
+    ((u_int32_t*)mbox)[1] = __cpu_to_be32(op1);
+    return ICMD_STS_OK;
+}
+
+static u_int8_t icmd_exec(u_int16_t opcode, u_int8_t *mbox)
+{
+    sim_icmd_resp_t *r;
+
+    for (r = sim_icmd_resps; r; r = r->next) {
+        if (r->opcode == opcode) {
+            memcpy(mbox, r->data, r->len);
+            return r->status;
+        }
+    }
+    switch (opcode) {
+    case ICMD_FLASH_REG_ACCESS:
+        return icmd_reg_access(mbox);
+
+    case ICMD_QUERY_CAP:
+        memset(mbox, 0, 8);
+        return ICMD_STS_OK;
+
+    default:
+        return ICMD_STS_BAD_OPCODE;
+    }
+}
+
+static int icmd_cmd_ptr_read(sim_module_t *m, u_int32_t addr, u_int32_t *val)
+{
+    sim_icmd_t *ic = m->ctx;
+
+    TOOLS_UNUSED(addr);
+    *val = (ICMD_VERSION << 24) | ic->mbox;
+    return 0;
+}
+
+static int icmd_cfg_read(sim_module_t *m, u_int32_t addr, u_int32_t *val)
+{
+    sim_icmd_t *ic = m->ctx;
+
+    /* static configuration is always done */
+    *val = cr_get(addr) & ~(1U << ic->cfg_bit);
+    return 0;
+}
+
+static int icmd_ctrl_write(sim_module_t *m, u_int32_t addr, u_int32_t val)
+{
+    sim_icmd_t *ic = m->ctx;
+
+    if (val & ICMD_CTRL_BUSY) {
+        u_int8_t status = icmd_exec(EXTRACT(val, 16, 16), cr_bytes(ic->mbox));
+        val = MERGE(val, status, 8, 8) & ~ICMD_CTRL_BUSY;
+    }
+    cr_set(addr, val);
+    return 0;
+}
+
+static int icmd_add(const struct sim_dev_info *info)
+{
+    sim_module_t *m;
+
+    sim_icmd.cmd_ptr_addr = info->cmd_ptr_addr;
+    sim_icmd.mbox = info->cmd_ptr_addr + ICMD_MBOX_OFFSET;
+    sim_icmd.cfg_addr = info->cfg_addr;
+    sim_icmd.cfg_bit = info->cfg_bit;
+
+    if (sem_add(info->icmd_sem)) {
+        return -1;
+    }
+    if (!(m = sim_module_new("icmd cmd_ptr", info->cmd_ptr_addr, 4, &sim_icmd))) {
+        return -1;
+    }
+    m->read4 = icmd_cmd_ptr_read;
+    m->write4 = ro_write;
+    if (sim_register(m)) {
+        return -1;
+    }
+    if (!(m = sim_module_new("icmd cfg", info->cfg_addr, 4, &sim_icmd))) {
+        return -1;
+    }
+    m->read4 = icmd_cfg_read;
+    if (sim_register(m)) {
+        return -1;
+    }
+    if (!(m = sim_module_new("icmd ctrl", sim_icmd.mbox + ICMD_CTRL_OFFSET, 4, &sim_icmd))) {
+        return -1;
+    }
+    m->write4 = icmd_ctrl_write;
+    return sim_register(m);
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* VSEC gateway: icmd and semaphore spaces */
+
+static int vsec_read4(u_int32_t addr, u_int32_t *val)
+{
+    if (addr % 4) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sim_space == AS_ICMD) {
+        if (addr < VSEC_ICMD_CTRL_SIZE) {
+            *val = sim_vsec_ctrl[addr / 4];
+            return 0;
+        }
+        if (addr == VSEC_ICMD_MBOX_SIZE) {
+            *val = ICMD_MBOX_SIZE;
+            return 0;
+        }
+        if (addr >= VSEC_ICMD_MBOX && addr - VSEC_ICMD_MBOX < ICMD_MBOX_SIZE) {
+            *val = __be32_to_cpu(sim_vsec_mbox[(addr - VSEC_ICMD_MBOX) / 4]);
+            return 0;
+        }
+    } else if (sim_space == AS_SEMAPHORE && addr < VSEC_SEMS * 4) {
+        /* the ticket of the owner, 0 when free */
+        *val = sim_vsec_sems[addr / 4];
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static int vsec_write4(u_int32_t addr, u_int32_t val)
+{
+    if (addr % 4) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sim_space == AS_ICMD) {
+        if (addr < VSEC_ICMD_CTRL_SIZE) {
+            if (addr == VSEC_ICMD_CTRL && (val & ICMD_CTRL_BUSY)) {
+                u_int8_t status = icmd_exec(EXTRACT(val, 16, 16), (u_int8_t*)sim_vsec_mbox);
+                val = MERGE(val, status, 8, 8) & ~ICMD_CTRL_BUSY;
+            }
+            sim_vsec_ctrl[addr / 4] = val;
+            return 0;
+        }
+        if (addr >= VSEC_ICMD_MBOX && addr - VSEC_ICMD_MBOX < ICMD_MBOX_SIZE) {
+            sim_vsec_mbox[(addr - VSEC_ICMD_MBOX) / 4] = __cpu_to_be32(val);
+            return 0;
+        }
+    } else if (sim_space == AS_SEMAPHORE && addr < VSEC_SEMS * 4) {
+        /* writing a ticket takes a free semaphore, writing 0 releases it */
+        if (!val || !sim_vsec_sems[addr / 4]) {
+            sim_vsec_sems[addr / 4] = val;
+        }
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+int sim_vsec_supp(void)
+{
+    return sim_vsec;
+}
+
+int sim_set_space(int space)
+{
+    if (!sim_vsec) {
+        /* no gateway, all the spaces are cr-space */
+        return 0;
+    }
+    if (space != AS_CR_SPACE && space != AS_ICMD && space != AS_SEMAPHORE) {
+        errno = EINVAL;
+        return -1;
+    }
+    sim_space = space;
+    return 0;
+}
+
+int sim_get_space(void)
+{
+    return sim_space;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Flash gateway */
+
+static int flash_is_erase(u_int8_t op, u_int32_t *sect_size)
+{
+    switch (op) {
+    case 0xd8:  /* SE */
+    case 0xdc:  /* 4SE */
+        *sect_size = 0x10000;
+        return 1;
+
+    case 0x20:  /* SSE */
+    case 0x21:  /* 4SSE */
+        *sect_size = 0x1000;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static int flash_gw_write(sim_module_t *m, u_int32_t addr, u_int32_t cmd)
+{
+    sim_flash_t *f = m->ctx;
+    u_int8_t *data = cr_bytes(FLASH_GW_DATA);
+    u_int32_t size = 1 << EXTRACT(cmd, FGW_MSIZE, 3);
+    u_int32_t sect_size, i;
+
+    if (!EXTRACT(cmd, FGW_BUSY, 1)) {
+        cr_set(addr, cmd);
+        return 0;
+    }
+    if (EXTRACT(cmd, FGW_CMD_PHASE, 1)) {
+        f->op = EXTRACT(cmd, FGW_CMD, 8);
+        f->addressed = EXTRACT(cmd, FGW_ADDR_PHASE, 1);
+        f->pos = cr_get(FLASH_GW_ADDR) & (f->size - 1);
+    }
+
+    if (EXTRACT(cmd, FGW_CS, 2)) {
+        /* single flash, other chip selects read a floating bus */
+        if (EXTRACT(cmd, FGW_READ_OP, 1)) {
+            memset(data, 0xff, size);
+        }
+    } else if (f->addressed && flash_is_erase(f->op, &sect_size)) {
+        if (EXTRACT(cmd, FGW_CMD_PHASE, 1)) {
+            memset(f->image + (f->pos & ~(sect_size - 1)), 0xff, sect_size);
+        }
+    } else if (EXTRACT(cmd, FGW_DATA_PHASE, 1)) {
+        if (!f->addressed) {
+            /* status/id registers, the flash is never busy or protected */
+            memset(data, 0, size);
+            if (f->op == 0x9f) { /* JEDEC */
+                u_int32_t log2size = 0;
+                while ((1U << log2size) < f->size) {
+                    log2size++;
+                }
+                data[0] = FLASH_VENDOR;
+                data[1] = FLASH_TYPE;
+                data[2] = log2size;
+            }
+        } else if (EXTRACT(cmd, FGW_READ_OP, 1)) {
+            for (i = 0; i < size; i++) {
+                data[i] = f->image[(f->pos + i) & (f->size - 1)];
+            }
+            f->pos += size;
+        } else {
+            /* program can only clear bits */
+            for (i = 0; i < size; i++) {
+                f->image[(f->pos + i) & (f->size - 1)] &= data[i];
+            }
+            f->pos += size;
+        }
+    }
+    cr_set(addr, MERGE(cmd, 0, FGW_BUSY, 1));
+    return 0;
+}
+
+static int flash_attach(const char *path)
+{
+    sim_flash_t *f = &sim_flash;
+    sim_module_t *m;
+    struct stat st;
+
+    f->fd = open(path, O_RDWR);
+    if (f->fd < 0 || fstat(f->fd, &st)) {
+        printf("-E- Failed to open flash image %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    /* densities known to mflash: 1MB - 16MB */
+    if (st.st_size < 0x100000 || st.st_size > 0x1000000 || (st.st_size & (st.st_size - 1))) {
+        printf("-E- Flash image %s: size must be a power of 2 between 1MB and 16MB\n", path);
+        return -1;
+    }
+    f->size = st.st_size;
+    f->image = mmap(0, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (f->image == MAP_FAILED) {
+        f->image = NULL;
+        printf("-E- Failed to map flash image %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!(m = sim_module_new("flash gw", FLASH_GW_CMD, 4, f))) {
+        return -1;
+    }
+    m->write4 = flash_gw_write;
+    return sim_register(m);
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+/* Script */
+
+static int parse_dwords(u_int8_t *data, int max_len, int *len)
+{
+    char *tok, *end;
+
+    *len = 0;
+    while ((tok = strtok(NULL, " \t\r\n"))) {
+        u_int32_t dw = strtoul(tok, &end, 0);
+        if (*end || *len + 4 > max_len) {
+            return -1;
+        }
+        dw = __cpu_to_be32(dw);
+        memcpy(data + *len, &dw, 4);
+        *len += 4;
+    }
+    return 0;
+}
+
+static int parse_num(u_int32_t *val)
+{
+    char *end, *tok = strtok(NULL, " \t\r\n");
+
+    if (!tok) {
+        return -1;
+    }
+    *val = strtoul(tok, &end, 0);
+    return *end ? -1 : 0;
+}
+
+static int load_script(const char *path)
+{
+    char buf[4096];
+    int line;
+    FILE *fh = fopen(path, "r");
+
+    if (!fh) {
+        printf("-E- Failed to open simulator script %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    for (line = 1; fgets(buf, sizeof(buf), fh); line++) {
+        char *p = strchr(buf, '#');
+        char *kw;
+        u_int32_t num, status;
+        int rc = 0;
+
+        if (p) {
+            *p = '\0';
+        }
+        kw = strtok(buf, " \t\r\n");
+        if (!kw) {
+            continue;
+        }
+        if (!strcmp(kw, "devid")) {
+            rc = parse_num(&sim_script_devid);
+        } else if (!strcmp(kw, "vsec")) {
+            sim_vsec = 1;
+        } else if (!strcmp(kw, "sem")) {
+            rc = parse_num(&num) || num % 4 || num >= sim_cr_size || sem_add(num);
+        } else if (!strcmp(kw, "reg")) {
+            sim_reg_t *r = calloc(1, sizeof(*r));
+            if (!r || parse_num(&num) || parse_dwords(r->data, sizeof(r->data), &r->len)) {
+                free(r);
+                rc = -1;
+            } else {
+                r->id = num;
+                r->next = sim_regs;
+                sim_regs = r;
+            }
+        } else if (!strcmp(kw, "icmd")) {
+            sim_icmd_resp_t *r = calloc(1, sizeof(*r));
+            if (!r || parse_num(&num) || parse_num(&status) ||
+                parse_dwords(r->data, sizeof(r->data), &r->len)) {
+                free(r);
+                rc = -1;
+            } else {
+                r->opcode = num;
+                r->status = status;
+                r->next = sim_icmd_resps;
+                sim_icmd_resps = r;
+            }
+        } else {
+            rc = -1;
+        }
+        if (rc) {
+            printf("-E- %s:%d: invalid statement\n", path, line);
+            fclose(fh);
+            return -1;
+        }
+    }
+    fclose(fh);
+    return 0;
+}
+
+/* ////////////////////////////////////////////////////////////////////// */
+int sim_init(u_int32_t *cr, u_int32_t cr_size, u_int32_t hw_id, const char *script,
+             const char *flash_image)
+{
+    sim_module_t *m;
+    unsigned int i;
+
+    sim_cr = cr;
+    sim_cr_size = cr_size;
+    sim_pages = calloc(cr_size >> SIM_PAGE_SHIFT, 1);
+    if (!sim_pages) {
+        printf("-E- Simulator: %s\n", strerror(errno));
+        return -1;
+    }
+    SRV_LOCK_INIT(&sim_lock);
+
+    for (i = 0; i < sizeof(sim_common_sems) / sizeof(sim_common_sems[0]); i++) {
+        if (sem_add(sim_common_sems[i])) {
+            return -1;
+        }
+    }
+    if (script && load_script(script)) {
+        return -1;
+    }
+    if (!hw_id && sim_script_devid) {
+        cr_set(HW_ID_ADDR, sim_script_devid);
+    }
+    if (!(m = sim_module_new("devid", HW_ID_ADDR, 4, NULL))) {
+        return -1;
+    }
+    m->write4 = ro_write;
+    if (sim_register(m)) {
+        return -1;
+    }
+
+    hw_id = cr_get(HW_ID_ADDR) & 0xffff;
+    for (i = 0; i < sizeof(sim_dev_db) / sizeof(sim_dev_db[0]); i++) {
+        if (sim_dev_db[i].hw_id == hw_id) {
+            if (icmd_add(&sim_dev_db[i])) {
+                return -1;
+            }
+            break;
+        }
+    }
+    if (flash_image && flash_attach(flash_image)) {
+        return -1;
+    }
+    return 0;
+}
+
+void sim_cleanup(void)
+{
+    while (sim_modules) {
+        sim_module_t *m = sim_modules;
+        sim_modules = m->next;
+        free(m);
+    }
+    while (sim_regs) {
+        sim_reg_t *r = sim_regs;
+        sim_regs = r->next;
+        free(r);
+    }
+    while (sim_icmd_resps) {
+        sim_icmd_resp_t *r = sim_icmd_resps;
+        sim_icmd_resps = r->next;
+        free(r);
+    }
+    if (sim_flash.image) {
+        munmap(sim_flash.image, sim_flash.size);
+        close(sim_flash.fd);
+        sim_flash.image = NULL;
+    }
+    free(sim_pages);
+    sim_pages = NULL;
+}
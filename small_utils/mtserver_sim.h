@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ *
+ *  mtserver_sim.h - cr-space device models for the mtserver simulator
+ *
+ *  In simulation mode cr-space is plain memory. The models below give the
+ *  addresses the tools poll a behaviour, so flash and register access flows
+ *  complete against the simulator:
+ *
+ *  devid     - 0xf0014, read only (set by -i, the dump or the script).
+ *  semaphore - HW semaphores: a read returns the value and takes the
+ *              semaphore (sets it to 1), a write of 0 releases it.
+ *  icmd      - the icmd mailbox of the device type. Setting the busy bit
+ *              executes the command: FLASH_REG_ACCESS is served from the
+ *              register table, other opcodes get their scripted response.
+ *  flash     - the flash gateway (0xf0400), backed by a flash image file.
+ *  vsec      - with the "vsec" statement OPEN reports the vendor specific
+ *              capability and the gateway serves the icmd space (control 0x0,
+ *              mailbox size 0x1000, mailbox 0x100000) and the semaphore space
+ *              (write a ticket to take a free semaphore, read back the owner,
+ *              write 0 to release). Other spaces are rejected. Without it
+ *              every address space is cr-space.
+ *
+ *  Script file (-s), one statement per line, '#' starts a comment:
+ *      devid <hw_id>                       - device id (unless -i is given)
+ *      vsec                                - expose the VSEC gateway
+ *      sem   <addr>                        - additional HW semaphore
+ *      reg   <reg_id> [dword ...]          - register answered by REG_ACCESS,
+ *                                            Set() updates its data
+ *      icmd  <opcode> <status> [dword ...] - mailbox response to an opcode
+ *
+ */
+
+#ifndef MTSERVER_SIM_H
+#define MTSERVER_SIM_H
+
+#include <compatibility.h>
+
+/*
+ * A model claims the dwords [base, base + size). A handler returns 0 when it
+ * served the access or -1 to fall back to plain memory; a NULL handler always
+ * falls back.
+ */
+typedef struct sim_module {
+    struct sim_module *next;
+    const char *name;
+    u_int32_t base;
+    u_int32_t size;
+    int (*read4)(struct sim_module *m, u_int32_t addr, u_int32_t *val);
+    int (*write4)(struct sim_module *m, u_int32_t addr, u_int32_t val);
+    void *ctx;
+} sim_module_t;
+
+/*
+ * sim_init - attach the models to the cr-space image "cr" (big endian dwords).
+ * "hw_id" is the -i device id (0 - none), "script" and "flash_image" may be
+ * NULL. Returns 0 or -1 after printing the error.
+ */
+int sim_init(u_int32_t *cr, u_int32_t cr_size, u_int32_t hw_id, const char *script,
+             const char *flash_image);
+
+void sim_cleanup(void);
+
+int sim_register(sim_module_t *m);
+
+/*
+ * sim_read4/sim_write4 - access "addr" in the current address space. Return 1
+ * when a model served the access, 0 when the caller should access plain
+ * memory and -1 (errno set) when the address isn't valid in the space.
+ */
+int sim_read4(u_int32_t addr, u_int32_t *val);
+int sim_write4(u_int32_t addr, u_int32_t val);
+
+/*
+ * VSEC support and the current address space of the gateway. sim_set_space
+ * returns 0 or -1 (errno set) for a space the gateway doesn't have.
+ */
+int sim_vsec_supp(void);
+int sim_set_space(int space);
+int sim_get_space(void);
+
+/*
+ * sim_reg_access - access a register of the register table directly. "data"
+ * is the register in network order. Returns an mtcr (ME_*) code, the
+ * operation TLV status is returned in "reg_status".
+ */
+int sim_reg_access(u_int16_t reg_id, int method, u_int8_t *data, int len, int *reg_status);
+
+#endif
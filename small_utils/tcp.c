@@ -251,6 +251,19 @@ INSIDE_MTCR int reads(int fd, char *ptr, int maxlen, proto_type_t proto)
     return tcp_reads(fd, ptr, maxlen);
 }
 
+/* ////////////////////////////////////////////////////////////////////// */
+/*
+** readany - read whatever is available (at least 1 byte) from the socket "fd"
+*/
+INSIDE_MTCR int readany(int fd, void *ptr, int maxlen, proto_type_t proto)
+{
+    int rc;
+    do {
+        rc = COMP_READ(fd, (char*)ptr, maxlen, proto);
+    } while (rc < 0 && errno == EINTR);
+    return rc;
+}
+
 /* ////////////////////////////////////////////////////////////////////// */
 /*
 ** readnl - reads till till newline  from the socket "fd"
@@ -409,6 +422,32 @@ INSIDE_MTCR int open_cli_connection(const char *host, const int port, proto_type
     return SockFD;
 }
 
+/* ////////////////////////////////////////////////////////////////////// */
+/*
+** open_serv_socket - open listening server TCP socket and return its fd
+*/
+INSIDE_MTCR int open_serv_socket(const int port)
+{
+    struct sockaddr_in serv_addr;
+    int SockFD, on = 1;
+
+    if ((SockFD = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    setsockopt(SockFD, SOL_SOCKET, SO_REUSEADDR, (char*)&on, sizeof(on));
+
+    memset((char*) &serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_addr.sin_port        = (short)(htons((short)port));
+    if (bind(SockFD, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0 ||
+        listen(SockFD, SOMAXCONN) < 0) {
+        COMP_CLOSE(SockFD);
+        return -1;
+    }
+    return SockFD;
+}
+
 /* ////////////////////////////////////////////////////////////////////// */
 /*
 ** open_serv_connection - open server TCP connection and return socket fd
@@ -66,6 +66,11 @@ int plog(const char *fmt, ...) ATTRIBUTE;
 */
 int open_cli_connection(const char *host, const int port, proto_type_t proto);
 
+/*
+** open_serv_socket - open listening server TCP socket and return its fd
+*/
+int open_serv_socket(const int port);
+
 /*
 ** open_serv_connection - open server TCP connection and return socket fd
 */
@@ -88,6 +93,14 @@ int open_serv_connection(const int port);
 */
 int reads(int fd, char *ptr, int maxlen, proto_type_t proto);
 
+/*
+** readany - read whatever is available (at least 1 byte) from the socket "fd"
+**
+** Blocks until data arrives. Returns number of bytes read (at most
+** "maxlen"), 0 on EOF, or -1 if an error occurs.
+*/
+int readany(int fd, void *ptr, int maxlen, proto_type_t proto);
+
 /*
 ** readnl - reads till till newline  from the socket "fd"
 */
@@ -35,53 +35,8 @@
 *** This file was generated at "2017-03-24 22:07:56"
 ***/
 
-#include <assert.h>
 #include "adb_to_c_utils.h"
 
-/************************************
- * Function: adb2c_calc_array_field_address
- ************************************/
-u_int32_t adb2c_calc_array_field_address(u_int32_t start_bit_offset, u_int32_t arr_elemnt_size,
-                                   int arr_idx, u_int32_t parent_node_size,
-                                   int is_big_endian_arr)
-{
-    u_int32_t offs;
-
-    if (arr_elemnt_size > 32)
-    {
-        assert(!(arr_elemnt_size % 32));
-        start_bit_offset += arr_elemnt_size*(u_int32_t)arr_idx;                                                                                     
-        return start_bit_offset;
-    }
-
-    if (is_big_endian_arr)
-    {
-        u_int32_t dword_delta;
-        offs = start_bit_offset - arr_elemnt_size*(u_int32_t)arr_idx;
-        dword_delta = (((start_bit_offset>>5)<<2) - ((offs>>5)<<2))/4;
-        if (dword_delta)
-        {
-            offs += 64*dword_delta;
-        }
-    }
-    else
-    {
-        offs = start_bit_offset + arr_elemnt_size*(u_int32_t)arr_idx;
-    }
-
-    //printf("==> %d\n", MIN(32, parent_node_size) - (offs%32) - arr_elemnt_size + ((offs>>5)<<5));
-    return ADB2C_MIN(32, parent_node_size) - (offs%32) - arr_elemnt_size + ((offs>>5)<<5);
-}
-
-/************************************
- * Function: adb2c_push_integer_to_buff
- ************************************/
-void adb2c_push_integer_to_buff(u_int8_t *buff, u_int32_t bit_offset,  u_int32_t byte_size, u_int64_t field_value)
-{
-    field_value = ADB2C_CPU_TO_BE64(field_value);
-    memcpy(buff + bit_offset/8, (u_int8_t*)&field_value + (8-byte_size), (size_t)byte_size);
-}
-
 /************************************
  * Function: adb2c_push_integer_to_buff_le
  ************************************/
@@ -93,29 +48,6 @@ void adb2c_push_integer_to_buff_le(u_int8_t *buff, u_int32_t bit_offset,  u_int3
 }
 
 
-/************************************
- * Function: adb2c_push_bits_to_buff
- ************************************/
-//the next function will push the field into the buffer by inserting it's MSB bits first
-//and therefore by doing it we save the CPU_TO_BE operation
-void adb2c_push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
-{
-    u_int32_t i 		= 0;
-    u_int32_t byte_n	= bit_offset / 8;
-    u_int32_t byte_n_offset	= bit_offset % 8;
-    u_int32_t to_push;
-
-    //going over all bits in field
-    while (i < field_size)
-    {
-        to_push = ADB2C_MIN(8 - byte_n_offset, field_size - i);
-        i += to_push;
-        ADB2C_INSERTF_8(ADB2C_BYTE_N(buff, byte_n), 8U - to_push - byte_n_offset, field_value, field_size - i, to_push);
-        byte_n_offset  = 0;	//(byte_n_offset + to_push) % 8U;
-        byte_n++;
-    }
-}
-
 /************************************
  * Function: adb2c_push_bits_to_buff_le
  ************************************/
@@ -167,48 +99,85 @@ void adb2c_push_to_buf_le(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_
 }
 
 /************************************
- * Function: adb2c_pop_integer_from_buff
+ * Function: adb2c_pop_integer_from_buff_le
  ************************************/
-u_int64_t adb2c_pop_integer_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size)
+u_int64_t adb2c_pop_integer_from_buff_le(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size)
 {
     u_int64_t val = 0;
-    memcpy((u_int8_t*)&val + (8-byte_size), buff + bit_offset/8, (size_t)byte_size);
-    return ADB2C_BE64_TO_CPU(val);
+    memcpy((u_int8_t*)&val, buff + bit_offset/8, (size_t)byte_size);
+    return ADB2C_LE64_TO_CPU(val);
 }
 
 /************************************
- * Function: adb2c_pop_integer_from_buff_le
+ * Function: adb2c_pop_bits_from_buff_bulk
  ************************************/
-u_int64_t adb2c_pop_integer_from_buff_le(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size)
+void adb2c_pop_bits_from_buff_bulk(const u_int8_t *buff, const struct adb2c_bit_field *fields, u_int32_t fields_num, u_int32_t *values)
 {
-    u_int64_t val = 0;
-    memcpy((u_int8_t*)&val, buff + bit_offset/8, (size_t)byte_size);
-    return ADB2C_LE64_TO_CPU(val);
+    u_int32_t dword = 0;
+    u_int32_t dword_n = 0xffffffff;
+    u_int32_t i;
+
+    for (i = 0; i < fields_num; i++)
+    {
+        u_int32_t start = fields[i].bit_offset % 32;
+        u_int32_t size = fields[i].field_size;
+
+        if (size == 0 || start + size > 32)
+        {
+            values[i] = adb2c_pop_bits_from_buff(buff, fields[i].bit_offset, size);
+            continue;
+        }
+        if (fields[i].bit_offset / 32 != dword_n)
+        {
+            dword_n = fields[i].bit_offset / 32;
+            dword = adb2c_load_be_bytes(buff + dword_n * 4, 4);
+        }
+        values[i] = (dword << start) >> (32 - size);
+    }
 }
 
 /************************************
- * Function: adb2c_pop_bits_from_buff
+ * Function: adb2c_push_bits_to_buff_bulk
  ************************************/
-//the next function will pop the field into the buffer by removing it's MSB bits first
-//and therefore by doing it we save the BE_TO_CPU operation
-u_int32_t adb2c_pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
+void adb2c_push_bits_to_buff_bulk(u_int8_t *buff, const struct adb2c_bit_field *fields, u_int32_t fields_num, const u_int32_t *values)
 {
-    u_int32_t i 		= 0;
-    u_int32_t byte_n	= bit_offset / 8;
-    u_int32_t byte_n_offset	= bit_offset % 8;
-    u_int32_t field_32	= 0;
-    u_int32_t to_pop;
+    u_int32_t dword = 0;
+    u_int32_t dword_n = 0xffffffff;
+    u_int32_t i, shift, mask;
 
-    //going over all bits in field
-    while (i < field_size)
+    for (i = 0; i < fields_num; i++)
     {
-        to_pop =  ADB2C_MIN(8 - byte_n_offset, field_size - i);
-        i += to_pop;
-        ADB2C_INSERTF_8(field_32, field_size - i, ADB2C_BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
-        byte_n_offset  = 0;	//(byte_n_offset + to_pop) % 8;
-        byte_n++;
+        u_int32_t start = fields[i].bit_offset % 32;
+        u_int32_t size = fields[i].field_size;
+
+        if (size == 0 || start + size > 32)
+        {
+            //the field may overlap the pending dword, write it first
+            if (dword_n != 0xffffffff)
+            {
+                adb2c_store_be_bytes(buff + dword_n * 4, 4, dword);
+                dword_n = 0xffffffff;
+            }
+            adb2c_push_bits_to_buff(buff, fields[i].bit_offset, size, values[i]);
+            continue;
+        }
+        if (fields[i].bit_offset / 32 != dword_n)
+        {
+            if (dword_n != 0xffffffff)
+            {
+                adb2c_store_be_bytes(buff + dword_n * 4, 4, dword);
+            }
+            dword_n = fields[i].bit_offset / 32;
+            dword = adb2c_load_be_bytes(buff + dword_n * 4, 4);
+        }
+        shift = 32 - start - size;
+        mask = (0xffffffffU >> (32 - size)) << shift;
+        dword = (dword & ~mask) | ((values[i] << shift) & mask);
+    }
+    if (dword_n != 0xffffffff)
+    {
+        adb2c_store_be_bytes(buff + dword_n * 4, 4, dword);
     }
-    return field_32;
 }
 
 /************************************
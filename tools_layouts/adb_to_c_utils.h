@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
 
 //for htonl etc...
 #if defined(_WIN32) || defined(_WIN64)
@@ -228,17 +229,147 @@ struct adb2c_node_db
 /************************************/
 /************************************/
 /************************************/
-u_int32_t adb2c_calc_array_field_address(u_int32_t start_bit_offset, u_int32_t arr_elemnt_size,
-                                   int arr_idx, u_int32_t parent_node_size,
-                                   int is_big_endian_arr);
 /* Big Endian Functions */
-void adb2c_push_integer_to_buff(u_int8_t *buff, u_int32_t bit_offset,  u_int32_t byte_size, u_int64_t field_value);                                
-void adb2c_push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value);
 void adb2c_push_to_buf(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int64_t field_value);
-u_int64_t adb2c_pop_integer_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size);
-u_int32_t adb2c_pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size);
 u_int64_t adb2c_pop_from_buf(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size);
 
+/*
+ * The generated pack/unpack functions call the functions below once per field
+ * with constant offsets and sizes. They are inlined so that the compiler folds
+ * each call into the loads, shifts and masks of that field: a field within
+ * four bytes is read and written as one big endian word of 1-4 bytes, e.g. an
+ * aligned dword field becomes a single load/store and a byte swap. Fields that
+ * span five bytes (unaligned 25-32 bit fields) take a second load of the
+ * fifth byte.
+ */
+#if defined(_MSC_VER) && !defined(__cplusplus)
+    #define ADB2C_INLINE static __inline
+#else
+    #define ADB2C_INLINE static inline
+#endif
+
+/* Array elements are unpacked in loops, inlined the offset is a few adds and shifts of the index */
+ADB2C_INLINE u_int32_t adb2c_calc_array_field_address(u_int32_t start_bit_offset, u_int32_t arr_elemnt_size,
+                                                      int arr_idx, u_int32_t parent_node_size,
+                                                      int is_big_endian_arr)
+{
+    u_int32_t offs;
+
+    if (arr_elemnt_size > 32)
+    {
+        assert(!(arr_elemnt_size % 32));
+        start_bit_offset += arr_elemnt_size*(u_int32_t)arr_idx;
+        return start_bit_offset;
+    }
+
+    if (is_big_endian_arr)
+    {
+        u_int32_t dword_delta;
+        offs = start_bit_offset - arr_elemnt_size*(u_int32_t)arr_idx;
+        dword_delta = (((start_bit_offset>>5)<<2) - ((offs>>5)<<2))/4;
+        if (dword_delta)
+        {
+            offs += 64*dword_delta;
+        }
+    }
+    else
+    {
+        offs = start_bit_offset + arr_elemnt_size*(u_int32_t)arr_idx;
+    }
+
+    return ADB2C_MIN(32, parent_node_size) - (offs%32) - arr_elemnt_size + ((offs>>5)<<5);
+}
+
+/* Loads the n (1-4) bytes at p as the MSBs of a big endian dword */
+ADB2C_INLINE u_int32_t adb2c_load_be_bytes(const u_int8_t *p, u_int32_t n)
+{
+    u_int32_t val = 0;
+    memcpy((u_int8_t*)&val, p, (size_t)n);
+    return ADB2C_BE32_TO_CPU(val);
+}
+
+ADB2C_INLINE void adb2c_store_be_bytes(u_int8_t *p, u_int32_t n, u_int32_t val)
+{
+    val = ADB2C_CPU_TO_BE32(val);
+    memcpy(p, (u_int8_t*)&val, (size_t)n);
+}
+
+ADB2C_INLINE void adb2c_push_integer_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size, u_int64_t field_value)
+{
+    field_value = ADB2C_CPU_TO_BE64(field_value);
+    memcpy(buff + bit_offset / 8, (u_int8_t*)&field_value + (8 - byte_size), (size_t)byte_size);
+}
+
+ADB2C_INLINE u_int64_t adb2c_pop_integer_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t byte_size)
+{
+    u_int64_t val = 0;
+    memcpy((u_int8_t*)&val + (8 - byte_size), buff + bit_offset / 8, (size_t)byte_size);
+    return ADB2C_BE64_TO_CPU(val);
+}
+
+//pushes the field_size (1-32) LSBs of field_value to bits bit_offset.. of buff, counting from the MSB of byte 0
+ADB2C_INLINE void adb2c_push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
+{
+    u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
+    u_int32_t shift, mask;
+    u_int64_t word, mask64;
+
+    if (field_size == 0) {
+        return;
+    }
+    if (!start && !(field_size % 8)) {
+        /* whole bytes, no need to keep any bits of the buffer */
+        adb2c_store_be_bytes(p, n, field_value << (32 - field_size));
+        return;
+    }
+    if (n <= 4) {
+        shift = 32 - start - field_size;
+        mask = (0xffffffffU >> (32 - field_size)) << shift;
+        adb2c_store_be_bytes(p, n, (adb2c_load_be_bytes(p, n) & ~mask) | ((field_value << shift) & mask));
+        return;
+    }
+    /* 5 bytes: dword at p and the byte after it */
+    shift = 40 - start - field_size;
+    mask64 = (u_int64_t)(0xffffffffU >> (32 - field_size)) << shift;
+    word = ((u_int64_t)adb2c_load_be_bytes(p, 4) << 8) | p[4];
+    word = (word & ~mask64) | (((u_int64_t)field_value << shift) & mask64);
+    adb2c_store_be_bytes(p, 4, (u_int32_t)(word >> 8));
+    p[4] = (u_int8_t)word;
+}
+
+//pops field_size (1-32) bits from bit_offset.. of buff, counting from the MSB of byte 0
+ADB2C_INLINE u_int32_t adb2c_pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
+{
+    const u_int8_t *p = buff + bit_offset / 8;
+    u_int32_t start = bit_offset % 8;
+    u_int32_t n = (start + field_size + 7) / 8;
+
+    if (field_size == 0) {
+        return 0;
+    }
+    if (n <= 4) {
+        return (adb2c_load_be_bytes(p, n) << start) >> (32 - field_size);
+    }
+    /* 5 bytes: dword at p and the byte after it */
+    return (u_int32_t)(((((u_int64_t)adb2c_load_be_bytes(p, 4) << 8) | p[4]) >> (40 - start - field_size)) &
+                       (0xffffffffU >> (32 - field_size)));
+}
+
+/*
+ * Bulk versions for extracting or updating many fields of one buffer: fields
+ * in the same dword share a single load (and store). The buffer must hold the
+ * whole dwords of the fields, as register buffers do.
+ */
+struct adb2c_bit_field {
+    u_int32_t bit_offset;
+    u_int32_t field_size;
+};
+
+void adb2c_pop_bits_from_buff_bulk(const u_int8_t *buff, const struct adb2c_bit_field *fields, u_int32_t fields_num, u_int32_t *values);
+void adb2c_push_bits_to_buff_bulk(u_int8_t *buff, const struct adb2c_bit_field *fields, u_int32_t fields_num, const u_int32_t *values);
+
 /* Little Endian Functions */
 void adb2c_push_integer_to_buff_le(u_int8_t *buff, u_int32_t bit_offset,  u_int32_t byte_size, u_int64_t field_value);
 void adb2c_push_bits_to_buff_le(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value);
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * layouts_bench.c - measures the pack/unpack functions of some big registers
+ * (the correctness checks are in layouts_check):
+ *
+ *   layouts_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "adb_to_c_utils.h"
+#include "reg_access_hca_layouts.h"
+#include "tools_open_layouts.h"
+
+#define BUFF_SIZE 1024
+
+typedef void (*pack_func)(const void *ptr_struct, u_int8_t *ptr_buff);
+typedef void (*unpack_func)(void *ptr_struct, const u_int8_t *ptr_buff);
+
+/* Calls the typed pack/unpack functions through the generic pointers above */
+#define BENCH_REG_FUNCS(name) \
+    static void name##_pack_any(const void *ptr_struct, u_int8_t *ptr_buff) \
+    { \
+        name##_pack((const struct name*)ptr_struct, ptr_buff); \
+    } \
+    static void name##_unpack_any(void *ptr_struct, const u_int8_t *ptr_buff) \
+    { \
+        name##_unpack((struct name*)ptr_struct, ptr_buff); \
+    }
+
+BENCH_REG_FUNCS(reg_access_hca_mgir)
+BENCH_REG_FUNCS(reg_access_hca_mcda_reg)
+BENCH_REG_FUNCS(tools_open_nvda)
+BENCH_REG_FUNCS(tools_open_mgir)
+
+struct bench_reg {
+    const char *name;
+    pack_func pack;
+    unpack_func unpack;
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void fill_random(u_int8_t *buff, unsigned int size)
+{
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        buff[i] = (u_int8_t)rand();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_reg regs[] = {
+        {"MGIR", reg_access_hca_mgir_pack_any, reg_access_hca_mgir_unpack_any},
+        {"MCDA", reg_access_hca_mcda_reg_pack_any, reg_access_hca_mcda_reg_unpack_any},
+        {"MNVDA", tools_open_nvda_pack_any, tools_open_nvda_unpack_any},
+        {"MGIR (tools_open)", tools_open_mgir_pack_any, tools_open_mgir_unpack_any},
+    };
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    u_int8_t buff[BUFF_SIZE], packed[BUFF_SIZE];
+    void *ptr_struct = malloc(BUFF_SIZE);   /* holds any of the structs */
+    unsigned int r;
+    int i;
+
+    if (!ptr_struct) {
+        fprintf(stderr, "-E- Out of memory\n");
+        return 1;
+    }
+
+    for (r = 0; r < sizeof(regs) / sizeof(regs[0]); r++) {
+        double t0, t1, t2;
+        srand(r);
+        fill_random(buff, sizeof(buff));
+        memset(packed, 0, sizeof(packed));
+        memset(ptr_struct, 0, BUFF_SIZE);
+
+        t0 = now();
+        for (i = 0; i < iterations; i++) {
+            regs[r].unpack(ptr_struct, buff);
+        }
+        t1 = now();
+        for (i = 0; i < iterations; i++) {
+            regs[r].pack(ptr_struct, packed);
+        }
+        t2 = now();
+        printf("%-20s unpack: %8.1f ns  pack: %8.1f ns\n", regs[r].name,
+               (t1 - t0) * 1e6 / iterations, (t2 - t1) * 1e6 / iterations);
+    }
+    free(ptr_struct);
+    return 0;
+}
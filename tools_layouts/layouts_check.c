@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * layouts_check.c - checks the bit push/pop functions of the adb2c layouts
+ * (single and bulk) and of the mtcr packets against the original byte at a
+ * time loops, for every offset and size and for random fields, and the
+ * unpack/pack functions of some big registers against reference vectors:
+ *
+ *   layouts_check [-g]
+ *
+ * Exits with 1 on a mismatch. The timings are in layouts_bench.
+ * -g prints the reference vectors (layouts_check_vectors.h) of this build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "adb_to_c_utils.h"
+#include "reg_access_hca_layouts.h"
+#include "tools_open_layouts.h"
+#include "packets_common.h"
+#include "layouts_check_vectors.h"
+
+#define REG_BUFF_SIZE 1024
+
+typedef void (*push_bits_func)(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value);
+typedef u_int32_t (*pop_bits_func)(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size);
+
+struct bits_impl {
+    const char *name;
+    push_bits_func push;
+    pop_bits_func pop;
+};
+
+static void fill_random(u_int8_t *buff, unsigned int size)
+{
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        buff[i] = (u_int8_t)rand();
+    }
+}
+
+static u_int32_t rand32()
+{
+    return (u_int32_t)rand() ^ ((u_int32_t)rand() << 16);
+}
+
+/* The original byte at a time implementation, the reference for the checks */
+static void ref_push_bits(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
+{
+    u_int32_t i = 0;
+    u_int32_t byte_n = bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t to_push;
+
+    while (i < field_size) {
+        to_push = ADB2C_MIN(8 - byte_n_offset, field_size - i);
+        i += to_push;
+        ADB2C_INSERTF_8(ADB2C_BYTE_N(buff, byte_n), 8U - to_push - byte_n_offset, field_value, field_size - i, to_push);
+        byte_n_offset = 0;
+        byte_n++;
+    }
+}
+
+static u_int32_t ref_pop_bits(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
+{
+    u_int32_t i = 0;
+    u_int32_t byte_n = bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t field_32 = 0;
+    u_int32_t to_pop;
+
+    while (i < field_size) {
+        to_pop = ADB2C_MIN(8 - byte_n_offset, field_size - i);
+        i += to_pop;
+        ADB2C_INSERTF_8(field_32, field_size - i, ADB2C_BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
+        byte_n_offset = 0;
+        byte_n++;
+    }
+    return field_32;
+}
+
+static int check_field(const struct bits_impl *impl, u_int32_t offset, u_int32_t size)
+{
+    u_int8_t buff[72], ref[72];
+    u_int32_t val = rand32();
+
+    fill_random(buff, sizeof(buff));
+    memcpy(ref, buff, sizeof(buff));
+    if (impl->pop(buff, offset, size) != ref_pop_bits(buff, offset, size)) {
+        fprintf(stderr, "-E- %s: pop mismatch at offset %u size %u\n", impl->name, offset, size);
+        return 1;
+    }
+    impl->push(buff, offset, size, val);
+    ref_push_bits(ref, offset, size, val);
+    if (memcmp(buff, ref, sizeof(buff))) {
+        fprintf(stderr, "-E- %s: push mismatch at offset %u size %u\n", impl->name, offset, size);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_bulk(int fields_num)
+{
+    struct adb2c_bit_field fields[64];
+    u_int32_t values[64], ref_values[64];
+    u_int8_t buff[72], ref[72];
+    int i;
+
+    for (i = 0; i < fields_num; i++) {
+        fields[i].field_size = 1 + rand() % 32;
+        fields[i].bit_offset = rand() % (64 * 8 - fields[i].field_size);
+        values[i] = rand32();
+    }
+    fill_random(buff, sizeof(buff));
+    memcpy(ref, buff, sizeof(buff));
+    adb2c_push_bits_to_buff_bulk(buff, fields, fields_num, values);
+    for (i = 0; i < fields_num; i++) {
+        ref_push_bits(ref, fields[i].bit_offset, fields[i].field_size, values[i]);
+    }
+    adb2c_pop_bits_from_buff_bulk(buff, fields, fields_num, values);
+    for (i = 0; i < fields_num; i++) {
+        ref_values[i] = ref_pop_bits(ref, fields[i].bit_offset, fields[i].field_size);
+    }
+    if (memcmp(buff, ref, sizeof(buff)) || memcmp(values, ref_values, fields_num * sizeof(values[0]))) {
+        fprintf(stderr, "-E- adb2c: bulk push/pop mismatch\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int check_bits(const struct bits_impl *impl)
+{
+    u_int32_t offset, size;
+    int i;
+
+    for (offset = 0; offset < 64; offset++) {
+        for (size = 1; size <= 32; size++) {
+            if (check_field(impl, offset, size)) {
+                return 1;
+            }
+        }
+    }
+    for (i = 0; i < 1000000; i++) {
+        size = 1 + rand() % 32;
+        if (check_field(impl, rand() % (64 * 8 - size), size)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Register reference vectors: the input buffer is a fixed pseudo random
+ * sequence, the vector is the buffer packed back from the unpacked struct
+ * and a hash of the struct as printed, so it does not depend on the struct
+ * layout of the compiler.
+ */
+typedef void (*reg_roundtrip_func)(const u_int8_t *in, u_int8_t *out, FILE *fd);
+
+#define REG_ROUNDTRIP(name) \
+    static void name##_roundtrip(const u_int8_t *in, u_int8_t *out, FILE *fd) \
+    { \
+        struct name reg; \
+        memset(&reg, 0, sizeof(reg)); \
+        name##_unpack(&reg, in); \
+        name##_print(&reg, fd, 0); \
+        name##_pack(&reg, out); \
+    }
+
+REG_ROUNDTRIP(reg_access_hca_mgir)
+REG_ROUNDTRIP(reg_access_hca_mcda_reg)
+REG_ROUNDTRIP(tools_open_nvda)
+REG_ROUNDTRIP(tools_open_mgir)
+
+struct check_reg {
+    const char *name;
+    const char *id;             /* of the vector, lower case */
+    reg_roundtrip_func roundtrip;
+    u_int64_t print_hash;
+    const u_int8_t *packed;     /* up to the last non zero byte */
+    unsigned int packed_size;
+};
+
+static void fill_sequence(u_int8_t *buff, unsigned int size, u_int32_t seed)
+{
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        /* xorshift32, the same on every platform */
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        buff[i] = (u_int8_t)seed;
+    }
+}
+
+static u_int64_t hash_buff(u_int64_t h, const u_int8_t *buff, unsigned int size)
+{
+    unsigned int i;
+    for (i = 0; i < size; i++) {
+        h = (h ^ buff[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Runs the register round trip, returns the hash of the printed struct or 0 on error */
+static u_int64_t run_roundtrip(const struct check_reg *reg, u_int32_t seed, u_int8_t *packed)
+{
+    u_int8_t buff[REG_BUFF_SIZE];
+    u_int64_t h = 0xcbf29ce484222325ULL;
+    FILE *fd = tmpfile();
+    size_t n;
+
+    if (!fd) {
+        fprintf(stderr, "-E- %s: failed to create a temporary file\n", reg->name);
+        return 0;
+    }
+    fill_sequence(buff, sizeof(buff), seed);
+    memset(packed, 0, REG_BUFF_SIZE);
+    reg->roundtrip(buff, packed, fd);
+    rewind(fd);
+    while ((n = fread(buff, 1, sizeof(buff), fd)) > 0) {
+        h = hash_buff(h, buff, (unsigned int)n);
+    }
+    fclose(fd);
+    return h;
+}
+
+static int check_regs(const struct check_reg *regs, unsigned int regs_num)
+{
+    u_int8_t packed[REG_BUFF_SIZE];
+    u_int64_t h;
+    unsigned int r, i;
+
+    for (r = 0; r < regs_num; r++) {
+        h = run_roundtrip(&regs[r], r + 1, packed);
+        if (h != regs[r].print_hash) {
+            fprintf(stderr, "-E- %s: unpacked fields differ from the reference (hash 0x%016llx)\n",
+                    regs[r].name, (unsigned long long)h);
+            return 1;
+        }
+        for (i = 0; i < REG_BUFF_SIZE; i++) {
+            if (packed[i] != (i < regs[r].packed_size ? regs[r].packed[i] : 0)) {
+                fprintf(stderr, "-E- %s: packed byte %u is 0x%02x, expected 0x%02x\n", regs[r].name, i,
+                        packed[i], i < regs[r].packed_size ? regs[r].packed[i] : 0);
+                return 1;
+            }
+        }
+        printf("%-18s unpack/pack: OK\n", regs[r].name);
+    }
+    return 0;
+}
+
+static int generate_vectors(const struct check_reg *regs, unsigned int regs_num)
+{
+    u_int8_t packed[REG_BUFF_SIZE];
+    u_int64_t h;
+    unsigned int r, i, size;
+    const char *c;
+
+    for (r = 0; r < regs_num; r++) {
+        if (!(h = run_roundtrip(&regs[r], r + 1, packed))) {
+            return 1;
+        }
+        printf("#define ");
+        for (c = regs[r].id; *c; c++) {
+            putchar(toupper(*c));
+        }
+        printf("_PRINT_HASH 0x%016llxULL\n", (unsigned long long)h);
+        for (size = REG_BUFF_SIZE; size && !packed[size - 1]; size--) {
+        }
+        printf("static const u_int8_t %s_packed[] = {", regs[r].id);
+        for (i = 0; i < size; i++) {
+            printf("%s0x%02x,", i % 12 ? " " : "\n    ", packed[i]);
+        }
+        printf("\n};\n\n");
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct check_reg regs[] = {
+        {"MGIR", "mgir", reg_access_hca_mgir_roundtrip,
+         MGIR_PRINT_HASH, mgir_packed, sizeof(mgir_packed)},
+        {"MCDA", "mcda", reg_access_hca_mcda_reg_roundtrip,
+         MCDA_PRINT_HASH, mcda_packed, sizeof(mcda_packed)},
+        {"MNVDA", "mnvda", tools_open_nvda_roundtrip,
+         MNVDA_PRINT_HASH, mnvda_packed, sizeof(mnvda_packed)},
+        {"MGIR (tools_open)", "tools_open_mgir", tools_open_mgir_roundtrip,
+         TOOLS_OPEN_MGIR_PRINT_HASH, tools_open_mgir_packed, sizeof(tools_open_mgir_packed)},
+    };
+    static const struct bits_impl impls[] = {
+        {"adb2c", adb2c_push_bits_to_buff, adb2c_pop_bits_from_buff},
+        {"packets_common", push_to_buff, pop_from_buff},
+    };
+    unsigned int i;
+
+    if (argc > 1 && !strcmp(argv[1], "-g")) {
+        return generate_vectors(regs, sizeof(regs) / sizeof(regs[0]));
+    }
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (check_bits(&impls[i])) {
+            return 1;
+        }
+        printf("%-18s bit push/pop: OK\n", impls[i].name);
+    }
+    for (i = 0; i < 100000; i++) {
+        if (check_bulk(1 + rand() % 64)) {
+            return 1;
+        }
+    }
+    printf("%-18s bulk push/pop: OK\n", "adb2c");
+    return check_regs(regs, sizeof(regs) / sizeof(regs[0]));
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Jan 2020 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Reference vectors of layouts_check, printed by "layouts_check -g" of a
+ * build with the original byte at a time adb2c push/pop functions.
+ */
+
+#ifndef LAYOUTS_CHECK_VECTORS_H
+#define LAYOUTS_CHECK_VECTORS_H
+
+#define MGIR_PRINT_HASH 0xdf14638742579529ULL
+static const u_int8_t mgir_packed[] = {
+    0x21, 0x01, 0xc5, 0x4f, 0xd1, 0xd0, 0x1a, 0xb2, 0x25, 0x74, 0xcb, 0x37,
+    0x8a, 0xae, 0xf5, 0xb1, 0x08, 0x08, 0x91, 0x19, 0x33, 0xb9, 0xeb, 0x4f,
+    0xf2, 0x29, 0xa5, 0xe4, 0xdb, 0x3e, 0x57, 0x14, 0x01, 0x28, 0xe0, 0xf4,
+    0xfa, 0xe2, 0x7e, 0x07, 0xf1, 0x1a, 0x43, 0x27, 0xb7, 0xe9, 0x45, 0x54,
+    0xad, 0x85, 0x3b, 0xb3, 0xcc, 0xd5, 0xb4, 0xd4, 0xd4, 0x54, 0xd3, 0x8d,
+    0x6d, 0x26, 0x00, 0xc7, 0x60, 0xb0, 0xd4, 0x4a, 0xed, 0xcc, 0x8e, 0x91,
+    0x10, 0x60, 0xdc, 0x05, 0x36, 0xcd, 0x9f, 0xd0, 0x85, 0x14, 0xc6, 0xc0,
+    0x04, 0x4c, 0x07, 0x4f, 0x39, 0x7b, 0x38, 0x5d, 0xbf, 0xc9, 0xc0, 0xda,
+    0x9b, 0xe1, 0x90, 0xf7, 0xbc, 0xa0, 0x48, 0x0a, 0xbb, 0xd3, 0xea, 0xa1,
+    0x70, 0x18, 0x65, 0x0d, 0x79, 0x11, 0x71, 0x90, 0x18, 0x5a, 0x57, 0xa6,
+    0xaa, 0xc6, 0x9d, 0x40, 0xdc, 0xd6, 0x9a, 0x2d, 0xda, 0x81, 0xc1, 0x2d,
+    0x68, 0xec, 0x60, 0x0b, 0x2f, 0xee, 0x92, 0x94, 0xbc, 0x6e, 0x4b, 0x6e,
+    0xb6, 0xd5, 0x02, 0x0a, 0xf9, 0xfd, 0xee, 0x5d, 0xe0, 0x91, 0xc8, 0x94,
+};
+
+#define MCDA_PRINT_HASH 0x971752e7a2c8a61dULL
+static const u_int8_t mcda_packed[] = {
+    0x00, 0x02, 0x82, 0x06, 0x1a, 0x23, 0x59, 0xb6, 0x00, 0x00, 0xca, 0x3d,
+};
+
+#define MNVDA_PRINT_HASH 0xeb22ce422338cf17ULL
+static const u_int8_t mnvda_packed[] = {
+    0x03, 0x03, 0x47, 0x49, 0xcb, 0xf3, 0x43, 0x04, 0x00, 0x00, 0x00, 0x00,
+    0x83, 0x8a, 0xcb, 0x4f, 0xb7, 0xf7, 0xa4, 0x82, 0xbb, 0x51, 0x61, 0xd6,
+    0x15, 0x4d, 0xa1, 0xd1, 0xfb, 0xe7, 0x94, 0x63, 0xd0, 0x53, 0xdd, 0x9e,
+    0xd8, 0x45, 0x9b, 0xda, 0xa5, 0x9f, 0x56, 0x91, 0x95, 0xea, 0x19, 0x60,
+    0xe1, 0x76, 0xa1, 0xc3, 0x80, 0x7f, 0x43, 0x57, 0xb4, 0x2d, 0x42, 0x74,
+    0xa0, 0xa9, 0x7c, 0x05, 0x46, 0x80, 0x56, 0x1c, 0xf4, 0x41, 0x69, 0xe2,
+    0xcc, 0xfe, 0xe9, 0x3e, 0x6b, 0x57, 0x4e, 0x06, 0x89, 0xb6, 0x85, 0x6a,
+    0xd9, 0xcf, 0x54, 0x1e, 0xd6, 0xf5, 0x60, 0xea, 0x40, 0x7b, 0x80, 0x98,
+    0xd6, 0xa9, 0xad, 0x30, 0x03, 0x8b, 0xa5, 0x4e, 0x3a, 0x84, 0xe0, 0x31,
+    0xb7, 0x09, 0xc8, 0x05, 0x8c, 0x36, 0x95, 0x82, 0x81, 0x23, 0x25, 0x45,
+    0xff, 0x13, 0x7a, 0xdb, 0xc9, 0x8a, 0xdb, 0xc4, 0xb9, 0x1e, 0x5c, 0x9d,
+    0x52, 0x87, 0xbd, 0x49, 0x55, 0x97, 0x85, 0x0a, 0x92, 0x58, 0xed, 0xbc,
+    0xaf, 0xdd, 0xaa, 0x6e, 0x01, 0x5f, 0xf9, 0x93, 0x1c, 0x3f, 0x0d, 0xb1,
+    0xe6, 0xbb, 0x00, 0x14, 0x85, 0xa2, 0x2b, 0xc7, 0x5d, 0x4b, 0xc1, 0x61,
+    0xd1, 0xef, 0x9f, 0x28, 0x53, 0x80, 0xfd, 0xd2, 0x25, 0xe9, 0x51, 0x59,
+    0x8e, 0x75, 0xf5, 0xfd, 0x95, 0x29, 0xa5, 0xe7, 0x52, 0x74, 0xf9, 0xb9,
+    0x9e, 0xad, 0xb4, 0xa5, 0x8b, 0x58, 0xb8, 0xe8, 0x80, 0x99, 0xde, 0x3b,
+    0x32, 0x5e, 0x33, 0x16, 0xd6, 0xec, 0x36, 0x38, 0x5f, 0xd2, 0xd9, 0x39,
+    0x81, 0xf6, 0xf5, 0x19, 0x1a, 0x49, 0xd4, 0x67, 0xf5, 0x01, 0x60, 0x38,
+    0x40, 0x55, 0xb3, 0xea, 0xf6, 0x6a, 0xbe, 0x9e, 0x34, 0x9b, 0xcd, 0x34,
+    0x06, 0x4c, 0x2e, 0x0f, 0x2b, 0x1c, 0xe7, 0xeb, 0xe8, 0xaf, 0x6c, 0xdc,
+    0x27, 0xf5, 0x8e, 0xd2, 0x8f, 0x96, 0x76, 0xd7, 0x13, 0x05, 0x98, 0x5c,
+    0xb6, 0x9f, 0xa2, 0x3b,
+};
+
+#define TOOLS_OPEN_MGIR_PRINT_HASH 0xee78f07f3bd8226bULL
+static const u_int8_t tools_open_mgir_packed[] = {
+    0x84, 0x04, 0x04, 0x0c, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0xfc, 0xee,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0xa9, 0x8b, 0x21, 0x32, 0x0e,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x46, 0xa1, 0xf4, 0x0a, 0x22, 0x02, 0xc8,
+    0x11, 0xad, 0x3e, 0x5d, 0xc3, 0x75, 0x1a, 0x1d, 0x00, 0x00, 0x2a, 0xb6,
+    0x61, 0xd0, 0xd8, 0x9c, 0x4a, 0x10, 0x97, 0x7a, 0x16, 0x40, 0xbd, 0x2a,
+    0xe3, 0x32, 0xa3, 0x68, 0x63, 0x3b, 0x46, 0x7e, 0x83, 0x4a, 0x03, 0xfe,
+    0xd2, 0x92, 0x81, 0x03, 0x94, 0x70, 0xc3, 0xc2, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xd8, 0xe5, 0x68, 0xc5, 0x9f, 0x86, 0x78, 0x23, 0x00, 0xa3, 0x99,
+    0xed, 0x3a, 0xc4, 0x15, 0x07, 0xd2, 0xab, 0xbc, 0xb5, 0xab, 0xd5, 0xb2,
+};
+
+#endif